@@ -10,7 +10,7 @@ endif()
 if (MTS_CMAKE_INIT)
   set(MTS_CXX_FLAGS "${CMAKE_CXX_FLAGS}")
   if (CMAKE_CXX_COMPILER_ID MATCHES "GNU|Clang")
-    set(MTS_CXX_FLAGS "-fvisibility=hidden -pipe -march=nocona -ffast-math -Wall -Winvalid-pch")
+    set(MTS_CXX_FLAGS "-fvisibility=hidden -pipe -march=nocona -mtune=generic -ffast-math -Wall -Winvalid-pch")
   endif()
   if (CMAKE_CXX_COMPILER_ID MATCHES "GNU")
     set(MTS_CXX_FLAGS "${MTS_CXX_FLAGS} -mfpmath=sse")
@@ -74,6 +74,8 @@ class PathSampler;
 class Mutator;
 class PathSolver;
 class SpecularManifold;
+class GuidingTree;
+class PathGuide;
 
 MTS_NAMESPACE_END
 
@@ -0,0 +1,289 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_BIDIR_GUIDING_H_)
+#define __MITSUBA_BIDIR_GUIDING_H_
+
+#include <mitsuba/bidir/common.h>
+#include <mitsuba/core/aabb.h>
+#include <mitsuba/core/lock.h>
+#include <mitsuba/render/bsdf.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Spatio-temporal directional distribution used to guide
+ * the random walks of bidirectional path tracing.
+ *
+ * This is a variant of the SD-tree of "Practical Path Guiding for
+ * Efficient Light-Transport Simulation" by M\"uller et al. The spatial
+ * binary tree partitions the scene bounding box together with an
+ * additional dimension: the optical path length accumulated by the
+ * subpath up to the vertex being sampled. Each spatial leaf stores a
+ * directional quad-tree over the cylindrical mapping of the sphere.
+ *
+ * Every leaf holds two quad-trees: one that is used for sampling and
+ * that remains constant throughout the lifetime of the tree, and one
+ * that collects the contributions of the current training iteration.
+ * Recording is thread-safe and lock-free; \ref refine() turns the
+ * collected statistics into the next (immutable) sampling distribution.
+ *
+ * When the maximum path length is zero (e.g. in steady-state
+ * rendering), the path length dimension is ignored.
+ *
+ * \ingroup libbidir
+ */
+class MTS_EXPORT_BIDIR GuidingTree : public Object {
+public:
+	/**
+	 * \brief Create an empty (untrained) guiding tree
+	 *
+	 * \param aabb
+	 *     Bounding box of the scene
+	 * \param maxLength
+	 *     Largest path length of interest (usually the upper bound
+	 *     of the transient decomposition), or zero to disable the
+	 *     path length dimension
+	 * \param bsdfFraction
+	 *     Probability of sampling the BSDF instead of the guiding
+	 *     distribution at guided vertices
+	 * \param recordTarget
+	 *     Number of recorded samples after which the tree should
+	 *     be refined for the first time
+	 */
+	GuidingTree(const AABB &aabb, Float maxLength,
+		Float bsdfFraction, size_t recordTarget);
+
+	/// Can the directions sampled at an interaction with \c bsdf be guided?
+	static inline bool isGuidable(const BSDF *bsdf) {
+		unsigned int type = bsdf->getType();
+		return (type & BSDF::ESmooth)
+			&& !(type & (BSDF::EDelta | BSDF::ETransmission));
+	}
+
+	/// Does the tree provide a sampling distribution at the given location?
+	bool isTrained(const Point &p, Float pathLength) const;
+
+	/// Evaluate the solid angle density of sampling the direction \c d
+	Float pdf(const Point &p, Float pathLength, const Vector &d) const;
+
+	/**
+	 * \brief Sample a world-space direction from the guiding distribution
+	 *
+	 * Must only be called when \ref isTrained() returned \c true
+	 * for the same location. The solid angle density is returned
+	 * in \c pdf.
+	 */
+	Vector sample(const Point &p, Float pathLength,
+		Point2 sample, Float &pdf) const;
+
+	/**
+	 * \brief Record an estimate of the incident radiance (or importance)
+	 * arriving at \c p from the direction \c d.
+	 *
+	 * The value should already be divided by the density of the
+	 * technique that generated \c d.
+	 */
+	void record(const Point &p, Float pathLength, const Vector &d, Float value);
+
+	/// Return the probability of sampling the BSDF at guided vertices
+	inline Float getBSDFSamplingFraction() const { return m_bsdfFraction; }
+
+	/// Return the number of samples recorded since the last refinement
+	inline size_t getRecordCount() const { return (size_t) m_recordCount; }
+
+	/// Return the number of recorded samples that triggers the next refinement
+	inline size_t getRecordTarget() const { return m_recordTarget; }
+
+	/// Return the number of refinements that led to this tree
+	inline int getIteration() const { return m_iteration; }
+
+	/**
+	 * \brief Create the tree of the next training iteration
+	 *
+	 * The contributions collected so far become the new sampling
+	 * distribution. Spatial leaves that received more than
+	 * <tt>spatialThreshold * sqrt(2^iteration)</tt> samples are split,
+	 * and the directional trees are subdivided wherever a quadrant
+	 * holds more than 1% of the energy of its leaf.
+	 */
+	ref<GuidingTree> refine(int spatialThreshold) const;
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Node of a directional quad-tree
+	struct DNode {
+		uint32_t children[4];
+		volatile float sum[4];
+
+		inline DNode() {
+			for (int i=0; i<4; ++i) {
+				children[i] = 0;
+				sum[i] = 0.0f;
+			}
+		}
+
+		inline DNode(const DNode &node) {
+			for (int i=0; i<4; ++i) {
+				children[i] = node.children[i];
+				sum[i] = node.sum[i];
+			}
+		}
+
+		inline DNode &operator=(const DNode &node) {
+			for (int i=0; i<4; ++i) {
+				children[i] = node.children[i];
+				sum[i] = node.sum[i];
+			}
+			return *this;
+		}
+
+		inline Float total() const {
+			return (Float) sum[0] + sum[1] + sum[2] + sum[3];
+		}
+	};
+
+	/// Directional quad-tree (index 0 is the root)
+	struct DTree {
+		std::vector<DNode> nodes;
+
+		inline DTree() : nodes(1) { }
+
+		inline Float total() const { return nodes[0].total(); }
+
+		Float pdf(Point2 uv) const;
+		Point2 sample(Point2 sample) const;
+		void record(Point2 uv, Float value);
+		void refine(const DTree &source, Float threshold, int maxDepth);
+	};
+
+	/// Leaf of the spatial tree
+	struct Leaf {
+		DTree sampling, building;
+		volatile int32_t recordCount;
+
+		inline Leaf() : recordCount(0) { }
+		inline Leaf(const Leaf &leaf) : sampling(leaf.sampling),
+			building(leaf.building), recordCount(leaf.recordCount) { }
+		inline Leaf &operator=(const Leaf &leaf) {
+			sampling = leaf.sampling;
+			building = leaf.building;
+			recordCount = leaf.recordCount;
+			return *this;
+		}
+	};
+
+	/// Node of the spatial tree
+	struct SNode {
+		uint32_t children[2];
+		uint32_t leaf;
+		uint8_t axis;
+		bool isLeaf;
+	};
+
+	/// Create an empty tree that \ref refine() will fill
+	GuidingTree(const GuidingTree *parent);
+
+	/// Virtual destructor
+	virtual ~GuidingTree();
+
+	/// Find the leaf that contains the given location
+	uint32_t lookup(const Point &p, Float pathLength) const;
+
+	/// Append a refined copy of the spatial subtree rooted at \c node of \c parent
+	uint32_t refineNode(const GuidingTree *parent, uint32_t node,
+		int depth, Float threshold);
+
+	/// Append the leaf (or subtree) that replaces \c source
+	uint32_t refineLeaf(const Leaf &source, Float recordCount,
+		int depth, Float threshold);
+private:
+	std::vector<SNode> m_nodes;
+	std::vector<Leaf> m_leaves;
+	AABB m_aabb;
+	Vector m_invExtents;
+	Float m_maxLength;
+	Float m_bsdfFraction;
+	int m_dimensions;
+	int m_iteration;
+	size_t m_recordTarget;
+	volatile int32_t m_recordCount;
+};
+
+/**
+ * \brief Owns the guiding trees of the emitter and sensor subpaths
+ * and coordinates their progressive training among all worker threads.
+ *
+ * Render threads fetch the current trees, record contributions into
+ * them, and periodically call \ref update(). Once enough samples have
+ * been recorded, the first thread to notice refines the tree and
+ * publishes the result; the number of samples between refinements
+ * doubles every iteration.
+ *
+ * \ingroup libbidir
+ */
+class MTS_EXPORT_BIDIR PathGuide : public Object {
+public:
+	/**
+	 * \brief Create a new path guide
+	 *
+	 * \param aabb
+	 *     Bounding box of the scene
+	 * \param maxLength
+	 *     Largest path length of interest, or zero to disable the
+	 *     path length dimension
+	 * \param bsdfFraction
+	 *     Probability of sampling the BSDF at guided vertices
+	 * \param spatialThreshold
+	 *     Number of samples a spatial leaf must receive (in the
+	 *     first iteration) before it is split
+	 */
+	PathGuide(const AABB &aabb, Float maxLength, Float bsdfFraction,
+		int spatialThreshold);
+
+	/// Return the current tree for the subpaths of the given transport mode
+	ref<GuidingTree> getTree(ETransportMode mode) const;
+
+	/**
+	 * \brief Refine \c tree if it has seen enough samples
+	 *
+	 * \return The tree that should be used from now on (either
+	 * \c tree or its successor)
+	 */
+	ref<GuidingTree> update(ETransportMode mode, GuidingTree *tree);
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~PathGuide() { }
+private:
+	ref<GuidingTree> m_trees[2];
+	mutable ref<Mutex> m_mutex;
+	int m_spatialThreshold;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_BIDIR_GUIDING_H_ */
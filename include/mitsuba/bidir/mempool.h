@@ -50,6 +50,7 @@ public:
 		#if defined(MTS_BD_DEBUG_HEAVY)
 		memset(vertex, 0xFF, sizeof(PathVertex));
 		#endif
+		vertex->misFlags = 0;
 		return vertex;
 	}
 
@@ -150,7 +150,9 @@ public:
 	 * \param sampler
 	 *     Pointer to a sample generator
 	 * \param emitterPath
-	 *     Reference to the emitter subpath to be filled
+	 *     Reference to the emitter subpath to be filled. If it already
+	 *     contains more than the supernode (e.g. a cached prefix), the
+	 *     random walk continues from its last vertex.
 	 * \param nEmitterSteps
 	 *     Desired number of random walk steps on the emitter subpath
 	 *     (<tt>-1</tt>=infinite)
@@ -169,13 +171,18 @@ public:
 	 * \param pool
 	 *     Reference to a memory pool that will be used to allocate
 	 *     edges and vertices.
+	 * \param emitterGuide
+	 *     Optional guiding distribution for the emitter subpath
+	 * \param sensorGuide
+	 *     Optional guiding distribution for the sensor subpath
 	 * \return The number of successful steps performed by the random walk
 	 *         on the emitter and sensor subpath, respectively.
 	 */
 	static std::pair<int, int> alternatingRandomWalkFromPixel(const Scene *scene,
 		Sampler *sampler, BDPTWorkResult *wr, Path &emitterPath, int nEmitterSteps,
 		Path &sensorPath, int nSensorSteps, const Point2i &pixelPosition,
-		int rrStart, MemoryPool &pool);
+		int rrStart, MemoryPool &pool, const GuidingTree *emitterGuide = NULL,
+		const GuidingTree *sensorGuide = NULL);
 
 	/**
 	 * \brief Verify the cached values stored in this path
@@ -229,6 +236,22 @@ public:
 		return (int) m_edges.size();
 	}
 
+	/**
+	 * \brief Return the optical length of the path, i.e. the
+	 * distance traveled between the emitter and sensor
+	 *
+	 * This is the sum over the lengths of all edges except for the two
+	 * (purely symbolic) supernode edges. Since mutations update the edges
+	 * in place, the value always refers to the current state of a
+	 * Markov chain.
+	 */
+	inline Float getPathLength() const {
+		Float result = 0;
+		for (size_t i=1; i+1<m_edges.size(); ++i)
+			result += m_edges[i]->length;
+		return result;
+	}
+
 	/// Return an vertex by its index
 	inline PathVertexPtr &vertex(size_t index) {
 		#if MTS_BD_DEBUG == 1
@@ -436,6 +459,49 @@ public:
 			const Path &sensorSubpath, int s, int t,
 			bool direct, bool lightImage, Sampler *sampler);
 
+	/**
+	 * \brief Reference implementation of the elliptic MI weight that
+	 * sweeps over all vertices of both subpaths
+	 *
+	 * \ref miWeightElliptic() falls back to this function whenever the
+	 * partial sums cached by \ref computeMISPartials() cannot be used.
+	 * It is exposed separately so that the two can be compared.
+	 */
+	static Float miWeightEllipticSweep(const Scene *scene,
+			const Path &emitterSubpath,
+			const PathEdge *connectionEdge1,
+			const PathVertex *shadowVertex,
+			const PathEdge *connectionEdge2,
+			const Path &sensorSubpath, int s, int t);
+
+	/**
+	 * \brief Cache partial sums of the MIS weight computation
+	 * on the vertices of this subpath
+	 *
+	 * \ref miWeight() and \ref miWeightElliptic() normally sweep over
+	 * all vertices of both subpaths, which is linear in the path length
+	 * for each connection. After this function has been called on both
+	 * subpaths, most connections can instead be handled in constant time
+	 * by combining the cached sums with the densities of the few vertices
+	 * that depend on the connection itself. Connections involving
+	 * specular or index-matched vertices, or the direct sampling
+	 * strategies (<tt>s==1</tt> and <tt>t==1</tt>), still use the
+	 * general implementation.
+	 *
+	 * The cached values are not updated when the subpath is modified
+	 * afterwards, hence this should be called right after the random walk.
+	 *
+	 * \param mode
+	 *    \ref EImportance for an emitter subpath and
+	 *    \ref ERadiance for a sensor subpath
+	 * \param direct
+	 *    Must match the value later passed to \ref miWeight()
+	 * \param lightImage
+	 *    Must match the value later passed to \ref miWeight()
+	 */
+	void computeMISPartials(const Scene *scene, ETransportMode mode,
+			bool direct, bool lightImage);
+
 
 	/**
 	 * \brief Collapse a path into an entire edge that summarizes the aggregate
@@ -47,6 +47,13 @@ public:
 	 */
 	typedef boost::function<void (int, int, Float, Path &)> PathCallback;
 
+	/**
+	 * \brief Predicate type for use with \ref setSeedFilter()
+	 *
+	 * Returns \c false for paths that should be disregarded.
+	 */
+	typedef boost::function<bool (const Path &)> PathFilter;
+
 	/// Specifies the sampling algorithm that is internally used
 	enum ETechnique {
 		/// Bidirectional path tracing
@@ -168,6 +175,16 @@ public:
 			bool fineGrained, const Bitmap *importanceMap,
 			std::vector<PathSeed> &seeds);
 
+	/**
+	 * \brief Restrict the paths that are considered by \ref generateSeeds()
+	 *
+	 * Only paths accepted by \c filter are turned into seeds and contribute
+	 * to the returned luminance. This is e.g. used by MLT to confine the
+	 * chains to the path length window of a transient film. The filter only
+	 * applies to fine-grained seeds. Pass an empty function to disable it.
+	 */
+	inline void setSeedFilter(const PathFilter &filter) { m_seedFilter = filter; }
+
 	/**
 	 * \brief Compute the average luminance over the image plane
 	 * \param sampleCount
@@ -208,6 +225,7 @@ protected:
 	Path m_emitterSubpath, m_sensorSubpath;
 	Path m_connectionSubpath, m_fullPath;
 	MemoryPool m_pool;
+	PathFilter m_seedFilter;
 };
 
 /**
@@ -69,6 +69,128 @@ public:
 			RenderQueue *queue, int sizeFactor, ref<RenderJob> &nestedJob);
 };
 
+/**
+ * \brief Maps complete paths to the time bins of a transient film
+ *
+ * Used by the Markov chain-based integrators (ERPT, Veach-MLT) to splat
+ * each chain state into the bin that corresponds to its optical length
+ * (\ref Film::ETransient) or bounce count (\ref Film::EBounce), following
+ * the same binning conventions as the bidirectional path tracer.
+ * Optionally, mutations can be restricted to the gate window
+ * <tt>[minBound, maxBound]</tt> so that no effort is spent on paths that
+ * never reach the film.
+ */
+struct TransientGate {
+	Film::EDecompositionType type;
+	Float minBound, maxBound, binWidth;
+	int frames;
+	bool gateMutations;
+
+	inline TransientGate() : type(Film::ESteadyState), minBound(0),
+		maxBound(0), binWidth(1), frames(1), gateMutations(false) { }
+
+	inline TransientGate(Stream *stream) {
+		type = (Film::EDecompositionType) stream->readInt();
+		minBound = stream->readFloat();
+		maxBound = stream->readFloat();
+		binWidth = stream->readFloat();
+		frames = stream->readInt();
+		gateMutations = stream->readBool();
+	}
+
+	inline void serialize(Stream *stream) const {
+		stream->writeInt((int) type);
+		stream->writeFloat(minBound);
+		stream->writeFloat(maxBound);
+		stream->writeFloat(binWidth);
+		stream->writeInt(frames);
+		stream->writeBool(gateMutations);
+	}
+
+	/// Copy the decomposition settings from a film
+	inline void configure(const Film *film) {
+		type = film->getDecompositionType();
+		if (type == Film::ESteadyState)
+			return;
+		if (type == Film::ETransientEllipse)
+			SLog(EError, "Elliptic path sampling is not supported by the "
+				"Metropolis-type integrators, please use \"transient\" instead");
+		if (SPECTRUM_SAMPLES != 3)
+			SLog(EError, "Transient rendering requires SPECTRUM_SAMPLES == 3");
+		minBound = film->getDecompositionMinBound();
+		maxBound = film->getDecompositionMaxBound();
+		binWidth = film->getDecompositionBinWidth();
+		frames = (int) film->getFrames();
+	}
+
+	/// Is a decomposition active?
+	inline bool isActive() const { return type != Film::ESteadyState; }
+
+	/// Should mutations be confined to the gate window?
+	inline bool isGated() const { return gateMutations && isActive(); }
+
+	/// Return the bin coordinate (optical length or bounce count) of a path
+	inline Float getCoordinate(const Path &path) const {
+		return type == Film::EBounce ? (Float) (path.length() - 2)
+			: path.getPathLength();
+	}
+
+	/// Return the time bin of a path, or \c -1 if it lies outside of the gate
+	inline int getBin(const Path &path) const {
+		Float value = getCoordinate(path);
+		if (!(value >= minBound && value <= maxBound))
+			return -1;
+		int bin = math::floorToInt((value - minBound) / binWidth);
+		return bin < frames ? bin : -1;
+	}
+
+	/// Does a path fall into one of the time bins?
+	inline bool contains(const Path &path) const { return getBin(path) >= 0; }
+
+	/**
+	 * \brief Splat the RGB equivalent of \c value into time bin \c bin
+	 * of an image block with three channels per bin, starting at
+	 * channel \c offset
+	 */
+	inline void put(ImageBlock *block, const Point2 &pos,
+			const Spectrum &value, int bin, int offset = 0) const {
+		Float rgb[3];
+		value.toLinearRGB(rgb[0], rgb[1], rgb[2]);
+		block->put(pos, rgb, offset + 3 * bin, 3);
+	}
+
+	/**
+	 * \brief Convert \c frames RGB triplets per pixel (starting at
+	 * channel \c offset of \c source) into the multi-spectrum layout
+	 * used by transient films, scaling them by the per-pixel
+	 * factors \c scale (or 1 when set to \c NULL)
+	 */
+	void develop(const Bitmap *source, int offset, Float factor,
+			const Float *scale, Bitmap *target) const {
+		size_t pixelCount = source->getPixelCount();
+		int srcChannels = source->getChannelCount(),
+		    dstChannels = target->getChannelCount();
+		const Float *src = source->getFloatData();
+		Float *dst = target->getFloatData();
+
+		for (size_t i=0; i<pixelCount; ++i) {
+			Float correction = scale ? factor * scale[i] : factor;
+			for (int j=0; j<3*frames; ++j)
+				dst[j] = src[offset + j] * correction;
+			dst[3*frames] = dst[3*frames + 1] = 1.0f;
+			src += srcChannels;
+			dst += dstChannels;
+		}
+	}
+
+	inline std::string toString() const {
+		if (!isActive())
+			return "no";
+		return formatString("%i bins in [%f, %f]%s", frames, minBound, maxBound,
+			gateMutations ? ", gated mutations" : "");
+	}
+};
+
 /// Restores the measure of a path vertex after going out of scope
 struct RestoreMeasureHelper {
 	RestoreMeasureHelper(PathVertex *vertex)
@@ -88,6 +88,25 @@ struct MTS_EXPORT_BIDIR PathVertex {
 			| ESurfaceInteraction | EMediumInteraction
 	};
 
+	/**
+	 * \brief Flags describing the cached partial sums that are
+	 * used to evaluate MIS weights in constant time
+	 *
+	 * \sa misFlags, Path::computeMISPartials()
+	 */
+	enum EMISFlags {
+		/// The partial sums \ref misPower and \ref misBalance are valid
+		EMISValid = 0x01,
+		/// The partial sums account for direct sampling strategies
+		EMISDirect = 0x02,
+		/// The partial sums account for light image strategies
+		EMISLightImage = 0x04,
+		/// The vertex was connectable when the partial sums were computed
+		EMISConnectable = 0x08,
+		/// All vertices with index 2..i (including this one) are connectable
+		EMISPrefixConnectable = 0x10
+	};
+
 	/**
 	 * \brief Specifies one of several possible path vertex types
 	 *
@@ -201,6 +220,23 @@ struct MTS_EXPORT_BIDIR PathVertex {
 	/// \brief Termination weight due to russian roulette (used by BDPT)
 	Float rrWeight;
 
+	/**
+	 * \brief Partial sums of the power and balance heuristic weights
+	 *
+	 * These store the sum over all strategies that connect two vertices
+	 * with indices less than this one, relative to the density of the
+	 * strategy that ends the subpath here. They are filled in by
+	 * \ref Path::computeMISPartials() and allow \ref Path::miWeight()
+	 * and \ref Path::miWeightElliptic() to run in constant time.
+	 */
+	double misPower, misBalance;
+
+	/// \brief Cached ratio of the direct and regular sampling densities (vertex 2 only)
+	Float misDirect;
+
+	/// \brief Combination of \ref EMISFlags describing the cached values
+	uint8_t misFlags;
+
 	/**
 	 * \brief Auxilary node-depependent data associated with each vertex
 	 *
@@ -289,13 +325,24 @@ struct MTS_EXPORT_BIDIR PathVertex {
 	 *     spectrum value that is used to record the aggregate path weight
 	 *     thus far. It will be updated automatically to account for the current
 	 *     interaction.
+	 * \param guide
+	 *     Optional guiding distribution. At smooth reflective surface
+	 *     interactions where the guide is trained, the outgoing direction
+	 *     is drawn from a one-sample mixture of the BSDF and the guide.
+	 *     Only the \c weight field accounts for this; the \ref pdf
+	 *     fields keep the BSDF densities used for multiple importance
+	 *     sampling.
+	 * \param pathLength
+	 *     Path length accumulated by the subpath up to the current
+	 *     vertex (used to look up the guiding distribution)
 	 * \return \c true on success
 	 */
 	bool sampleNext(const Scene *scene, Sampler *sampler,
 		const PathVertex *pred, const PathEdge *predEdge,
 		PathEdge *succEdge, PathVertex *succ,
 		ETransportMode mode, bool russianRoulette = false,
-		Spectrum *throughput = NULL);
+		Spectrum *throughput = NULL, const GuidingTree *guide = NULL,
+		Float pathLength = 0.0f);
 
 	/**
 	 * \brief \a Direct sampling: given the current vertex as a reference
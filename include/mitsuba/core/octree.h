@@ -62,12 +62,21 @@ public:
 		return m_head;
 	}
 
+	/**
+	 * \brief Insert an item into the list
+	 *
+	 * Items are prepended, so that only a single successful
+	 * compare-and-exchange operation is needed regardless of the
+	 * list length. Concurrent readers either see the old or the
+	 * new head, both of which are valid.
+	 */
 	void append(const T &value) {
-		ListItem *item = new ListItem(value);
-		ListItem **cur = &m_head;
+		ListItem *item = new ListItem(value), *head;
 
-		while (!atomicCompareAndExchangePtr<ListItem>(cur, item, NULL))
-			cur = &((*cur)->next);
+		do {
+			head = m_head;
+			item->next = head;
+		} while (!atomicCompareAndExchangePtr<ListItem>(&m_head, item, head));
 	}
 private:
 	ListItem *m_head;
@@ -139,7 +148,7 @@ public:
 		for (uint32_t i=0; i<m_items.size(); ++i)
 			perm[i] = i;
 
-		/* Build the kd-tree and compute a suitable permutation of the elements */
+		/* Build the octree and compute a suitable permutation of the elements */
 		m_root = build(m_aabb, 0, &perm[0], &temp[0], &perm[0], &perm[0] + m_items.size());
 
 		/* Apply the permutation */
@@ -209,21 +218,30 @@ protected:
 		for (int i=1; i<=8; ++i)
 			nestedOffsets[i] = nestedOffsets[i-1] + nestedCounts[i-1];
 
-		/* Sort by label */
+		/* Sort by label (using the part of the temporary
+		   buffer that corresponds to this node's range) */
+		uint32_t *localTemp = temp + (start - base);
 		for (uint32_t *it = start; it != end; ++it) {
 			int offset = nestedOffsets[m_items[*it].label]++;
-			temp[offset] = *it;
+			localTemp[offset] = *it;
 		}
-		memcpy(start, temp, (end-start) * sizeof(uint32_t));
+		memcpy(start, localTemp, (end-start) * sizeof(uint32_t));
 
-		/* Recurse */
+		uint32_t *childStart[9];
+		childStart[0] = start;
+		for (int i=0; i<8; ++i)
+			childStart[i+1] = childStart[i] + nestedCounts[i];
+
+		/* Recurse. The children cover disjoint ranges of all buffers,
+		   hence large subtrees near the root can be built in parallel */
 		OctreeNode *result = new OctreeNode();
+#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(dynamic) if (depth == 0 && end-start > 65536)
+#endif
 		for (int i=0; i<8; i++) {
 			AABB bounds = childBounds(i, aabb, center);
-
-			uint32_t *it = start + nestedCounts[i];
-			result->children[i] = build(bounds, depth+1, base, temp, start, it);
-			start = it;
+			result->children[i] = build(bounds, depth+1, base, temp,
+				childStart[i], childStart[i+1]);
 		}
 
 		result->leaf = false;
@@ -152,6 +152,17 @@
 #error Unsupported compiler!
 #endif
 
+/* Functions marked with MTS_TARGET("avx") etc. may use instruction set
+   extensions beyond the compile-time baseline. They must only be called
+   after checking getSIMDLevel() (see mitsuba/core/util.h) */
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define MTS_TARGET(isa)        __attribute__((target(isa)))
+#define MTS_HAS_TARGET_ATTRIBUTE
+#else
+#define MTS_TARGET(isa)
+#endif
+
 #ifdef MTS_SSE
 #define SSE_STR	"SSE2 enabled"
 #else
@@ -21,6 +21,7 @@
 #define __MITSUBA_CORE_SCHED_REMOTE_H_
 
 #include <mitsuba/core/sched.h>
+#include <boost/filesystem.hpp>
 #include <set>
 
 /// Default port of <tt>mtssrv</tt>
@@ -35,11 +36,124 @@
    continue sending batches of work units */
 #define MTS_CONTINUE_FACTOR 2
 
+/** Default amount of memory (in MiB) that a render server
+   uses to cache the contents of resources between jobs */
+#define MTS_DEFAULT_RESOURCE_CACHE 4096
+
 MTS_NAMESPACE_BEGIN
 
 class RemoteWorkerReader;
 class StreamBackend;
 
+/**
+ * \brief 128-bit content hash of a part of a serialized resource
+ *
+ * Resources are split into content-defined chunks when they are
+ * transmitted to a processing node. The chunks are identified by
+ * this hash, which makes it possible to reuse them between
+ * consecutive jobs (see \ref ResourceCache).
+ *
+ * \ingroup libcore
+ */
+struct MTS_EXPORT_CORE ResourceHash {
+	uint64_t h1, h2;
+
+	inline ResourceHash() : h1(0), h2(0) { }
+
+	/// Compute the hash of a memory region (MurmurHash3, x64 128-bit variant)
+	static ResourceHash compute(const void *data, size_t size);
+
+	/// Read a hash from a stream
+	inline void load(Stream *stream) {
+		h1 = stream->readULong();
+		h2 = stream->readULong();
+	}
+
+	/// Write the hash to a stream
+	inline void save(Stream *stream) const {
+		stream->writeULong(h1);
+		stream->writeULong(h2);
+	}
+
+	inline bool operator==(const ResourceHash &h) const {
+		return h1 == h.h1 && h2 == h.h2;
+	}
+
+	inline bool operator<(const ResourceHash &h) const {
+		return h1 < h.h1 || (h1 == h.h1 && h2 < h.h2);
+	}
+
+	/// Return a hexadecimal representation
+	std::string toString() const;
+};
+
+/**
+ * \brief Content-addressed cache for serialized resources
+ *
+ * A processing node keeps the chunks of serialized resources it has
+ * received, indexed by their \ref ResourceHash. When a later job uses
+ * a resource with partly the same contents (e.g. the scene of a
+ * parameter sweep, where only the sensor or the output file changed),
+ * the client only sends the hashes of the known chunks instead of their
+ * data. Entries are evicted in least-recently-used order once the memory
+ * limit is exceeded. When a directory is specified, every chunk is
+ * additionally written to disk, so that it also survives eviction and
+ * restarts of the server.
+ *
+ * The cache is thread-safe and can be shared by several
+ * instances of \ref StreamBackend.
+ *
+ * \ingroup libcore
+ */
+class MTS_EXPORT_CORE ResourceCache : public Object {
+public:
+	/**
+	 * \brief Create a new resource cache
+	 *
+	 * \param memoryLimit
+	 *    Maximum amount of memory (in bytes) used by the in-memory cache
+	 * \param directory
+	 *    Optional directory for the on-disk cache (disabled when empty)
+	 */
+	ResourceCache(size_t memoryLimit, const fs::path &directory = fs::path());
+
+	/**
+	 * \brief Look up the data of a resource chunk
+	 *
+	 * \return The chunk data, or \c NULL when it is not cached
+	 */
+	ref<MemoryStream> get(const ResourceHash &hash);
+
+	/// Insert the data of a resource chunk into the cache
+	void put(const ResourceHash &hash, MemoryStream *data);
+
+	/// Return the amount of memory used by the in-memory cache
+	inline size_t getMemoryUsage() const { return m_memoryUsage; }
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~ResourceCache() { }
+
+	/// Insert an entry into the in-memory cache (lock must be held)
+	void insert(const ResourceHash &hash, MemoryStream *data);
+private:
+	struct Entry {
+		ref<MemoryStream> data;
+		uint64_t lastAccess;
+	};
+
+	std::map<ResourceHash, Entry> m_entries;
+	ref<Mutex> m_mutex;
+	fs::path m_directory;
+	size_t m_memoryLimit;
+	size_t m_memoryUsage;
+	uint64_t m_timestamp;
+};
+
 /**
  * \brief Acquires work from the scheduler and forwards
  * it to a processing node reachable through a \ref Stream.
@@ -72,6 +186,23 @@ protected:
 	virtual void start(Scheduler *scheduler, int workerIndex, int coreOffset);
 	void flush();
 
+	/**
+	 * \brief Ask the remote side which of the given resource chunks
+	 * are already present in its resource cache
+	 *
+	 * Must be called while \c m_mutex is held.
+	 */
+	std::vector<bool> queryResources(const std::vector<ResourceHash> &hashes,
+		const std::vector<size_t> &sizes);
+
+	/// Called by \ref RemoteWorkerReader when the cache query was answered
+	inline void signalQueryResponse(const std::vector<bool> &cached) {
+		LockGuard lock(m_mutex);
+		m_queryResponse = cached;
+		m_queryDone = true;
+		m_finishCond->signal();
+	}
+
 	inline void signalCompletion() {
 		LockGuard lock(m_mutex);
 		m_inFlight--;
@@ -91,6 +222,8 @@ protected:
 	std::set<std::string> m_plugins;
 	std::string m_nodeName;
 	size_t m_inFlight;
+	std::vector<bool> m_queryResponse;
+	bool m_queryDone;
 };
 
 /**
@@ -212,9 +345,14 @@ public:
 	 *    Stream used for communications
 	 * \param detach
 	 *    Should the associated thread be joinable or detach instead?
+	 * \param cache
+	 *    Optional cache, which retains the contents of resources
+	 *    between jobs. When set to \c NULL, every resource is
+	 *    transmitted in full.
 	 */
 	StreamBackend(const std::string &name, Scheduler *scheduler,
-		const std::string &nodeName, Stream *stream, bool detach);
+		const std::string &nodeName, Stream *stream, bool detach,
+		ResourceCache *cache = NULL);
 
 	MTS_DECLARE_CLASS()
 protected:
@@ -233,6 +371,8 @@ protected:
 		EResourceExpired,
 		EQuit,
 		EIncompatible,
+		EQueryResources,
+		EResourceStatus,
 		EHello = 0x1bcd
 	};
 
@@ -241,6 +381,8 @@ protected:
 	virtual void run();
 	void sendWorkResult(int id, const WorkResult *result, bool cancelled);
 	void sendCancellation(int id, int numLost);
+	/// Deserialize a (multi-)resource and register it with the scheduler
+	void registerResource(int id, MemoryStream *data, bool multi);
 private:
 	Scheduler *m_scheduler;
 	std::string m_nodeName;
@@ -248,6 +390,10 @@ private:
 	ref<MemoryStream> m_memStream;
 	std::map<int, RemoteProcess *> m_processes;
 	std::map<int, int> m_resources;
+	ref<ResourceCache> m_cache;
+	/* Cache entries that were reported as present by the last
+	   query, kept alive until the client has referred to them */
+	std::map<ResourceHash, ref<MemoryStream> > m_pinned;
 	ref<Mutex> m_sendMutex;
 	bool m_detach;
 };
@@ -52,6 +52,14 @@
 # pragma intrinsic(__rdtsc)
 #endif
 
+/* AVX kernels can be compiled when AVX is part of the baseline, or when
+   they can be compiled individually using MTS_TARGET("avx") and are
+   then selected at runtime based on getSIMDLevel() */
+#if defined(__AVX__) || defined(MTS_HAS_TARGET_ATTRIBUTE)
+# define MTS_HAS_AVX_KERNELS
+# include <immintrin.h>
+#endif
+
 #define splat_ps(ps, i)          _mm_shuffle_ps   ((ps),(ps), (i<<6) | (i<<4) | (i<<2) | i)
 #define splat_epi32(ps, i)       _mm_shuffle_epi32((ps), (i<<6) | (i<<4) | (i<<2) | i)
 #define mux_ps(sel, op1, op2)    _mm_or_ps   (_mm_and_ps   ((sel), (op1)), _mm_andnot_ps   ((sel), (op2)))
@@ -79,6 +79,22 @@ public:
 	/// Return the core affinity
 	int getCoreAffinity() const;
 
+	/**
+	 * \brief Restrict the thread to the processors of a NUMA node
+	 *
+	 * Unlike \ref setCoreAffinity(), the operating system may still
+	 * migrate the thread between the cores of the node, but never to
+	 * another node. The parameter -1 (the default) removes the restriction.
+	 * Only supported on Linux.
+	 */
+	void setNUMANodeAffinity(int node);
+
+	/**
+	 * \brief Return the NUMA node on which this thread runs, or -1 when
+	 * it is not pinned to a core or NUMA node
+	 */
+	int getNUMANode() const;
+
 	/**
 	 * \brief Specify whether or not this thread is critical
 	 *
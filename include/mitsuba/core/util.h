@@ -108,6 +108,94 @@ extern std::string MTS_EXPORT_CORE lastErrorText();
 /// Determine the number of available CPU cores
 extern MTS_EXPORT_CORE int getCoreCount();
 
+/**
+ * \brief Allocate a large, aligned region of memory that is preferably
+ * backed by transparent huge pages
+ *
+ * Intended for large arrays that are accessed randomly (e.g. kd-tree nodes),
+ * where huge pages reduce the number of TLB misses. Falls back to
+ * \ref allocAligned() on small sizes and on platforms other than Linux.
+ * The memory must be released using \ref freeAligned().
+ */
+extern MTS_EXPORT_CORE void * __restrict allocHugeAligned(size_t size);
+
+/// Return the number of NUMA nodes (1 when not available, e.g. on non-Linux platforms)
+extern MTS_EXPORT_CORE int getNUMANodeCount();
+
+/// Return the NUMA node of a logical processor (0 when not available)
+extern MTS_EXPORT_CORE int getNUMANodeOfProcessor(int processor);
+
+/// Return the logical processors that belong to a NUMA node
+extern MTS_EXPORT_CORE std::vector<int> getNUMANodeProcessors(int node);
+
+/**
+ * \brief Return the NUMA node of the calling thread, or -1 when it is
+ * not pinned (see \ref Thread::getNUMANode())
+ *
+ * This only reads a thread-local variable and is cheap enough to be
+ * called for every ray. It also works on threads that were not
+ * created by Mitsuba (which are never pinned).
+ */
+extern MTS_EXPORT_CORE int getCurrentNUMANode();
+
+/**
+ * \brief Copy a memory region into a new allocation on the given NUMA node
+ *
+ * The memory is allocated using \ref allocHugeAligned() and first touched
+ * by a thread that is pinned to the node, so that the kernel places its
+ * pages there. It must be released using \ref freeAligned().
+ */
+extern MTS_EXPORT_CORE void *copyToNUMANode(const void *src, size_t size, int node);
+
+/**
+ * \brief Enable or disable the replication of read-only acceleration
+ * data structures on every NUMA node (disabled by default)
+ *
+ * When enabled, structures that are built afterwards (e.g. the kd-tree of
+ * a scene) keep one copy per NUMA node, and threads pinned to a node (see
+ * \ref Thread::setCoreAffinity() and \ref Thread::setNUMANodeAffinity())
+ * use the local one.
+ */
+extern MTS_EXPORT_CORE void setNUMAReplication(bool enabled);
+
+/// Return whether NUMA replication is enabled
+extern MTS_EXPORT_CORE bool getNUMAReplication();
+
+/// SIMD instruction set extensions, ordered by increasing capability
+enum ESIMDLevel {
+	ESIMDNone = 0,
+	ESIMDSSE2,
+	ESIMDSSE42,
+	ESIMDAVX,
+	ESIMDAVX2,
+	ESIMDAVX512
+};
+
+/**
+ * \brief Return the most capable SIMD instruction set extension that is
+ * supported by the processor and enabled by the operating system
+ *
+ * Kernels with several implementations use this to pick one at runtime,
+ * so that a portable binary still uses the widest available vectors.
+ * Setting the environment variable \c MTS_SIMD (to \c none, \c sse2,
+ * \c sse4.2, \c avx, \c avx2 or \c avx512) lowers the detected level,
+ * which is useful to test the fallback implementations.
+ */
+extern MTS_EXPORT_CORE ESIMDLevel getSIMDLevel();
+
+/// Return a human-readable name of a SIMD level
+extern MTS_EXPORT_CORE const char *getSIMDLevelName(ESIMDLevel level);
+
+/**
+ * \brief Does the processor support the F16C half precision conversion
+ * instructions?
+ *
+ * F16C is a separate CPUID feature that is not implied by any of the
+ * levels above. Since the instructions operate on AVX registers, this
+ * also requires \ref getSIMDLevel() to be at least \ref ESIMDAVX.
+ */
+extern MTS_EXPORT_CORE bool hasF16C();
+
 /// Return the host name of this machine
 extern MTS_EXPORT_CORE std::string getHostName();
 
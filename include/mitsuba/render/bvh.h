@@ -72,20 +72,18 @@ public:
 	}
 	void expandBBox(AABB &bb, const T &ta){
 		const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-		const Triangle *triangles = mesh->getTriangles();
 		const Point *positions = mesh->getVertexPositions();
 
-		const Triangle &tri = triangles[ta.primIndex];
+		const Triangle tri = mesh->getTriangle(ta.primIndex);
 		bb.expandBy(positions[tri.idx[0]]);
 		bb.expandBy(positions[tri.idx[1]]);
 		bb.expandBy(positions[tri.idx[2]]);
 	}
 	Point getCenter(const T &ta) const{
 		const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-		const Triangle *triangles = mesh->getTriangles();
 		const Point *positions = mesh->getVertexPositions();
 
-		const Triangle &tri = triangles[ta.primIndex];
+		const Triangle tri = mesh->getTriangle(ta.primIndex);
 		return 0.33f * (positions[tri.idx[0]] +
 						positions[tri.idx[1]] +
 						positions[tri.idx[2]]);
@@ -108,6 +108,48 @@ public:
 	inline size_t getSBounces() const {return m_sBounces; }
 	inline size_t getTBounces() const {return m_tBounces; }
 
+	/**
+	 * \brief Does the film restrict rendering to a region of interest?
+	 *
+	 * This is the case when a pixel mask (\c roiMask) or a bin range
+	 * (\c roiMinBin, \c roiMaxBin) narrower than the full histogram
+	 * was specified. Integrators then only need to render the selected
+	 * pixels and bins; films that resume an existing rendering merge the
+	 * new samples exclusively into this region.
+	 */
+	inline bool hasRegionOfInterest() const {
+		return m_roiMask.get() != NULL || m_roiMinBin > 0 ||
+			m_roiMaxBin < (int) m_frames - 1;
+	}
+
+	/**
+	 * \brief Is the given pixel (relative to the crop window) part of
+	 * the region of interest?
+	 *
+	 * Always returns \c true when no pixel mask was specified.
+	 */
+	inline bool isInRegionOfInterest(const Point2i &pixel) const {
+		if (m_roiMask.get() == NULL)
+			return true;
+		if (pixel.x < 0 || pixel.y < 0 || pixel.x >= m_cropSize.x || pixel.y >= m_cropSize.y)
+			return false;
+		return m_roiMask->getUInt8Data()[pixel.x + (size_t) pixel.y * m_cropSize.x] != 0;
+	}
+
+	/**
+	 * \brief Return the number of pixels in the region of interest
+	 *
+	 * Equals the number of pixels of the crop window when no pixel mask
+	 * was specified.
+	 */
+	inline size_t getRegionPixelCount() const { return m_roiPixelCount; }
+
+	/// Return the first time bin of the region of interest
+	inline int getRegionMinBin() const { return m_roiMinBin; }
+
+	/// Return the last time bin of the region of interest (inclusive)
+	inline int getRegionMaxBin() const { return m_roiMaxBin; }
+
 	/**
 	 * \brief Develop the contents of a subregion of the film and store
 	 * it inside the given bitmap
@@ -123,6 +165,33 @@ public:
 		const Point2i &targetOffset,
 		Bitmap *target) const = 0;
 
+	/**
+	 * \brief Develop the entire film into a new 32-bit floating point
+	 * bitmap in memory
+	 *
+	 * Transient films return an \ref Bitmap::EMultiChannel image that
+	 * stores the channels of all frames one after the other (in the same
+	 * layout that is written to disk).
+	 *
+	 * \return The developed bitmap, or \c NULL when the film does not have
+	 * an explicit representation of its contents (the default)
+	 */
+	virtual ref<Bitmap> developBitmap() const;
+
+	/**
+	 * \brief Attach auxiliary per-pixel channels (AOVs) that are written
+	 * together with the film contents when the film is developed
+	 *
+	 * \c aovs must be a \ref Bitmap::EMultiChannel image with the size of
+	 * the crop window and named channels (e.g. "depth.Y"). Passing \c NULL
+	 * removes previously attached channels. Films that cannot store extra
+	 * channels ignore them.
+	 */
+	inline void setAOVs(Bitmap *aovs) { m_aovs = aovs; }
+
+	/// Return the attached AOVs (or \c NULL)
+	inline const Bitmap *getAOVs() const { return m_aovs.get(); }
+
 	/// Does the destination file already exist?
 	virtual bool destinationExists(const fs::path &basename) const = 0;
 
@@ -176,6 +245,7 @@ protected:
 	Vector2i m_size, m_cropSize;
 	bool m_highQualityEdges;
 	ref<ReconstructionFilter> m_filter;
+	ref<Bitmap> m_aovs;
 
 protected:
 // For BDPT decomposition renderer:
@@ -199,6 +269,11 @@ protected:
 	bool m_forceBounces;
 	unsigned int m_sBounces;
 	unsigned int m_tBounces;
+
+	// Region of interest for incremental re-rendering
+	ref<Bitmap> m_roiMask;
+	size_t m_roiPixelCount;
+	int m_roiMinBin, m_roiMaxBin;
 };
 
 MTS_NAMESPACE_END
@@ -77,6 +77,7 @@ class SparseMipmap3D;
 class Spiral;
 class Subsurface;
 class Texture;
+class TileCache;
 struct TriAccel;
 struct TriAccel4;
 class TriMesh;
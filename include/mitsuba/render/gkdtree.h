@@ -753,6 +753,50 @@ public:
 			delete[] m_indices;
 		if (m_nodes)
 			freeAligned(m_nodes-1); // undo alignment shift
+		for (size_t i=0; i<m_nodeReplicas.size(); ++i) {
+			freeAligned(m_nodeReplicas[i]-1);
+			freeAligned(m_indexReplicas[i]);
+		}
+	}
+
+	/**
+	 * \brief Keep a copy of the tree nodes and the index buffer on
+	 * every NUMA node
+	 *
+	 * Threads that are pinned to a NUMA node then traverse the local
+	 * copy (see \ref getLocalNodes()). Does nothing on machines with
+	 * a single NUMA node. Must be called after the tree has been built.
+	 */
+	void replicateNUMA() {
+		int nodeCount = getNUMANodeCount();
+		if (nodeCount < 2 || !isBuilt() || !m_nodeReplicas.empty())
+			return;
+
+		for (int i=0; i<nodeCount; ++i) {
+			m_nodeReplicas.push_back(static_cast<KDNode *>(copyToNUMANode(m_nodes-1,
+				sizeof(KDNode) * (m_nodeCount+1), i))+1);
+			m_indexReplicas.push_back(static_cast<IndexType *>(copyToNUMANode(m_indices,
+				sizeof(IndexType) * m_indexCount, i)));
+		}
+
+		KDLog(EDebug, "Replicated the kd-tree on %i NUMA nodes (%s per node)", nodeCount,
+			memString(sizeof(KDNode) * m_nodeCount + sizeof(IndexType) * m_indexCount).c_str());
+	}
+
+	/// Return the tree nodes that are local to the NUMA node of the calling thread
+	inline const KDNode *getLocalNodes() const {
+		if (EXPECT_TAKEN(m_nodeReplicas.empty()))
+			return m_nodes;
+		int node = getCurrentNUMANode();
+		return node >= 0 ? m_nodeReplicas[node] : m_nodes;
+	}
+
+	/// Return the index buffer that is local to the NUMA node of the calling thread
+	inline const IndexType *getLocalIndices() const {
+		if (EXPECT_TAKEN(m_indexReplicas.empty()))
+			return m_indices;
+		int node = getCurrentNUMANode();
+		return node >= 0 ? m_indexReplicas[node] : m_indices;
 	}
 
 	/**
@@ -1110,7 +1154,7 @@ protected:
 		m_indexCount = ctx.primIndexCount;
 
 		// +1 shift is for alignment purposes (see KDNode::getSibling)
-		m_nodes = static_cast<KDNode *> (allocAligned(
+		m_nodes = static_cast<KDNode *> (allocHugeAligned(
 				sizeof(KDNode) * (m_nodeCount+1)))+1;
 		m_indices = new IndexType[m_indexCount];
 
@@ -2603,6 +2647,8 @@ protected:
 	SizeType m_minMaxBins;
 	SizeType m_nodeCount;
 	SizeType m_indexCount;
+	std::vector<KDNode *> m_nodeReplicas;
+	std::vector<IndexType *> m_indexReplicas;
 	std::vector<TreeBuilder *> m_builders;
 	std::vector<KDNode *> m_indirections;
 	ref<Mutex> m_indirectionLock;
@@ -23,6 +23,7 @@
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/sched.h>
 #include <mitsuba/core/rfilter.h>
+#include <mitsuba/core/sse.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -157,39 +158,18 @@ public:
 		}
 
 		{
-			const Float filterRadius = m_filter->getRadius();
-			const Vector2i &size = m_bitmap->getSize();
-
-			/* Convert to pixel coordinates within the image block */
-			const Point2 pos(
-				_pos.x - 0.5f - (m_offset.x - m_borderSize),
-				_pos.y - 0.5f - (m_offset.y - m_borderSize));
-
-			/* Determine the affected range of pixels */
-			const Point2i min(std::max((int) std::ceil (pos.x - filterRadius), 0),
-			                  std::max((int) std::ceil (pos.y - filterRadius), 0)),
-			              max(std::min((int) std::floor(pos.x + filterRadius), size.x - 1),
-			                  std::min((int) std::floor(pos.y + filterRadius), size.y - 1));
-
-			/* Lookup values from the pre-rasterized filter */
-			for (int x=min.x, idx = 0; x<=max.x; ++x)
-				m_weightsX[idx++] = m_filter->evalDiscretized(x-pos.x);
-			for (int y=min.y, idx = 0; y<=max.y; ++y)
-				m_weightsY[idx++] = m_filter->evalDiscretized(y-pos.y);
-
-			/* Rasterize the filtered sample into the framebuffer */
-			for (int y=min.y, yr=0; y<=max.y; ++y, ++yr) {
-				const Float weightY = m_weightsY[yr];
-				Float *dest = m_bitmap->getFloatData()
-					+ (y * (size_t) size.x + min.x) * channels;
-
-				for (int x=min.x, xr=0; x<=max.x; ++x, ++xr) {
-					const Float weight = m_weightsX[xr] * weightY;
-
-					for (int k=0; k<channels; ++k)
-						*dest++ += weight * value[k];
-				}
-			}
+			Point2i min, max;
+			lookupFilter(_pos, min, max);
+
+			/* Rasterize the filtered sample into the framebuffer. The common
+			   spectrum+alpha+weight layout gets a fully unrolled kernel, while
+			   wide (e.g. transient) layouts use the widest available vectors */
+			if (channels == SPECTRUM_SAMPLES + 2)
+				rasterize<SPECTRUM_SAMPLES + 2>(min, max, value, channels);
+			else if (channels >= 16)
+				rasterizeWide(min, max, value, channels);
+			else
+				rasterize<0>(min, max, value, channels);
 		}
 
 		return true;
@@ -209,6 +189,45 @@ public:
 		return false;
 	}
 
+	/**
+	 * \brief Store a single sample that only affects the channels
+	 * <tt>[offset, offset+count)</tt> of the block
+	 *
+	 * This is useful for wide layouts (e.g. one RGB triplet per time bin)
+	 * where a sample only contributes to a small subset of the channels.
+	 * The remaining channels are left untouched instead of accumulating
+	 * explicit zeros.
+	 *
+	 * \param value
+	 *    Pointer to an array containing \c count channel values
+	 * \return \c false if one of the sample values was \a invalid
+	 */
+	FINLINE bool put(const Point2 &_pos, const Float *value, int offset, int count) {
+		for (int i=0; i<count; ++i) {
+			if (EXPECT_NOT_TAKEN(!std::isfinite(value[i]) && m_warn)) {
+				Log(EWarn, "Invalid sample value in channel %i: %f", offset+i, value[i]);
+				return false;
+			}
+		}
+
+		Point2i min, max;
+		lookupFilter(_pos, min, max);
+
+		const int channels = m_bitmap->getChannelCount();
+		const size_t width = (size_t) m_bitmap->getWidth();
+		for (int y=min.y, yr=0; y<=max.y; ++y, ++yr) {
+			const Float weightY = m_weightsY[yr];
+			Float *dest = m_bitmap->getFloatData()
+				+ (y * width + min.x) * channels + offset;
+
+			for (int xr=0; xr<=max.x-min.x; ++xr) {
+				splat(dest, value, m_weightsX[xr] * weightY, count);
+				dest += channels;
+			}
+		}
+		return true;
+	}
+
 	/// Create a clone of the entire image block
 	ref<ImageBlock> clone() const {
 		ref<ImageBlock> clone = new ImageBlock(m_bitmap->getPixelFormat(),
@@ -240,6 +259,85 @@ public:
 protected:
 	/// Virtual destructor
 	virtual ~ImageBlock();
+
+	/**
+	 * \brief Determine the range of pixels affected by a sample at
+	 * \c _pos and store the associated filter weights in \c m_weightsX/Y
+	 */
+	FINLINE void lookupFilter(const Point2 &_pos, Point2i &min, Point2i &max) {
+		const Float filterRadius = m_filter->getRadius();
+		const Vector2i &size = m_bitmap->getSize();
+
+		/* Convert to pixel coordinates within the image block */
+		const Point2 pos(
+			_pos.x - 0.5f - (m_offset.x - m_borderSize),
+			_pos.y - 0.5f - (m_offset.y - m_borderSize));
+
+		/* Determine the affected range of pixels */
+		min = Point2i(std::max((int) std::ceil (pos.x - filterRadius), 0),
+		              std::max((int) std::ceil (pos.y - filterRadius), 0));
+		max = Point2i(std::min((int) std::floor(pos.x + filterRadius), size.x - 1),
+		              std::min((int) std::floor(pos.y + filterRadius), size.y - 1));
+
+		/* Lookup values from the pre-rasterized filter */
+		for (int x=min.x, idx = 0; x<=max.x; ++x)
+			m_weightsX[idx++] = m_filter->evalDiscretized(x-pos.x);
+		for (int y=min.y, idx = 0; y<=max.y; ++y)
+			m_weightsY[idx++] = m_filter->evalDiscretized(y-pos.y);
+	}
+
+	/**
+	 * \brief Add the weighted sample \c value to the pixels in the range
+	 * [\c min, \c max] using the filter weights in \c m_weightsX/Y
+	 *
+	 * When \c FixedChannels is nonzero, it overrides \c channels so that
+	 * the inner loop has a compile-time trip count.
+	 */
+	template <int FixedChannels> FINLINE void rasterize(const Point2i &min,
+			const Point2i &max, const Float *value, int channels) {
+		if (FixedChannels > 0)
+			channels = FixedChannels;
+		const size_t width = (size_t) m_bitmap->getWidth();
+
+		for (int y=min.y, yr=0; y<=max.y; ++y, ++yr) {
+			const Float weightY = m_weightsY[yr];
+			Float *dest = m_bitmap->getFloatData()
+				+ (y * width + min.x) * channels;
+
+			for (int xr=0; xr<=max.x-min.x; ++xr) {
+				splat(dest, value, m_weightsX[xr] * weightY, channels);
+				dest += channels;
+			}
+		}
+	}
+
+	/**
+	 * \brief Variant of \ref rasterize() for layouts with many channels
+	 *
+	 * Uses AVX when supported by the processor, even if the compile-time
+	 * baseline only includes SSE2 (see \ref getSIMDLevel())
+	 */
+	void rasterizeWide(const Point2i &min, const Point2i &max,
+			const Float *value, int channels);
+
+	/// Compute <tt>dest[k] += weight * value[k]</tt> for \c channels entries
+	static FINLINE void splat(Float *dest, const Float *value, Float weight, int channels) {
+		int k = 0;
+#if defined(MTS_SSE)
+#if defined(__AVX__)
+		const __m256 weight8 = _mm256_set1_ps(weight);
+		for (; k+8 <= channels; k += 8)
+			_mm256_storeu_ps(dest + k, _mm256_add_ps(_mm256_loadu_ps(dest + k),
+				_mm256_mul_ps(weight8, _mm256_loadu_ps(value + k))));
+#endif
+		const __m128 weight4 = _mm_set1_ps(weight);
+		for (; k+4 <= channels; k += 4)
+			_mm_storeu_ps(dest + k, _mm_add_ps(_mm_loadu_ps(dest + k),
+				_mm_mul_ps(weight4, _mm_loadu_ps(value + k))));
+#endif
+		for (; k<channels; ++k)
+			dest[k] += weight * value[k];
+	}
 protected:
 	ref<Bitmap> m_bitmap;
 	Point2i m_offset;
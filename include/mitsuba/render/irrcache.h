@@ -215,6 +215,14 @@ public:
 	/// Manually insert an irradiance record
 	void insert(Record *rec);
 
+	/**
+	 * \brief Insert a batch of irradiance records
+	 *
+	 * Since octree insertions are lock-free, the records are
+	 * distributed over all available cores.
+	 */
+	void insert(const std::vector<Record *> &records);
+
 	/**
 	 * Serialize an irradiance cache to a binary data stream
 	 */
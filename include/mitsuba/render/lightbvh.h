@@ -0,0 +1,149 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_LIGHTBVH_H_)
+#define __MITSUBA_RENDER_LIGHTBVH_H_
+
+#include <mitsuba/render/emitter.h>
+#include <mitsuba/core/aabb.h>
+#include <boost/unordered_map.hpp>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Bounding hierarchy over the emitters of a scene that is used to
+ * pick an emitter for direct illumination sampling
+ *
+ * Every node stores a spatial bound (an axis-aligned box), an orientation
+ * bound (a cone of emission directions plus the maximum angle of emission
+ * beyond it) and the total emitted power of its subtree. Starting at the
+ * root, the sampling routine descends into one of the two children with a
+ * probability that is proportional to a conservative estimate of the
+ * power that the child can deliver to the shading point. This follows the
+ * "light BVH" of PBRT v4 (based on Conty Estevez and Kulla,
+ * "Importance Sampling of Many Lights with Adaptive Tree Splitting").
+ *
+ * Emitters without a finite spatial extent (environment maps, directional
+ * emitters, etc.) are not part of the hierarchy and are chosen uniformly
+ * with a probability of <tt>n/(n+1)</tt>, where \c n denotes their number.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER LightBVH : public Object {
+public:
+	/// Build the hierarchy over a list of (configured) emitters
+	LightBVH(const ref_vector<Emitter> &emitters);
+
+	/**
+	 * \brief Choose an emitter for direct illumination sampling
+	 *
+	 * \param p
+	 *    Position of the shading point
+	 * \param n
+	 *    Normal at the shading point, or a zero vector for points
+	 *    that are located in a participating medium
+	 * \param sample
+	 *    A uniformly distributed number on <tt>[0, 1)</tt>. It is
+	 *    remapped so that it can be reused for subsequent sampling steps.
+	 * \param pdf
+	 *    Returns the discrete probability of the chosen emitter
+	 * \return
+	 *    The index of the emitter in the list passed to the constructor,
+	 *    or <tt>(size_t) -1</tt> when no emitter can illuminate \c p
+	 */
+	size_t sample(const Point &p, const Normal &n, Float &sample, Float &pdf) const;
+
+	/**
+	 * \brief Return the discrete probability that \ref sample()
+	 * chooses the given emitter at a shading point
+	 */
+	Float pdf(const Point &p, const Normal &n, const Emitter *emitter) const;
+
+	/// Return the number of nodes in the hierarchy
+	inline size_t getNodeCount() const { return m_nodes.size(); }
+
+	/// Return the number of emitters that are stored outside of the hierarchy
+	inline size_t getInfiniteEmitterCount() const { return m_infinite.size(); }
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Spatial and directional bounds of a set of emitters
+	struct LightBounds {
+		AABB aabb;
+		/// Axis of the cone of emission directions
+		Vector axis;
+		/// Emitted power
+		Float phi;
+		/// Cosine of the cone's half-angle
+		Float cosThetaO;
+		/// Cosine of the angle of emission beyond the cone
+		Float cosThetaE;
+
+		inline LightBounds() : axis(0.0f, 0.0f, 1.0f), phi(0.0f),
+			cosThetaO(1.0f), cosThetaE(1.0f) { }
+
+		/// Return the union of two bounds
+		static LightBounds merge(const LightBounds &a, const LightBounds &b);
+
+		/// Conservative estimate of the power received at \c p with normal \c n
+		Float importance(const Point &p, const Normal &n) const;
+	};
+
+	struct Node {
+		LightBounds bounds;
+		/// Index of the second child (interior nodes) or of the emitter (leaves)
+		uint32_t index;
+		bool leaf;
+	};
+
+	/// Per-emitter data needed to build the hierarchy
+	struct BuildItem {
+		LightBounds bounds;
+		Point centroid;
+		uint32_t emitter;
+	};
+
+	/// Compute the bounds of a single emitter
+	static LightBounds computeBounds(const Emitter *emitter);
+
+	/// Recursively build a subtree and return its bounds
+	LightBounds build(std::vector<BuildItem> &items, size_t start,
+		size_t end, uint64_t bitTrail, int depth);
+
+	/// Virtual destructor
+	virtual ~LightBVH() { }
+private:
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_infinite;
+	/// Maps every emitter to its index in the emitter list
+	boost::unordered_map<const Emitter *, uint32_t> m_emitterIndex;
+	/// Path from the root to the leaf of every emitter (one bit per level)
+	std::vector<uint64_t> m_bitTrails;
+	/// Marks the emitters that are stored outside of the hierarchy
+	std::vector<bool> m_isInfinite;
+	size_t m_emitterCount;
+	int m_maxDepth;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_LIGHTBVH_H_ */
@@ -26,6 +26,7 @@
 #include <mitsuba/core/mmap.h>
 #include <mitsuba/core/timer.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/render/tilecache.h>
 #include <boost/filesystem/fstream.hpp>
 
 MTS_NAMESPACE_BEGIN
@@ -74,7 +75,11 @@ enum EMIPFilterType {
  * anisotropy of texture lookups in UV space.
  *
  * Generating good mip maps is costly, and therefore this class provides
- * the means to cache them on disk if desired.
+ * the means to cache them on disk if desired. Alternatively, when the
+ * global \ref TileCache is enabled (which takes precedence over cache
+ * files), no level is precomputed: tiles of the full resolution level are
+ * converted from the input bitmap on demand, and tiles of the coarser
+ * levels are generated from them using a 2x2 box filter.
  *
  * \tparam Value
  *    This class can be parameterized to yield MIP map classes for
@@ -88,7 +93,8 @@ enum EMIPFilterType {
  *
  * \ingroup librender
  */
-template <typename Value, typename QuantizedValue> class TMIPMap : public Object {
+template <typename Value, typename QuantizedValue> class TMIPMap
+		: public Object, public TileCache::TileSource {
 public:
 #if MTS_MIPMAP_BLOCKED == 1
 	/// Use a blocked array to store MIP map data
@@ -142,6 +148,7 @@ public:
 	 *    Optional filename of a memory-mapped cache file that is used to keep
 	 *    MIP map data out of core, and to avoid having to load and
 	 *    downsample textures over and over again in subsequent Mitsuba runs.
+	 *    Ignored when the \ref TileCache is enabled.
 	 *
 	 * \param maxValue
 	 *    Maximum image value. This is used to clamp out-of-range values
@@ -164,8 +171,10 @@ public:
 			uint64_t timestamp = 0,
 			Float maxValue = 1.0f,
 			Spectrum::EConversionIntent intent = Spectrum::EReflectance)
-		: m_pixelFormat(pixelFormat), m_bcu(bcu), m_bcv(bcv), m_filterType(filterType),
-		  m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
+		: m_pixelFormat(pixelFormat), m_componentFormat(componentFormat), m_intent(intent),
+		  m_bcu(bcu), m_bcv(bcv), m_filterType(filterType), m_weightLut(NULL),
+		  m_maxAnisotropy(maxAnisotropy), m_lazy(false), m_levelZeroReady(false),
+		  m_tileSourceID(0) {
 
 		/* Keep track of time */
 		ref<Timer> timer = new Timer();
@@ -191,7 +200,19 @@ public:
 			}
 		}
 
-		stats::mipStorage += cacheSize;
+		/* When the tile cache is enabled, all levels are generated
+		   lazily. This takes precedence over cache file creation,
+		   which would otherwise precompute the entire pyramid */
+		m_lazy = TileCache::getInstance()->isEnabled();
+
+		if (m_lazy && !cacheFilename.empty()) {
+			Log(EDebug, "Tile cache is enabled -- not creating the MIP map cache file \"%s\"",
+				cacheFilename.string().c_str());
+			cacheFilename = fs::path();
+		}
+
+		if (!m_lazy)
+			stats::mipStorage += cacheSize;
 
 		/* Potentially create a MIP map cache file */
 		uint8_t *mmapData = NULL, *mmapPtr = NULL;
@@ -211,32 +232,44 @@ public:
 		/* 2. Store the base image in a suitable memory layout */
 		m_pyramid = new Array2DType[m_levels];
 		m_sizeRatio = new Vector2[m_levels];
-
-		/* Allocate memory for the first MIP map level */
-		if (mmapPtr) {
-			mmapPtr += sizeof(MIPMapHeader) + padding;
-			m_pyramid[0].map(mmapPtr, bitmap_->getSize());
-			mmapPtr += m_pyramid[0].getBufferSize();
+		m_levelSize = new Vector2i[m_levels];
+		m_levelSize[0] = bitmap_->getSize();
+
+		ref<Bitmap> bitmap;
+		if (m_lazy) {
+			/* Only keep the (unconverted) input image around. Tiles of
+			   the first level are converted from it on demand, so a
+			   single streaming pass suffices to collect statistics */
+			m_source = mapSource(bitmap_->expand());
+			computeStatistics();
+			m_mutex = new Mutex();
 		} else {
-			m_pyramid[0].alloc(bitmap_->getSize());
-		}
+			/* Allocate memory for the first MIP map level */
+			if (mmapPtr) {
+				mmapPtr += sizeof(MIPMapHeader) + padding;
+				m_pyramid[0].map(mmapPtr, bitmap_->getSize());
+				mmapPtr += m_pyramid[0].getBufferSize();
+			} else {
+				m_pyramid[0].alloc(bitmap_->getSize());
+			}
 
-		/* Initialize the first mip map level and extract some general
-		   information (i.e. the minimum, maximum, and average texture value) */
-		ref<Bitmap> bitmap = bitmap_->expand()->convert(pixelFormat,
-			componentFormat, 1.0f, 1.0f, intent);
+			/* Initialize the first mip map level and extract some general
+			   information (i.e. the minimum, maximum, and average texture value) */
+			bitmap = bitmap_->expand()->convert(pixelFormat,
+				componentFormat, 1.0f, 1.0f, intent);
 
-		m_pyramid[0].cleanup();
-		m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+			m_pyramid[0].cleanup();
+			m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
 
-		if (m_minimum.min() < 0) {
-			Log(EWarn, "The texture contains negative pixel values! These will be clamped!");
-			Value *value = (Value *) bitmap->getData();
+			if (m_minimum.min() < 0) {
+				Log(EWarn, "The texture contains negative pixel values! These will be clamped!");
+				Value *value = (Value *) bitmap->getData();
 
-			for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
-				(*value++).clampNegative();
+				for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
+					(*value++).clampNegative();
 
-			m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+				m_pyramid[0].init((Value *) bitmap->getData(), m_minimum, m_maximum, m_average);
+			}
 		}
 
 		m_sizeRatio[0] = Vector2(1, 1);
@@ -249,6 +282,16 @@ public:
 				/* Compute the size of the next downsampled layer */
 				size.x = std::max(1, (size.x + 1) / 2);
 				size.y = std::max(1, (size.y + 1) / 2);
+				m_levelSize[m_levels] = size;
+				m_sizeRatio[m_levels] = Vector2(
+					(Float) size.x / (Float) m_levelSize[0].x,
+					(Float) size.y / (Float) m_levelSize[0].y);
+
+				if (m_lazy) {
+					/* Tiles of this level will be generated on demand */
+					++m_levels;
+					continue;
+				}
 
 				/* Either allocate memory or index into the memory map file */
 				if (mmapPtr) {
@@ -261,14 +304,14 @@ public:
 				bitmap = bitmap->resample(rfilter, bcu, bcv, size, 0.0f, maxValue);
 				m_pyramid[m_levels].cleanup();
 				m_pyramid[m_levels].init((Value *) bitmap->getData());
-				m_sizeRatio[m_levels] = Vector2(
-					(Float) size.x / (Float) m_pyramid[0].getWidth(),
-					(Float) size.y / (Float) m_pyramid[0].getHeight());
 
 				++m_levels;
 			}
 		}
 
+		if (m_lazy)
+			m_tileSourceID = TileCache::getInstance()->registerSource(this);
+
 		if (mmapData) {
 			/* If a cache file was requested, create a header that
 			   describes the current MIP map configuration */
@@ -317,7 +360,8 @@ public:
 	 *    cache file that was previously created.
 	 */
 	TMIPMap(fs::path cacheFilename, Float maxAnisotropy = 20.0f)
-			: m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy) {
+			: m_weightLut(NULL), m_maxAnisotropy(maxAnisotropy), m_lazy(false),
+		  m_levelZeroReady(false), m_tileSourceID(0) {
 		m_mmap = new MemoryMappedFile(cacheFilename);
 		uint8_t *mmapPtr = (uint8_t *) m_mmap->getData();
 		Log(EInfo, "Mapped MIP map cache file \"%s\" into memory (%s).", cacheFilename.string().c_str(),
@@ -348,7 +392,9 @@ public:
 		/* Map the highest resolution level */
 		m_pyramid = new Array2DType[m_levels];
 		m_sizeRatio = new Vector2[m_levels];
+		m_levelSize = new Vector2i[m_levels];
 		Vector2i size(header.width, header.height);
+		m_levelSize[0] = size;
 		m_pyramid[0].map(mmapPtr, size);
 		mmapPtr += m_pyramid[0].getBufferSize();
 		m_sizeRatio[0] = Vector2(1, 1);
@@ -360,6 +406,7 @@ public:
 				size.x = std::max(1, (size.x + 1) / 2);
 				size.y = std::max(1, (size.y + 1) / 2);
 				m_pyramid[level].map(mmapPtr, size);
+				m_levelSize[level] = size;
 				m_sizeRatio[level] = Vector2(
 					(Float) size.x / (Float) m_pyramid[0].getWidth(),
 					(Float) size.y / (Float) m_pyramid[0].getHeight());
@@ -379,8 +426,11 @@ public:
 
 	/// Release all memory
 	~TMIPMap() {
+		if (m_tileSourceID)
+			TileCache::getInstance()->unregisterSource(m_tileSourceID);
 		delete[] m_pyramid;
 		delete[] m_sizeRatio;
+		delete[] m_levelSize;
 		if (m_weightLut)
 			freeAligned(m_weightLut);
 	}
@@ -448,13 +498,15 @@ public:
 	/// Return the size of all buffers
 	size_t getBufferSize() const {
 		size_t size = 0;
+		if (m_lazy)
+			return m_levelZeroReady ? m_pyramid[0].getBufferSize() : 0;
 		for (int i=0; i<m_levels; ++i)
 			size += m_pyramid[i].getBufferSize();
 		return size;
 	}
 
 	/// Return the size of the underlying full resolution texture
-	inline const Vector2i &getSize() const { return m_pyramid[0].getSize(); }
+	inline const Vector2i &getSize() const { return m_levelSize[0]; }
 
 	/// Return the width of the represented texture
 	inline int getWidth() const { return getSize().x; }
@@ -477,14 +529,26 @@ public:
 	/// Get the component-wise average
 	inline const Value &getAverage() const { return m_average; }
 
-	/// Return the blocked array used to store a given MIP level
+	/**
+	 * \brief Return the blocked array used to store a given MIP level
+	 *
+	 * \remark When the MIP map is generated lazily (see \ref TileCache),
+	 * only the full resolution level can be accessed this way. It is
+	 * materialized into a temporary file upon the first request.
+	 */
 	inline const Array2DType &getArray(int level = 0) const {
+		if (m_lazy) {
+			if (level != 0)
+				Log(EError, "getArray(): only the full resolution level "
+					"of a lazily generated MIP map can be accessed!");
+			materializeLevelZero();
+		}
 		return m_pyramid[level];
 	}
 
 	/// Return a bitmap representation of the given level
 	ref<Bitmap> toBitmap(int level = 0) const {
-		const Array2DType &array = m_pyramid[level];
+		const Array2DType &array = getArray(level);
 		ref<Bitmap> result = new Bitmap(
 			m_pixelFormat,
 			Bitmap::componentFormat<typename QuantizedValue::Scalar>(),
@@ -501,7 +565,7 @@ public:
 	 * coordinates, while accounting for boundary conditions
 	 */
 	inline Value evalTexel(int level, int x, int y) const {
-		const Vector2i &size = m_pyramid[level].getSize();
+		const Vector2i &size = m_levelSize[level];
 
 		if (x < 0 || x >= size.x) {
 			/* Encountered an out of bounds access -- determine what to do */
@@ -559,12 +623,15 @@ public:
 			}
 		}
 
+		if (m_lazy)
+			return evalLazyTexel(level, x, y);
+
 		return Value(m_pyramid[level](x, y));
 	}
 
 	/// Evaluate the texture at the given resolution using a box filter
 	inline Value evalBox(int level, const Point2 &uv) const {
-		const Vector2i &size = m_pyramid[level].getSize();
+		const Vector2i &size = m_levelSize[level];
 		return evalTexel(level, math::floorToInt(uv.x*size.x), math::floorToInt(uv.y*size.y));
 	}
 
@@ -582,7 +649,7 @@ public:
 		}
 
 		/* Convert to fractional pixel coordinates on the specified level */
-		const Vector2i &size = m_pyramid[level].getSize();
+		const Vector2i &size = m_levelSize[level];
 		Float u = uv.x * size.x - 0.5f, v = uv.y * size.y - 0.5f;
 
 		int xPos = math::floorToInt(u), yPos = math::floorToInt(v);
@@ -609,7 +676,7 @@ public:
 		}
 
 		/* Convert to fractional pixel coordinates on the specified level */
-		const Vector2i &size = m_pyramid[level].getSize();
+		const Vector2i &size = m_levelSize[level];
 		Float u = uv.x * size.x - 0.5f, v = uv.y * size.y - 0.5f;
 
 		int xPos = math::floorToInt(u), yPos = math::floorToInt(v);
@@ -633,7 +700,7 @@ public:
 			return evalBilinear(0, uv);
 
 		/* Convert into texel coordinates */
-		const Vector2i &size = m_pyramid[0].getSize();
+		const Vector2i &size = m_levelSize[0];
 		Float du0 = d0.x * size.x, dv0 = d0.y * size.y,
 			  du1 = d1.x * size.x, dv1 = d1.y * size.y;
 
@@ -721,7 +788,8 @@ public:
 			<< "   pixelFormat = " << m_pixelFormat << "," << endl
 			<< "   size = " << memString(getBufferSize()) << "," << endl
 			<< "   levels = " << m_levels << "," << endl
-			<< "   cached = " << (m_mmap.get() ? "yes" : "no") << "," << endl
+			<< "   cached = " << (m_mmap.get() && !m_lazy ? "yes" : "no") << "," << endl
+			<< "   lazy = " << (m_lazy ? "yes" : "no") << "," << endl
 			<< "   filterType = ";
 
 		switch (m_filterType) {
@@ -739,8 +807,168 @@ public:
 		return oss.str();
 	}
 
+	/// Generate a tile of a lazily evaluated level (used by \ref TileCache)
+	void fillTile(int level, int tx, int ty, TileCache::Tile *tile) const {
+		const Vector2i &size = m_levelSize[level];
+		QuantizedValue *target = (QuantizedValue *) tile->getData();
+		int x0 = tx * MTS_TILECACHE_TILE_RES, y0 = ty * MTS_TILECACHE_TILE_RES,
+		    x1 = std::min(x0 + MTS_TILECACHE_TILE_RES, size.x),
+		    y1 = std::min(y0 + MTS_TILECACHE_TILE_RES, size.y);
+
+		if (level == 0) {
+			/* Convert the corresponding region of the input image */
+			ref<Bitmap> bitmap = convertRegion(Point2i(x0, y0), Vector2i(x1-x0, y1-y0));
+			const Value *value = (const Value *) bitmap->getData();
+			for (int y=y0; y<y1; ++y) {
+				QuantizedValue *row = target + (y-y0) * MTS_TILECACHE_TILE_RES;
+				for (int x=x0; x<x1; ++x)
+					row[x-x0] = QuantizedValue(*value++);
+			}
+			return;
+		}
+
+		const Vector2i &prevSize = m_levelSize[level-1];
+
+		/* Downsample the next finer level using a 2x2 box filter. Odd
+		   resolutions are handled by replicating the last row/column */
+		for (int y=y0; y<y1; ++y) {
+			int sy0 = 2*y, sy1 = std::min(2*y+1, prevSize.y-1);
+			QuantizedValue *row = target + (y-y0) * MTS_TILECACHE_TILE_RES;
+			for (int x=x0; x<x1; ++x) {
+				int sx0 = 2*x, sx1 = std::min(2*x+1, prevSize.x-1);
+				Value value = evalTexel(level-1, sx0, sy0) + evalTexel(level-1, sx1, sy0)
+				            + evalTexel(level-1, sx0, sy1) + evalTexel(level-1, sx1, sy1);
+				row[x-x0] = QuantizedValue(value * 0.25f);
+			}
+		}
+	}
+
+	/// Return the size of a tile in bytes (used by \ref TileCache)
+	size_t getTileSize(int level) const {
+		return sizeof(QuantizedValue) * MTS_TILECACHE_TILE_RES * MTS_TILECACHE_TILE_RES;
+	}
+
 	MTS_DECLARE_CLASS()
 protected:
+	/**
+	 * \brief Convert a region of the input image of a lazily generated
+	 * MIP map into the MIP map pixel format (clamping negative values)
+	 */
+	ref<Bitmap> convertRegion(const Point2i &offset, const Vector2i &size) const {
+		ref<Bitmap> bitmap = m_source->crop(offset, size)->convert(
+			m_pixelFormat, m_componentFormat, 1.0f, 1.0f, m_intent);
+		Value *value = (Value *) bitmap->getData();
+		for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i)
+			(*value++).clampNegative();
+		return bitmap;
+	}
+
+	/**
+	 * \brief Move the input image of a lazily generated MIP map into a
+	 * temporary file-backed memory mapping
+	 *
+	 * This way, the decoded image does not stay resident in memory: the
+	 * operating system pages in the parts that are needed to fill tiles
+	 * of the first level, and may evict them again under memory pressure.
+	 */
+	ref<Bitmap> mapSource(Bitmap *bitmap) {
+		try {
+			m_sourceMap = MemoryMappedFile::createTemporary(bitmap->getBufferSize());
+		} catch (std::runtime_error &e) {
+			Log(EWarn, "Unable to create a temporary file for the texture -- keeping "
+				"it in memory. Error message was: %s", e.what());
+			return bitmap;
+		}
+		uint8_t *data = (uint8_t *) m_sourceMap->getData();
+		memcpy(data, bitmap->getData(), bitmap->getBufferSize());
+
+		ref<Bitmap> result = new Bitmap(bitmap->getPixelFormat(),
+			bitmap->getComponentFormat(), bitmap->getSize(),
+			bitmap->getChannelCount(), data);
+		result->setGamma(bitmap->getGamma());
+		result->setChannelNames(bitmap->getChannelNames());
+		return result;
+	}
+
+	/**
+	 * \brief Compute the minimum, maximum, and average value of a lazily
+	 * generated MIP map using one streaming pass over the input image
+	 */
+	void computeStatistics() {
+		typedef typename Value::Scalar Scalar;
+		const Vector2i &size = m_levelSize[0];
+		bool negative = false;
+
+		m_minimum = Value(+std::numeric_limits<Scalar>::infinity());
+		m_maximum = Value(-std::numeric_limits<Scalar>::infinity());
+		m_average = Value((Scalar) 0);
+
+		for (int y=0; y<size.y; y += MTS_TILECACHE_TILE_RES) {
+			int rows = std::min(MTS_TILECACHE_TILE_RES, size.y - y);
+			ref<Bitmap> bitmap = m_source->crop(Point2i(0, y), Vector2i(size.x, rows))
+				->convert(m_pixelFormat, m_componentFormat, 1.0f, 1.0f, m_intent);
+			Value *value = (Value *) bitmap->getData();
+			for (size_t i=0, count=bitmap->getPixelCount(); i<count; ++i) {
+				if (value->min() < 0) {
+					negative = true;
+					value->clampNegative();
+				}
+				for (int j=0; j<Value::dim; ++j) {
+					m_minimum[j]  = std::min(m_minimum[j], (*value)[j]);
+					m_maximum[j]  = std::max(m_maximum[j], (*value)[j]);
+					m_average[j] += (*value)[j];
+				}
+				++value;
+			}
+		}
+		m_average /= (Scalar) ((size_t) size.x * (size_t) size.y);
+
+		if (negative)
+			Log(EWarn, "The texture contains negative pixel values! These will be clamped!");
+	}
+
+	/**
+	 * \brief Store the full resolution level of a lazily generated MIP map
+	 * in a file-backed memory mapping (if this has not already happened)
+	 */
+	void materializeLevelZero() const {
+		LockGuard lock(m_mutex);
+		if (m_levelZeroReady)
+			return;
+
+		const Vector2i &size = m_levelSize[0];
+		size_t bufferSize = Array2DType::bufferSize(size);
+		try {
+			m_mmap = MemoryMappedFile::createTemporary(bufferSize);
+			m_pyramid[0].map(m_mmap->getData(), size);
+		} catch (std::runtime_error &e) {
+			Log(EWarn, "Unable to create a temporary MIP map file -- keeping "
+				"the texture in memory. Error message was: %s", e.what());
+			m_pyramid[0].alloc(size);
+		}
+		m_pyramid[0].cleanup();
+		stats::mipStorage += bufferSize;
+
+		for (int y=0; y<size.y; y += MTS_TILECACHE_TILE_RES) {
+			int rows = std::min(MTS_TILECACHE_TILE_RES, size.y - y);
+			ref<Bitmap> bitmap = convertRegion(Point2i(0, y), Vector2i(size.x, rows));
+			const Value *value = (const Value *) bitmap->getData();
+			for (int yo=0; yo<rows; ++yo)
+				for (int x=0; x<size.x; ++x)
+					m_pyramid[0](x, y+yo) = QuantizedValue(*value++);
+		}
+		m_levelZeroReady = true;
+	}
+
+	/// Look up a texel of a lazily evaluated level (coordinates must be in range)
+	inline Value evalLazyTexel(int level, int x, int y) const {
+		const TileCache::Tile *tile = TileCache::getInstance()->getTile(m_tileSourceID, level,
+			x / MTS_TILECACHE_TILE_RES, y / MTS_TILECACHE_TILE_RES);
+		const QuantizedValue *data = (const QuantizedValue *) tile->getData();
+		return Value(data[(y % MTS_TILECACHE_TILE_RES) * MTS_TILECACHE_TILE_RES
+			+ x % MTS_TILECACHE_TILE_RES]);
+	}
+
 	/// Header file for MIP map cache files
 	struct MIPMapHeader {
 		char identifier[3];
@@ -772,7 +1000,7 @@ protected:
 		}
 
 		/* Convert to fractional pixel coordinates on the specified level */
-		const Vector2i &size = m_pyramid[level].getSize();
+		const Vector2i &size = m_levelSize[level];
 		Float u = uv.x * size.x - 0.5f;
 		Float v = uv.y * size.y - 0.5f;
 
@@ -833,15 +1061,24 @@ protected:
 		return result / denominator;
 	}
 private:
-	ref<MemoryMappedFile> m_mmap;
+	mutable ref<MemoryMappedFile> m_mmap;
+	ref<MemoryMappedFile> m_sourceMap;
+	ref<Bitmap> m_source;
+	mutable ref<Mutex> m_mutex;
 	Bitmap::EPixelFormat m_pixelFormat;
+	Bitmap::EComponentFormat m_componentFormat;
+	Spectrum::EConversionIntent m_intent;
 	EBoundaryCondition m_bcu, m_bcv;
 	EMIPFilterType m_filterType;
 	Float *m_weightLut;
 	Float m_maxAnisotropy;
 	Vector2 *m_sizeRatio;
+	Vector2i *m_levelSize;
 	Array2DType *m_pyramid;
 	int m_levels;
+	bool m_lazy;
+	mutable bool m_levelZeroReady;
+	uint32_t m_tileSourceID;
 	Value m_minimum;
 	Value m_maximum;
 	Value m_average;
@@ -201,7 +201,8 @@ protected:
 		stack[exPt].node = NULL;
 
 		bool foundIntersection = false;
-		const KDNode * __restrict currNode = m_nodes;
+		const KDNode * __restrict currNode = this->getLocalNodes();
+		const IndexType * __restrict indices = this->getLocalIndices();
 		while (currNode != NULL) {
 			while (EXPECT_TAKEN(!currNode->isLeaf())) {
 				const Float splitVal = (Float) currNode->getSplit();
@@ -271,7 +272,7 @@ protected:
 			/* Reached a leaf node */
 			for (IndexType entry=currNode->getPrimStart(),
 					last = currNode->getPrimEnd(); entry != last; entry++) {
-				const IndexType primIdx = m_indices[entry];
+				const IndexType primIdx = indices[entry];
 
 				#if defined(MTS_KD_MAILBOX_ENABLED)
 				if (mailbox.contains(primIdx))
@@ -348,7 +349,8 @@ protected:
 		uint64_t timer = rdtsc();
 		bool foundIntersection = false;
 
-		const KDNode * __restrict currNode = m_nodes;
+		const KDNode * __restrict currNode = this->getLocalNodes();
+		const IndexType * __restrict indices = this->getLocalIndices();
 		while (currNode != NULL) {
 			while (EXPECT_TAKEN(!currNode->isLeaf())) {
 				const Float splitVal = (Float) currNode->getSplit();
@@ -405,7 +407,7 @@ protected:
 			/* Reached a leaf node */
 			for (unsigned int entry=currNode->getPrimStart(),
 					last = currNode->getPrimEnd(); entry != last; entry++) {
-				const IndexType primIdx = m_indices[entry];
+				const IndexType primIdx = indices[entry];
 
 				++numIntersections;
 				bool result = cast()->intersect(ray, primIdx, mint, maxt, t, temp);
@@ -437,7 +439,8 @@ protected:
 		KDStackEntry stack[MTS_KD_MAXDEPTH];
 		int stackPos = 0;
 		Float mint = mint_, maxt=maxt_;
-		const KDNode *node = m_nodes;
+		const KDNode *node = this->getLocalNodes();
+		const IndexType * __restrict indices = this->getLocalIndices();
 		bool foundIntersection = false;
 
 		while (node != NULL) {
@@ -471,7 +474,7 @@ protected:
 			} else {
 				for (unsigned int entry=node->getPrimStart(),
 						last = node->getPrimEnd(); entry != last; entry++) {
-					const IndexType primIdx = m_indices[entry];
+					const IndexType primIdx = indices[entry];
 
 					bool result;
 					if (!shadowRay)
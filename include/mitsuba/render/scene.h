@@ -25,6 +25,7 @@
 #include <mitsuba/core/aabb.h>
 #include <mitsuba/render/trimesh.h>
 #include <mitsuba/render/skdtree.h>
+#include <mitsuba/render/lightbvh.h>
 #include <mitsuba/render/sensor.h>
 #include <mitsuba/render/integrator.h>
 #include <mitsuba/render/bsdf.h>
@@ -859,6 +860,10 @@ public:
 	/**
 	 * \brief Return the discrete probability of choosing a
 	 * certain emitter in <tt>sampleEmitter*</tt>
+	 *
+	 * When a light BVH is used (<tt>emitterSampling=bvh</tt>), the
+	 * direct sampling routines instead depend on the reference point;
+	 * their probabilities are included in \ref pdfEmitterDirect().
 	 */
 	inline Float pdfEmitterDiscrete(const Emitter *emitter) const {
 		return emitter->getSamplingWeight() * m_emitterPDF.getNormalization();
@@ -1081,6 +1086,9 @@ public:
 	/// Return the scene's film
 	inline const Film *getFilm() const { return m_sensor->getFilm(); }
 
+	/// Return the light BVH used for direct illumination sampling (or \c NULL)
+	inline const LightBVH *getLightBVH() const { return m_lightBVH.get(); }
+
 	/// Return the scene's kd-tree accelerator
 	inline ShapeKDTree *getKDTree() { return m_kdtree; }
 	/// Return the scene's kd-tree accelerator
@@ -1157,6 +1165,14 @@ protected:
 	/// \cond
 	/// Add a shape to the scene
 	void addShape(Shape *shape);
+
+	/// Choose an emitter for direct illumination sampling from \c dRec.ref
+	inline size_t sampleEmitterIndex(const DirectSamplingRecord &dRec,
+			Float &sample, Float &pdf) const {
+		if (m_lightBVH.get())
+			return m_lightBVH->sample(dRec.ref, dRec.refN, sample, pdf);
+		return m_emitterPDF.sampleReuse(sample, pdf);
+	}
 	/// \endcond
 private:
 	ref<ShapeKDTree> m_kdtree;
@@ -1176,10 +1192,12 @@ private:
 	fs::path *m_sourceFile;
 	fs::path *m_destinationFile;
 	DiscreteDistribution m_emitterPDF;
+	ref<LightBVH> m_lightBVH;
 	AABB m_aabb;
 	uint32_t m_blockSize;
 	bool m_degenerateSensor;
 	bool m_degenerateEmitters;
+	bool m_useLightBVH;
 };
 
 MTS_NAMESPACE_END
@@ -49,20 +49,20 @@ struct BBTree{
 	size_t m_currentNode;
 	size_t m_maxNodes;
 
-	size_t *m_triangleRepetition;
-	AABB *m_aabbTriangle;
+	/// Number of kd-tree leaves that reference each triangle
+	uint32_t *m_triangleRepetition;
 
 	BBTree(const size_t& max_depth, const size_t& primCount){
 		m_currentNode = 0;
 		m_maxNodes = pow(2, max_depth) + 1;
 		m_aabb = new AABB[m_maxNodes];
-		m_triangleRepetition = new size_t[primCount];
-		m_aabbTriangle		 = new AABB[primCount];
-		memset(m_triangleRepetition, 0, primCount*sizeof(size_t));
+		m_triangleRepetition = new uint32_t[primCount];
+		memset(m_triangleRepetition, 0, primCount*sizeof(uint32_t));
 	}
 
 	~BBTree(){
 		delete [] m_aabb;
+		delete [] m_triangleRepetition;
 	}
 
 	inline void print(const size_t& index) const{
@@ -314,7 +314,7 @@ protected:
 		const Shape *shape = m_shapes[shapeIdx];
 		if (m_triangleFlag[shapeIdx]) {
 			const TriMesh *mesh = static_cast<const TriMesh *>(shape);
-			return mesh->getTriangles()[idx].getAABB(mesh->getVertexPositions());
+			return mesh->getTriangle(idx).getAABB(mesh->getVertexPositions());
 		} else {
 			return shape->getAABB();
 		}
@@ -326,7 +326,7 @@ protected:
 		const Shape *shape = m_shapes[shapeIdx];
 		if (m_triangleFlag[shapeIdx]) {
 			const TriMesh *mesh = static_cast<const TriMesh *>(shape);
-			return mesh->getTriangles()[idx].getClippedAABB(mesh->getVertexPositions(), aabb);
+			return mesh->getTriangle(idx).getClippedAABB(mesh->getVertexPositions(), aabb);
 		} else {
 			return shape->getClippedAABB(aabb);
 		}
@@ -354,7 +354,7 @@ protected:
 		if (EXPECT_TAKEN(m_triangleFlag[shapeIdx])) {
 			const TriMesh *mesh =
 				static_cast<const TriMesh *>(m_shapes[shapeIdx]);
-			const Triangle &tri = mesh->getTriangles()[idx];
+			const Triangle tri = mesh->getTriangle(idx);
 			Float tempU, tempV, tempT;
 			if (tri.rayIntersect(mesh->getVertexPositions(), ray,
 						tempU, tempV, tempT)) {
@@ -413,7 +413,7 @@ protected:
 		if (EXPECT_TAKEN(m_triangleFlag[shapeIdx])) {
 			const TriMesh *mesh =
 				static_cast<const TriMesh *>(m_shapes[shapeIdx]);
-			const Triangle &tri = mesh->getTriangles()[idx];
+			const Triangle tri = mesh->getTriangle(idx);
 			Float tempU, tempV, tempT;
 			if (tri.rayIntersect(mesh->getVertexPositions(), ray, tempU, tempV, tempT))
 				return tempT >= mint && tempT <= maxt;
@@ -442,10 +442,8 @@ protected:
 		const Shape *shape = m_shapes[cache->shapeIndex];
 		if (m_triangleFlag[cache->shapeIndex]) {
 			const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
-			const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
+			const Triangle tri = trimesh->getTriangle(cache->primIndex);
 			const Point *vertexPositions = trimesh->getVertexPositions();
-			const Normal *vertexNormals = trimesh->getVertexNormals();
-			const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
 			const Color3 *vertexColors = trimesh->getVertexColors();
 			const TangentSpace *vertexTangents = trimesh->getUVTangents();
 			const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
@@ -475,11 +473,11 @@ protected:
 				its.dpdv = side2;
 			}
 
-			if (EXPECT_TAKEN(vertexNormals)) {
+			if (EXPECT_TAKEN(trimesh->hasVertexNormals())) {
 				const Normal
-					&n0 = vertexNormals[idx0],
-					&n1 = vertexNormals[idx1],
-					&n2 = vertexNormals[idx2];
+					n0 = trimesh->getVertexNormal(idx0),
+					n1 = trimesh->getVertexNormal(idx1),
+					n2 = trimesh->getVertexNormal(idx2);
 
 				its.shFrame.n = normalize(n0 * b.x + n1 * b.y + n2 * b.z);
 
@@ -491,10 +489,10 @@ protected:
 			}
 			its.geoFrame = Frame(faceNormal);
 
-			if (EXPECT_TAKEN(vertexTexcoords)) {
-				const Point2 &t0 = vertexTexcoords[idx0];
-				const Point2 &t1 = vertexTexcoords[idx1];
-				const Point2 &t2 = vertexTexcoords[idx2];
+			if (EXPECT_TAKEN(trimesh->hasVertexTexcoords())) {
+				const Point2 t0 = trimesh->getVertexTexcoord(idx0);
+				const Point2 t1 = trimesh->getVertexTexcoord(idx1);
+				const Point2 t2 = trimesh->getVertexTexcoord(idx2);
 				its.uv = t0 * b.x + t1 * b.y + t2 * b.z;
 			} else {
 				its.uv = Point2(b.y, b.z);
@@ -539,10 +537,8 @@ protected:
 		const Shape *shape = m_shapes[cache->shapeIndex];
 		if (m_triangleFlag[cache->shapeIndex]) {
 			const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
-			const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
+			const Triangle tri = trimesh->getTriangle(cache->primIndex);
 			const Point *vertexPositions = trimesh->getVertexPositions();
-			const Normal *vertexNormals = trimesh->getVertexNormals();
-			const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
 			const Color3 *vertexColors = trimesh->getVertexColors();
 			const TangentSpace *vertexTangents = trimesh->getUVTangents();
 			const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
@@ -572,11 +568,11 @@ protected:
 				its.dpdv = side2;
 			}
 
-			if (EXPECT_TAKEN(vertexNormals)) {
+			if (EXPECT_TAKEN(trimesh->hasVertexNormals())) {
 				const Normal
-					&n0 = vertexNormals[idx0],
-					&n1 = vertexNormals[idx1],
-					&n2 = vertexNormals[idx2];
+					n0 = trimesh->getVertexNormal(idx0),
+					n1 = trimesh->getVertexNormal(idx1),
+					n2 = trimesh->getVertexNormal(idx2);
 
 				its.shFrame.n = normalize(n0 * b.x + n1 * b.y + n2 * b.z);
 
@@ -588,10 +584,10 @@ protected:
 			}
 			its.geoFrame = Frame(faceNormal);
 
-			if (EXPECT_TAKEN(vertexTexcoords)) {
-				const Point2 &t0 = vertexTexcoords[idx0];
-				const Point2 &t1 = vertexTexcoords[idx1];
-				const Point2 &t2 = vertexTexcoords[idx2];
+			if (EXPECT_TAKEN(trimesh->hasVertexTexcoords())) {
+				const Point2 t0 = trimesh->getVertexTexcoord(idx0);
+				const Point2 t1 = trimesh->getVertexTexcoord(idx1);
+				const Point2 t2 = trimesh->getVertexTexcoord(idx2);
 				its.uv = t0 * b.x + t1 * b.y + t2 * b.z;
 			} else {
 				its.uv = Point2(b.y, b.z);
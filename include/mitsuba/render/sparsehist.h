@@ -0,0 +1,142 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_SPARSEHIST_H_)
+#define __MITSUBA_RENDER_SPARSEHIST_H_
+
+#include <mitsuba/core/bitmap.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Sparse storage of the per-pixel time histograms of a
+ * transient rendering
+ *
+ * Most pixels of a transient rendering only receive energy in a small
+ * fraction of their time bins. This class stores the non-zero bins in
+ * compressed sparse row (CSR) form: the bins of pixel \c i (in row-major
+ * order) are found at the indices <tt>[offsets[i], offsets[i+1])</tt> of
+ * the bin index and value arrays. Every value consists of three linear
+ * RGB components.
+ *
+ * On disk, the format consists of a small header followed by the
+ * three arrays in little endian byte order:
+ * <pre>
+ *   char[4]   "MTSH"
+ *   uint8     version (1)
+ *   int32     width, height
+ *   uint32    bin count
+ *   float32   minimum path length, bin width
+ *   uint32    number of non-zero bins (nnz)
+ *   uint32    offsets[width*height + 1]
+ *   uint32    binIndices[nnz]
+ *   float32   values[nnz * 3]
+ * </pre>
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER SparseHistogram : public Object {
+public:
+	/**
+	 * \brief Compress the storage of a film
+	 *
+	 * \param storage
+	 *     A bitmap with the pixel format \ref Bitmap::EMultiSpectrumAlphaWeight
+	 *     or \ref Bitmap::ESpectrumAlphaWeight (i.e. the accumulation buffer
+	 *     of \c hdrfilm). The values are divided by the weight channel.
+	 *     Pixels are processed in parallel.
+	 * \param minBound
+	 *     Path length that corresponds to the start of the first bin
+	 * \param binWidth
+	 *     Width of the time bins
+	 */
+	SparseHistogram(const Bitmap *storage, Float minBound, Float binWidth);
+
+	/// Unserialize a sparse histogram written by \ref write()
+	SparseHistogram(Stream *stream);
+
+	/// Load a sparse histogram from a file
+	SparseHistogram(const fs::path &path);
+
+	/// Write the sparse histogram to a binary data stream
+	void write(Stream *stream) const;
+
+	/// Write the sparse histogram to a file
+	void write(const fs::path &path) const;
+
+	/**
+	 * \brief Expand the histogram into a dense multi-channel bitmap
+	 *
+	 * The result uses the channel names "1.R", "1.G", "1.B", "2.R", ..
+	 * so that it matches the layers written by \c hdrfilm.
+	 */
+	ref<Bitmap> toBitmap() const;
+
+	/// Return the image resolution
+	inline const Vector2i &getSize() const { return m_size; }
+
+	/// Return the number of time bins per pixel
+	inline int getBinCount() const { return m_binCount; }
+
+	/// Return the path length at the start of the first bin
+	inline Float getMinBound() const { return m_minBound; }
+
+	/// Return the width of a time bin
+	inline Float getBinWidth() const { return m_binWidth; }
+
+	/// Return the number of stored (non-zero) bins
+	inline size_t getNonZeroCount() const { return m_binIndices.size(); }
+
+	/// Return the offsets into the bin and value arrays (one entry per pixel plus one)
+	inline const std::vector<uint32_t> &getOffsets() const { return m_offsets; }
+
+	/// Return the index of every stored bin
+	inline const std::vector<uint32_t> &getBinIndices() const { return m_binIndices; }
+
+	/// Return the RGB values of every stored bin
+	inline const std::vector<float> &getValues() const { return m_values; }
+
+	/// Return the stored data as non-const arrays (e.g. to expose them to Python)
+	inline uint32_t *getOffsetData() { return &m_offsets[0]; }
+	inline uint32_t *getBinIndexData() { return m_binIndices.empty() ? NULL : &m_binIndices[0]; }
+	inline float *getValueData() { return m_values.empty() ? NULL : &m_values[0]; }
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor
+	virtual ~SparseHistogram() { }
+
+	/// Read the contents of a stream written by \ref write()
+	void read(Stream *stream);
+private:
+	Vector2i m_size;
+	int m_binCount;
+	Float m_minBound;
+	Float m_binWidth;
+	std::vector<uint32_t> m_offsets;
+	std::vector<uint32_t> m_binIndices;
+	std::vector<float> m_values;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_SPARSEHIST_H_ */
@@ -0,0 +1,212 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TILECACHE_H_)
+#define __MITSUBA_RENDER_TILECACHE_H_
+
+#include <mitsuba/core/tls.h>
+#include <mitsuba/core/lock.h>
+#include <mitsuba/core/statistics.h>
+#include <boost/unordered_map.hpp>
+#include <list>
+
+MTS_NAMESPACE_BEGIN
+
+/// Resolution (in texels) of a single tile managed by the \ref TileCache
+#define MTS_TILECACHE_TILE_RES 64
+
+/// Number of direct-mapped entries in the per-thread tile caches
+#define MTS_TILECACHE_LOCAL_SIZE 16
+
+namespace stats {
+	extern MTS_EXPORT_RENDER StatsCounter tileCacheHits;
+	extern MTS_EXPORT_RENDER StatsCounter tileCacheEvictions;
+};
+
+/**
+ * \brief Global, size-bounded cache of lazily generated texture tiles
+ *
+ * Large bitmap textures and projector patterns can easily exceed the
+ * available memory once the full MIP map pyramid has been built. When
+ * the cache is enabled (i.e. \ref setMaxSize() was called with a nonzero
+ * value), \ref TMIPMap does not precompute its pyramid (nor does it create
+ * or reuse MIP map cache files) and instead requests all levels in units
+ * of \c MTS_TILECACHE_TILE_RES x \c MTS_TILECACHE_TILE_RES texel tiles
+ * from this class. Tiles are generated on demand by a registered
+ * \ref TileSource and evicted in least-recently-used order once the
+ * memory budget is exceeded. The decoded input image, from which tiles of
+ * the full resolution level are converted, is kept in a temporary
+ * memory-mapped file, so that it does not stay resident either.
+ *
+ * To avoid lock contention, every thread additionally keeps a small
+ * direct-mapped cache of the tiles it accessed most recently. Only
+ * misses in this per-thread cache touch the shared data structures.
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER TileCache : public Object {
+public:
+	/// Reference-counted storage of a single tile
+	class MTS_EXPORT_RENDER Tile : public Object {
+	public:
+		/// Allocate a tile with the given number of bytes
+		Tile(size_t size);
+
+		/// Return a pointer to the tile contents
+		inline uint8_t *getData() { return m_data; }
+
+		/// Return a pointer to the tile contents (const version)
+		inline const uint8_t *getData() const { return m_data; }
+
+		/// Return the size of the tile in bytes
+		inline size_t getSize() const { return m_size; }
+
+		MTS_DECLARE_CLASS()
+	protected:
+		virtual ~Tile();
+	private:
+		uint8_t *m_data;
+		size_t m_size;
+	};
+
+	/// Interface of objects that can (re-)generate tiles on demand
+	class MTS_EXPORT_RENDER TileSource {
+	public:
+		/**
+		 * \brief Generate the contents of the specified tile
+		 *
+		 * This function is invoked without holding any locks and
+		 * may itself request other tiles from the cache.
+		 */
+		virtual void fillTile(int level, int tx, int ty, Tile *tile) const = 0;
+
+		/// Return the size of a tile of the given level in bytes
+		virtual size_t getTileSize(int level) const = 0;
+
+		/// Virtual destructor
+		virtual ~TileSource() { }
+	};
+
+	/// Return the global tile cache instance
+	static TileCache *getInstance();
+
+	/**
+	 * \brief Set the memory budget of the cache in bytes
+	 *
+	 * A value of zero (the default) disables the cache, in which
+	 * case MIP maps are fully precomputed at load time.
+	 */
+	void setMaxSize(size_t size);
+
+	/// Return the memory budget of the cache in bytes
+	inline size_t getMaxSize() const { return m_maxSize; }
+
+	/// Return the number of bytes currently held by the cache
+	inline size_t getSize() const { return m_size; }
+
+	/// Is the cache enabled?
+	inline bool isEnabled() const { return m_maxSize > 0; }
+
+	/**
+	 * \brief Register a tile source and return a unique
+	 * identifier that is subsequently used to look up its tiles
+	 */
+	uint32_t registerSource(const TileSource *source);
+
+	/// Unregister a tile source and release all of its tiles
+	void unregisterSource(uint32_t id);
+
+	/**
+	 * \brief Look up (and potentially generate) a tile
+	 *
+	 * The returned pointer remains valid at least until the next
+	 * call to \ref getTile() on the same thread.
+	 */
+	inline const Tile *getTile(uint32_t id, int level, int tx, int ty) {
+		uint64_t key = getKey(id, level, tx, ty);
+		LocalCache &local = m_local.get();
+		size_t slot = (size_t) ((key ^ (key >> 17) ^ (key >> 34))
+			% MTS_TILECACHE_LOCAL_SIZE);
+		if (EXPECT_TAKEN(local.keys[slot] == key && local.tiles[slot].get() != NULL)) {
+			++stats::tileCacheHits;
+			stats::tileCacheHits.incrementBase();
+			return local.tiles[slot].get();
+		}
+		local.tiles[slot] = lookup(key, id, level, tx, ty);
+		local.keys[slot] = key;
+		return local.tiles[slot].get();
+	}
+
+	/// Return a human-readable string representation
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Per-thread direct-mapped cache of recently used tiles
+	struct LocalCache {
+		uint64_t keys[MTS_TILECACHE_LOCAL_SIZE];
+		ref<Tile> tiles[MTS_TILECACHE_LOCAL_SIZE];
+
+		LocalCache() {
+			for (int i=0; i<MTS_TILECACHE_LOCAL_SIZE; ++i)
+				keys[i] = 0;
+		}
+	};
+
+	/// Entry of the shared cache
+	struct Entry {
+		uint64_t key;
+		ref<Tile> tile;
+	};
+
+	typedef std::list<Entry> EntryList;
+	typedef boost::unordered_map<uint64_t, EntryList::iterator> EntryMap;
+
+	/// Create a new (disabled) tile cache
+	TileCache();
+
+	/// Virtual destructor
+	virtual ~TileCache();
+
+	/// Pack a tile address into a 64 bit key
+	inline static uint64_t getKey(uint32_t id, int level, int tx, int ty) {
+		return ((uint64_t) id << 40) | ((uint64_t) level << 34)
+			| ((uint64_t) ty << 17) | (uint64_t) tx;
+	}
+
+	/// Look up a tile in the shared cache and generate it when necessary
+	ref<Tile> lookup(uint64_t key, uint32_t id, int level, int tx, int ty);
+
+	/// Evict least recently used tiles until the budget is met
+	void evict();
+private:
+	static ref<TileCache> m_instance;
+	mutable ref<Mutex> m_mutex;
+	PrimitiveThreadLocal<LocalCache> m_local;
+	std::map<uint32_t, const TileSource *> m_sources;
+	EntryList m_lru;
+	EntryMap m_entries;
+	uint32_t m_nextID;
+	size_t m_maxSize;
+	size_t m_size;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TILECACHE_H_ */
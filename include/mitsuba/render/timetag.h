@@ -0,0 +1,163 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#pragma once
+#if !defined(__MITSUBA_RENDER_TIMETAG_H_)
+#define __MITSUBA_RENDER_TIMETAG_H_
+
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/render/film.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief A single path contribution recorded in time-tag mode
+ *
+ * Instead of being accumulated into a dense per-pixel histogram,
+ * every contribution is stored together with its optical path length
+ * (in scene units), so that it can be binned at any resolution
+ * after rendering has finished.
+ *
+ * \ingroup librender
+ */
+struct TimeTagEvent {
+	/// Flags that can be attached to an event
+	enum EFlags {
+		/// The contribution was splatted onto the light image (s>=1, t==1)
+		ELightImage = 0x01,
+		/// The contribution was generated by elliptic sampling
+		EElliptic   = 0x02
+	};
+
+	/// Pixel index (<tt>y * width + x</tt>) relative to the crop window
+	uint32_t pixel;
+	/// Optical path length of the contribution
+	float pathLength;
+	/// Linear RGB value (not yet divided by the sample count)
+	float value[3];
+	/// Number of scattering events along the path
+	uint16_t bounces;
+	/// Combination of \ref EFlags
+	uint16_t flags;
+
+	inline TimeTagEvent() { }
+
+	inline TimeTagEvent(uint32_t pixel, float pathLength, const float *rgb,
+			uint16_t bounces, uint16_t flags) : pixel(pixel),
+			pathLength(pathLength), bounces(bounces), flags(flags) {
+		value[0] = rgb[0]; value[1] = rgb[1]; value[2] = rgb[2];
+	}
+
+	/// Unserialize an event from a binary data stream
+	inline TimeTagEvent(Stream *stream) {
+		pixel = stream->readUInt();
+		pathLength = stream->readSingle();
+		stream->readSingleArray(value, 3);
+		bounces = stream->readUShort();
+		flags = stream->readUShort();
+	}
+
+	/// Serialize an event to a binary data stream
+	inline void serialize(Stream *stream) const {
+		stream->writeUInt(pixel);
+		stream->writeSingle(pathLength);
+		stream->writeSingleArray(value, 3);
+		stream->writeUShort(bounces);
+		stream->writeUShort(flags);
+	}
+};
+
+/**
+ * \brief Binary file of \ref TimeTagEvent records
+ *
+ * The file starts with a small header that describes the rendering
+ * (crop size, sample count, and the decomposition that defines the
+ * meaning of the path lengths), followed by a flat array of events in
+ * little endian byte order. The event count in the header is patched
+ * when a file opened for writing is closed.
+ *
+ * Writing is not synchronized: callers that append from several
+ * threads must serialize their calls to \ref append().
+ *
+ * \ingroup librender
+ */
+class MTS_EXPORT_RENDER TimeTagFile : public Object {
+public:
+	/// Description of the rendering that produced the events
+	struct Header {
+		/// Size of the crop window (the pixel indices refer to it)
+		Vector2i size;
+		/// Number of samples per pixel (used to normalize the events)
+		uint64_t sampleCount;
+		/// Type of the decomposition (path lengths or bounce counts)
+		Film::EDecompositionType decompositionType;
+		/// Range of path lengths covered by the rendering
+		Float minBound, maxBound;
+		/// Bin width that was configured on the film
+		Float binWidth;
+		/// Number of events stored in the file
+		uint64_t eventCount;
+
+		inline Header() : size(0, 0), sampleCount(0),
+			decompositionType(Film::ETransient), minBound(0.0f),
+			maxBound(0.0f), binWidth(0.0f), eventCount(0) { }
+	};
+
+	/// Create a new time-tag file and write its header
+	TimeTagFile(const fs::path &path, const Header &header);
+
+	/// Open an existing time-tag file for reading
+	TimeTagFile(const fs::path &path);
+
+	/// Return the file header
+	inline const Header &getHeader() const { return m_header; }
+
+	/// Append a batch of events (write mode only)
+	void append(const std::vector<TimeTagEvent> &events);
+
+	/**
+	 * \brief Read up to \c maxCount events into \c events (read mode only)
+	 *
+	 * \return The number of events that were read; zero once
+	 * the end of the file has been reached
+	 */
+	size_t read(std::vector<TimeTagEvent> &events, size_t maxCount);
+
+	/// Update the header and close the file
+	void close();
+
+	/// Return a human-readable summary
+	std::string toString() const;
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Virtual destructor (closes the file if necessary)
+	virtual ~TimeTagFile();
+
+	void writeHeader();
+	void readHeader();
+private:
+	ref<FileStream> m_stream;
+	Header m_header;
+	uint64_t m_eventsRead;
+	bool m_write;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __MITSUBA_RENDER_TIMETAG_H_ */
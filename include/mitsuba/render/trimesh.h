@@ -61,7 +61,53 @@ struct TangentSpace {
 	}
 };
 
+/**
+ * \brief Pack a unit normal into 32 bits using an octahedral
+ * parameterization with 16 bits per coordinate
+ *
+ * The maximum angular error is roughly 0.004 degrees.
+ */
+inline uint32_t packOctahedralNormal(const Normal &n) {
+	Float l1 = std::abs(n.x) + std::abs(n.y) + std::abs(n.z);
+	if (l1 == 0)
+		return 0x7FFF7FFF;
+	Float u = n.x / l1, v = n.y / l1;
+	if (n.z < 0) {
+		Float tu = (1 - std::abs(v)) * (u >= 0 ? 1 : -1),
+		      tv = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+		u = tu; v = tv;
+	}
+	uint32_t qu = (uint32_t) math::roundToInt((math::clamp(u, (Float) -1, (Float) 1) * 0.5f + 0.5f) * 65535),
+	         qv = (uint32_t) math::roundToInt((math::clamp(v, (Float) -1, (Float) 1) * 0.5f + 0.5f) * 65535);
+	return qu | (qv << 16);
+}
+
+/// Inverse of \ref packOctahedralNormal()
+inline Normal unpackOctahedralNormal(uint32_t packed) {
+	Float u = (packed & 0xFFFF) * (2.0f / 65535) - 1,
+	      v = (packed >> 16) * (2.0f / 65535) - 1;
+	Normal n(u, v, 1 - std::abs(u) - std::abs(v));
+	if (n.z < 0) {
+		n.x = (1 - std::abs(v)) * (u >= 0 ? 1 : -1);
+		n.y = (1 - std::abs(u)) * (v >= 0 ? 1 : -1);
+	}
+	return normalize(n);
+}
+
 /** \brief Abstract triangle mesh base class
+ *
+ * Meshes can optionally be stored in a \a compact form (see
+ * \ref compact()), which keeps the vertex positions and colors but
+ * replaces the remaining arrays by quantized or compressed versions:
+ * normals are octahedral-encoded into 32 bits, texture coordinates are
+ * quantized to 16 bits per coordinate relative to their bounding box, and
+ * the triangle indices are delta-encoded into variable-length integers
+ * in blocks of \ref ETriangleBlockSize triangles. The raw accessors
+ * \ref getTriangles(), \ref getVertexNormals() and
+ * \ref getVertexTexcoords() return \c NULL for compact meshes; the
+ * element-wise accessors \ref getTriangle(), \ref getVertexNormal() and
+ * \ref getVertexTexcoord() work in both modes.
+ *
  * \ingroup librender
  * \ingroup libpython
  */
@@ -118,6 +164,11 @@ public:
 	//! @{ \name Access to the stored triangle mesh
 	// =============================================================
 
+	/// Number of triangles per independently decodable block of a compact mesh
+	enum {
+		ETriangleBlockSize = 16
+	};
+
 	/// Return the number of triangles
 	inline size_t getTriangleCount() const { return m_triangleCount; }
 	/// Return the number of vertices
@@ -138,7 +189,7 @@ public:
 	/// Return the vertex normals
 	inline Normal *getVertexNormals() { return m_normals; };
 	/// Does the mesh have vertex normals?
-	inline bool hasVertexNormals() const { return m_normals != NULL; };
+	inline bool hasVertexNormals() const { return m_normals != NULL || m_packedNormals != NULL; };
 
 	/// Return the vertex colors (const version)
 	inline const Color3 *getVertexColors() const { return m_colors; };
@@ -152,7 +203,7 @@ public:
 	/// Return the vertex texture coordinates
 	inline Point2 *getVertexTexcoords() { return m_texcoords; };
 	/// Does the mesh have vertex texture coordinates?
-	inline bool hasVertexTexcoords() const { return m_texcoords != NULL; };
+	inline bool hasVertexTexcoords() const { return m_texcoords != NULL || m_packedTexcoords != NULL; };
 
 	/// Return the per-triangle UV tangents (const version)
 	inline const TangentSpace *getUVTangents() const { return m_tangents; };
@@ -161,6 +212,35 @@ public:
 	/// Does the mesh have UV tangent information?
 	inline bool hasUVTangents() const { return m_tangents != NULL; };
 
+	/// Return triangle \c i (decoded on the fly for compact meshes)
+	inline Triangle getTriangle(size_t i) const {
+		if (EXPECT_TAKEN(m_triangles != NULL))
+			return m_triangles[i];
+		return decodeTriangle(i);
+	}
+
+	/// Return the normal of vertex \c i. Requires \ref hasVertexNormals()
+	inline Normal getVertexNormal(size_t i) const {
+		if (EXPECT_TAKEN(m_normals != NULL))
+			return m_normals[i];
+		return unpackOctahedralNormal(m_packedNormals[i]);
+	}
+
+	/// Return the texture coordinates of vertex \c i. Requires \ref hasVertexTexcoords()
+	inline Point2 getVertexTexcoord(size_t i) const {
+		if (EXPECT_TAKEN(m_texcoords != NULL))
+			return m_texcoords[i];
+		const uint16_t *uv = m_packedTexcoords + 2*i;
+		return Point2(m_texcoordOffset.x + m_texcoordScale.x * uv[0],
+		              m_texcoordOffset.y + m_texcoordScale.y * uv[1]);
+	}
+
+	/// Is the mesh stored in compact form?
+	inline bool isCompact() const { return m_packedTriangles != NULL; }
+
+	/// Request that \ref configure() converts the mesh into compact form
+	inline void setCompact(bool compact) { m_compact = compact; }
+
 	//! @}
 	// =============================================================
 
@@ -239,6 +319,21 @@ public:
 	 */
 	void rebuildTopology(Float maxAngle);
 
+	/**
+	 * \brief Convert the mesh into the compact representation
+	 * described in the class documentation
+	 *
+	 * This trades a small amount of decoding work during intersection
+	 * queries for a much lower memory footprint, which is what makes
+	 * very large scanned meshes fit into memory. Normals and texture
+	 * coordinates are quantized (lossy); the topology is preserved
+	 * exactly. Afterwards, the mesh cannot be modified anymore.
+	 *
+	 * Called from \ref configure() when the \c compact parameter
+	 * of the shape is set.
+	 */
+	void compact();
+
 	/// Serialize to a file/network stream
 	void serialize(Stream *stream, InstanceManager *manager) const;
 
@@ -352,6 +447,9 @@ protected:
 
 	/// Prepare internal tables for sampling uniformly wrt. area
 	void prepareSamplingTable();
+
+	/// Decode a triangle of a compact mesh
+	Triangle decodeTriangle(size_t i) const;
 protected:
 	AABB m_aabb;
 	Triangle *m_triangles;
@@ -364,6 +462,15 @@ protected:
 	size_t m_vertexCount;
 	bool m_flipNormals;
 	bool m_faceNormals;
+	bool m_compact;
+
+	/* Compact storage (see \ref compact()) */
+	uint8_t *m_packedTriangles;
+	uint64_t *m_triangleBlocks;
+	uint32_t *m_packedNormals;
+	uint16_t *m_packedTexcoords;
+	Point2 m_texcoordOffset;
+	Vector2 m_texcoordScale;
 
 	/* Surface and distribution -- generated on demand */
 	DiscreteDistribution m_areaDistr;
@@ -130,7 +130,8 @@ public:
 			   reuse cache files that have been created previously */
 			cacheFile = m_filename;
 			cacheFile.replace_extension(".mip");
-			tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true);
+			tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true)
+				&& !TileCache::getInstance()->isEnabled();
 		}
 
 		/* Gamma override */
@@ -18,8 +18,11 @@
 
 #include <mitsuba/render/film.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/fresolver.h>
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/core/statistics.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/render/sparsehist.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/lexical_cast.hpp> // Added to cast integers to strings
 #include "banner.h"
@@ -27,6 +30,10 @@
 
 MTS_NAMESPACE_BEGIN
 
+/* File identifier and version of the render state format */
+#define MTS_FILMSTATE_MAGIC "MTSF"
+#define MTS_FILMSTATE_VERSION 1
+
 /*!\plugin{hdrfilm}{High dynamic range film}
  * \order{1}
  * \parameters{
@@ -38,7 +45,8 @@ MTS_NAMESPACE_BEGIN
  *       Denotes the desired output file format. The options
  *       are \code{openexr} (for ILM's OpenEXR format),
  *       \code{rgbe} (for Greg Ward's RGBE format),
- *       or \code{pfm} (for the Portable Float Map format)
+ *       \code{pfm} (for the Portable Float Map format),
+ *       or \code{sparse} (for transient renderings, see below)
  *       \default{\code{openexr}}
  *     }
  *     \parameter{pixelFormat}{\String}{Specifies the desired pixel format
@@ -75,6 +83,22 @@ MTS_NAMESPACE_BEGIN
  *        reconstruction filters. In general, this is not needed though.
  *        \default{\code{false}, i.e. disabled}
  *     }
+ *     \parameter{writeState}{\Boolean}{Additionally store the unnormalized
+ *       film contents and per-pixel sample weights in a \code{.state} file next
+ *       to the output, so that the rendering can be refined later on (see
+ *       \code{resumeFile}). \default{\code{false}}
+ *     }
+ *     \parameter{resumeFile}{\String}{Render state written by a previous
+ *       run with \code{writeState=true}. New samples are merged into it
+ *       \default{Unused}
+ *     }
+ *     \parameter{roiMask}{\String}{Image with the size of the crop window
+ *       that selects the pixels (nonzero values) of the region of interest
+ *       \default{Unused, i.e. all pixels}
+ *     }
+ *     \parameter{roiMinBin, roiMaxBin}{\Integer}{First and last time bin
+ *       of the region of interest \default{all bins}
+ *     }
  *     \parameter{\Unnamed}{\RFilter}{Reconstruction filter that should
  *     be used by the film. \default{\code{gaussian}, a windowed Gaussian filter}}
  * }
@@ -107,6 +131,36 @@ MTS_NAMESPACE_BEGIN
  * Due to the superior accuracy and adoption of OpenEXR, the use of these
  * two alternative formats is discouraged however.
  *
+ * Most pixels of a transient rendering are only non-zero in a few of their
+ * time bins. With \code{fileFormat=sparse}, the film stores the per-pixel
+ * histograms in compressed sparse row form (a \code{.shist} file holding
+ * per-pixel offsets, bin indices, and linear RGB values of the non-zero bins,
+ * see \code{include/mitsuba/render/sparsehist.h}), which is typically one to two
+ * orders of magnitude smaller than the corresponding OpenEXR file. The
+ * \code{pixelFormat} and \code{componentFormat} parameters are ignored in
+ * this case. The Python bindings can read these files using
+ * \code{mitsuba.render.SparseHistogram}.
+ *
+ * Integrators can attach auxiliary channels to the film, such as the
+ * first-return depth, normals and albedo recorded by the bidirectional
+ * path tracer (\code{aovs=true}). OpenEXR output stores them as additional
+ * layers (e.g. \code{depth.Y} or \code{normal.X}) of the same file. In the
+ * transient case, a \code{steady} layer holding the sum of all time bins is
+ * added as well. The other file formats write these channels to a separate
+ * OpenEXR file with the suffix \code{\_aovs}.
+ *
+ * Renderings can be refined incrementally. With \code{writeState=true}, the film
+ * also writes the weighted sums of all samples and the per-pixel sample weights
+ * (a \code{.state} file). A later run that specifies this file as
+ * \code{resumeFile} adds its samples on top, which yields the same result as a
+ * single rendering with the combined sample count. Together with a region of
+ * interest (\code{roiMask}, \code{roiMinBin}, and \code{roiMaxBin}), only the
+ * selected pixels and time bins are updated, while all other values are taken
+ * over unchanged from the state file. Integrators that support regions of
+ * interest (e.g. \pluginref{bdpt}) skip the remaining pixels altogether.
+ * The new samples must be statistically independent of the previous ones;
+ * see the \code{sampleOffset} parameter of \pluginref{bdpt}.
+ *
  * When RGB(A) output is selected, the measured spectral power distributions are
  * converted to linear RGB based on the CIE 1931 XYZ color matching curves and
  * the ITU-R Rec. BT.709-3 primaries with a D65 white point.
@@ -213,6 +267,7 @@ public:
 
 		std::string fileFormat = boost::to_lower_copy(
 			props.getString("fileFormat", "openexr"));
+		m_sparse = false;
 		std::vector<std::string> pixelFormats = tokenize(boost::to_lower_copy(
 			props.getString("pixelFormat", "rgb")), " ,");
 		std::vector<std::string> channelNames = tokenize(
@@ -241,9 +296,16 @@ public:
 			m_fileFormat = Bitmap::ERGBE;
 		} else if (fileFormat == "pfm") {
 			m_fileFormat = Bitmap::EPFM;
+		} else if (fileFormat == "sparse") {
+			/* Sparse per-pixel histograms; the pixel and component
+			   formats below are ignored */
+			m_fileFormat = Bitmap::EOpenEXR;
+			m_sparse = true;
+			if (SPECTRUM_SAMPLES != 3)
+				Log(EError, "fileFormat=\"sparse\" requires an RGB build (SPECTRUM_SAMPLES=3)!");
 		} else {
 			Log(EError, "The \"fileFormat\" parameter must either be "
-				"equal to \"openexr\", \"pfm\", or \"rgbe\"!");
+				"equal to \"openexr\", \"pfm\", \"rgbe\", or \"sparse\"!");
 		}
 
 		if (pixelFormats.empty())
@@ -370,6 +432,16 @@ public:
 			m_storage = new ImageBlock(Bitmap::EMultiSpectrumAlphaWeight, m_cropSize,
 				NULL, (int) (SPECTRUM_SAMPLES * m_pixelFormats.size() + 2));
 		}
+
+		/* Incremental re-rendering: store the raw film contents and/or
+		   merge new samples into a previously stored state */
+		m_writeState = props.getBoolean("writeState", false);
+		if (props.hasProperty("resumeFile"))
+			m_resume = readState(Thread::getThread()->getFileResolver()->resolve(
+				props.getString("resumeFile")));
+		else if (hasRegionOfInterest())
+			Log(EWarn, "A region of interest was specified without a \"resumeFile\" "
+				"-- all other pixels and bins will be empty!");
 	}
 
 	HDRFilm(Stream *stream, InstanceManager *manager)
@@ -384,6 +456,8 @@ public:
 		for (size_t i=0; i<m_channelNames.size(); ++i)
 			m_channelNames[i] = stream->readString();
 		m_componentFormat = (Bitmap::EComponentFormat) stream->readUInt();
+		m_sparse = stream->readBool();
+		m_writeState = stream->readBool();
 	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
@@ -398,6 +472,10 @@ public:
 		for (size_t i=0; i<m_channelNames.size(); ++i)
 			stream->writeString(m_channelNames[i]);
 		stream->writeUInt(m_componentFormat);
+		stream->writeBool(m_sparse);
+		/* The resumed state is only needed when developing the film,
+		   which never happens on remote render nodes */
+		stream->writeBool(m_writeState);
 	}
 
 	void clear() {
@@ -471,6 +549,7 @@ public:
 
 	bool develop(const Point2i &sourceOffset, const Vector2i &size,
 			const Point2i &targetOffset, Bitmap *target) const {
+		/* Used for previews; only shows the samples of the current run */
 		const Bitmap *source = m_storage->getBitmap();
 		const FormatConverter *cvt = FormatConverter::getInstance(
 			std::make_pair(Bitmap::EFloat, target->getComponentFormat())
@@ -519,6 +598,118 @@ public:
 		return true;
 	}
 
+	ref<Bitmap> developBitmap() const {
+		ref<Bitmap> state = getState();
+		ref<Bitmap> bitmap;
+		if (m_pixelFormats.size() == 1) {
+			bitmap = state->convert(m_pixelFormats[0], Bitmap::EFloat32);
+			bitmap->setChannelNames(m_channelNames);
+		} else {
+			bitmap = state->convertMultiSpectrumAlphaWeight(m_pixelFormats,
+					Bitmap::EFloat32, m_channelNames);
+		}
+		return bitmap;
+	}
+
+	/**
+	 * \brief Return the unnormalized film contents including the alpha
+	 * and weight channels
+	 *
+	 * When a render state was resumed, the new samples are merged into
+	 * it: inside the region of interest, the weighted sums and weights
+	 * of both are added. Bins outside of the bin range are rescaled so
+	 * that they keep their previous value under the combined weight, and
+	 * pixels outside of the mask are taken over unchanged.
+	 */
+	ref<Bitmap> getState() const {
+		Bitmap *storage = const_cast<Bitmap *>(m_storage->getBitmap());
+		if (m_resume.get() == NULL)
+			return storage;
+
+		ref<Bitmap> result = m_resume->clone();
+		int channels = result->getChannelCount(),
+		    binStart = m_roiMinBin * SPECTRUM_SAMPLES,
+		    binEnd = (m_roiMaxBin + 1) * SPECTRUM_SAMPLES;
+		const Float *source = storage->getFloatData();
+		Float *target = result->getFloatData();
+
+		for (int y=0; y<m_cropSize.y; ++y) {
+			for (int x=0; x<m_cropSize.x; ++x) {
+				if (isInRegionOfInterest(Point2i(x, y))) {
+					Float weight = target[channels-1],
+					      newWeight = source[channels-1],
+					      scale = weight > 0 ? (weight + newWeight) / weight : 1.0f;
+					for (int j=0; j<channels-2; ++j) {
+						if (j >= binStart && j < binEnd)
+							target[j] += source[j];
+						else
+							target[j] *= scale;
+					}
+					target[channels-2] += source[channels-2];
+					target[channels-1] += newWeight;
+				}
+				source += channels;
+				target += channels;
+			}
+		}
+		return result;
+	}
+
+	/// Write the unnormalized film contents to a render state file
+	void writeState(const Bitmap *state) const {
+		fs::path filename = m_destFile;
+		filename.replace_extension(".state");
+		Log(EInfo, "Writing render state to \"%s\" ..", filename.string().c_str());
+		ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
+		stream->write(MTS_FILMSTATE_MAGIC, 4);
+		stream->writeUChar(MTS_FILMSTATE_VERSION);
+		stream->writeUChar((uint8_t) sizeof(Float));
+		stream->writeInt(m_cropSize.x);
+		stream->writeInt(m_cropSize.y);
+		stream->writeInt(state->getChannelCount());
+		stream->writeSingle((float) m_decompositionMinBound);
+		stream->writeSingle((float) m_decompositionBinWidth);
+		stream->writeFloatArray(state->getFloatData(),
+			(size_t) m_cropSize.x * (size_t) m_cropSize.y * state->getChannelCount());
+	}
+
+	/// Read a render state file and validate it against the film configuration
+	ref<Bitmap> readState(const fs::path &filename) const {
+		Log(EInfo, "Resuming from render state \"%s\" ..", filename.string().c_str());
+		ref<FileStream> stream = new FileStream(filename, FileStream::EReadOnly);
+		char magic[4];
+		stream->read(magic, 4);
+		if (memcmp(magic, MTS_FILMSTATE_MAGIC, 4) != 0)
+			Log(EError, "readState(): invalid file (the header is corrupt)!");
+		uint8_t version = stream->readUChar();
+		if (version != MTS_FILMSTATE_VERSION)
+			Log(EError, "readState(): unsupported file version %i (expected %i)",
+				(int) version, MTS_FILMSTATE_VERSION);
+		if (stream->readUChar() != sizeof(Float))
+			Log(EError, "readState(): the render state was written using a "
+				"different floating point precision!");
+
+		Vector2i size;
+		size.x = stream->readInt();
+		size.y = stream->readInt();
+		int channels = stream->readInt();
+		Float minBound = (Float) stream->readSingle(),
+		      binWidth = (Float) stream->readSingle();
+		const Bitmap *storage = m_storage->getBitmap();
+		if (size != m_cropSize || channels != storage->getChannelCount() ||
+			minBound != (Float) (float) m_decompositionMinBound ||
+			binWidth != (Float) (float) m_decompositionBinWidth)
+			Log(EError, "readState(): the render state (%ix%i pixels, %i channels) does not "
+				"match the film configuration (%ix%i pixels, %i channels)!", size.x, size.y,
+				channels, m_cropSize.x, m_cropSize.y, storage->getChannelCount());
+
+		ref<Bitmap> state = new Bitmap(storage->getPixelFormat(), Bitmap::EFloat,
+			m_cropSize, channels);
+		stream->readFloatArray(state->getFloatData(),
+			(size_t) m_cropSize.x * (size_t) m_cropSize.y * channels);
+		return state;
+	}
+
 	void setDestinationFile(const fs::path &destFile, uint32_t blockSize) {
 		m_destFile = destFile;
 	}
@@ -529,12 +720,35 @@ public:
 
 		Log(EDebug, "Developing film ..");
 
+		ref<Bitmap> state = getState();
+		if (m_writeState)
+			writeState(state);
+
+		if (m_sparse) {
+			fs::path filename = m_destFile;
+			if (boost::to_lower_copy(filename.extension().string()) != ".shist")
+				filename.replace_extension(".shist");
+
+			ref<Timer> timer = new Timer();
+			ref<SparseHistogram> hist = new SparseHistogram(state,
+				m_decompositionMinBound, m_decompositionBinWidth);
+			Log(EInfo, "Writing sparse histograms (" SIZE_T_FMT " non-zero bins) to \"%s\" ..",
+				hist->getNonZeroCount(), filename.string().c_str());
+			hist->write(filename);
+			Log(EDebug, "Sparse histograms written in %i ms", timer->getMilliseconds());
+
+			ref<Bitmap> aovs = developAOVs(state);
+			if (aovs)
+				writeAOVs(aovs);
+			return;
+		}
+
 		ref<Bitmap> bitmap;
 		if (m_pixelFormats.size() == 1) {
-			bitmap = m_storage->getBitmap()->convert(m_pixelFormats[0], m_componentFormat);
+			bitmap = state->convert(m_pixelFormats[0], m_componentFormat);
 			bitmap->setChannelNames(m_channelNames);
 		} else {
-			bitmap = m_storage->getBitmap()->convertMultiSpectrumAlphaWeight(m_pixelFormats,
+			bitmap = state->convertMultiSpectrumAlphaWeight(m_pixelFormats,
 					m_componentFormat, m_channelNames);
 		}
 
@@ -552,7 +766,9 @@ public:
 
 		fs::path filename = m_destFile;
 		std::string properExtension;
-		if (m_fileFormat == Bitmap::EOpenEXR)
+		if (m_sparse)
+			properExtension = ".shist";
+		else if (m_fileFormat == Bitmap::EOpenEXR)
 			properExtension = ".exr";
 		else if (m_fileFormat == Bitmap::ERGBE)
 			properExtension = ".rgbe";
@@ -578,9 +794,89 @@ public:
 			bitmap->setMetadataString("log", log);
 		}
 
+		ref<Bitmap> aovs = developAOVs(state);
+		if (aovs && m_fileFormat == Bitmap::EOpenEXR) {
+			/* Store the AOVs as additional layers of the same file */
+			aovs->setGamma(bitmap->getGamma());
+			std::vector<Bitmap *> layers;
+			layers.push_back(bitmap);
+			layers.push_back(aovs);
+			bitmap = Bitmap::join(Bitmap::EMultiChannel, layers);
+		} else if (aovs) {
+			writeAOVs(aovs);
+		}
+
 		bitmap->write(m_fileFormat, stream);
 	}
 
+	/**
+	 * \brief Combine the attached AOVs with the steady-state image of a
+	 * transient film (i.e. the sum of all time bins of \c storage)
+	 *
+	 * \return A multi-channel bitmap in the film's component format,
+	 * or \c NULL when no AOVs are attached
+	 */
+	ref<Bitmap> developAOVs(const Bitmap *storage) const {
+		if (m_aovs.get() == NULL)
+			return NULL;
+		if (m_aovs->getPixelFormat() != Bitmap::EMultiChannel ||
+			m_aovs->getComponentFormat() != Bitmap::EFloat32 ||
+			m_aovs->getSize() != m_cropSize)
+			Log(EError, "The attached AOVs must be a float32 multi-channel "
+				"bitmap with the size of the crop window!");
+
+		bool steady = m_pixelFormats.size() > 1 && SPECTRUM_SAMPLES == 3;
+		int aovChannels = m_aovs->getChannelCount(),
+		    storageChannels = storage->getChannelCount(),
+		    channels = aovChannels + (steady ? 3 : 0),
+		    bins = (storageChannels - 2) / SPECTRUM_SAMPLES;
+		size_t nPixels = (size_t) m_cropSize.x * (size_t) m_cropSize.y;
+
+		ref<Bitmap> result = new Bitmap(Bitmap::EMultiChannel,
+			Bitmap::EFloat32, m_cropSize, channels);
+		const float *source = m_aovs->getFloat32Data();
+		float *target = result->getFloat32Data();
+
+		for (size_t i=0; i<nPixels; ++i) {
+			for (int j=0; j<aovChannels; ++j)
+				*target++ = *source++;
+			if (!steady)
+				continue;
+
+			const Float *value = storage->getFloatData() + i * storageChannels;
+			Float weight = value[storageChannels - 1],
+			      invWeight = weight != 0 ? 1.0f / weight : 0.0f,
+			      sum[3] = { 0.0f, 0.0f, 0.0f };
+			for (int b=0; b<bins; ++b)
+				for (int k=0; k<3; ++k)
+					sum[k] += value[b * SPECTRUM_SAMPLES + k];
+			for (int k=0; k<3; ++k)
+				*target++ = (float) (sum[k] * invWeight);
+		}
+
+		std::vector<std::string> channelNames = m_aovs->getChannelNames();
+		if (steady) {
+			channelNames.push_back("steady.R");
+			channelNames.push_back("steady.G");
+			channelNames.push_back("steady.B");
+		}
+		result->setChannelNames(channelNames);
+
+		if (m_componentFormat != Bitmap::EFloat32)
+			result = result->convert(Bitmap::EMultiChannel, m_componentFormat);
+		return result;
+	}
+
+	/// Write the AOVs to a separate OpenEXR file next to the output
+	void writeAOVs(Bitmap *aovs) const {
+		fs::path filename = m_destFile;
+		filename.replace_extension();
+		filename = filename.parent_path() / (filename.filename().string() + "_aovs.exr");
+		Log(EInfo, "Writing AOVs to \"%s\" ..", filename.string().c_str());
+		ref<FileStream> stream = new FileStream(filename, FileStream::ETruncWrite);
+		aovs->write(Bitmap::EOpenEXR, stream);
+	}
+
 	bool hasAlpha() const {
 		for (size_t i=0; i<m_pixelFormats.size(); ++i) {
 			if (m_pixelFormats[i] == Bitmap::ELuminanceAlpha ||
@@ -594,7 +890,9 @@ public:
 
 	bool destinationExists(const fs::path &baseName) const {
 		std::string properExtension;
-		if (m_fileFormat == Bitmap::EOpenEXR)
+		if (m_sparse)
+			properExtension = ".shist";
+		else if (m_fileFormat == Bitmap::EOpenEXR)
 			properExtension = ".exr";
 		else if (m_fileFormat == Bitmap::ERGBE)
 			properExtension = ".rgbe";
@@ -612,6 +910,7 @@ public:
 		oss << "HDRFilm[" << endl
 			<< "  size = " << m_size.toString() << "," << endl
 			<< "  fileFormat = " << m_fileFormat << "," << endl
+			<< "  sparse = " << m_sparse << "," << endl
 			<< "  pixelFormat = ";
 		for (size_t i=0; i<m_pixelFormats.size(); ++i)
 			oss << m_pixelFormats[i] << ", ";
@@ -624,6 +923,8 @@ public:
 			<< "  cropOffset = " << m_cropOffset.toString() << "," << endl
 			<< "  cropSize = " << m_cropSize.toString() << "," << endl
 			<< "  banner = " << m_banner << "," << endl
+			<< "  writeState = " << m_writeState << "," << endl
+			<< "  resumed = " << (m_resume.get() != NULL) << "," << endl
 			<< "  filter = " << indent(m_filter->toString()) << endl
 			<< "]";
 		return oss.str();
@@ -637,8 +938,11 @@ protected:
 	Bitmap::EComponentFormat m_componentFormat;
 	bool m_banner;
 	bool m_attachLog;
+	bool m_sparse;
+	bool m_writeState;
 	fs::path m_destFile;
 	ref<ImageBlock> m_storage;
+	ref<Bitmap> m_resume;
 
 };
 
@@ -46,6 +46,92 @@ MTS_NAMESPACE_BEGIN
  *	      which the implementation will start to use the ``russian roulette''
  *	      path termination criterion. \default{\code{5}}
  *	   }
+ *	   \parameter{seedSplit}{\Integer}{When set to a nonzero value, work is not
+ *	      distributed as image blocks. Instead, every work unit renders the entire
+ *	      image using a disjoint range of the pixel samples, and the results are
+ *	      summed up as they arrive. \code{-1} creates one work unit per core,
+ *	      and a positive value specifies the number of work units. See the text
+ *	      below for details. \default{\code{0}, i.e. render image blocks}
+ *	   }
+ *	   \parameter{guiding}{\Boolean}{Guide the random walks of both subpaths
+ *	      using spatio-temporal SD-trees that are trained progressively from
+ *	      the contributions falling inside the film's path length window.
+ *	      The trees partition space and the path length accumulated by each
+ *	      subpath, so that e.g. early and late returns through the same region
+ *	      can prefer different directions. Only smooth reflective surfaces are
+ *	      guided. \default{\code{false}}
+ *	   }
+ *	   \parameter{guidingBSDFFraction}{\Float}{Probability of sampling the BSDF
+ *	      instead of the guiding distribution at guided vertices. \default{0.5}
+ *	   }
+ *	   \parameter{guidingSpatialThreshold}{\Integer}{Number of samples a region
+ *	      must receive in the first training iteration before it is subdivided.
+ *	      \default{12000}
+ *	   }
+ *	   \parameter{denoise}{\Boolean}{Denoise the image once rendering has finished.
+ *	      Every pixel of every time bin is replaced by a non-local means average
+ *	      over neighboring pixels in the same and adjacent time bins, using
+ *	      per-bin variance estimates accumulated during rendering. This works
+ *	      for steady-state films, too, and is mainly useful for previews
+ *	      and training data at low sample counts. When \code{aovs} is
+ *	      enabled, the depth and normal of the first surface additionally
+ *	      keep the filter from blurring across geometric edges.
+ *	      \default{\code{false}}
+ *	   }
+ *	   \parameter{denoiseRadius}{\Integer}{Spatial radius of the denoiser's
+ *	      search window in pixels. \default{3}
+ *	   }
+ *	   \parameter{denoiseTemporalRadius}{\Integer}{Number of neighboring time
+ *	      bins on each side that the denoiser searches. \default{1}
+ *	   }
+ *	   \parameter{denoisePatchRadius}{\Integer}{Radius of the patches compared
+ *	      by the denoiser. \default{1}
+ *	   }
+ *	   \parameter{denoiseStrength}{\Float}{Denoiser strength; larger values
+ *	      blur more aggressively. \default{0.45}
+ *	   }
+ *	   \parameter{timeTags}{\Boolean}{Additionally record every path
+ *	      contribution of a transient rendering as a raw event (pixel, path
+ *	      length, RGB value and bounce count) in a binary file next to the
+ *	      output image, using the extension \code{.ttag}. The events can be
+ *	      re-binned at an arbitrary temporal resolution afterwards using
+ *	      \code{mtsutil rebin}. Combine this with \code{frames=1} on the film
+ *	      to avoid the memory cost of the dense histogram. Requires an
+ *	      unmodulated transient or bounce decomposition. \default{\code{false}}
+ *	   }
+ *	   \parameter{aovs}{\Boolean}{Additionally record the distance, shading
+ *	      normal and diffuse albedo of the first surface seen through every
+ *	      pixel (zero where the camera ray escapes), filtered like the image
+ *	      itself. The film stores them as the layers \code{depth},
+ *	      \code{normal} and \code{albedo}; transient films also add a
+ *	      \code{steady} layer with the sum of all time bins. This replaces
+ *	      separate \pluginref{field} and steady-state renderings when
+ *	      generating datasets. \default{\code{false}}
+ *	   }
+ *	   \parameter{lightPaths}{\Integer}{When set to a positive value, every
+ *	      work unit (image block) first traces this many emitter subpaths and
+ *	      stores them in a shared pool. Each sensor subpath is then connected
+ *	      to randomly chosen pooled subpaths instead of a freshly traced one,
+ *	      which amortizes the cost of emitter tracing over many pixels. This
+ *	      pays off when emitter subpaths are expensive but do not depend on
+ *	      the pixel (e.g. lasers and projectors). The result remains unbiased,
+ *	      but small pools produce correlated, structured noise.
+ *	      Not supported with adaptive sampling or motion blur.
+ *	      \default{\code{0}, i.e. trace one emitter subpath per sample}
+ *	   }
+ *	   \parameter{lightConnections}{\Integer}{Number of pooled emitter subpaths
+ *	      that each sensor subpath is connected to when \code{lightPaths} is
+ *	      used. The light tracing strategies (\code{t=1}) are only evaluated
+ *	      for the first of them. \default{1}
+ *	   }
+ *	   \parameter{sampleOffset}{\Integer}{Index of the first pixel sample.
+ *	      When refining an existing rendering (see below), set this to the
+ *	      total sample count of all previous runs so that the new samples
+ *	      continue the sample sequence instead of repeating it. Requires
+ *	      the \pluginref{halton}, \pluginref{hammersley} or \pluginref{sobol}
+ *	      sampler, or an \pluginref{independent} sampler with an explicit
+ *	      \code{seed}. \default{0}
+ *	   }
  * }
  *
  ** \renderings{
@@ -123,6 +209,32 @@ MTS_NAMESPACE_BEGIN
  * When rendering an image of a reasonable resolution without network nodes,
  * this is not a big concern, hence these strategies are enabled by default.
  *
+ * A third option, which is particularly useful for transient renderings
+ * with many frames, is the \code{seedSplit} parameter. In this mode, each
+ * core (local or on a network render node) renders the full image with its
+ * own, disjoint range of pixel sample indices, hence only one camera and light
+ * image is transmitted per work unit instead of one per block. The master sums
+ * up the partial results as they arrive, which yields the same estimate as
+ * a single machine rendering all samples.
+ *
+ * Renderings can also be refined after the fact: when the \pluginref{hdrfilm}
+ * resumes a render state written by a previous run (\code{resumeFile}),
+ * the new samples are merged into it with the correct weights. If the film
+ * specifies a region of interest, this integrator only renders the pixels
+ * selected by \code{roiMask} (the light image is scaled up by the fraction
+ * of skipped pixels, since its emitter subpaths then only start from the
+ * selected ones), and for unmodulated transient or bounce
+ * decompositions, connections whose path length falls outside of the bins
+ * \code{roiMinBin} to \code{roiMaxBin} are rejected early. The sample
+ * indices of the new samples start at \code{sampleOffset}, which makes them
+ * independent of the previous ones for the deterministic samplers
+ * (\pluginref{halton}, \pluginref{hammersley}, \pluginref{sobol}). The
+ * \pluginref{independent} sampler must instead be given a different
+ * \code{seed}; samplers that precompute a fixed number of samples per
+ * pixel (e.g. \pluginref{ldsampler}) cannot be used.
+ * Refinement cannot be combined with \code{denoise}, since the denoised
+ * image no longer carries per-pixel sample weights.
+ *
  * \remarks{
  *    \item This integrator does not work with dipole-style subsurface
  *    scattering models.
@@ -139,6 +251,20 @@ public:
 		m_config.lightImage = props.getBoolean("lightImage", true);
 		m_config.sampleDirect = props.getBoolean("sampleDirect", true);
 		m_config.showWeighted = props.getBoolean("showWeighted", false);
+		m_seedSplit = m_config.seedSplit = props.getInteger("seedSplit", 0);
+		m_config.guiding = props.getBoolean("guiding", false);
+		m_config.guidingBSDFFraction = props.getFloat("guidingBSDFFraction", 0.5f);
+		m_config.guidingSpatialThreshold = props.getInteger("guidingSpatialThreshold", 12000);
+		m_config.denoise = props.getBoolean("denoise", false);
+		m_config.denoiseRadius = props.getInteger("denoiseRadius", 3);
+		m_config.denoiseTemporalRadius = props.getInteger("denoiseTemporalRadius", 1);
+		m_config.denoisePatchRadius = props.getInteger("denoisePatchRadius", 1);
+		m_config.denoiseStrength = props.getFloat("denoiseStrength", 0.45f);
+		m_config.timeTags = props.getBoolean("timeTags", false);
+		m_config.aovs = props.getBoolean("aovs", false);
+		m_config.lightPaths = props.getInteger("lightPaths", 0);
+		m_config.lightConnections = props.getInteger("lightConnections", 1);
+		m_config.sampleOffset = props.getSize("sampleOffset", 0);
 // Do not read the transient related configurations from the xml file BDPT properties.
 // Instead read them from the Film (sensor) properties
 //		m_config.transient = props.getBoolean("transient", false);
@@ -162,12 +288,36 @@ public:
 
 		if (m_config.maxDepth <= 0 && m_config.maxDepth != -1)
 			Log(EError, "'maxDepth' must be set to -1 (infinite) or a value greater than zero!");
+
+		if (m_seedSplit < -1)
+			Log(EError, "'seedSplit' must be set to -1 (one work unit per core), 0 (disabled) "
+				"or a value greater than zero!");
+
+		if (m_config.guidingBSDFFraction <= 0 || m_config.guidingBSDFFraction > 1)
+			Log(EError, "'guidingBSDFFraction' must be in the interval (0, 1]!");
+
+		if (m_config.guidingSpatialThreshold <= 0)
+			Log(EError, "'guidingSpatialThreshold' must be set to a value greater than zero!");
+
+		if (m_config.denoiseRadius < 0 || m_config.denoiseTemporalRadius < 0 ||
+			m_config.denoisePatchRadius < 0)
+			Log(EError, "The denoiser radii must be nonnegative!");
+
+		if (m_config.denoiseStrength <= 0)
+			Log(EError, "'denoiseStrength' must be set to a value greater than zero!");
+
+		if (m_config.lightPaths < 0)
+			Log(EError, "'lightPaths' must be set to 0 (disabled) or a value greater than zero!");
+
+		if (m_config.lightConnections <= 0)
+			Log(EError, "'lightConnections' must be set to a value greater than zero!");
 	}
 
 	/// Unserialize from a binary data stream
 	BDPTIntegrator(Stream *stream, InstanceManager *manager)
 	 : Integrator(stream, manager) {
 		m_config = BDPTConfiguration(stream);
+		m_seedSplit = m_config.seedSplit;
 	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
@@ -229,6 +379,33 @@ public:
 
 		m_config.pathLengthSampler = film->getPathLengthSampler();
 
+		m_config.roiMinBin = film->getRegionMinBin();
+		m_config.roiMaxBin = film->getRegionMaxBin();
+		if (m_config.denoise && film->getProperties().hasProperty("resumeFile"))
+			Log(EError, "'denoise' cannot be combined with resuming a render state!");
+
+		if (m_config.timeTags) {
+			if (m_config.m_decompositionType == Film::ESteadyState)
+				Log(EError, "'timeTags' requires a transient or bounce decomposition!");
+			if (m_config.pathLengthSampler->getModulationType() != PathLengthSampler::ENone)
+				Log(EError, "'timeTags' cannot be combined with a modulated path length sampler!");
+		}
+
+		if (m_config.sampleOffset > 0) {
+			/* Only the deterministic samplers can generate arbitrary sample
+			   indices; others precompute a fixed number of samples per pixel */
+			const Properties &samplerProps = scene->getSampler()->getProperties();
+			const std::string &samplerName = samplerProps.getPluginName();
+			if (samplerName == "independent") {
+				if (!samplerProps.hasProperty("seed"))
+					Log(EError, "'sampleOffset' has no effect on the independent sampler -- "
+						"please give it a different 'seed' than the previous runs instead!");
+			} else if (samplerName != "halton" && samplerName != "hammersley" && samplerName != "sobol") {
+				Log(EError, "'sampleOffset' requires a sampler that supports arbitrary sample "
+					"indices (halton, hammersley or sobol), or an independent sampler with a "
+					"different 'seed'. The sampler '%s' does not support it!", samplerName.c_str());
+			}
+		}
 
 		// m_config.m_forceBounces = film->getForceBounces();
 		// m_config.m_sBounces  	= film->getSBounces();
@@ -255,11 +432,56 @@ public:
 		m_config.blockSize = scene->getBlockSize();
 		m_config.cropSize = film->getCropSize();
 		m_config.sampleCount = sampleCount;
+
+		if (m_config.lightPaths > 0) {
+			if (m_config.m_isAdaptive)
+				Log(EError, "'lightPaths' cannot be combined with adaptive sampling!");
+			if (sensor->needsTimeSample())
+				Log(EError, "'lightPaths' cannot be combined with motion blur!");
+		}
+
+		m_config.seedSplit = 0;
+		if (m_seedSplit != 0) {
+			if (m_config.m_isAdaptive)
+				Log(EError, "'seedSplit' cannot be combined with adaptive sampling!");
+			/* Every work unit renders the whole image using a disjoint range of sample indices */
+			m_config.seedSplit = (int) std::min(sampleCount, m_seedSplit == -1
+				? nCores : (size_t) m_seedSplit);
+			Log(EInfo, "Splitting the " SIZE_T_FMT " samples per pixel into %i full-image work units",
+				sampleCount, m_config.seedSplit);
+		}
 		m_config.dump();
 		std::cout << "check0" << std::endl;
 
-		ref<BDPTProcess> process = new BDPTProcess(job, queue, m_config);
+		ref<PathGuide> guide;
+		if (m_config.guiding) {
+			/* The path length dimension is only meaningful for transient renderings */
+			bool transient = m_config.m_decompositionType == Film::ETransient
+				|| m_config.m_decompositionType == Film::ETransientEllipse;
+			guide = new PathGuide(scene->getAABB(),
+				transient ? m_config.m_decompositionMaxBound : 0.0f,
+				m_config.guidingBSDFFraction, m_config.guidingSpatialThreshold);
+		}
+
+		ref<BDPTProcess> process = new BDPTProcess(job, queue, m_config, guide);
 		m_process = process;
+
+		ref<TimeTagFile> timeTags;
+		if (m_config.timeTags) {
+			TimeTagFile::Header header;
+			header.size = m_config.cropSize;
+			header.sampleCount = sampleCount;
+			header.decompositionType = m_config.m_decompositionType;
+			header.minBound = m_config.m_decompositionMinBound;
+			header.maxBound = m_config.m_decompositionMaxBound;
+			header.binWidth = m_config.m_decompositionBinWidth;
+
+			fs::path path = scene->getDestinationFile();
+			path.replace_extension(".ttag");
+			Log(EInfo, "Writing time-tag events to \"%s\"", path.string().c_str());
+			timeTags = new TimeTagFile(path, header);
+			process->setTimeTagFile(timeTags);
+		}
 		std::cout << "check1" << std::endl;
 		process->bindResource("scene", sceneResID);
 		std::cout << "check2" << std::endl;
@@ -273,7 +495,19 @@ public:
 		scheduler->wait(process);
 		std::cout << "check6" << std::endl;
 		m_process = NULL;
+		if (timeTags) {
+			timeTags->close();
+			Log(EInfo, "Wrote %llu time-tag events",
+				(unsigned long long) timeTags->getHeader().eventCount);
+		}
 		process->develop();
+		if (m_config.denoise && process->getReturnStatus() == ParallelProcess::ESuccess)
+			process->denoise();
+		/* Don't leave the AOVs of a previous render attached to the film */
+		if (m_config.aovs)
+			film->setAOVs(process->developAOVs());
+		else
+			film->setAOVs(NULL);
 
 		#if BDPT_DEBUG == 1
 			fs::path path = scene->getDestinationFile();
@@ -288,6 +522,7 @@ public:
 private:
 	ref<ParallelProcess> m_process;
 	BDPTConfiguration m_config;
+	int m_seedSplit;
 };
 
 MTS_IMPLEMENT_CLASS_S(BDPTIntegrator, false, Integrator)
@@ -42,6 +42,7 @@ MTS_NAMESPACE_BEGIN
  */
 struct BDPTConfiguration {
 	int maxDepth, blockSize, borderSize;
+	int seedSplit;
 	bool lightImage;
 	bool sampleDirect;
 	bool showWeighted;
@@ -69,6 +70,29 @@ struct BDPTConfiguration {
 	unsigned int m_sBounces;
 	unsigned int m_tBounces;
 
+	// path guiding
+	bool guiding;
+	Float guidingBSDFFraction;
+	int guidingSpatialThreshold;
+
+	// develop-time denoising
+	bool denoise;
+	int denoiseRadius, denoiseTemporalRadius, denoisePatchRadius;
+	Float denoiseStrength;
+
+	// time-tag (raw event) output
+	bool timeTags;
+
+	// first-return AOVs (depth, normal, albedo)
+	bool aovs;
+
+	// shared pool of emitter subpaths per work unit (light vertex cache)
+	int lightPaths, lightConnections;
+
+	// incremental re-rendering: first sample index and the film's bin range
+	size_t sampleOffset;
+	int roiMinBin, roiMaxBin;
+
 	// ref<PathLengthSampler> pathLengthSampler;
 
 	// bool m_forceBounces;
@@ -80,6 +104,7 @@ struct BDPTConfiguration {
 	inline BDPTConfiguration(Stream *stream) {
 		maxDepth = stream->readInt();
 		blockSize = stream->readInt();
+		seedSplit = stream->readInt();
 		lightImage = stream->readBool();
 		sampleDirect = stream->readBool();
 		showWeighted = stream->readBool();
@@ -111,11 +136,32 @@ struct BDPTConfiguration {
 		m_forceBounces = stream->readBool();
 		m_sBounces = stream->readUInt();
 		m_tBounces = stream->readUInt();
+
+		guiding = stream->readBool();
+		guidingBSDFFraction = stream->readFloat();
+		guidingSpatialThreshold = stream->readInt();
+
+		denoise = stream->readBool();
+		denoiseRadius = stream->readInt();
+		denoiseTemporalRadius = stream->readInt();
+		denoisePatchRadius = stream->readInt();
+		denoiseStrength = stream->readFloat();
+
+		timeTags = stream->readBool();
+		aovs = stream->readBool();
+
+		lightPaths = stream->readInt();
+		lightConnections = stream->readInt();
+
+		sampleOffset = stream->readSize();
+		roiMinBin = stream->readInt();
+		roiMaxBin = stream->readInt();
 	}
 
 	inline void serialize(Stream *stream) const {
 		stream->writeInt(maxDepth);
 		stream->writeInt(blockSize);
+		stream->writeInt(seedSplit);
 		stream->writeBool(lightImage);
 		stream->writeBool(sampleDirect);
 		stream->writeBool(showWeighted);
@@ -142,6 +188,26 @@ struct BDPTConfiguration {
 		stream->writeBool(m_forceBounces);
 		stream->writeUInt(m_sBounces);
 		stream->writeUInt(m_tBounces);
+
+		stream->writeBool(guiding);
+		stream->writeFloat(guidingBSDFFraction);
+		stream->writeInt(guidingSpatialThreshold);
+
+		stream->writeBool(denoise);
+		stream->writeInt(denoiseRadius);
+		stream->writeInt(denoiseTemporalRadius);
+		stream->writeInt(denoisePatchRadius);
+		stream->writeFloat(denoiseStrength);
+
+		stream->writeBool(timeTags);
+		stream->writeBool(aovs);
+
+		stream->writeInt(lightPaths);
+		stream->writeInt(lightConnections);
+
+		stream->writeSize(sampleOffset);
+		stream->writeInt(roiMinBin);
+		stream->writeInt(roiMaxBin);
 	}
 
 	void dump() const {
@@ -167,6 +233,7 @@ struct BDPTConfiguration {
 			lightImage ? "yes" : "no");
 		SLog(EDebug, "   Russian roulette depth      : %i", rrDepth);
 		SLog(EDebug, "   Block size                  : %i", blockSize);
+		SLog(EDebug, "   Seed-split work units       : %i", seedSplit);
 		SLog(EDebug, "   Number of samples           : " SIZE_T_FMT, sampleCount);
 		SLog(EDebug, "   decomposition type 		 : %s", decompositionType.c_str());
 		SLog(EDebug, "   Combine BDPT and Elliptic?  : %s",
@@ -189,6 +256,31 @@ struct BDPTConfiguration {
 		SLog(EDebug, "   Force Bounces		 	 	 : %i", m_forceBounces);
 		SLog(EDebug, "   S Bounce number		 	 : %i", m_sBounces);
 		SLog(EDebug, "   T Bounce number		 	 : %i", m_tBounces);
+		SLog(EDebug, "   Path guiding                : %s",
+			guiding ? "yes" : "no");
+		if (guiding) {
+			SLog(EDebug, "   Guiding BSDF fraction       : %f", guidingBSDFFraction);
+			SLog(EDebug, "   Guiding spatial threshold   : %i", guidingSpatialThreshold);
+		}
+		SLog(EDebug, "   Denoise at develop time     : %s",
+			denoise ? "yes" : "no");
+		if (denoise) {
+			SLog(EDebug, "   Denoiser radius (px, bins)  : %i, %i",
+				denoiseRadius, denoiseTemporalRadius);
+			SLog(EDebug, "   Denoiser patch radius       : %i", denoisePatchRadius);
+			SLog(EDebug, "   Denoiser strength           : %f", denoiseStrength);
+		}
+		SLog(EDebug, "   Write time-tag events       : %s",
+			timeTags ? "yes" : "no");
+		SLog(EDebug, "   Write first-return AOVs     : %s",
+			aovs ? "yes" : "no");
+		if (lightPaths > 0)
+			SLog(EDebug, "   Pooled emitter subpaths     : %i per work unit, %i connections",
+				lightPaths, lightConnections);
+		else
+			SLog(EDebug, "   Pooled emitter subpaths     : no");
+		SLog(EDebug, "   First sample index          : " SIZE_T_FMT, sampleOffset);
+		SLog(EDebug, "   Region of interest bins     : %i to %i", roiMinBin, roiMaxBin);
 
 		#if BDPT_DEBUG == 1
 			SLog(EDebug, "   Show weighted contributions : %s", showWeighted ? "yes" : "no");
@@ -0,0 +1,181 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include "bdpt_denoise.h"
+
+MTS_NAMESPACE_BEGIN
+
+/* Avoids a division by zero when comparing noise-free pixels */
+#define DENOISE_EPSILON 1e-10f
+
+/* Number of image rows per unit of parallel work */
+#define DENOISE_BAND_HEIGHT 16
+
+/* Bandwidths of the guide features: relative depth difference and
+   distance between unit normals (0.3 corresponds to about 17 degrees) */
+#define DENOISE_DEPTH_SIGMA 0.05f
+#define DENOISE_NORMAL_SIGMA 0.3f
+
+Float TransientDenoiser::guideDistance(const Float *p, const Float *q) {
+	Float depthDiff = (p[0] - q[0]) / std::max(std::max(p[0], q[0]), (Float) DENOISE_EPSILON),
+	      normalDiff = 0.0f;
+	for (int k=1; k<4; ++k)
+		normalDiff += (p[k] - q[k]) * (p[k] - q[k]);
+	return depthDiff * depthDiff * (1.0f / (DENOISE_DEPTH_SIGMA * DENOISE_DEPTH_SIGMA))
+		+ normalDiff * (1.0f / (DENOISE_NORMAL_SIGMA * DENOISE_NORMAL_SIGMA));
+}
+
+void TransientDenoiser::boxFilter(const Vector2i &size, Float *data, Float *temp) const {
+	const int width = size.x, height = size.y, f = m_patchRadius;
+	if (f <= 0)
+		return;
+
+	/* Horizontal pass */
+	for (int y=0; y<height; ++y) {
+		const Float *row = data + (size_t) y * width;
+		Float *target = temp + (size_t) y * width;
+		for (int x=0; x<width; ++x) {
+			Float sum = 0.0f;
+			for (int k=-f; k<=f; ++k)
+				sum += row[std::min(std::max(x + k, 0), width - 1)];
+			target[x] = sum;
+		}
+	}
+
+	/* Vertical pass */
+	const Float normalization = 1.0f / ((2*f + 1) * (2*f + 1));
+	for (int y=0; y<height; ++y) {
+		Float *target = data + (size_t) y * width;
+		for (int x=0; x<width; ++x) {
+			Float sum = 0.0f;
+			for (int k=-f; k<=f; ++k)
+				sum += temp[(size_t) std::min(std::max(y + k, 0), height - 1) * width + x];
+			target[x] = sum * normalization;
+		}
+	}
+}
+
+void TransientDenoiser::denoise(const Vector2i &size, int bins, const Float *color,
+		size_t stride, const Float *variance, const Float *guide, Float *output) const {
+	const int width = size.x, height = size.y, f = m_patchRadius;
+	const size_t nPixels = (size_t) width * (size_t) height;
+	const Float k2 = m_strength * m_strength;
+
+	/* Bin-major luminance planes used to compare patches */
+	std::vector<Float> lum(nPixels * bins);
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for
+#endif
+	for (int b=0; b<bins; ++b) {
+		for (size_t i=0; i<nPixels; ++i)
+			lum[b * nPixels + i] = luminance(color + i * stride + b * SPECTRUM_SAMPLES);
+	}
+
+	/* Work is distributed over (time bin, band of rows) pairs, so that
+	   images with few bins are filtered in parallel, too */
+	const int nBands = (height + DENOISE_BAND_HEIGHT - 1) / DENOISE_BAND_HEIGHT,
+	          nItems = bins * nBands;
+
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int item=0; item<nItems; ++item) {
+		const int b = item / nBands, band = item % nBands;
+
+		/* Rows [ys, ye) are filtered. The patch distances are also needed for
+		   the patch radius on either side; the band is treated as an image of
+		   its own, whose clamped edges only matter where it meets the image edges */
+		const int ys = band * DENOISE_BAND_HEIGHT,
+		          ye = std::min(ys + DENOISE_BAND_HEIGHT, height),
+		          y0 = std::max(ys - f, 0),
+		          y1 = std::min(ye + f, height);
+		const Vector2i bandSize(width, y1 - y0);
+		const size_t nBandPixels = (size_t) width * (size_t) (y1 - y0);
+
+		std::vector<Float> dist(nBandPixels), temp(nBandPixels),
+			weights(nBandPixels, 0.0f), accum(nBandPixels * SPECTRUM_SAMPLES, 0.0f);
+		const Float *lumP = &lum[b * nPixels], *varP = variance + b * nPixels;
+
+		for (int bq = std::max(b - m_temporalRadius, 0);
+				bq <= std::min(b + m_temporalRadius, bins - 1); ++bq) {
+			const Float *lumQ = &lum[bq * nPixels], *varQ = variance + bq * nPixels;
+
+			for (int dy=-m_radius; dy<=m_radius; ++dy) {
+				for (int dx=-m_radius; dx<=m_radius; ++dx) {
+					/* Variance-normalized squared distance between each pixel
+					   and its shifted counterpart (shifts are clamped to the image) */
+					for (int y=y0; y<y1; ++y) {
+						int qy = std::min(std::max(y + dy, 0), height - 1);
+						for (int x=0; x<width; ++x) {
+							int qx = std::min(std::max(x + dx, 0), width - 1);
+							size_t i = (size_t) y * width + x,
+							       iq = (size_t) qy * width + qx;
+							Float vp = varP[i], vq = varQ[iq], diff = lumP[i] - lumQ[iq];
+							dist[(size_t) (y - y0) * width + x] = (diff * diff - (vp + std::min(vp, vq)))
+								/ (DENOISE_EPSILON + k2 * (vp + vq));
+						}
+					}
+
+					/* Compare whole patches instead of individual pixels */
+					boxFilter(bandSize, &dist[0], &temp[0]);
+
+					for (int y=ys; y<ye; ++y) {
+						int qy = y + dy;
+						if (qy < 0 || qy >= height)
+							continue;
+						for (int x=0; x<width; ++x) {
+							int qx = x + dx;
+							if (qx < 0 || qx >= width)
+								continue;
+							size_t i = (size_t) y * width + x,
+							       iq = (size_t) qy * width + qx,
+							       j = (size_t) (y - y0) * width + x;
+							Float d = std::max(dist[j], (Float) 0.0f);
+							if (guide)
+								d += guideDistance(guide + i * 4, guide + iq * 4);
+							Float weight = std::exp(-d);
+							const Float *value = color + iq * stride + bq * SPECTRUM_SAMPLES;
+							for (int k=0; k<SPECTRUM_SAMPLES; ++k)
+								accum[j * SPECTRUM_SAMPLES + k] += weight * value[k];
+							weights[j] += weight;
+						}
+					}
+				}
+			}
+		}
+
+		for (int y=ys; y<ye; ++y) {
+			for (int x=0; x<width; ++x) {
+				size_t i = (size_t) y * width + x,
+				       j = (size_t) (y - y0) * width + x;
+				Float *target = output + i * stride + b * SPECTRUM_SAMPLES;
+				if (weights[j] > 0) {
+					Float invWeight = 1.0f / weights[j];
+					for (int k=0; k<SPECTRUM_SAMPLES; ++k)
+						target[k] = accum[j * SPECTRUM_SAMPLES + k] * invWeight;
+				} else {
+					const Float *value = color + i * stride + b * SPECTRUM_SAMPLES;
+					for (int k=0; k<SPECTRUM_SAMPLES; ++k)
+						target[k] = value[k];
+				}
+			}
+		}
+	}
+}
+
+MTS_NAMESPACE_END
@@ -0,0 +1,110 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(__BDPT_DENOISE_H)
+#define __BDPT_DENOISE_H
+
+#include <mitsuba/mitsuba.h>
+
+MTS_NAMESPACE_BEGIN
+
+/* ==================================================================== */
+/*                          Transient denoiser                          */
+/* ==================================================================== */
+
+/**
+ * \brief Joint space-time non-local means filter for transient images
+ *
+ * Every pixel of every time bin is replaced by a weighted average over a
+ * spatial window in the same and in the neighboring time bins. The weights
+ * compare small spatial patches of the luminance, normalized by the
+ * estimated variance of the pixel values (Rousselle et al., "Adaptive
+ * Rendering with Non-Local Means Filtering", 2012), so that noise is
+ * averaged away while features that exceed the noise level are kept.
+ * When the depth and normal of the first surface seen through every pixel
+ * are available, they additionally keep the filter from averaging across
+ * geometric edges (as in a cross-bilateral filter).
+ *
+ * The time bins and bands of image rows are filtered in parallel.
+ */
+class TransientDenoiser {
+public:
+	/**
+	 * \param radius
+	 *     Spatial radius of the search window in pixels
+	 * \param temporalRadius
+	 *     Number of neighboring time bins (on each side) that are searched
+	 * \param patchRadius
+	 *     Spatial radius of the patches that are compared
+	 * \param strength
+	 *     Filter strength (the parameter \a k of Rousselle et al.)
+	 */
+	TransientDenoiser(int radius, int temporalRadius, int patchRadius, Float strength)
+		: m_radius(radius), m_temporalRadius(temporalRadius),
+		  m_patchRadius(patchRadius), m_strength(strength) { }
+
+	/**
+	 * \brief Denoise a transient image
+	 *
+	 * \param size
+	 *     Image resolution
+	 * \param bins
+	 *     Number of time bins
+	 * \param color
+	 *     Pixel-major image data. Bin \c b of pixel \c i is stored at
+	 *     <tt>color[i*stride + b*SPECTRUM_SAMPLES]</tt>
+	 * \param stride
+	 *     Number of values per pixel
+	 * \param variance
+	 *     Bin-major (<tt>[bin][y][x]</tt>) variance of the luminance
+	 *     of each pixel value
+	 * \param guide
+	 *     Optional pixel-major guide features (or \c NULL): the depth and
+	 *     the shading normal of the first surface seen through each
+	 *     pixel, i.e. four values per pixel. Escaped pixels have zero depth
+	 * \param output
+	 *     Target buffer with the same layout as \c color. Only the
+	 *     color values are written
+	 */
+	void denoise(const Vector2i &size, int bins, const Float *color,
+		size_t stride, const Float *variance, const Float *guide,
+		Float *output) const;
+
+	/// Luminance of a pixel value stored in the film's (linear RGB) layout
+	static inline Float luminance(const Float *value) {
+		Spectrum spec;
+		for (int k=0; k<SPECTRUM_SAMPLES; ++k)
+			spec[k] = value[k];
+		return spec.getLuminance();
+	}
+private:
+	/// Box-filter \c data over the patch footprint (edges are clamped)
+	void boxFilter(const Vector2i &size, Float *data, Float *temp) const;
+
+	/// Squared, bandwidth-normalized distance between two guide features
+	static Float guideDistance(const Float *p, const Float *q);
+private:
+	int m_radius;
+	int m_temporalRadius;
+	int m_patchRadius;
+	Float m_strength;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __BDPT_DENOISE_H */
@@ -18,8 +18,13 @@
 
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/core/sfcurve.h>
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/qmc.h>
 #include <mitsuba/bidir/util.h>
+#include <mitsuba/render/range.h>
 #include "bdpt_proc.h"
+#include "bdpt_denoise.h"
+#include "bdpt_subpath.h"
 
 MTS_NAMESPACE_BEGIN
 
@@ -29,24 +34,31 @@ MTS_NAMESPACE_BEGIN
 
 class BDPTRenderer : public WorkProcessor {
 public:
-	BDPTRenderer(const BDPTConfiguration &config) : m_config(config) { }
+	BDPTRenderer(const BDPTConfiguration &config, PathGuide *guide = NULL)
+		: m_config(config), m_guide(guide), m_laserPrefixReady(false) { }
 
 	BDPTRenderer(Stream *stream, InstanceManager *manager)
-		: WorkProcessor(stream, manager), m_config(stream) { }
+		: WorkProcessor(stream, manager), m_config(stream),
+		  m_laserPrefixReady(false) { }
 
-	virtual ~BDPTRenderer() { }
+	virtual ~BDPTRenderer() {
+		m_laserPrefix.release(m_prefixPool);
+	}
 
 	void serialize(Stream *stream, InstanceManager *manager) const {
 		m_config.serialize(stream);
 	}
 
 	ref<WorkUnit> createWorkUnit() const {
-		return new RectangularWorkUnit();
+		if (m_config.seedSplit > 0)
+			return new RangeWorkUnit();
+		else
+			return new RectangularWorkUnit();
 	}
 
 	ref<WorkResult> createWorkResult() const {
 		return new BDPTWorkResult(m_config, m_rfilter.get(),
-			Vector2i(m_config.blockSize));
+			m_config.seedSplit > 0 ? m_imageSize : Vector2i(m_config.blockSize));
 	}
 
 	void prepare() {
@@ -62,6 +74,22 @@ public:
 		m_scene->wakeup(NULL, m_resources);
 		m_scene->initializeBidirectional();
 
+		/* The path length sampler is not part of the serialized configuration;
+		   network render nodes obtain it from their copy of the film */
+		if (!m_config.pathLengthSampler)
+			m_config.pathLengthSampler = m_sensor->getFilm()->getPathLengthSampler();
+
+		/* Region covered by a work unit in seed-split mode (same as the
+		   union of all blocks in block mode) */
+		Film *film = m_sensor->getFilm();
+		m_imageOffset = Point2i(0, 0);
+		m_imageSize = film->getCropSize();
+		if (film->hasHighQualityEdges()) {
+			int borderSize = m_rfilter->getBorderSize();
+			m_imageOffset -= Vector2i(borderSize, borderSize);
+			m_imageSize += Vector2i(2 * borderSize, 2 * borderSize);
+		}
+
 		if((m_config.m_isldSampling || m_config.m_isAdaptive) && m_sampler->getSampleCount()%m_config.m_frames != 0)
 			SLog(EError, "Number of samples (%i) must be integral multiple of number of frames (%i) "
 					"if ldsampling or adaptive sampling is enabled", m_sampler->getSampleCount(), m_config.m_frames);
@@ -70,15 +98,30 @@ public:
 	}
 
 	void process(const WorkUnit *workUnit, WorkResult *workResult, const bool &stop) {
-		const RectangularWorkUnit *rect = static_cast<const RectangularWorkUnit *>(workUnit);
+		const RectangularWorkUnit *rect = NULL;
+		const RangeWorkUnit *range = NULL;
 		BDPTWorkResult *result = static_cast<BDPTWorkResult *>(workResult);
 		bool needsTimeSample = m_sensor->needsTimeSample();
 		Float time = m_sensor->getShutterOpen();
+		const Film *film = m_sensor->getFilm();
 
-		result->setOffset(rect->getOffset());
-		result->setSize(rect->getSize());
+		if (m_config.seedSplit > 0) {
+			range = static_cast<const RangeWorkUnit *>(workUnit);
+			result->setOffset(m_imageOffset);
+			result->setSize(m_imageSize);
+		} else {
+			rect = static_cast<const RectangularWorkUnit *>(workUnit);
+			result->setOffset(rect->getOffset());
+			result->setSize(rect->getSize());
+			m_hilbertCurve.initialize(TVector2<uint8_t>(rect->getSize()));
+		}
 		result->clear();
-		m_hilbertCurve.initialize(TVector2<uint8_t>(rect->getSize()));
+
+		/* Pick up the most recent guiding distributions */
+		if (m_guide) {
+			m_emitterGuide = m_guide->getTree(EImportance);
+			m_sensorGuide = m_guide->getTree(ERadiance);
+		}
 
 		#if defined(MTS_DEBUG_FP)
 			enableFPExceptions();
@@ -113,41 +156,55 @@ public:
 		if (!m_scene->hasDegenerateEmitters() && sensorDepth != -1)
 			++sensorDepth;
 
-		if(!m_config.m_isAdaptive){ //Not adaptive, so perform the regular technique
+		if (!m_laserPrefixReady)
+			prepareLaserPrefix(result, emitterDepth);
+
+		if (m_config.lightPaths > 0) {
+			/* Seed the pool from the work unit (and the sample offset of
+			   incremental renderings), so that different workers and work
+			   units do not share the same emitter subpaths */
+			uint64_t seed = range
+				? sampleTEA((uint32_t) range->getRangeStart(), 0xFFFFFFFFU)
+				: sampleTEA((uint32_t) rect->getOffset().x, (uint32_t) rect->getOffset().y);
+			seed ^= sampleTEA((uint32_t) m_config.sampleOffset,
+				(uint32_t) ((uint64_t) m_config.sampleOffset >> 32));
+			fillLightPathPool(result, emitterDepth, seed);
+		}
+
+		if (range) {
+			/* Seed-split mode: render every pixel of the image, but only using
+			   the sample indices [rangeStart, rangeEnd]. The remaining indices
+			   are handled by other work units (possibly on other machines) */
+			for (int y=0; y<m_imageSize.y && !stop; ++y) {
+				for (int x=0; x<m_imageSize.x; ++x) {
+					Point2i offset = m_imageOffset + Vector2i(x, y);
+					if (!film->isInRegionOfInterest(offset))
+						continue;
+					m_sampler->generate(offset);
+					m_sampler->setSampleIndex(m_config.sampleOffset + range->getRangeStart());
+
+					for (size_t j = range->getRangeStart(); j<=range->getRangeEnd(); j++) {
+						if (stop)
+							break;
+						renderSample(result, emitterSubpath, emitterDepth,
+							sensorSubpath, sensorDepth, offset, j);
+					}
+				}
+			}
+		} else if(!m_config.m_isAdaptive){ //Not adaptive, so perform the regular technique
 			for (size_t i=0; i<m_hilbertCurve.getPointCount(); ++i) {
 				Point2i offset = Point2i(m_hilbertCurve[i]) + Vector2i(rect->getOffset());
+				if (!film->isInRegionOfInterest(offset))
+					continue;
 				m_sampler->generate(offset);
+				if (m_config.sampleOffset > 0)
+					m_sampler->setSampleIndex(m_config.sampleOffset);
 
 				for (size_t j = 0; j<m_sampler->getSampleCount(); j++) {
 					if (stop)
 						break;
-
-					if (needsTimeSample)
-						time = m_sensor->sampleTime(m_sampler->next1D());
-
-					/* Start new emitter and sensor subpaths */
-					emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
-					sensorSubpath.initialize(m_scene, time, ERadiance, m_pool);
-
-					/* Sample a random path length between pathMin and PathMax which will be equal to the total path for this path: TODO: Extend to multiple random path lengths? */
-					Float pathLengthTarget;
-					if(!m_config.m_isldSampling)
-						pathLengthTarget = result->samplePathLengthTarget(m_sampler);
-					else
-						pathLengthTarget = m_config.m_decompositionMinBound + m_config.m_decompositionBinWidth*(j%m_config.m_frames) + m_config.m_decompositionBinWidth*m_sampler->nextFloat();
-
-					// TODO: For transientEllipse, stop generating random paths after pathLength target
-					/* Perform a random walk using alternating steps on each path */
-					Path::alternatingRandomWalkFromPixel(m_scene, m_sampler,result,
-						emitterSubpath, emitterDepth, sensorSubpath,
-						sensorDepth, offset, m_config.rrDepth, m_pool);
-
-					evaluate(result, emitterSubpath, sensorSubpath, pathLengthTarget);
-
-					emitterSubpath.release(m_pool);
-					sensorSubpath.release(m_pool);
-
-					m_sampler->advance();
+					renderSample(result, emitterSubpath, emitterDepth,
+						sensorSubpath, sensorDepth, offset, j);
 				}
 			}
 		}else {
@@ -158,6 +215,8 @@ public:
 			BDPTConfiguration fakeConfig = m_config;
 			fakeConfig.m_decompositionBinWidth = fakeConfig.m_decompositionMaxBound-fakeConfig.m_decompositionMinBound;
 			fakeConfig.m_frames = 1; // mean value can be computed with average only
+			fakeConfig.timeTags = false;
+			fakeConfig.aovs = false;
 
 			// Create a fake work result to use the evaluate function and put either transient/transientEllipse case there
 			BDPTWorkResult *fakeResult = new BDPTWorkResult(fakeConfig, m_rfilter.get(),
@@ -182,11 +241,12 @@ public:
 					time = m_sensor->sampleTime(m_sampler->next1D());
 
 				/* Start new emitter and sensor subpaths */
-				emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
+				startEmitterSubpath(emitterSubpath, time);
 								sensorSubpath.initialize(m_scene, time, ERadiance, m_pool);
 				Path::alternatingRandomWalkFromPixel(m_scene, m_sampler,result,
 					emitterSubpath, emitterDepth, sensorSubpath,
-					sensorDepth, offset, m_config.rrDepth, m_pool);
+					sensorDepth, offset, m_config.rrDepth, m_pool,
+					m_emitterGuide.get(), m_sensorGuide.get());
 				meanValue += evaluate(fakeResult, emitterSubpath, sensorSubpath, pathLengthTarget);
 
 				emitterSubpath.release(m_pool);
@@ -214,7 +274,11 @@ public:
 
 			for (size_t i=0; i<m_hilbertCurve.getPointCount(); ++i) {
 				Point2i offset = Point2i(m_hilbertCurve[i]) + Vector2i(rect->getOffset());
+				if (!film->isInRegionOfInterest(offset))
+					continue;
 				m_sampler->generate(offset);
+				if (m_config.sampleOffset > 0)
+					m_sampler->setSampleIndex(m_config.sampleOffset);
 
 				for (size_t j=0; j < m_config.m_frames; j++){
 
@@ -239,7 +303,7 @@ public:
 							time = m_sensor->sampleTime(m_sampler->next1D());
 
 						/* Start new emitter and sensor subpaths */
-						emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
+						startEmitterSubpath(emitterSubpath, time);
 						sensorSubpath.initialize(m_scene, time, ERadiance, m_pool);
 
 						/* Sample a random path length between pathMin and PathMax which will be equal to the total path for this path: TODO: Extend to multiple random path lengths? */
@@ -253,7 +317,8 @@ public:
 						/* Perform a random walk using alternating steps on each path */
 						Path::alternatingRandomWalkFromPixel(m_scene, m_sampler,result,
 							emitterSubpath, emitterDepth, sensorSubpath,
-							sensorDepth, offset, m_config.rrDepth, m_pool);
+							sensorDepth, offset, m_config.rrDepth, m_pool,
+							m_emitterGuide.get(), m_sensorGuide.get());
 
 						Spectrum sampleValue = evaluate(result, emitterSubpath, sensorSubpath, pathLengthTarget);
 
@@ -303,18 +368,221 @@ public:
 			disableFPExceptions();
 		#endif
 
+		for (size_t i=0; i<m_lightPaths.size(); ++i)
+			m_lightPaths[i].release(m_pool);
+		m_lightPaths.clear();
+
 		/* Make sure that there were no memory leaks */
 		Assert(m_pool.unused());
 	}
 
-	/// Evaluate the contributions of the given eye and light paths
+	/**
+	 * \brief Trace the pool of emitter subpaths that is shared by all
+	 * sensor samples of the current work unit
+	 *
+	 * Failed random walks are kept as well (as paths consisting only of the
+	 * supernode), since they are part of the distribution being sampled.
+	 * The paths are traced using a separate sample generator with the
+	 * given seed, since they are not associated with any particular pixel.
+	 */
+	void fillLightPathPool(const BDPTWorkResult *wr, int emitterDepth, uint64_t seed) {
+		Properties props("independent");
+		props.setLong("seed", (int64_t) seed);
+		m_lightSampler = static_cast<Sampler *> (PluginManager::getInstance()->
+			createObject(MTS_CLASS(Sampler), props));
+		m_lightSampler->configure();
+
+		Float time = m_sensor->getShutterOpen();
+		m_lightPaths.resize(m_config.lightPaths);
+		for (size_t i=0; i<m_lightPaths.size(); ++i) {
+			Path &path = m_lightPaths[i];
+			startEmitterSubpath(path, time);
+			emitterRandomWalk(wr, path, emitterDepth);
+			path.computeMISPartials(m_scene, EImportance,
+				m_config.sampleDirect, m_config.lightImage);
+			m_lightSampler->advance();
+		}
+	}
+
+	/**
+	 * \brief Random walk from the emitters only, using the same path length
+	 * cutoff as \ref Path::alternatingRandomWalkFromPixel()
+	 *
+	 * Like the latter, this continues from the last vertex of \c path
+	 * when it already contains a prefix.
+	 */
+	void emitterRandomWalk(const BDPTWorkResult *wr, Path &path, int nSteps) {
+		bool truncate = wr->m_decompositionType == Film::ETransient
+			|| wr->m_decompositionType == Film::ETransientEllipse;
+		int s = (int) path.vertexCount() - 1;
+		PathVertex *curVertex = path.vertex(s), *predVertex = path.vertexOrNull(s-1);
+		PathEdge *predEdge = path.edgeOrNull(s-1);
+		Spectrum throughput(1.0f);
+		Float pathLength = 0.0f;
+		for (int i=0; i<s; ++i) {
+			throughput *= path.vertex(i)->weight[EImportance] *
+				path.vertex(i)->rrWeight * path.edge(i)->weight[EImportance];
+			if (i > 0)
+				pathLength += path.edge(i)->length;
+		}
+
+		for (; s < nSteps || nSteps == -1; ++s) {
+			PathVertex *succVertex = m_pool.allocVertex();
+			PathEdge *succEdge = m_pool.allocEdge();
+
+			if (!curVertex->sampleNext(m_scene, m_lightSampler, predVertex,
+					predEdge, succEdge, succVertex, EImportance,
+					m_config.rrDepth != -1 && s >= m_config.rrDepth, &throughput,
+					m_emitterGuide.get(), pathLength) ||
+				(truncate && pathLength + succEdge->length > wr->m_decompositionMaxBound)) {
+				m_pool.release(succVertex);
+				m_pool.release(succEdge);
+				break;
+			}
+
+			pathLength += succEdge->length;
+			path.append(succEdge, succVertex);
+			predVertex = curVertex;
+			curVertex = succVertex;
+			predEdge = succEdge;
+		}
+	}
+
+	/**
+	 * \brief Trace the deterministic prefix shared by all emitter subpaths
+	 *
+	 * When the scene contains a single laser-type emitter (which needs
+	 * neither a position nor a direction sample) outside of participating
+	 * media, the first segment of every emitter subpath ends at the same
+	 * spot. It is traced once per worker, and emitter subpaths then start
+	 * as copies of it (see \ref startEmitterSubpath()), which saves a
+	 * ray cast per sample.
+	 */
+	void prepareLaserPrefix(const BDPTWorkResult *wr, int emitterDepth) {
+		m_laserPrefixReady = true;
+
+		const ref_vector<Emitter> &emitters = m_scene->getEmitters();
+		if (emitters.size() != 1 || m_sensor->needsTimeSample())
+			return;
+
+		/* The prefix must not be subject to russian roulette or the depth limit */
+		if ((emitterDepth != -1 && emitterDepth < 2)
+			|| (m_config.rrDepth != -1 && m_config.rrDepth < 2))
+			return;
+
+		const Emitter *emitter = emitters[0].get();
+		if (emitter->needsPositionSample() || emitter->needsDirectionSample()
+			|| emitter->getMedium() != NULL)
+			return;
+
+		m_sampler->generate(Point2i(0));
+		m_laserPrefix.initialize(m_scene, m_sensor->getShutterOpen(),
+			EImportance, m_prefixPool);
+		m_laserPrefix.randomWalk(m_scene, m_sampler, 2, -1, EImportance, m_prefixPool);
+
+		bool truncate = wr->m_decompositionType == Film::ETransient
+			|| wr->m_decompositionType == Film::ETransientEllipse;
+		if (m_laserPrefix.vertexCount() != 3 ||
+			!m_laserPrefix.vertex(2)->isSurfaceInteraction() ||
+			(truncate && m_laserPrefix.edge(1)->length > wr->m_decompositionMaxBound)) {
+			/* The laser misses the scene (or the spot is outside of the window) */
+			m_laserPrefix.release(m_prefixPool);
+			return;
+		}
+
+		Log(EDebug, "Caching the first emitter subpath segment (laser spot at %s)",
+			m_laserPrefix.vertex(2)->getPosition().toString().c_str());
+	}
+
+	/// Start a new emitter subpath, beginning with the cached laser prefix if available
+	inline void startEmitterSubpath(Path &emitterSubpath, Float time) {
+		if (m_laserPrefix.vertexCount() > 0)
+			m_laserPrefix.clone(emitterSubpath, m_pool);
+		else
+			emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
+	}
+
+	/// Generate and evaluate the sample with index \c j of the pixel at \c offset
+	inline void renderSample(BDPTWorkResult *result, Path &emitterSubpath, int emitterDepth,
+			Path &sensorSubpath, int sensorDepth, const Point2i &offset, size_t j) {
+		Float time = m_sensor->getShutterOpen();
+		if (m_sensor->needsTimeSample())
+			time = m_sensor->sampleTime(m_sampler->next1D());
+
+		/* Start new emitter and sensor subpaths (only the supernode is
+		   needed for the emitter subpath when connecting to pooled ones) */
+		if (m_lightPaths.empty())
+			startEmitterSubpath(emitterSubpath, time);
+		else
+			emitterSubpath.initialize(m_scene, time, EImportance, m_pool);
+		sensorSubpath.initialize(m_scene, time, ERadiance, m_pool);
+
+		/* Sample a random path length between pathMin and PathMax which will be equal to the total path for this path: TODO: Extend to multiple random path lengths? */
+		Float pathLengthTarget;
+		if(!m_config.m_isldSampling)
+			pathLengthTarget = result->samplePathLengthTarget(m_sampler);
+		else
+			pathLengthTarget = m_config.m_decompositionMinBound + m_config.m_decompositionBinWidth*(j%m_config.m_frames) + m_config.m_decompositionBinWidth*m_sampler->nextFloat();
+
+		if (!m_lightPaths.empty()) {
+			/* Only trace the sensor subpath (the emitter subpath stays at the
+			   supernode) and connect it to randomly chosen pooled emitter subpaths */
+			Path::alternatingRandomWalkFromPixel(m_scene, m_sampler, result,
+				emitterSubpath, 0, sensorSubpath, sensorDepth, offset,
+				m_config.rrDepth, m_pool, NULL, m_sensorGuide.get());
+			emitterSubpath.release(m_pool);
+
+			size_t poolSize = m_lightPaths.size();
+			for (int k=0; k<m_config.lightConnections; ++k) {
+				size_t index = std::min((size_t) (m_sampler->next1D() * poolSize), poolSize - 1);
+				evaluate(result, m_lightPaths[index], sensorSubpath, pathLengthTarget, k == 0);
+			}
+
+			sensorSubpath.release(m_pool);
+			m_sampler->advance();
+			return;
+		}
+
+		// TODO: For transientEllipse, stop generating random paths after pathLength target
+		/* Perform a random walk using alternating steps on each path */
+		Path::alternatingRandomWalkFromPixel(m_scene, m_sampler,result,
+			emitterSubpath, emitterDepth, sensorSubpath,
+			sensorDepth, offset, m_config.rrDepth, m_pool,
+			m_emitterGuide.get(), m_sensorGuide.get());
+
+		evaluate(result, emitterSubpath, sensorSubpath, pathLengthTarget);
+
+		emitterSubpath.release(m_pool);
+		sensorSubpath.release(m_pool);
+
+		m_sampler->advance();
+	}
+
+	/**
+	 * \brief Evaluate the contributions of the given eye and light paths
+	 *
+	 * When a sensor subpath is connected to several pooled emitter subpaths,
+	 * only the \c primary connection evaluates the light tracing strategies
+	 * and records time-tag events, so that these are counted once per sample.
+	 */
 	Spectrum evaluate(BDPTWorkResult *wr,
-			Path &emitterSubpath, Path &sensorSubpath, Float &pathLengthTarget) {
+			Path &emitterSubpath, Path &sensorSubpath, Float &pathLengthTarget,
+			bool primary = true) {
+		/* Cache partial sums so that MIS weights can be evaluated in constant
+		   time (pooled emitter subpaths were already prepared in fillLightPathPool()) */
+		if (m_lightPaths.empty())
+			emitterSubpath.computeMISPartials(m_scene, EImportance,
+				m_config.sampleDirect, m_config.lightImage);
+		sensorSubpath.computeMISPartials(m_scene, ERadiance,
+			m_config.sampleDirect, m_config.lightImage);
+
 		/* Check if the emitter is laser?*/
 		bool isEmitterLaser = false;
-		const AbstractEmitter *AE = emitterSubpath.vertex(1)->getAbstractEmitter();
-		if (!AE->needsPositionSample() && !AE->needsDirectionSample() ){
-			isEmitterLaser = true;
+		if (emitterSubpath.vertexCount() > 1) {
+			const AbstractEmitter *AE = emitterSubpath.vertex(1)->getAbstractEmitter();
+			if (!AE->needsPositionSample() && !AE->needsDirectionSample() ){
+				isEmitterLaser = true;
+			}
 		}
 
 		//For adaptive renderer
@@ -338,56 +606,53 @@ public:
 		bool combine = wr->m_combineBDPTAndElliptic;
 		Float corrWeight = 1.0f; // will hold the f(\|x\|) for the BDPT length also will be equal to BDPT_pdf if BDPT is selected and Elliptic_pdf if Elliptic-BDPT is selected
 
-		/* Compute the combined path lengths of the two subpaths */
-		Float *emitterPathlength = NULL;
-		Float *sensorPathlength = NULL;
-
-
-
-		if (wr->m_decompositionType != Film::ESteadyState) {
-			emitterPathlength = (Float *) alloca(emitterSubpath.vertexCount() * sizeof(Float));
-			sensorPathlength = (Float *) alloca(sensorSubpath.vertexCount() * sizeof(Float));
-
-			emitterPathlength[0] = sensorPathlength[0] = Float(0.0f);
-			emitterPathlength[1] = sensorPathlength[1] = Float(0.0f);
-			if (wr->m_decompositionType == Film::ETransient || wr->m_decompositionType == Film::ETransientEllipse) {
-				for (size_t i = 2; i < emitterSubpath.vertexCount(); ++i){
-					emitterPathlength[i] = emitterPathlength[i-1] + emitterSubpath.edge(i - 1)->length;
-				}
-
-				for (size_t i = 2; i < sensorSubpath.vertexCount(); ++i){
-					sensorPathlength[i] = sensorPathlength[i-1] + sensorSubpath.edge(i - 1)->length;
-				}
-			} else if (wr->m_decompositionType == Film::EBounce) {
-				for (size_t i = 2; i < emitterSubpath.vertexCount(); ++i){
-					emitterPathlength[i] = emitterPathlength[i-1] + 1.0f;
-				}
-
-				for (size_t i = 2; i < sensorSubpath.vertexCount(); ++i){
-					sensorPathlength[i] = sensorPathlength[i-1] + 1.0f;
-				}
-			}
+		/* Gather the combined weights and path lengths of the two subpaths
+		   (plus the positions used for the connection lengths below) into
+		   compact arrays, so that the strategy loop does not have to chase
+		   pointers into the full vertex records */
+		m_emitterCache.fill(emitterSubpath, EImportance, wr->m_decompositionType);
+		m_sensorCache.fill(sensorSubpath, ERadiance, wr->m_decompositionType);
+		const Spectrum *importanceWeights = m_emitterCache.getWeights(),
+		               *radianceWeights = m_sensorCache.getWeights();
+		const Float *emitterPathlength = m_emitterCache.getPathLengths(),
+		            *sensorPathlength = m_sensorCache.getPathLengths();
+
+		/* Total lengths of the deterministic connections of the current
+		   emitter vertex, indexed by t. Without modulation, connections of
+		   a transient film whose length falls outside of the time window
+		   cannot contribute and are rejected before any BSDF evaluation
+		   or visibility test */
+		bool hasConnectionLength = wr->m_decompositionType != Film::ESteadyState;
+		bool windowReject = (wr->m_decompositionType == Film::ETransient
+				&& wr->getModulationType() == PathLengthSampler::ENone)
+				|| wr->m_decompositionType == Film::EBounce;
+
+		/* The window is narrowed to the film's region of interest bins
+		   (except for the single-bin work result of the adaptive pre-pass) */
+		size_t roiMinBin = 0, roiMaxBin = wr->m_frames - 1;
+		if (wr->m_frames == m_config.m_frames) {
+			roiMinBin = (size_t) m_config.roiMinBin;
+			roiMaxBin = (size_t) m_config.roiMaxBin;
 		}
-
-		/* Compute the combined weights along the two subpaths */
-		Spectrum *importanceWeights = (Spectrum *) alloca(emitterSubpath.vertexCount() * sizeof(Spectrum)),
-				 *radianceWeights  = (Spectrum *) alloca(sensorSubpath.vertexCount()  * sizeof(Spectrum));
-
-		importanceWeights[0] = radianceWeights[0] = Spectrum(1.0f);
-		for (size_t i=1; i<emitterSubpath.vertexCount(); ++i)
-			importanceWeights[i] = importanceWeights[i-1] *
-				emitterSubpath.vertex(i-1)->weight[EImportance] *
-				emitterSubpath.vertex(i-1)->rrWeight *
-				emitterSubpath.edge(i-1)->weight[EImportance];
-
-		for (size_t i=1; i<sensorSubpath.vertexCount(); ++i)
-			radianceWeights[i] = radianceWeights[i-1] *
-				sensorSubpath.vertex(i-1)->weight[ERadiance] *
-				sensorSubpath.vertex(i-1)->rrWeight *
-				sensorSubpath.edge(i-1)->weight[ERadiance];
+		Float windowMin = wr->m_decompositionMinBound
+				+ roiMinBin * wr->m_decompositionBinWidth,
+			windowMax = std::min(wr->m_decompositionMaxBound, wr->m_decompositionMinBound
+				+ (roiMaxBin + 1) * wr->m_decompositionBinWidth);
+		if (m_connectionLength.size() < sensorSubpath.vertexCount())
+			m_connectionLength.resize(sensorSubpath.vertexCount());
+		Float *connectionLength = &m_connectionLength[0];
 
 		Spectrum sampleValue(0.0f);
 
+		/* Luminance of the in-window contributions per emitter (s) and sensor (t)
+		   subpath length, used to train the guiding distributions */
+		Float *emitterGuideValue = NULL, *sensorGuideValue = NULL;
+		if (m_guide) {
+			emitterGuideValue = (Float *) alloca(emitterSubpath.vertexCount() * sizeof(Float));
+			sensorGuideValue = (Float *) alloca(sensorSubpath.vertexCount() * sizeof(Float));
+			memset(emitterGuideValue, 0, emitterSubpath.vertexCount() * sizeof(Float));
+			memset(sensorGuideValue, 0, sensorSubpath.vertexCount() * sizeof(Float));
+		}
 
 		Float *sampleDecompositionValue = NULL;
 		Float *l_sampleDecompositionValue = NULL;
@@ -409,11 +674,15 @@ public:
 		for (int s = (int) emitterSubpath.vertexCount()-1; s >= 0; --s) {
 			/* Determine the range of sensor vertices to be traversed,
 			   while respecting the specified maximum path length */
-			int minT = std::max(2-s, m_config.lightImage ? 0 : 2),
+			int minT = std::max(2-s, m_config.lightImage && primary ? 0 : 2),
 			    maxT = (int) sensorSubpath.vertexCount() - 1;
 			if (m_config.maxDepth != -1)
 				maxT = std::min(maxT, maxDepth + 1 - s);
 
+			if (hasConnectionLength && s > 0 && maxT >= minT)
+				m_emitterCache.connectionLengths(s, m_sensorCache, minT, maxT,
+					wr->m_decompositionType, connectionLength);
+
 			for (int t = maxT; t >= minT; --t) {
 				if(s == 0 || t == 0 || (wr->m_decompositionType == Film::ETransient && s==1 && t==1)){
 					continue; // hack to remove paths that are not taken care in transientEllipse
@@ -615,12 +884,15 @@ public:
 				} else {
 
 					/* Can't connect degenerate endpoints */
-					if (vs->isDegenerate() || vt->isDegenerate())
+					if (!m_emitterCache.isConnectable(s) || !m_sensorCache.isConnectable(t))
 						continue;
 
+					if (windowReject && (connectionLength[t] < windowMin
+							|| connectionLength[t] > windowMax))
+						continue;
 
 					if(currentDecompositionType == Film::ETransient || currentDecompositionType == Film::ETransientEllipse){
-						tempPathLength = emitterPathlength[s]+sensorPathlength[t]+distance(vs->getPosition(),vt->getPosition());
+						tempPathLength = connectionLength[t];
 					}
 
 					if( combine && (currentDecompositionType == Film::ETransientEllipse) && (tempPathLength >= wr->m_decompositionMinBound) && (tempPathLength <= wr->m_decompositionMaxBound)){
@@ -753,17 +1025,24 @@ public:
 					#endif
 
 
+					Float guideValue = 0.0f;
 					if(currentDecompositionType != Film::ESteadyState){
 						if(currentDecompositionType == Film::ETransient && wr->getModulationType() != PathLengthSampler::ENone)
 								miWeight *= wr->correlationFunction(pathLength)*corrWeight;
 						else{
 							size_t binIndex = floor((pathLength - wr->m_decompositionMinBound)/(wr->m_decompositionBinWidth));
-							if ( pathLength >= wr->m_decompositionMinBound && pathLength <= wr->m_decompositionMaxBound && !value.isZero() && currentDecompositionType != Film::ESteadyState && binIndex >= 0 && binIndex < wr->m_frames){
+							if ( pathLength >= wr->m_decompositionMinBound && pathLength <= wr->m_decompositionMaxBound && !value.isZero() && currentDecompositionType != Film::ESteadyState && binIndex >= roiMinBin && binIndex <= roiMaxBin){
 								if(SPECTRUM_SAMPLES == 3)
 									value.toLinearRGB(temp[0],temp[1],temp[2]); // Verify what happens when SPECTRUM_SAMPLES ! = 3
 								else
 									SLog(EError, "cannot run transient renderer for spectrum values more than 3");
 
+								guideValue = value.getLuminance() * miWeight;
+								if (primary && wr->hasEvents()) {
+									Float rgb[3] = { temp[0] * miWeight, temp[1] * miWeight, temp[2] * miWeight };
+									wr->putEvent(t >= 2 ? initialSamplePos : samplePos, pathLength, rgb,
+										s+t-2, t == 1 ? TimeTagEvent::ELightImage : 0);
+								}
 								if (t>=2){
 									sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+0] += temp[0] * miWeight;
 									sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+1] += temp[1] * miWeight;
@@ -788,16 +1067,38 @@ public:
 							sampleValue += value * miWeight;
 						else
 							wr->putLightSample(samplePos, value * miWeight);
+						guideValue = value.getLuminance() * miWeight;
+					}
+
+					if (emitterGuideValue && guideValue > 0) {
+						emitterGuideValue[s] += guideValue;
+						sensorGuideValue[t] += guideValue;
 					}
 				}
 			}
 		}
 		if (wr->m_decompositionType == Film::ESteadyState || ( (wr->m_decompositionType == Film::ETransient || wr->m_decompositionType == Film::ETransientEllipse) && wr->getModulationType() != PathLengthSampler::ENone)) {
 			wr->putSample(initialSamplePos, sampleValue);
+			if (wr->hasMoments())
+				putMoments(wr, initialSamplePos, NULL, sampleValue);
 		} else {
 			sampleDecompositionValue[wr->getChannelCount()-2]=1.0f;
 			sampleDecompositionValue[wr->getChannelCount()-1]=1.0f;
 			wr->putSample(initialSamplePos, sampleDecompositionValue);
+			if (wr->hasMoments())
+				putMoments(wr, initialSamplePos, sampleDecompositionValue, sampleValue);
+		}
+
+		if (wr->hasAOVs())
+			putAOVs(wr, sensorSubpath, initialSamplePos);
+
+		if (m_guide) {
+			recordGuidingSamples(m_emitterGuide, emitterSubpath, EImportance,
+				importanceWeights, emitterPathlength, emitterGuideValue);
+			recordGuidingSamples(m_sensorGuide, sensorSubpath, ERadiance,
+				radianceWeights, sensorPathlength, sensorGuideValue);
+			m_emitterGuide = m_guide->update(EImportance, m_emitterGuide);
+			m_sensorGuide = m_guide->update(ERadiance, m_sensorGuide);
 		}
 
 		m_pool.release(connectionEdge1);
@@ -806,8 +1107,85 @@ public:
 		return meanSpectrum;
 	}
 
+	/**
+	 * \brief Record the squared luminance of a camera sample for the denoiser
+	 *
+	 * \c decomposition holds the per-bin values of a transient sample, or
+	 * is \c NULL when the sample is given by the single value \c value.
+	 */
+	inline void putMoments(BDPTWorkResult *wr, const Point2 &samplePos,
+			const Float *decomposition, const Spectrum &value) {
+		size_t bins = wr->m_frames;
+		Float *moments = (Float *) alloca((bins + 1) * sizeof(Float));
+		for (size_t b=0; b<bins; ++b) {
+			Float lum = decomposition
+				? TransientDenoiser::luminance(decomposition + b * SPECTRUM_SAMPLES)
+				: (b == 0 ? value.getLuminance() : 0.0f);
+			moments[b] = lum * lum;
+		}
+		moments[bins] = 1.0f;
+		wr->putMomentSample(samplePos, moments);
+	}
+
+	/// Record the depth, normal and albedo of the first vertex after the sensor
+	inline void putAOVs(BDPTWorkResult *wr, const Path &sensorSubpath,
+			const Point2 &samplePos) {
+		Float aovs[BDPT_AOV_CHANNELS];
+		for (int i=0; i<BDPT_AOV_CHANNELS; ++i)
+			aovs[i] = 0.0f;
+
+		if (sensorSubpath.vertexCount() > 2) {
+			const PathVertex *vertex = sensorSubpath.vertex(2);
+			if (vertex->isSurfaceInteraction() || vertex->isMediumInteraction())
+				aovs[0] = sensorSubpath.edge(1)->length;
+
+			if (vertex->isSurfaceInteraction()) {
+				const Intersection &its = vertex->getIntersection();
+				for (int i=0; i<3; ++i)
+					aovs[1+i] = its.shFrame.n[i];
+				const BSDF *bsdf = its.getBSDF();
+				if (bsdf)
+					bsdf->getDiffuseReflectance(its).toLinearRGB(aovs[4], aovs[5], aovs[6]);
+			}
+		}
+
+		aovs[BDPT_AOV_CHANNELS - 1] = 1.0f;
+		wr->putAOVSample(samplePos, aovs);
+	}
+
+	/**
+	 * \brief Train the guiding distribution of one subpath
+	 *
+	 * Every guidable vertex \c i receives the contributions of all strategies
+	 * that use the edge towards vertex <tt>i+1</tt>, divided by the subpath
+	 * throughput up to that edge (i.e. an estimate of the incident radiance
+	 * or importance) and by the density of the sampled direction.
+	 */
+	void recordGuidingSamples(GuidingTree *tree, const Path &path, ETransportMode mode,
+			const Spectrum *weights, const Float *pathLength, const Float *contribution) {
+		Float bsdfFraction = tree->getBSDFSamplingFraction(), suffix = 0.0f;
+
+		for (int i = (int) path.vertexCount() - 2; i >= 2; --i) {
+			suffix += contribution[i+1];
+			const PathVertex *vertex = path.vertex(i), *succ = path.vertex(i+1);
+			Float weight = weights[i+1].getLuminance();
+			if (suffix <= 0 || weight <= 0 || !vertex->isSurfaceInteraction() ||
+				!GuidingTree::isGuidable(vertex->getIntersection().getBSDF()))
+				continue;
+
+			const Point &p = vertex->getIntersection().p;
+			Float length = pathLength ? pathLength[i] : 0.0f;
+			Vector d = normalize(succ->getPosition() - p);
+			Float pdf = vertex->evalPdf(m_scene, path.vertex(i-1), succ, mode, ESolidAngle);
+			if (tree->isTrained(p, length))
+				pdf = bsdfFraction * pdf + (1 - bsdfFraction) * tree->pdf(p, length, d);
+			if (pdf > 0)
+				tree->record(p, length, d, suffix / (weight * pdf));
+		}
+	}
+
 	ref<WorkProcessor> clone() const {
-		return new BDPTRenderer(m_config);
+		return new BDPTRenderer(m_config, m_guide);
 	}
 
 	MTS_DECLARE_CLASS()
@@ -815,10 +1193,21 @@ private:
 	ref<Scene> m_scene;
 	ref<Sensor> m_sensor;
 	ref<Sampler> m_sampler;
+	ref<Sampler> m_lightSampler;
 	ref<ReconstructionFilter> m_rfilter;
 	MemoryPool m_pool;
 	BDPTConfiguration m_config;
+	mutable ref<PathGuide> m_guide;
+	ref<GuidingTree> m_emitterGuide, m_sensorGuide;
 	HilbertCurve2D<uint8_t> m_hilbertCurve;
+	Point2i m_imageOffset;
+	Vector2i m_imageSize;
+	std::vector<Path> m_lightPaths;
+	MemoryPool m_prefixPool;
+	Path m_laserPrefix;
+	bool m_laserPrefixReady;
+	SubpathCache m_emitterCache, m_sensorCache;
+	std::vector<Float> m_connectionLength;
 
 	Ellipsoid *m_ellipsoid;
 };
@@ -829,13 +1218,15 @@ private:
 /* ==================================================================== */
 
 BDPTProcess::BDPTProcess(const RenderJob *parent, RenderQueue *queue,
-		const BDPTConfiguration &config) :
-	BlockedRenderProcess(parent, queue, config.blockSize), m_config(config) {
+		const BDPTConfiguration &config, PathGuide *guide) :
+	BlockedRenderProcess(parent, queue, config.blockSize), m_config(config),
+	m_guide(guide) {
 	m_refreshTimer = new Timer();
+	m_seedSplitIndex = 0;
 }
 
 ref<WorkProcessor> BDPTProcess::createWorkProcessor() const {
-	return new BDPTRenderer(m_config);
+	return new BDPTRenderer(m_config, m_guide);
 }
 
 void BDPTProcess::develop() {
@@ -845,12 +1236,96 @@ void BDPTProcess::develop() {
 	const ImageBlock *lightImage = m_result->getLightImage();
 	m_film->setBitmap(m_result->getImageBlock()->getBitmap());
 
-	m_film->addBitmap(lightImage->getBitmap(), 1.0f / m_config.sampleCount);
+	m_film->addBitmap(lightImage->getBitmap(), getLightImageWeight());
 
 	m_refreshTimer->reset();
 	m_queue->signalRefresh(m_parent);
 }
 
+Float BDPTProcess::getLightImageWeight() const {
+	/* Emitter subpaths are only traced from the pixels in the film's
+	   region of interest, while their contributions can end up anywhere
+	   on the light image. Compensate for the pixels that were skipped */
+	Vector2i cropSize = m_film->getCropSize();
+	Float regionScale = (Float) ((size_t) cropSize.x * (size_t) cropSize.y)
+		/ (Float) m_film->getRegionPixelCount();
+	return regionScale / (Float) m_config.sampleCount;
+}
+
+void BDPTProcess::denoise() {
+	LockGuard lock(m_resultMutex);
+	ref<Timer> timer = new Timer();
+	const Bitmap *image = m_result->getImageBlock()->getBitmap();
+	const Bitmap *moments = m_result->getMomentBlock()->getBitmap();
+	const Bitmap *lightImage = m_config.lightImage
+		? m_result->getLightImage()->getBitmap() : NULL;
+
+	Vector2i size = image->getSize();
+	int channels = image->getChannelCount(),
+	    bins = (int) m_config.m_frames;
+	size_t nPixels = (size_t) size.x * (size_t) size.y;
+	Float invSampleCount = 1.0f / m_config.sampleCount,
+	      lightImageWeight = getLightImageWeight();
+
+	Log(EInfo, "Denoising %i time bin(s) ..", bins);
+
+	/* Normalize the camera image, add the light image, and estimate the
+	   variance of every pixel value from the second moments. The latter
+	   only cover the camera samples */
+	ref<Bitmap> combined = new Bitmap(image->getPixelFormat(),
+		Bitmap::EFloat, size, channels);
+	std::vector<Float> variance(nPixels * bins);
+	for (size_t i=0; i<nPixels; ++i) {
+		const Float *source = image->getFloatData() + i * channels;
+		const Float *moment = moments->getFloatData() + i * (bins + 1);
+		Float *target = combined->getFloatData() + i * channels;
+
+		Float weight = source[channels - 1],
+		      invWeight = weight > 0 ? 1.0f / weight : 0.0f,
+		      invMomentWeight = moment[bins] > 0 ? 1.0f / moment[bins] : 0.0f;
+
+		for (int j=0; j<channels-2; ++j)
+			target[j] = source[j] * invWeight;
+		target[channels - 2] = source[channels - 2] * invWeight;
+		target[channels - 1] = 1.0f;
+
+		for (int b=0; b<bins; ++b) {
+			Float mean = TransientDenoiser::luminance(target + b * SPECTRUM_SAMPLES);
+			variance[b * nPixels + i] = std::max((Float) 0.0f,
+				moment[b] * invMomentWeight - mean * mean) * invSampleCount;
+		}
+
+		if (lightImage) {
+			const Float *light = lightImage->getFloatData()
+				+ i * lightImage->getChannelCount();
+			for (int j=0; j<bins*SPECTRUM_SAMPLES; ++j)
+				target[j] += light[j] * lightImageWeight;
+		}
+	}
+
+	/* Guide the filter with the depth and normal of the first surface */
+	std::vector<Float> guide;
+	if (m_config.aovs) {
+		ref<Bitmap> aovs = developAOVs();
+		const float *source = aovs->getFloat32Data();
+		int aovChannels = aovs->getChannelCount();
+		guide.resize(nPixels * 4);
+		for (size_t i=0; i<nPixels; ++i)
+			for (int k=0; k<4; ++k)
+				guide[i * 4 + k] = (Float) source[i * aovChannels + k];
+	}
+
+	ref<Bitmap> output = combined->clone();
+	TransientDenoiser denoiser(m_config.denoiseRadius, m_config.denoiseTemporalRadius,
+		m_config.denoisePatchRadius, m_config.denoiseStrength);
+	denoiser.denoise(size, bins, combined->getFloatData(), channels,
+		&variance[0], guide.empty() ? NULL : &guide[0], output->getFloatData());
+
+	m_film->setBitmap(output);
+	m_queue->signalRefresh(m_parent);
+	Log(EInfo, "Denoising finished (took %i ms)", timer->getMilliseconds());
+}
+
 void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 	if (cancelled)
 		return;
@@ -858,6 +1333,10 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 	ImageBlock *block = const_cast<ImageBlock *>(result->getImageBlock());
 	LockGuard lock(m_resultMutex);
 	m_progress->update(++m_resultCount);
+	if (m_timeTags)
+		m_timeTags->append(result->getEvents());
+	if ((m_config.denoise || m_config.aovs) && !m_config.lightImage)
+		m_result->put(result);
 	if (m_config.lightImage) {
 		const ImageBlock *lightImage = m_result->getLightImage();
 		m_result->put(result);
@@ -867,7 +1346,7 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 			   not 100% correct but doesn't matter, as the shown image will be properly re-developed
 			   every 2 seconds and once more when the rendering process finishes */
 
-			Float invSampleCount = 1.0f / m_config.sampleCount;
+			Float lightImageWeight = getLightImageWeight();
 			const Bitmap *sourceBitmap = lightImage->getBitmap();
 			Bitmap *destBitmap = block->getBitmap();
 			int borderSize = block->getBorderSize();
@@ -881,7 +1360,7 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 					+ (borderSize + (y + borderSize) * destBitmap->getWidth()) * (SPECTRUM_SAMPLES + 2);
 
 				for (int x=0; x<size.x; ++x) {
-					Float weight = dest[SPECTRUM_SAMPLES + 1] * invSampleCount;
+					Float weight = dest[SPECTRUM_SAMPLES + 1] * lightImageWeight;
 					for (int k=0; k<SPECTRUM_SAMPLES; ++k)
 						*dest++ += *source++ * weight;
 					dest += 2;
@@ -904,11 +1383,75 @@ void BDPTProcess::processResult(const WorkResult *wr, bool cancelled) {
 		develop();
 }
 
+ref<Bitmap> BDPTProcess::developAOVs() {
+	LockGuard lock(m_resultMutex);
+	const Bitmap *source = m_result->getAOVBlock()->getBitmap();
+	Vector2i size = source->getSize();
+	size_t nPixels = (size_t) size.x * (size_t) size.y;
+
+	ref<Bitmap> result = new Bitmap(Bitmap::EMultiChannel, Bitmap::EFloat32,
+		size, BDPT_AOV_CHANNELS - 1);
+	float *target = result->getFloat32Data();
+
+	for (size_t i=0; i<nPixels; ++i) {
+		const Float *value = source->getFloatData() + i * BDPT_AOV_CHANNELS;
+		Float weight = value[BDPT_AOV_CHANNELS - 1],
+		      invWeight = weight > 0 ? 1.0f / weight : 0.0f;
+
+		/* Filtering averages the normals of neighboring surfaces */
+		Normal n(value[1], value[2], value[3]);
+		if (!n.isZero())
+			n = normalize(n);
+
+		target[0] = (float) (value[0] * invWeight);
+		for (int k=0; k<3; ++k) {
+			target[1+k] = (float) n[k];
+			target[4+k] = (float) (value[4+k] * invWeight);
+		}
+		target += BDPT_AOV_CHANNELS - 1;
+	}
+
+	std::vector<std::string> channelNames;
+	channelNames.push_back("depth.Y");
+	channelNames.push_back("normal.X");
+	channelNames.push_back("normal.Y");
+	channelNames.push_back("normal.Z");
+	channelNames.push_back("albedo.R");
+	channelNames.push_back("albedo.G");
+	channelNames.push_back("albedo.B");
+	result->setChannelNames(channelNames);
+	return result;
+}
+
+ParallelProcess::EStatus BDPTProcess::generateWork(WorkUnit *unit, int worker) {
+	if (m_config.seedSplit <= 0)
+		return BlockedRenderProcess::generateWork(unit, worker);
+
+	if (m_seedSplitIndex == m_config.seedSplit)
+		return EFailure;
+
+	/* Partition the pixel sample indices into contiguous, disjoint ranges */
+	size_t n = (size_t) m_config.seedSplit, i = (size_t) m_seedSplitIndex++;
+	size_t start = (m_config.sampleCount * i) / n,
+	       end   = (m_config.sampleCount * (i+1)) / n - 1;
+	static_cast<RangeWorkUnit *>(unit)->setRange(start, end);
+	return ESuccess;
+}
+
 void BDPTProcess::bindResource(const std::string &name, int id) {
 	BlockedRenderProcess::bindResource(name, id);
-	if (name == "sensor" && m_config.lightImage) {
-		/* If needed, allocate memory for the light image */
-		m_result = new BDPTWorkResult(m_config, NULL, m_film->getCropSize());
+	if (name == "sensor" && m_config.seedSplit > 0) {
+		/* Progress is reported per full-image work unit */
+		delete m_progress;
+		m_progress = new ProgressReporter("Rendering", m_config.seedSplit, m_parent);
+	}
+	if (name == "sensor" && (m_config.lightImage || m_config.denoise || m_config.aovs)) {
+		/* If needed, allocate memory for the light image (and the
+		   full-resolution camera image, moments for the denoiser,
+		   and first-return AOVs) */
+		BDPTConfiguration config = m_config;
+		config.timeTags = false; /* Events are streamed to disk instead */
+		m_result = new BDPTWorkResult(config, NULL, m_film->getCropSize());
 		m_result->clear();
 	}
 }
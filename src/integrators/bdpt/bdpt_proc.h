@@ -22,6 +22,7 @@
 #include <mitsuba/render/renderproc.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/bidir/guiding.h>
 #include "bdpt_wr.h"
 
 MTS_NAMESPACE_BEGIN
@@ -33,30 +34,66 @@ MTS_NAMESPACE_BEGIN
 /**
  * \brief Renders work units (rectangular image regions) using
  * bidirectional path tracing
+ *
+ * In seed-split mode (<tt>BDPTConfiguration::seedSplit > 0</tt>), each work
+ * unit instead covers the entire image and a disjoint range of pixel sample
+ * indices, and the partial results are summed up as they arrive.
  */
 class BDPTProcess : public BlockedRenderProcess {
 public:
 	BDPTProcess(const RenderJob *parent, RenderQueue *queue,
-		const BDPTConfiguration &config);
+		const BDPTConfiguration &config, PathGuide *guide = NULL);
 
 	inline const BDPTWorkResult *getResult() const { return m_result.get(); }
 
 	/// Develop the image
 	void develop();
 
+	/**
+	 * \brief Replace the film contents by a denoised version
+	 *
+	 * Requires \c BDPTConfiguration::denoise, and should be called
+	 * once rendering has finished.
+	 */
+	void denoise();
+
+	/**
+	 * \brief Stream the time-tag events of all work results to \c file
+	 *
+	 * Requires \c BDPTConfiguration::timeTags and must be called
+	 * before the process is scheduled.
+	 */
+	inline void setTimeTagFile(TimeTagFile *file) { m_timeTags = file; }
+
+	/**
+	 * \brief Return the normalized first-return AOVs (depth, normal
+	 * and albedo) of the camera samples
+	 *
+	 * Requires \c BDPTConfiguration::aovs. The result is a float32
+	 * multi-channel bitmap with the layers "depth", "normal" and "albedo".
+	 */
+	ref<Bitmap> developAOVs();
+
 	/* ParallelProcess impl. */
 	void processResult(const WorkResult *wr, bool cancelled);
 	ref<WorkProcessor> createWorkProcessor() const;
 	void bindResource(const std::string &name, int id);
+	EStatus generateWork(WorkUnit *unit, int worker);
 
 	MTS_DECLARE_CLASS()
 protected:
 	/// Virtual destructor
 	virtual ~BDPTProcess() { }
+
+	/// Return the factor by which the accumulated light image is scaled
+	Float getLightImageWeight() const;
 private:
 	ref<BDPTWorkResult> m_result;
 	ref<Timer> m_refreshTimer;
 	BDPTConfiguration m_config;
+	mutable ref<PathGuide> m_guide;
+	ref<TimeTagFile> m_timeTags;
+	int m_seedSplitIndex;
 };
 
 MTS_NAMESPACE_END
@@ -0,0 +1,162 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#if !defined(__BDPT_SUBPATH_H)
+#define __BDPT_SUBPATH_H
+
+#include <mitsuba/bidir/path.h>
+#include <mitsuba/render/film.h>
+
+MTS_NAMESPACE_BEGIN
+
+/* ==================================================================== */
+/*                        Compact subpath storage                       */
+/* ==================================================================== */
+
+/**
+ * \brief Structure-of-arrays copy of the per-vertex data that the
+ * connection loop of the BDPT renderer reads for every (s, t) pair
+ *
+ * A \ref PathVertex embeds a full intersection record and is several
+ * hundred bytes large, so looking up positions and flags of the two
+ * connection endpoints touches many cache lines per strategy. This cache
+ * stores the combined subpath weights, the cumulative path lengths, the
+ * vertex positions and connectability flags in contiguous arrays. It is
+ * filled once per subpath after the random walk and reuses its storage
+ * across samples, so that no allocation happens in the inner loop.
+ *
+ * Index \c i of every array refers to vertex \c i of the subpath.
+ */
+class SubpathCache {
+public:
+	/// Per-vertex flags
+	enum EFlags {
+		/// The vertex has a position and is not degenerate
+		EConnectable = 0x01
+	};
+
+	/**
+	 * \brief Refill the cache from a subpath
+	 *
+	 * \param path
+	 *     Emitter or sensor subpath
+	 * \param mode
+	 *     Transport mode of the subpath (selects the vertex and edge weights)
+	 * \param type
+	 *     Decomposition type of the film. Determines whether cumulative
+	 *     geometric path lengths, bounce counts or nothing is stored.
+	 */
+	void fill(const Path &path, ETransportMode mode, Film::EDecompositionType type) {
+		size_t n = path.vertexCount();
+		m_size = n;
+		if (m_weight.size() < n) {
+			m_weight.resize(n);
+			m_length.resize(n);
+			m_x.resize(n); m_y.resize(n); m_z.resize(n);
+			m_flags.resize(n);
+		}
+		m_hasLength = type != Film::ESteadyState;
+
+		m_weight[0] = Spectrum(1.0f);
+		m_length[0] = 0.0f;
+		for (size_t i=1; i<n; ++i) {
+			const PathVertex *pred = path.vertex(i-1);
+			m_weight[i] = m_weight[i-1] * pred->weight[mode] *
+				pred->rrWeight * path.edge(i-1)->weight[mode];
+
+			/* Edge 0 connects the supernode and is never given a length */
+			if (i == 1)
+				m_length[i] = 0.0f;
+			else if (type == Film::ETransient || type == Film::ETransientEllipse)
+				m_length[i] = m_length[i-1] + path.edge(i-1)->length;
+			else if (type == Film::EBounce)
+				m_length[i] = m_length[i-1] + 1.0f;
+			else
+				m_length[i] = 0.0f;
+		}
+
+		for (size_t i=0; i<n; ++i) {
+			const PathVertex *vertex = path.vertex(i);
+			uint8_t flags = 0;
+			Point p(0.0f);
+
+			if (!vertex->isSupernode()) {
+				p = vertex->getPosition();
+				if (!vertex->isDegenerate())
+					flags |= EConnectable;
+			}
+
+			m_x[i] = p.x; m_y[i] = p.y; m_z[i] = p.z;
+			m_flags[i] = flags;
+		}
+	}
+
+	/**
+	 * \brief Compute the total path length of the connections between
+	 * vertex \c s of this (emitter) subpath and the vertices
+	 * <tt>minT..maxT</tt> of a sensor subpath
+	 *
+	 * Entry \c t of \c result receives the combined length of both
+	 * subpaths plus the length of the connection segment (or the bounce
+	 * count for \ref Film::EBounce). The loop only reads contiguous
+	 * arrays and is amenable to auto-vectorization.
+	 */
+	void connectionLengths(size_t s, const SubpathCache &sensor,
+			int minT, int maxT, Film::EDecompositionType type, Float *result) const {
+		const Float *x = &sensor.m_x[0], *y = &sensor.m_y[0], *z = &sensor.m_z[0],
+			*length = &sensor.m_length[0];
+		Float px = m_x[s], py = m_y[s], pz = m_z[s], base = m_length[s];
+
+		if (type == Film::EBounce) {
+			for (int t=minT; t<=maxT; ++t)
+				result[t] = base + length[t] + 1.0f;
+		} else {
+			for (int t=minT; t<=maxT; ++t) {
+				Float dx = x[t] - px, dy = y[t] - py, dz = z[t] - pz;
+				result[t] = base + length[t] + std::sqrt(dx*dx + dy*dy + dz*dz);
+			}
+		}
+	}
+
+	/// Return the number of cached vertices
+	inline size_t size() const { return m_size; }
+
+	/// Return the combined weights along the subpath
+	inline const Spectrum *getWeights() const { return &m_weight[0]; }
+
+	/// Return the cumulative path lengths, or \c NULL for steady-state films
+	inline const Float *getPathLengths() const { return m_hasLength ? &m_length[0] : NULL; }
+
+	/// Return the position of vertex \c i
+	inline Point getPosition(size_t i) const { return Point(m_x[i], m_y[i], m_z[i]); }
+
+	/// Can vertex \c i be connected deterministically to another vertex?
+	inline bool isConnectable(size_t i) const { return m_flags[i] & EConnectable; }
+
+private:
+	size_t m_size;
+	bool m_hasLength;
+	std::vector<Spectrum> m_weight;
+	std::vector<Float> m_length;
+	std::vector<Float> m_x, m_y, m_z;
+	std::vector<uint8_t> m_flags;
+};
+
+MTS_NAMESPACE_END
+
+#endif /* __BDPT_SUBPATH_H */
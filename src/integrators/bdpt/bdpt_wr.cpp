@@ -48,6 +48,9 @@ BDPTWorkResult::BDPTWorkResult(const BDPTConfiguration &conf,
 	m_sBounces = conf.m_sBounces;
 	m_tBounces = conf.m_tBounces;
 
+	m_cropSize = conf.cropSize;
+	m_timeTags = conf.timeTags;
+
 	if (m_frames == 1) {
 		m_block = new ImageBlock(Bitmap::ESpectrumAlphaWeight, blockSize, rfilter);
 	} else {
@@ -57,6 +60,24 @@ BDPTWorkResult::BDPTWorkResult(const BDPTConfiguration &conf,
 	m_block->setOffset(Point2i(0, 0));
 	m_block->setSize(blockSize);
 
+	if (conf.denoise) {
+		/* Squared luminance of every time bin and the filter weight of
+		   the camera samples, used to estimate the noise level */
+		m_moments = new ImageBlock(Bitmap::EMultiChannel, blockSize,
+				rfilter, (int) (m_frames + 1));
+		m_moments->setOffset(Point2i(0, 0));
+		m_moments->setSize(blockSize);
+	}
+
+	if (conf.aovs) {
+		/* Depth, normal and albedo of the first surface seen
+		   by the camera samples */
+		m_aovs = new ImageBlock(Bitmap::EMultiChannel, blockSize,
+				rfilter, BDPT_AOV_CHANNELS);
+		m_aovs->setOffset(Point2i(0, 0));
+		m_aovs->setSize(blockSize);
+	}
+
 
 	if (conf.lightImage) {
 		/* Stores the 'light image' -- every worker requires a
@@ -100,6 +121,13 @@ void BDPTWorkResult::put(const BDPTWorkResult *workResult) {
 	m_block->put(workResult->m_block.get());
 	if (m_lightImage)
 		m_lightImage->put(workResult->m_lightImage.get());
+	if (m_moments)
+		m_moments->put(workResult->m_moments.get());
+	if (m_aovs)
+		m_aovs->put(workResult->m_aovs.get());
+	if (m_timeTags)
+		m_events.insert(m_events.end(), workResult->m_events.begin(),
+			workResult->m_events.end());
 }
 
 void BDPTWorkResult::clear() {
@@ -109,7 +137,12 @@ void BDPTWorkResult::clear() {
 #endif
 	if (m_lightImage)
 		m_lightImage->clear();
+	if (m_moments)
+		m_moments->clear();
+	if (m_aovs)
+		m_aovs->clear();
 	m_block->clear();
+	m_events.clear();
 }
 
 #if BDPT_DEBUG == 1
@@ -140,6 +173,10 @@ void BDPTWorkResult::load(Stream *stream) {
 #endif
 	if (m_lightImage)
 		m_lightImage->load(stream);
+	if (m_moments)
+		m_moments->load(stream);
+	if (m_aovs)
+		m_aovs->load(stream);
 	m_block->load(stream);
 
 	m_decompositionType = (Film::EDecompositionType) stream->readUInt();
@@ -153,6 +190,14 @@ void BDPTWorkResult::load(Stream *stream) {
 	m_forceBounces = stream->readBool();
 	m_sBounces = stream->readUInt();
 	m_tBounces = stream->readUInt();
+
+	if (m_timeTags) {
+		size_t eventCount = stream->readSize();
+		m_events.clear();
+		m_events.reserve(eventCount);
+		for (size_t i=0; i<eventCount; ++i)
+			m_events.push_back(TimeTagEvent(stream));
+	}
 }
 
 void BDPTWorkResult::save(Stream *stream) const {
@@ -162,6 +207,10 @@ void BDPTWorkResult::save(Stream *stream) const {
 #endif
 	if (m_lightImage.get())
 		m_lightImage->save(stream);
+	if (m_moments.get())
+		m_moments->save(stream);
+	if (m_aovs.get())
+		m_aovs->save(stream);
 	m_block->save(stream);
 
 	stream->writeUInt(m_decompositionType);
@@ -175,6 +224,12 @@ void BDPTWorkResult::save(Stream *stream) const {
 	stream->writeBool(m_forceBounces);
 	stream->writeUInt(m_sBounces);
 	stream->writeUInt(m_tBounces);
+
+	if (m_timeTags) {
+		stream->writeSize(m_events.size());
+		for (size_t i=0; i<m_events.size(); ++i)
+			m_events[i].serialize(stream);
+	}
 }
 
 std::string BDPTWorkResult::toString() const {
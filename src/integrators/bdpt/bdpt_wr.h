@@ -23,9 +23,13 @@
 #include <mitsuba/core/fresolver.h>
 #include "bdpt.h"
 #include <mitsuba/render/pathlengthsampler.h>
+#include <mitsuba/render/timetag.h>
 
 MTS_NAMESPACE_BEGIN
 
+/// Channels of the AOV block: depth, normal (3), albedo (3) and the filter weight
+#define BDPT_AOV_CHANNELS 8
+
 /* ==================================================================== */
 /*                             Work result                              */
 /* ==================================================================== */
@@ -73,6 +77,55 @@ public:
 		m_block->put(sample, spec, 1.0f);
 	}
 
+	/**
+	 * \brief Record the second moments of a camera sample for the denoiser
+	 *
+	 * \c value holds the squared luminance of every time bin followed
+	 * by a unit weight.
+	 */
+	inline void putMomentSample(const Point2 &sample, const Float *value) {
+		m_moments->put(sample, value);
+	}
+
+	/// Does this work result collect the second moments for the denoiser?
+	inline bool hasMoments() const { return m_moments.get() != NULL; }
+
+	/**
+	 * \brief Record the first-return AOVs of a camera sample
+	 *
+	 * \c value holds \ref BDPT_AOV_CHANNELS entries: the depth, the
+	 * shading normal, the albedo, and a unit weight.
+	 */
+	inline void putAOVSample(const Point2 &sample, const Float *value) {
+		m_aovs->put(sample, value);
+	}
+
+	/// Does this work result collect first-return AOVs?
+	inline bool hasAOVs() const { return m_aovs.get() != NULL; }
+
+	/**
+	 * \brief Record a contribution as a raw time-tag event
+	 *
+	 * The event is assigned to the pixel containing \c sample (i.e. the
+	 * reconstruction filter is ignored). \c rgb holds the linear RGB
+	 * value, which is normalized by the sample count when re-binning.
+	 */
+	inline void putEvent(const Point2 &sample, Float pathLength,
+			const Float *rgb, int bounces, uint16_t flags = 0) {
+		int x = math::floorToInt(sample.x), y = math::floorToInt(sample.y);
+		if (x < 0 || y < 0 || x >= m_cropSize.x || y >= m_cropSize.y)
+			return;
+		float value[3] = { (float) rgb[0], (float) rgb[1], (float) rgb[2] };
+		m_events.push_back(TimeTagEvent((uint32_t) (y * m_cropSize.x + x),
+			(float) pathLength, value, (uint16_t) bounces, flags));
+	}
+
+	/// Does this work result record time-tag events?
+	inline bool hasEvents() const { return m_timeTags; }
+
+	/// Return the time-tag events recorded since the last call to \ref clear()
+	inline const std::vector<TimeTagEvent> &getEvents() const { return m_events; }
+
 	inline void putLightSample(const Point2 &sample, const Float *value) {
 		m_lightImage->put(sample, value);
 	}
@@ -117,6 +170,14 @@ public:
 		return m_lightImage.get();
 	}
 
+	inline const ImageBlock *getMomentBlock() const {
+		return m_moments.get();
+	}
+
+	inline const ImageBlock *getAOVBlock() const {
+		return m_aovs.get();
+	}
+
 	inline Spectrum average() const {
 		return (m_block->average() + m_lightImage->average()) * 0.5;
 	}
@@ -127,10 +188,18 @@ public:
 
 	inline void setSize(const Vector2i &size) {
 		m_block->setSize(size);
+		if (m_moments)
+			m_moments->setSize(size);
+		if (m_aovs)
+			m_aovs->setSize(size);
 	}
 
 	inline void setOffset(const Point2i &offset) {
 		m_block->setOffset(offset);
+		if (m_moments)
+			m_moments->setOffset(offset);
+		if (m_aovs)
+			m_aovs->setOffset(offset);
 	}
 
 	/// Return a string representation
@@ -149,7 +218,10 @@ protected:
 #if BDPT_DEBUG == 1
 	ref_vector<ImageBlock> m_debugBlocks;
 #endif
-	ref<ImageBlock> m_block, m_lightImage;
+	ref<ImageBlock> m_block, m_lightImage, m_moments, m_aovs;
+	std::vector<TimeTagEvent> m_events;
+	Vector2i m_cropSize;
+	bool m_timeTags;
 public:
 	Film::EDecompositionType m_decompositionType;
 	bool m_combineBDPTAndElliptic;
@@ -62,6 +62,10 @@ MTS_NAMESPACE_BEGIN
  *	   }
  *	   \parameter{lambda}{\Float}{
  *	       Jump size of the manifold perturbation \default{\code{50}}}
+ *	   \parameter{gateMutations}{\Boolean}{
+ *	       When rendering into a transient film, reject all
+ *	       mutations that leave the film's path length window
+ *	       \default{\code{false}}}
  * }
  * \renderings{
  *  \rendering{A brass chandelier with 24 glass-enclosed bulbs}{integrator_mept_luminaire}
@@ -123,6 +127,14 @@ MTS_NAMESPACE_BEGIN
  * Chain is created that has an initial configuration matching the seed path.
  * It is simulated for \code{chainLength} iterations, and each intermediate
  * state is recorded in the output image.
+ *
+ * When the film uses a \code{transient} or \code{bounce} decomposition,
+ * every chain state is splatted into the time bin that corresponds to
+ * its current path length (or bounce count). Direct illumination is then
+ * handled by the chains as well. Since seed paths outside of the film's
+ * window do not contribute, they are skipped; with \code{gateMutations}
+ * enabled, the chains are furthermore confined to the window, which
+ * focuses all effort on the recorded interval.
  */
 class EnergyRedistributionPathTracing : public Integrator {
 public:
@@ -167,6 +179,9 @@ public:
 		m_config.avgAngleChangeSurface = props.getFloat("avgAngleChangeSurface", 0);
 		m_config.avgAngleChangeMedium = props.getFloat("avgAngleChangeMedium", 0);
 
+		/* Confine the chains to the path length window of a transient film */
+		m_config.transient.gateMutations = props.getBoolean("gateMutations", false);
+
 		if (m_config.maxDepth <= 0 && m_config.maxDepth != -1)
 			Log(EError, "'maxDepth' must be set to -1 (infinite) or a value greater than zero!");
 	}
@@ -226,6 +241,12 @@ public:
 			createObject(MTS_CLASS(Sampler), Properties("independent")));
 		indepSampler->configure();
 
+		m_config.transient.configure(film);
+		if (m_config.transient.isActive() && m_config.separateDirect) {
+			Log(EInfo, "Transient rendering: direct illumination will be handled by ERPT");
+			m_config.separateDirect = false;
+		}
+
 		ref<PathSampler> pathSampler = new PathSampler(PathSampler::EBidirectional, scene,
 			indepSampler, indepSampler, indepSampler, m_config.maxDepth, 10,
 			m_config.separateDirect, true, true);
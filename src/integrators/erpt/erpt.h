@@ -22,6 +22,7 @@
 #include <mitsuba/mitsuba.h>
 #include <mitsuba/bidir/manifold.h>
 #include <mitsuba/bidir/mut_manifold.h>
+#include <mitsuba/bidir/util.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -51,6 +52,7 @@ struct ERPTConfiguration {
 	Float avgAngleChangeSurface;
 	Float avgAngleChangeMedium;
 	int maxChains;
+	TransientGate transient;
 
 	inline ERPTConfiguration() { }
 
@@ -76,6 +78,8 @@ struct ERPTConfiguration {
 		SLog(EDebug, "   Block size                  : %i", blockSize);
 		SLog(EDebug, "   Overall sample luminance    : %f (%i samples)",
 			luminance, luminanceSamples);
+		SLog(EDebug, "   Transient decomposition     : %s",
+			transient.toString().c_str());
 		SLog(EDebug, "   Universal perturb. factor   : %f", probFactor);
 		SLog(EDebug, "   Manifold max iterations     : %i", MTS_MANIFOLD_MAX_ITERATIONS);
 		SLog(EDebug, "   Quantiles                   : %f (surfaces), %f (media)",
@@ -100,6 +104,7 @@ struct ERPTConfiguration {
 		avgAngleChangeSurface = stream->readFloat();
 		avgAngleChangeMedium = stream->readFloat();
 		maxChains = stream->readInt();
+		transient = TransientGate(stream);
 	}
 
 	inline void serialize(Stream *stream) const {
@@ -120,6 +125,7 @@ struct ERPTConfiguration {
 		stream->writeFloat(avgAngleChangeSurface);
 		stream->writeFloat(avgAngleChangeMedium);
 		stream->writeInt(maxChains);
+		transient.serialize(stream);
 	}
 };
 
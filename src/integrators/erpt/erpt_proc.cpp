@@ -45,8 +45,9 @@ public:
 	Point2i origOffset;
 	Vector2i origSize;
 
-	ERPTWorkResult(const Vector2i &size, const ReconstructionFilter *filter)
-		: ImageBlock(Bitmap::ESpectrum, size, filter) { }
+	ERPTWorkResult(const Vector2i &size, const ReconstructionFilter *filter, int frames = 0)
+		: ImageBlock(frames > 0 ? Bitmap::EMultiChannel : Bitmap::ESpectrum, size,
+			filter, frames > 0 ? 3 * frames : -1) { }
 
 	void load(Stream *stream) {
 		ImageBlock::load(stream);
@@ -87,7 +88,8 @@ public:
 	ref<WorkResult> createWorkResult() const {
 		return new ERPTWorkResult(
 			m_sensor->getFilm()->getCropSize(),
-			m_sensor->getFilm()->getReconstructionFilter());
+			m_sensor->getFilm()->getReconstructionFilter(),
+			m_config.transient.isActive() ? m_config.transient.frames : 0);
 	}
 
 	void prepare() {
@@ -139,10 +141,24 @@ public:
 			Log(EError, "There must be at least one mutator!");
 	}
 
+	/// Deposit energy at the sample position of a path (into time bin \c bin if transient)
+	inline void splat(const Path &path, int bin, Spectrum value) {
+		if (!m_config.transient.isActive())
+			m_result->put(path.getSamplePosition(), &value[0]);
+		else if (bin >= 0)
+			m_config.transient.put(m_result, path.getSamplePosition(), value, bin);
+	}
+
 	void pathCallback(int s, int t, Float weight, Path &path, const bool *stop) {
 		if (std::isnan(weight) || std::isinf(weight) || weight < 0)
 			Log(EWarn, "Invalid path weight: %f, ignoring path!", weight);
 
+		/* Time bin of the seed path. Gated chains never leave the window,
+		   hence seeds outside of it would not contribute anything */
+		int seedBin = m_config.transient.isActive() ? m_config.transient.getBin(path) : -1;
+		if (seedBin < 0 && m_config.transient.isGated())
+			return;
+
 #if 0
 		/* Don't run ERPT on paths that start with two diffuse vertices. It's
 		   usually safe to assume that these are handled well enough by BDPT */
@@ -178,6 +194,7 @@ public:
 		Path *current = new Path(),
 			 *proposed = new Path();
 		size_t mutations = 0;
+		int currentBin = -1, proposedBin = -1;
 
 		#if defined(MTS_BD_DEBUG_HEAVY)
 			if (!path.verify(m_scene, EImportance, oss))
@@ -187,6 +204,7 @@ public:
 		for (int chain=0; chain<numChains && !*stop; ++chain) {
 			relWeight = path.getRelativeWeight();
 			path.clone(*current, *m_pool);
+			currentBin = seedBin;
 			accumulatedWeight = 0;
 			++statsChainsPerPixel;
 
@@ -246,16 +264,23 @@ public:
 						a = 0;
 					}
 
+					if (m_config.transient.isActive()) {
+						proposedBin = m_config.transient.getBin(*proposed);
+						if (proposedBin < 0 && m_config.transient.isGated())
+							a = 0;
+					}
+
 					accumulatedWeight += 1-a;
 
 					/* Accept with probability 'a' */
 					if (a == 1 || m_indepSampler->next1D() < a) {
 						Spectrum value = relWeight * (accumulatedWeight * depositionEnergy);
-						m_result->put(current->getSamplePosition(), &value[0]);
+						splat(*current, currentBin, value);
 
 						/* The mutation was accepted */
 						current->release(muRec.l, muRec.m+1, *m_pool);
 						std::swap(current, proposed);
+						currentBin = proposedBin;
 						relWeight = current->getRelativeWeight();
 						mutator->accept(muRec);
 						currentMuRec = muRec;
@@ -265,7 +290,7 @@ public:
 					} else {
 						if (a > 0) {
 							Spectrum value = proposed->getRelativeWeight() * (a * depositionEnergy);
-							m_result->put(proposed->getSamplePosition(), &value[0]);
+							splat(*proposed, proposedBin, value);
 						}
 						/* The mutation was rejected */
 						proposed->release(muRec.l, muRec.l + muRec.ka + 1, *m_pool);
@@ -276,7 +301,7 @@ public:
 			}
 			if (accumulatedWeight > 0) {
 				Spectrum value = relWeight * (accumulatedWeight * depositionEnergy);
-				m_result->put(current->getSamplePosition(), &value[0]);
+				splat(*current, currentBin, value);
 			}
 			current->release(*m_pool);
 		}
@@ -354,7 +379,12 @@ ref<WorkProcessor> ERPTProcess::createWorkProcessor() const {
 
 void ERPTProcess::develop() {
 	LockGuard lock(m_resultMutex);
-	m_film->setBitmap(m_accum->getBitmap());
+	if (m_config.transient.isActive()) {
+		m_config.transient.develop(m_accum->getBitmap(), 0, 1.0f, NULL, m_developBuffer);
+		m_film->setBitmap(m_developBuffer);
+	} else {
+		m_film->setBitmap(m_accum->getBitmap());
+	}
 	if (m_directImage)
 		m_film->addBitmap(m_directImage);
 	m_queue->signalRefresh(m_job);
@@ -375,7 +405,14 @@ void ERPTProcess::bindResource(const std::string &name, int id) {
 	if (name == "sensor") {
 		Film *film = static_cast<Sensor *>(Scheduler::getInstance()->getResource(id))->getFilm();
 
-		m_accum = new ImageBlock(Bitmap::ESpectrum, film->getCropSize());
+		if (m_config.transient.isActive()) {
+			int frames = m_config.transient.frames;
+			m_accum = new ImageBlock(Bitmap::EMultiChannel, film->getCropSize(), NULL, 3 * frames);
+			m_developBuffer = new Bitmap(Bitmap::EMultiSpectrumAlphaWeight, Bitmap::EFloat,
+				film->getCropSize(), 3 * frames + 2);
+		} else {
+			m_accum = new ImageBlock(Bitmap::ESpectrum, film->getCropSize());
+		}
 		m_accum->clear();
 	}
 }
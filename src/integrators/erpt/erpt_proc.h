@@ -52,6 +52,7 @@ private:
 	ERPTConfiguration m_config;
 	ref<const Bitmap> m_directImage;
 	ref<ImageBlock> m_accum;
+	ref<Bitmap> m_developBuffer;
 };
 
 MTS_NAMESPACE_END
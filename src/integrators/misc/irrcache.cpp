@@ -236,8 +236,10 @@ public:
 
 			ref<const IrradianceRecordVector> vec = proc->getSamples();
 			Log(EDebug, "Overture pass generated %i irradiance samples", vec->size());
+			std::vector<IrradianceCache::Record *> records(vec->size());
 			for (size_t i=0; i<vec->size(); ++i)
-				m_irrCache->insert(new IrradianceCache::Record((*vec)[i]));
+				records[i] = new IrradianceCache::Record((*vec)[i]);
+			m_irrCache->insert(records);
 
 			m_irrCache->setQuality(m_quality * m_qualityAdjustment);
 		}
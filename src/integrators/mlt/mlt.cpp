@@ -18,6 +18,7 @@
 
 #include <mitsuba/bidir/util.h>
 #include <mitsuba/core/fstream.h>
+#include <boost/bind.hpp>
 #include "mlt_proc.h"
 
 MTS_NAMESPACE_BEGIN
@@ -60,6 +61,9 @@ MTS_NAMESPACE_BEGIN
  *	   }
  *	   \parameter{lambda}{\Float}{
  *	       Jump size of the manifold perturbation \default{50}}
+ *	   \parameter{gateMutations}{\Boolean}{
+ *	       When rendering into a transient film, confine the Markov
+ *	       chains to the film's path length window \default{\code{false}}}
  * }
  * Metropolis Light Transport (MLT) is a seminal rendering technique proposed by Veach and
  * Guibas \cite{Veach1997Metropolis}, which applies the Metropolis-Hastings
@@ -122,6 +126,14 @@ MTS_NAMESPACE_BEGIN
  * connection path (as opposed to the cascading mechanism employed by the
  * multi-chain perturbation).
  * \end{enumerate}
+ *
+ * When the film uses a \code{transient} or \code{bounce} decomposition,
+ * each state of the Markov chains is additionally splatted into the time
+ * bin given by its current path length (or bounce count), and the
+ * direct illumination is rendered by MLT as well. With \code{gateMutations}
+ * enabled, seeds and mutations outside of the film's window are rejected,
+ * so that all mutations are spent on the recorded interval; the luminance
+ * estimate then only accounts for paths within the window.
  */
 class MLT : public Integrator {
 public:
@@ -196,6 +208,9 @@ public:
 
 		/* Stop MLT after X seconds -- useful for equal-time comparisons */
 		m_config.timeout = props.getInteger("timeout", 0);
+
+		/* Confine the chains to the path length window of a transient film */
+		m_config.transient.gateMutations = props.getBoolean("gateMutations", false);
 	}
 
 	/// Unserialize from a binary data stream
@@ -285,6 +300,12 @@ public:
 		m_config.nMutations = (cropSize.x * cropSize.y *
 			sampleCount) / m_config.workUnits;
 
+		m_config.transient.configure(film);
+		if (m_config.transient.isActive() && m_config.separateDirect) {
+			Log(EInfo, "Transient rendering: direct illumination will be handled by MLT");
+			m_config.separateDirect = false;
+		}
+
 		ref<Bitmap> directImage;
 		if (m_config.separateDirect && m_config.directSamples > 0 && !nested) {
 			directImage = BidirectionalUtils::renderDirectComponent(scene,
@@ -297,6 +318,9 @@ public:
 		ref<PathSampler> pathSampler = new PathSampler(PathSampler::EBidirectional, scene,
 			rplSampler, rplSampler, rplSampler, m_config.maxDepth, 10,
 			m_config.separateDirect, true);
+		if (m_config.transient.isGated())
+			pathSampler->setSeedFilter(boost::bind(&TransientGate::contains,
+				&m_config.transient, _1));
 
 		std::vector<PathSeed> pathSeeds;
 		ref<MLTProcess> process = new MLTProcess(job, queue,
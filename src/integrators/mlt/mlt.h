@@ -22,6 +22,7 @@
 #include <mitsuba/core/bitmap.h>
 #include <mitsuba/bidir/manifold.h>
 #include <mitsuba/bidir/mut_manifold.h>
+#include <mitsuba/bidir/util.h>
 
 MTS_NAMESPACE_BEGIN
 
@@ -52,6 +53,7 @@ struct MLTConfiguration {
 	int firstStageSizeReduction;
 	ref<Bitmap> importanceMap;
 	size_t timeout;
+	TransientGate transient;
 
 	inline MLTConfiguration() { }
 
@@ -82,6 +84,8 @@ struct MLTConfiguration {
 			luminance, luminanceSamples);
 		SLog(EDebug, "   Total number of work units  : %i", workUnits);
 		SLog(EDebug, "   Mutations per work unit     : " SIZE_T_FMT, nMutations);
+		SLog(EDebug, "   Transient decomposition     : %s",
+			transient.toString().c_str());
 		SLog(EDebug, "   Universal perturb. factor   : %f", probFactor);
 		SLog(EDebug, "   Manifold max iterations     : %i", MTS_MANIFOLD_MAX_ITERATIONS);
 		SLog(EDebug, "   Quantiles                   : %f (surfaces), %f (media)",
@@ -114,6 +118,7 @@ struct MLTConfiguration {
 				(size_t) size.x * (size_t) size.y);
 		}
 		timeout = stream->readSize();
+		transient = TransientGate(stream);
 	}
 
 	inline void serialize(Stream *stream) const {
@@ -141,6 +146,7 @@ struct MLTConfiguration {
 			Vector2i(0, 0).serialize(stream);
 		}
 		stream->writeSize(timeout);
+		transient.serialize(stream);
 	}
 };
 
@@ -57,10 +57,28 @@ public:
 	}
 
 	ref<WorkResult> createWorkResult() const {
+		/* In transient mode, the steady-state spectrum (used for the
+		   luminance normalization) is followed by one RGB triplet per bin */
+		if (m_config.transient.isActive())
+			return new ImageBlock(Bitmap::EMultiChannel, m_film->getCropSize(),
+				m_film->getReconstructionFilter(),
+				SPECTRUM_SAMPLES + 3 * m_config.transient.frames);
 		return new ImageBlock(Bitmap::ESpectrum,
 			m_film->getCropSize(), m_film->getReconstructionFilter());
 	}
 
+	/// Deposit energy at the sample position of a path (and into time bin \c bin if transient)
+	inline void splat(ImageBlock *result, const Path &path, int bin, Spectrum value) {
+		if (!m_config.transient.isActive()) {
+			result->put(path.getSamplePosition(), &value[0]);
+		} else {
+			result->put(path.getSamplePosition(), &value[0], 0, SPECTRUM_SAMPLES);
+			if (bin >= 0)
+				m_config.transient.put(result, path.getSamplePosition(),
+					value, bin, SPECTRUM_SAMPLES);
+		}
+	}
+
 	void prepare() {
 		Scene *scene = static_cast<Scene *>(getResource("scene"));
 		m_sampler = static_cast<Sampler *>(getResource("sampler"));
@@ -126,6 +144,10 @@ public:
 		relWeight = current->getRelativeWeight();
 		BDAssert(!relWeight.isZero());
 
+		const TransientGate &transient = m_config.transient;
+		int currentBin = transient.isActive() ? transient.getBin(*current) : -1,
+		    proposedBin = -1;
+
 		DiscreteDistribution suitabilities(m_mutators.size());
 		MutationRecord muRec, currentMuRec(Mutator::EMutationTypeCount,0,0,0,Spectrum(0.f));
 		ref<Timer> timer = new Timer();
@@ -250,6 +272,12 @@ public:
 					a = 0;
 				}
 
+				if (transient.isActive()) {
+					proposedBin = transient.getBin(*proposed);
+					if (proposedBin < 0 && transient.isGated())
+						a = 0;
+				}
+
 				accumulatedWeight += 1-a;
 
 				/* Accept with probability 'a' */
@@ -257,10 +285,11 @@ public:
 					current->release(muRec.l, muRec.m+1, *m_pool);
 					Spectrum value = relWeight * accumulatedWeight;
 					if (!value.isZero())
-						result->put(current->getSamplePosition(), &value[0]);
+						splat(result, *current, currentBin, value);
 
 					/* The mutation was accepted */
 					std::swap(current, proposed);
+					currentBin = proposedBin;
 					relWeight = current->getRelativeWeight();
 					mutator->accept(muRec);
 					currentMuRec = muRec;
@@ -273,7 +302,7 @@ public:
 					consecRejections++;
 					if (a > 0) {
 						Spectrum value = proposed->getRelativeWeight() * a;
-						result->put(proposed->getSamplePosition(), &value[0]);
+						splat(result, *proposed, proposedBin, value);
 					}
 				}
 			} else {
@@ -289,7 +318,7 @@ public:
 
 		if (accumulatedWeight > 0) {
 			Spectrum value = relWeight * accumulatedWeight;
-			result->put(current->getSamplePosition(), &value[0]);
+			splat(result, *current, currentBin, value);
 		}
 
 		#if defined(MTS_DEBUG_FP)
@@ -344,34 +373,42 @@ ref<WorkProcessor> MLTProcess::createWorkProcessor() const {
 void MLTProcess::develop() {
 	LockGuard lock(m_resultMutex);
 	size_t pixelCount = m_accum->getBitmap()->getPixelCount();
-	const Spectrum *accum = (Spectrum *) m_accum->getBitmap()->getData();
+	int stride = m_accum->getBitmap()->getChannelCount();
+	const Float *accum = m_accum->getBitmap()->getFloatData();
 	const Spectrum *direct = m_directImage != NULL ?
 		(Spectrum *) m_directImage->getData() : NULL;
 	const Float *importanceMap = m_config.importanceMap != NULL ?
 			m_config.importanceMap->getFloatData() : NULL;
-	Spectrum *target = (Spectrum *) m_developBuffer->getData();
 
 	/* Compute the luminance correction factor */
 	Float avgLuminance = 0;
 	if (importanceMap) {
 		for (size_t i=0; i<pixelCount; ++i)
-			avgLuminance += accum[i].getLuminance() * importanceMap[i];
+			avgLuminance += ((const Spectrum *) (accum + i*stride))->getLuminance() * importanceMap[i];
 	} else {
 		for (size_t i=0; i<pixelCount; ++i)
-			avgLuminance += accum[i].getLuminance();
+			avgLuminance += ((const Spectrum *) (accum + i*stride))->getLuminance();
 	}
 
 	avgLuminance /= (Float) pixelCount;
 	Float luminanceFactor = m_config.luminance / avgLuminance;
 
-	for (size_t i=0; i<pixelCount; ++i) {
-		Float correction = luminanceFactor;
-		if (importanceMap)
-			correction *= importanceMap[i];
-		Spectrum value = accum[i] * correction;
-		if (direct)
-			value += direct[i];
-		target[i] = value;
+	if (m_config.transient.isActive()) {
+		/* The direct illumination is part of the chains in this case */
+		m_config.transient.develop(m_accum->getBitmap(), SPECTRUM_SAMPLES,
+			luminanceFactor, importanceMap, m_developBuffer);
+	} else {
+		const Spectrum *source = (const Spectrum *) accum;
+		Spectrum *target = (Spectrum *) m_developBuffer->getData();
+		for (size_t i=0; i<pixelCount; ++i) {
+			Float correction = luminanceFactor;
+			if (importanceMap)
+				correction *= importanceMap[i];
+			Spectrum value = source[i] * correction;
+			if (direct)
+				value += direct[i];
+			target[i] = value;
+		}
 	}
 
 	m_film->setBitmap(m_developBuffer);
@@ -417,9 +454,17 @@ void MLTProcess::bindResource(const std::string &name, int id) {
 		if (m_progress)
 			delete m_progress;
 		m_progress = new ProgressReporter("Rendering", m_config.workUnits, m_job);
-		m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize());
+		if (m_config.transient.isActive()) {
+			int frames = m_config.transient.frames;
+			m_accum = new ImageBlock(Bitmap::EMultiChannel, m_film->getCropSize(),
+				NULL, SPECTRUM_SAMPLES + 3 * frames);
+			m_developBuffer = new Bitmap(Bitmap::EMultiSpectrumAlphaWeight, Bitmap::EFloat,
+				m_film->getCropSize(), 3 * frames + 2);
+		} else {
+			m_accum = new ImageBlock(Bitmap::ESpectrum, m_film->getCropSize());
+			m_developBuffer = new Bitmap(Bitmap::ESpectrum, Bitmap::EFloat, m_film->getCropSize());
+		}
 		m_accum->clear();
-		m_developBuffer = new Bitmap(Bitmap::ESpectrum, Bitmap::EFloat, m_film->getCropSize());
 	}
 }
 
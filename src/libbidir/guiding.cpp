@@ -0,0 +1,395 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/bidir/guiding.h>
+#include <mitsuba/core/atomic.h>
+
+/// Maximum depth of the spatial tree
+#define MTS_GUIDING_MAX_SPATIAL_DEPTH 48
+/// Maximum depth of the directional quad-trees
+#define MTS_GUIDING_MAX_DIRECTIONAL_DEPTH 20
+/// Energy fraction above which a directional quadrant is subdivided
+#define MTS_GUIDING_DIRECTIONAL_THRESHOLD 0.01f
+/// Number of recorded samples that triggers the first refinement
+#define MTS_GUIDING_INITIAL_RECORDS (1 << 16)
+
+MTS_NAMESPACE_BEGIN
+
+/// Map a direction to the unit square using the (area-preserving) cylindrical mapping
+static inline Point2 dirToCanonical(const Vector &d) {
+	Float cosTheta = math::clamp(d.z, (Float) -1, (Float) 1);
+	Float phi = std::atan2(d.y, d.x);
+	if (phi < 0)
+		phi += 2 * M_PI;
+	return Point2(
+		std::min((cosTheta + 1) * 0.5f, ONE_MINUS_EPS),
+		std::min(phi * INV_TWOPI, ONE_MINUS_EPS));
+}
+
+/// Inverse of \ref dirToCanonical()
+static inline Vector canonicalToDir(const Point2 &p) {
+	Float cosTheta = 2 * p.x - 1,
+	      sinTheta = math::safe_sqrt(1 - cosTheta*cosTheta),
+	      sinPhi, cosPhi;
+	math::sincos((Float) (2 * M_PI) * p.y, &sinPhi, &cosPhi);
+	return Vector(sinTheta * cosPhi, sinTheta * sinPhi, cosTheta);
+}
+
+/// Return the quadrant of \c uv and rescale it to the quadrant's unit square
+static inline int childIndex(Point2 &uv) {
+	int index = 0;
+	if (uv.x >= 0.5f) {
+		uv.x = 2 * uv.x - 1;
+		index |= 1;
+	} else {
+		uv.x *= 2;
+	}
+	if (uv.y >= 0.5f) {
+		uv.y = 2 * uv.y - 1;
+		index |= 2;
+	} else {
+		uv.y *= 2;
+	}
+	return index;
+}
+
+/* ==================================================================== */
+/*                          Directional quad-tree                       */
+/* ==================================================================== */
+
+Float GuidingTree::DTree::pdf(Point2 uv) const {
+	Float factor = INV_FOURPI;
+	uint32_t index = 0;
+	while (true) {
+		const DNode &node = nodes[index];
+		Float total = node.total();
+		if (total <= 0)
+			return 0.0f;
+		int child = childIndex(uv);
+		factor *= 4 * node.sum[child] / total;
+		if (node.children[child] == 0)
+			return factor;
+		index = node.children[child];
+	}
+}
+
+Point2 GuidingTree::DTree::sample(Point2 sample) const {
+	/* Use double precision to avoid running out of bits
+	   while rescaling the random number at every level */
+	double u = sample.x;
+	Point2 origin(0.0f);
+	Float size = 1.0f;
+	uint32_t index = 0;
+
+	while (true) {
+		const DNode &node = nodes[index];
+		double total = node.total(), target = u * total;
+		int child = 0;
+		while (child < 3 && (target >= node.sum[child] || node.sum[child] <= 0)) {
+			target -= node.sum[child];
+			++child;
+		}
+		if (node.sum[child] <= 0) {
+			/* Ran past the last nonempty quadrant due to roundoff */
+			while (child > 0 && node.sum[child] <= 0)
+				--child;
+			target = node.sum[child];
+		}
+		u = math::clamp(target / (double) node.sum[child], 0.0, (double) ONE_MINUS_EPS);
+
+		size *= 0.5f;
+		if (child & 1)
+			origin.x += size;
+		if (child & 2)
+			origin.y += size;
+
+		if (node.children[child] == 0)
+			break;
+		index = node.children[child];
+	}
+
+	/* Uniformly sample the leaf using the rescaled first
+	   dimension and the untouched second dimension */
+	return Point2(
+		std::min(origin.x + (Float) u * size, ONE_MINUS_EPS),
+		std::min(origin.y + sample.y * size, ONE_MINUS_EPS));
+}
+
+void GuidingTree::DTree::record(Point2 uv, Float value) {
+	uint32_t index = 0;
+	while (true) {
+		DNode &node = nodes[index];
+		int child = childIndex(uv);
+		atomicAdd(&node.sum[child], (float) value);
+		if (node.children[child] == 0)
+			break;
+		index = node.children[child];
+	}
+}
+
+void GuidingTree::DTree::refine(const DTree &source, Float threshold, int maxDepth) {
+	struct Entry {
+		uint32_t node, sourceNode;
+		Float energy[4];
+		int depth;
+	};
+
+	nodes.clear();
+	nodes.push_back(DNode());
+	Float total = source.total();
+	if (total <= 0)
+		return;
+
+	/* Subdivide every quadrant that holds a sufficiently large fraction
+	   of the total energy. Quadrants that did not exist in the source tree
+	   are assumed to receive a uniform share of their parent's energy */
+	std::vector<Entry> stack;
+	Entry root;
+	root.node = 0;
+	root.sourceNode = 0;
+	root.depth = 1;
+	for (int i=0; i<4; ++i)
+		root.energy[i] = source.nodes[0].sum[i];
+	stack.push_back(root);
+
+	while (!stack.empty()) {
+		Entry entry = stack.back();
+		stack.pop_back();
+
+		for (int i=0; i<4; ++i) {
+			if (entry.depth >= maxDepth || entry.energy[i] <= threshold * total)
+				continue;
+
+			Entry child;
+			child.node = (uint32_t) nodes.size();
+			child.depth = entry.depth + 1;
+			nodes.push_back(DNode());
+			nodes[entry.node].children[i] = child.node;
+
+			uint32_t sourceChild = entry.sourceNode != (uint32_t) -1
+				? source.nodes[entry.sourceNode].children[i] : 0;
+			if (sourceChild != 0) {
+				child.sourceNode = sourceChild;
+				for (int j=0; j<4; ++j)
+					child.energy[j] = source.nodes[sourceChild].sum[j];
+			} else {
+				child.sourceNode = (uint32_t) -1;
+				for (int j=0; j<4; ++j)
+					child.energy[j] = entry.energy[i] * 0.25f;
+			}
+			stack.push_back(child);
+		}
+	}
+}
+
+/* ==================================================================== */
+/*                              Guiding tree                            */
+/* ==================================================================== */
+
+GuidingTree::GuidingTree(const AABB &aabb, Float maxLength,
+		Float bsdfFraction, size_t recordTarget)
+	: m_aabb(aabb), m_maxLength(maxLength), m_bsdfFraction(bsdfFraction),
+	  m_iteration(0), m_recordTarget(recordTarget), m_recordCount(0) {
+	Vector extents = aabb.getExtents();
+	for (int i=0; i<3; ++i)
+		m_invExtents[i] = extents[i] > 0 ? 1.0f / extents[i] : 0.0f;
+	m_dimensions = maxLength > 0 ? 4 : 3;
+
+	SNode root;
+	root.children[0] = root.children[1] = 0;
+	root.leaf = 0;
+	root.axis = 0;
+	root.isLeaf = true;
+	m_nodes.push_back(root);
+	m_leaves.push_back(Leaf());
+}
+
+GuidingTree::GuidingTree(const GuidingTree *parent)
+	: m_aabb(parent->m_aabb), m_invExtents(parent->m_invExtents),
+	  m_maxLength(parent->m_maxLength), m_bsdfFraction(parent->m_bsdfFraction),
+	  m_dimensions(parent->m_dimensions), m_iteration(parent->m_iteration + 1),
+	  m_recordTarget(parent->m_recordTarget * 2), m_recordCount(0) { }
+
+GuidingTree::~GuidingTree() { }
+
+uint32_t GuidingTree::lookup(const Point &p, Float pathLength) const {
+	Float x[4];
+	for (int i=0; i<3; ++i)
+		x[i] = (p[i] - m_aabb.min[i]) * m_invExtents[i];
+	x[3] = m_maxLength > 0 ? pathLength / m_maxLength : 0.0f;
+	for (int i=0; i<4; ++i)
+		x[i] = math::clamp(x[i], (Float) 0, ONE_MINUS_EPS);
+
+	uint32_t index = 0;
+	while (!m_nodes[index].isLeaf) {
+		const SNode &node = m_nodes[index];
+		Float &value = x[node.axis];
+		if (value >= 0.5f) {
+			value = 2 * value - 1;
+			index = node.children[1];
+		} else {
+			value *= 2;
+			index = node.children[0];
+		}
+	}
+	return m_nodes[index].leaf;
+}
+
+bool GuidingTree::isTrained(const Point &p, Float pathLength) const {
+	return m_leaves[lookup(p, pathLength)].sampling.total() > 0;
+}
+
+Float GuidingTree::pdf(const Point &p, Float pathLength, const Vector &d) const {
+	return m_leaves[lookup(p, pathLength)].sampling.pdf(dirToCanonical(d));
+}
+
+Vector GuidingTree::sample(const Point &p, Float pathLength,
+		Point2 sample, Float &pdf) const {
+	const DTree &tree = m_leaves[lookup(p, pathLength)].sampling;
+	Vector d = canonicalToDir(tree.sample(sample));
+	pdf = tree.pdf(dirToCanonical(d));
+	return d;
+}
+
+void GuidingTree::record(const Point &p, Float pathLength,
+		const Vector &d, Float value) {
+	if (!(value > 0) || !std::isfinite(value))
+		return;
+	Leaf &leaf = m_leaves[lookup(p, pathLength)];
+	leaf.building.record(dirToCanonical(d), value);
+	atomicAdd(&leaf.recordCount, 1);
+	atomicAdd(&m_recordCount, 1);
+}
+
+ref<GuidingTree> GuidingTree::refine(int spatialThreshold) const {
+	ref<GuidingTree> tree = new GuidingTree(this);
+	Float threshold = spatialThreshold * std::sqrt(std::pow((Float) 2, (Float) m_iteration));
+	tree->m_nodes.reserve(m_nodes.size());
+	tree->m_leaves.reserve(m_leaves.size());
+	tree->refineNode(this, 0, 0, threshold);
+	return tree;
+}
+
+uint32_t GuidingTree::refineNode(const GuidingTree *parent, uint32_t nodeIndex,
+		int depth, Float threshold) {
+	const SNode &node = parent->m_nodes[nodeIndex];
+	if (node.isLeaf) {
+		const Leaf &leaf = parent->m_leaves[node.leaf];
+		return refineLeaf(leaf, (Float) leaf.recordCount, depth, threshold);
+	}
+
+	uint32_t index = (uint32_t) m_nodes.size();
+	m_nodes.push_back(node);
+	for (int i=0; i<2; ++i) {
+		uint32_t child = refineNode(parent, node.children[i], depth + 1, threshold);
+		m_nodes[index].children[i] = child;
+	}
+	return index;
+}
+
+uint32_t GuidingTree::refineLeaf(const Leaf &source, Float recordCount,
+		int depth, Float threshold) {
+	uint32_t index = (uint32_t) m_nodes.size();
+	m_nodes.push_back(SNode());
+
+	if (recordCount > threshold && depth < MTS_GUIDING_MAX_SPATIAL_DEPTH) {
+		/* Split at the midpoint, assuming that the samples are
+		   distributed evenly among the two halves */
+		m_nodes[index].isLeaf = false;
+		m_nodes[index].leaf = 0;
+		m_nodes[index].axis = (uint8_t) (depth % m_dimensions);
+		for (int i=0; i<2; ++i) {
+			uint32_t child = refineLeaf(source, recordCount * 0.5f, depth + 1, threshold);
+			m_nodes[index].children[i] = child;
+		}
+	} else {
+		m_nodes[index].isLeaf = true;
+		m_nodes[index].leaf = (uint32_t) m_leaves.size();
+		m_nodes[index].axis = 0;
+		m_nodes[index].children[0] = m_nodes[index].children[1] = 0;
+		m_leaves.push_back(Leaf());
+		Leaf &leaf = m_leaves.back();
+		leaf.sampling = source.building;
+		leaf.building.refine(source.building, MTS_GUIDING_DIRECTIONAL_THRESHOLD,
+			MTS_GUIDING_MAX_DIRECTIONAL_DEPTH);
+	}
+	return index;
+}
+
+std::string GuidingTree::toString() const {
+	size_t directionalNodes = 0;
+	for (size_t i=0; i<m_leaves.size(); ++i)
+		directionalNodes += m_leaves[i].sampling.nodes.size();
+
+	std::ostringstream oss;
+	oss << "GuidingTree[" << endl
+		<< "  iteration = " << m_iteration << "," << endl
+		<< "  spatialNodes = " << m_nodes.size() << "," << endl
+		<< "  leaves = " << m_leaves.size() << "," << endl
+		<< "  directionalNodes = " << directionalNodes << "," << endl
+		<< "  maxLength = " << m_maxLength << "," << endl
+		<< "  bsdfFraction = " << m_bsdfFraction << endl
+		<< "]";
+	return oss.str();
+}
+
+/* ==================================================================== */
+/*                               Path guide                             */
+/* ==================================================================== */
+
+PathGuide::PathGuide(const AABB &aabb, Float maxLength, Float bsdfFraction,
+		int spatialThreshold) : m_spatialThreshold(spatialThreshold) {
+	m_mutex = new Mutex();
+	for (int i=0; i<2; ++i)
+		m_trees[i] = new GuidingTree(aabb, maxLength, bsdfFraction,
+			MTS_GUIDING_INITIAL_RECORDS);
+}
+
+ref<GuidingTree> PathGuide::getTree(ETransportMode mode) const {
+	LockGuard lock(m_mutex);
+	return m_trees[mode];
+}
+
+ref<GuidingTree> PathGuide::update(ETransportMode mode, GuidingTree *tree) {
+	if (tree->getRecordCount() < tree->getRecordTarget())
+		return tree;
+
+	LockGuard lock(m_mutex);
+	if (m_trees[mode].get() == tree) {
+		m_trees[mode] = tree->refine(m_spatialThreshold);
+		SLog(EDebug, "Refined the %s guiding tree: %s",
+			mode == EImportance ? "emitter" : "sensor",
+			m_trees[mode]->toString().c_str());
+	}
+	return m_trees[mode];
+}
+
+std::string PathGuide::toString() const {
+	LockGuard lock(m_mutex);
+	std::ostringstream oss;
+	oss << "PathGuide[" << endl
+		<< "  emitterTree = " << indent(m_trees[EImportance]->toString()) << "," << endl
+		<< "  sensorTree = " << indent(m_trees[ERadiance]->toString()) << "," << endl
+		<< "  spatialThreshold = " << m_spatialThreshold << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(GuidingTree, false, Object)
+MTS_IMPLEMENT_CLASS(PathGuide, false, Object)
+MTS_NAMESPACE_END
@@ -114,12 +114,16 @@ int Path::randomWalkFromPixel(const Scene *scene, Sampler *sampler,
 
 std::pair<int, int> Path::alternatingRandomWalkFromPixel(const Scene *scene, Sampler *sampler, BDPTWorkResult *wr,
 		Path &emitterPath, int nEmitterSteps, Path &sensorPath, int nSensorSteps,
-		const Point2i &pixelPosition, int rrStart, MemoryPool &pool) {
-	/* Determine the relevant edges and vertices to start the random walk */
-	PathVertex *curVertexS  = emitterPath.vertex(0),
+		const Point2i &pixelPosition, int rrStart, MemoryPool &pool,
+		const GuidingTree *emitterGuide, const GuidingTree *sensorGuide) {
+	/* Determine the relevant edges and vertices to start the random walk.
+	   The emitter subpath may already contain a prefix (e.g. the cached
+	   deterministic first segment of a laser), which is then continued */
+	int s = (int) emitterPath.vertexCount() - 1;
+	PathVertex *curVertexS  = emitterPath.vertex(s),
 	           *curVertexT  = sensorPath.vertex(0),
-	           *predVertexS = NULL, *predVertexT = NULL;
-	PathEdge   *predEdgeS  = NULL, *predEdgeT = NULL;
+	           *predVertexS = emitterPath.vertexOrNull(s-1), *predVertexT = NULL;
+	PathEdge   *predEdgeS  = emitterPath.edgeOrNull(s-1), *predEdgeT = NULL;
 
 	PathVertex *v1 = pool.allocVertex(), *v2 = pool.allocVertex();
 	PathEdge *e0 = pool.allocEdge(), *e1 = pool.allocEdge();
@@ -154,8 +158,13 @@ std::pair<int, int> Path::alternatingRandomWalkFromPixel(const Scene *scene, Sam
 	}
 
 	Spectrum throughputS(1.0f), throughputT(1.0f);
+	for (int i=0; i<s; ++i) {
+		throughputS *= emitterPath.vertex(i)->weight[EImportance] *
+			emitterPath.vertex(i)->rrWeight * emitterPath.edge(i)->weight[EImportance];
+		if (i > 0)
+			cumEmitterPathLength += emitterPath.edge(i)->length;
+	}
 
-	int s = 0;
 	do {
 		if (curVertexT && (t < nSensorSteps || nSensorSteps == -1)) {
 			PathVertex *succVertexT = pool.allocVertex();
@@ -163,7 +172,8 @@ std::pair<int, int> Path::alternatingRandomWalkFromPixel(const Scene *scene, Sam
 
 			if (curVertexT->sampleNext(scene, sampler, predVertexT,
 					predEdgeT, succEdgeT, succVertexT, ERadiance,
-					rrStart != -1 && t >= rrStart, &throughputT)) {
+					rrStart != -1 && t >= rrStart, &throughputT,
+					sensorGuide, cumSensorPathLength)) {
 				cumSensorPathLength = cumSensorPathLength + succEdgeT->length;
 				if(!(wr->m_decompositionType == Film::ETransient || wr->m_decompositionType == Film::ETransientEllipse) || !(cumSensorPathLength > wr->m_decompositionMaxBound)){
 					sensorPath.append(succEdgeT, succVertexT);
@@ -191,7 +201,8 @@ std::pair<int, int> Path::alternatingRandomWalkFromPixel(const Scene *scene, Sam
 
 			if (curVertexS->sampleNext(scene, sampler, predVertexS,
 					predEdgeS, succEdgeS, succVertexS, EImportance,
-					rrStart != -1 && s >= rrStart, &throughputS)) {
+					rrStart != -1 && s >= rrStart, &throughputS,
+					emitterGuide, cumEmitterPathLength)) {
 				cumEmitterPathLength = cumEmitterPathLength + succEdgeS->length;
 				if(!(wr->m_decompositionType == Film::ETransient || wr->m_decompositionType == Film::ETransientEllipse) || !(cumEmitterPathLength > wr->m_decompositionMaxBound)){
 					emitterPath.append(succEdgeS, succVertexS);
@@ -283,9 +294,276 @@ bool Path::operator==(const Path &path) const {
 	return true;
 }
 
+/// Weight of the balance heuristic strategy terminating at vertex \c m (cf. miWeightElliptic())
+static inline double misBalanceWeight(int m) {
+	return m <= 1 ? 0.0 : (m == 2 ? 0.5 : 1.0);
+}
+
+/**
+ * Squared weight of the strategy that connects the subpath vertices \c i
+ * and \c i+1 relative to the power heuristic (cf. miWeight())
+ */
+static inline double misPowerWeight(int i, bool connectable, bool connectableSucc,
+		ETransportMode mode, bool sampleDirect, bool lightImage, Float ratioDirect) {
+	if (!connectable || !connectableSucc || (mode == ERadiance && !lightImage && i < 2))
+		return 0.0;
+	else if (sampleDirect && i == 1)
+		return (double) ratioDirect * (double) ratioDirect;
+	else
+		return 1.0;
+}
+
+static inline bool misConnectable(const PathVertex *v) {
+	return (v->misFlags & PathVertex::EMISConnectable) != 0;
+}
+
+void Path::computeMISPartials(const Scene *scene, ETransportMode mode,
+		bool sampleDirect, bool lightImage) {
+	int n = (int) m_vertices.size();
+	if (n < 2)
+		return;
+
+	/* As in miWeight(): direct sampling strategies may make it possible
+	   to connect to endpoints that otherwise couldn't be connected */
+	EMeasure directMeasure = EInvalidMeasure;
+	if (sampleDirect)
+		directMeasure = m_vertices[1]->getAbstractEmitter()->getDirectMeasure();
+
+	bool prefix = true;
+	for (int i=0; i<n; ++i) {
+		PathVertex *v = m_vertices[i];
+		bool connectable;
+		if (sampleDirect && i == 0)
+			connectable = directMeasure != EDiscrete && directMeasure != EInvalidMeasure;
+		else if (sampleDirect && i == 1)
+			connectable = directMeasure != EInvalidMeasure;
+		else
+			connectable = v->isConnectable();
+
+		if (i >= 2)
+			prefix &= connectable;
+
+		v->misFlags = (connectable ? PathVertex::EMISConnectable : 0)
+			| (prefix ? PathVertex::EMISPrefixConnectable : 0);
+		v->misPower = v->misBalance = 0;
+		v->misDirect = 0;
+	}
+
+	Float ratioDirect = 0.0f;
+	if (sampleDirect && n > 2 && misConnectable(m_vertices[1])) {
+		/* The connectability of vertex 2 is checked when the weight is
+		   evaluated, since it may be the (modified) connection vertex */
+		Float pdf = m_vertices[0]->pdf[mode] * m_edges[0]->pdf[mode];
+		if (pdf == 0)
+			return;
+		ratioDirect = m_vertices[2]->evalPdfDirect(scene, m_vertices[1], mode,
+			directMeasure == ESolidAngle ? EArea : directMeasure) / pdf;
+		m_vertices[2]->misDirect = ratioDirect;
+	}
+
+	uint8_t flags = PathVertex::EMISValid
+		| (sampleDirect ? PathVertex::EMISDirect : 0)
+		| (lightImage ? PathVertex::EMISLightImage : 0);
+	m_vertices[0]->misFlags |= flags;
+
+	/* Accumulate the relative densities of all strategies with fewer vertices
+	   on this subpath. The ratio at vertex 'm' requires the reverse density
+	   stored on vertex 'm+1', which is only known if the walk continued */
+	double power = 0, balance = 0;
+	for (int m=1; m+2<n; ++m) {
+		Float pdf = m_vertices[m-1]->pdf[mode] * m_edges[m-1]->pdf[mode];
+		if (pdf == 0)
+			break;
+
+		double ratio = (double) (m_vertices[m+1]->pdf[1-mode]
+			* m_edges[m]->pdf[1-mode]) / (double) pdf;
+
+		power = ratio * ratio * (power + misPowerWeight(m-1,
+			misConnectable(m_vertices[m-1]), misConnectable(m_vertices[m]),
+			mode, sampleDirect, lightImage, ratioDirect));
+		balance = ratio * (balance + misBalanceWeight(m));
+
+		PathVertex *v = m_vertices[m];
+		v->misPower = power;
+		v->misBalance = balance;
+		v->misFlags |= flags;
+	}
+}
+
+/**
+ * Constant-time version of Path::miWeight() based on the partial sums cached
+ * by Path::computeMISPartials(). Returns \c false when the connection requires
+ * the general implementation.
+ */
+static bool miWeightRecursive(const Scene *scene, const Path &emitterSubpath,
+		const PathEdge *connectionEdge, const Path &sensorSubpath,
+		int s, int t, bool sampleDirect, bool lightImage, Float &result) {
+	if (s < 2 || t < 2)
+		return false;
+
+	const PathVertex
+		*vsPred2 = emitterSubpath.vertex(s-2),
+		*vtPred2 = sensorSubpath.vertex(t-2),
+		*vsPred = emitterSubpath.vertex(s-1),
+		*vtPred = sensorSubpath.vertex(t-1),
+		*vs = emitterSubpath.vertex(s),
+		*vt = sensorSubpath.vertex(t);
+
+	const uint8_t mask = PathVertex::EMISValid
+		| PathVertex::EMISDirect | PathVertex::EMISLightImage;
+	const uint8_t flags = PathVertex::EMISValid
+		| (sampleDirect ? PathVertex::EMISDirect : 0)
+		| (lightImage ? PathVertex::EMISLightImage : 0);
+
+	/* Specular and index-matched vertices require the measure
+	   conversions of the general implementation */
+	if ((vsPred2->misFlags & mask) != flags || (vtPred2->misFlags & mask) != flags ||
+		!(vsPred->misFlags & PathVertex::EMISPrefixConnectable) ||
+		!(vtPred->misFlags & PathVertex::EMISPrefixConnectable) ||
+		!vs->isConnectable() || !vt->isConnectable())
+		return false;
+
+	const PathEdge
+		*vsEdge = emitterSubpath.edge(s-1),
+		*vtEdge = sensorSubpath.edge(t-1);
+
+	Float pdfS  = vsPred->pdf[EImportance] * vsEdge->pdf[EImportance],
+	      pdfS1 = vsPred2->pdf[EImportance] * emitterSubpath.edge(s-2)->pdf[EImportance],
+	      pdfT  = vtPred->pdf[ERadiance] * vtEdge->pdf[ERadiance],
+	      pdfT1 = vtPred2->pdf[ERadiance] * sensorSubpath.edge(t-2)->pdf[ERadiance];
+
+	if (pdfS == 0 || pdfS1 == 0 || pdfT == 0 || pdfT1 == 0)
+		return false;
+
+	/* Density ratios of the four vertices adjacent to the connection edge */
+	double ratioS = (double) (vt->evalPdf(scene, vtPred, vs, ERadiance, EArea)
+			* connectionEdge->pdf[ERadiance]) / (double) pdfS,
+	       ratioS1 = (double) (vs->evalPdf(scene, vt, vsPred, ERadiance, EArea)
+			* vsEdge->pdf[ERadiance]) / (double) pdfS1,
+	       ratioT = (double) (vs->evalPdf(scene, vsPred, vt, EImportance, EArea)
+			* connectionEdge->pdf[EImportance]) / (double) pdfT,
+	       ratioT1 = (double) (vt->evalPdf(scene, vs, vtPred, EImportance, EArea)
+			* vtEdge->pdf[EImportance]) / (double) pdfT1;
+
+	Float ratioEmitterDirect = emitterSubpath.vertex(2)->misDirect,
+	      ratioSensorDirect = sensorSubpath.vertex(2)->misDirect;
+
+	double emitterWeight = ratioS * ratioS * (
+		misPowerWeight(s-1, misConnectable(vsPred), true, EImportance,
+			sampleDirect, lightImage, ratioEmitterDirect) + ratioS1 * ratioS1 * (
+		misPowerWeight(s-2, misConnectable(vsPred2), misConnectable(vsPred), EImportance,
+			sampleDirect, lightImage, ratioEmitterDirect) + vsPred2->misPower));
+
+	double sensorWeight = ratioT * ratioT * (
+		misPowerWeight(t-1, misConnectable(vtPred), true, ERadiance,
+			sampleDirect, lightImage, ratioSensorDirect) + ratioT1 * ratioT1 * (
+		misPowerWeight(t-2, misConnectable(vtPred2), misConnectable(vtPred), ERadiance,
+			sampleDirect, lightImage, ratioSensorDirect) + vtPred2->misPower));
+
+	result = (Float) (1.0 / (1.0 + emitterWeight + sensorWeight));
+	return true;
+}
+
+/**
+ * Constant-time version of Path::miWeightElliptic() based on the partial sums
+ * cached by Path::computeMISPartials(). The inserted ellipsoidal vertex only
+ * affects the densities of its two neighbors on either side, which are
+ * evaluated here directly.
+ */
+static bool miWeightEllipticRecursive(const Scene *scene, const Path &emitterSubpath,
+		const PathEdge *connectionEdge1, const PathVertex *shadowVertex,
+		const PathEdge *connectionEdge2, const Path &sensorSubpath,
+		int s, int t, Float &result) {
+	if (s < 1 || t < 1)
+		return false;
+
+	const PathVertex
+			*vsPred = emitterSubpath.vertex(s-1),
+			*vtPred = sensorSubpath.vertex(t-1),
+			*vs = emitterSubpath.vertex(s),
+			*vt = sensorSubpath.vertex(t);
+
+	if (!shadowVertex->isConnectable() || !vs->isConnectable() || !vt->isConnectable())
+		return false;
+
+	/* Cached values are only needed for the longer subpaths */
+	if (s >= 3 && (!(vsPred->misFlags & PathVertex::EMISPrefixConnectable) ||
+		!(emitterSubpath.vertex(s-2)->misFlags & PathVertex::EMISValid)))
+		return false;
+	if (t >= 3 && (!(vtPred->misFlags & PathVertex::EMISPrefixConnectable) ||
+		!(sensorSubpath.vertex(t-2)->misFlags & PathVertex::EMISValid)))
+		return false;
+
+	const PathEdge
+		*vsEdge = emitterSubpath.edge(s-1),
+		*vtEdge = sensorSubpath.edge(t-1);
+
+	/* Strategies with fewer emitter subpath vertices */
+	double emitterWeight = 0;
+	if (s >= 2) {
+		Float pdfS = vsPred->pdf[EImportance] * vsEdge->pdf[EImportance];
+		if (pdfS == 0)
+			return false;
+		double ratioS = (double) (shadowVertex->evalPdf(scene, vt, vs, ERadiance, EArea)
+			* connectionEdge1->pdf[ERadiance]) / (double) pdfS;
+
+		double inner = 0;
+		if (s >= 3) {
+			const PathVertex *vsPred2 = emitterSubpath.vertex(s-2);
+			Float pdfS1 = vsPred2->pdf[EImportance] * emitterSubpath.edge(s-2)->pdf[EImportance];
+			if (pdfS1 == 0)
+				return false;
+			double ratioS1 = (double) (vs->evalPdf(scene, shadowVertex, vsPred, ERadiance, EArea)
+				* vsEdge->pdf[ERadiance]) / (double) pdfS1;
+			inner = ratioS1 * (misBalanceWeight(s-1) + vsPred2->misBalance);
+		}
+		emitterWeight = ratioS * (misBalanceWeight(s) + inner);
+	}
+
+	/* Strategies with fewer sensor subpath vertices, starting with
+	   the one that moves the ellipsoidal vertex to the sensor subpath */
+	Float pdfShadow = vt->evalPdf(scene, vtPred, shadowVertex, ERadiance, EArea)
+		* connectionEdge2->pdf[ERadiance];
+	if (pdfShadow == 0)
+		return false;
+	double ratioShadow = (double) (vs->evalPdf(scene, vsPred, shadowVertex, EImportance, EArea)
+		* connectionEdge1->pdf[EImportance]) / (double) pdfShadow;
+
+	double inner = 0;
+	if (t >= 2) {
+		Float pdfT = vtPred->pdf[ERadiance] * vtEdge->pdf[ERadiance];
+		if (pdfT == 0)
+			return false;
+		double ratioT = (double) (shadowVertex->evalPdf(scene, vs, vt, EImportance, EArea)
+			* connectionEdge2->pdf[EImportance]) / (double) pdfT;
+
+		double inner2 = 0;
+		if (t >= 3) {
+			const PathVertex *vtPred2 = sensorSubpath.vertex(t-2);
+			Float pdfT1 = vtPred2->pdf[ERadiance] * sensorSubpath.edge(t-2)->pdf[ERadiance];
+			if (pdfT1 == 0)
+				return false;
+			double ratioT1 = (double) (vt->evalPdf(scene, shadowVertex, vtPred, EImportance, EArea)
+				* vtEdge->pdf[EImportance]) / (double) pdfT1;
+			inner2 = ratioT1 * (misBalanceWeight(t-1) + vtPred2->misBalance);
+		}
+		inner = ratioT * (misBalanceWeight(t) + inner2);
+	}
+	double sensorWeight = ratioShadow * (misBalanceWeight(t+1) + inner);
+
+	double weight = (s == 1 ? 0.5 : 1.0) + emitterWeight + sensorWeight;
+	result = (Float) (0.5 * (1.0 + ratioShadow) / weight);
+	return true;
+}
+
 Float Path::miWeight(const Scene *scene, const Path &emitterSubpath,
 		const PathEdge *connectionEdge, const Path &sensorSubpath,
 		int s, int t, bool sampleDirect, bool lightImage) {
+	Float result;
+	if (miWeightRecursive(scene, emitterSubpath, connectionEdge,
+			sensorSubpath, s, t, sampleDirect, lightImage, result))
+		return result;
+
 	int k = s+t+1, n = k+1;
 
 	const PathVertex
@@ -555,6 +833,18 @@ Float Path::miWeightElliptic(const Scene *scene, const Path &emitterSubpath,
 		const PathEdge *connectionEdge1, const PathVertex *shadowVertex, const PathEdge *connectionEdge2,
 		const Path &sensorSubpath,
 		int s, int t, bool sampleDirect, bool lightImage, Sampler *sampler) {
+	Float result;
+	if (miWeightEllipticRecursive(scene, emitterSubpath, connectionEdge1,
+			shadowVertex, connectionEdge2, sensorSubpath, s, t, result))
+		return result;
+
+	return miWeightEllipticSweep(scene, emitterSubpath, connectionEdge1,
+		shadowVertex, connectionEdge2, sensorSubpath, s, t);
+}
+
+Float Path::miWeightEllipticSweep(const Scene *scene, const Path &emitterSubpath,
+		const PathEdge *connectionEdge1, const PathVertex *shadowVertex, const PathEdge *connectionEdge2,
+		const Path &sensorSubpath, int s, int t) {
 	int k = s+t+1+1, n = k+1; // k -> #edges, n -> #vertices
 
 	const PathVertex
@@ -801,18 +1091,6 @@ Float Path::miWeightElliptic(const Scene *scene, const Path &emitterSubpath,
 
 
 
-	Float *FEdgePDF    = (Float *) alloca(k * sizeof(Float));
-	Float *BEdgePDF    = (Float *) alloca(k * sizeof(Float));
-	Float *sCumPDF    = (Float *) alloca(n * sizeof(Float));
-	Float *tCumPDF    = (Float *) alloca(n * sizeof(Float));
-	Float *stCumPDF    = (Float *) alloca(k * sizeof(Float));
-	for (int i=0; i < k; i++){
-		FEdgePDF[i] = sampler->nextFloat();
-	}
-	for (int i=0; i < k; i++){
-		BEdgePDF[i] = sampler->nextFloat();
-	}
-
 //	sCumPDF[0] = 1.0f;
 //	for (int i = 1; i < n; i++){
 //		sCumPDF[i] = sCumPDF[i-1] * FEdgePDF[i];
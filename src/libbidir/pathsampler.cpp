@@ -580,7 +580,11 @@ Float PathSampler::computeAverageLuminance(size_t sampleCount) {
 }
 
 static void seedCallback(std::vector<PathSeed> &output, const Bitmap *importanceMap,
-		Float &accum, int s, int t, Float weight, Path &path) {
+		const PathSampler::PathFilter &filter, Float &accum, int s, int t,
+		Float weight, Path &path) {
+	if (filter && !filter(path))
+		return;
+
 	accum += weight;
 
 	if (importanceMap) {
@@ -612,7 +616,8 @@ Float PathSampler::generateSeeds(size_t sampleCount, size_t seedCount,
 	SplatList splatList;
 	Float luminance;
 	PathCallback callback = boost::bind(&seedCallback,
-		boost::ref(tempSeeds), importanceMap, boost::ref(luminance),
+		boost::ref(tempSeeds), importanceMap, boost::cref(m_seedFilter),
+		boost::ref(luminance),
 		_1, _2, _3, _4);
 
 	Float mean = 0.0f, variance = 0.0f;
@@ -17,6 +17,7 @@
 */
 
 #include <mitsuba/bidir/path.h>
+#include <mitsuba/bidir/guiding.h>
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/render/ellipsoid.h> // To test ellipse code. FixMe to go throught the KDD tree
 
@@ -172,6 +173,11 @@ void PathVertex::EllipsoidalSampleBetween(const Scene *scene, ref<Sampler> sampl
 					if(wr->getModulationType() == PathLengthSampler::ENone){
 						//Place the currentValue in the appropriate time bin of the light image
 						currentValue.toLinearRGB(temp[0],temp[1],temp[2]);
+						if (wr->hasEvents()) {
+							Float rgb[3] = { temp[0] * miWeight, temp[1] * miWeight, temp[2] * miWeight };
+							wr->putEvent(samplePos, totalPathLength, rgb, s+t-1,
+								TimeTagEvent::ELightImage | TimeTagEvent::EElliptic);
+						}
 						l_sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+0] += temp[0] * miWeight;
 						l_sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+1] += temp[1] * miWeight;
 						l_sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+2] += temp[2] * miWeight;
@@ -193,6 +199,8 @@ void PathVertex::EllipsoidalSampleBetween(const Scene *scene, ref<Sampler> sampl
 
 				if(wr->getModulationType() == PathLengthSampler::ENone){
 					cumulativeValue.toLinearRGB(temp[0],temp[1],temp[2]);
+					if (wr->hasEvents())
+						wr->putEvent(samplePos, totalPathLength, temp, s+t-1, TimeTagEvent::EElliptic);
 					sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+0] += temp[0];
 					sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+1] += temp[1];
 					sampleDecompositionValue[binIndex*SPECTRUM_SAMPLES+2] += temp[2];
@@ -221,7 +229,8 @@ void PathVertex::EllipsoidalSampleBetween(const Scene *scene, ref<Sampler> sampl
 bool PathVertex::sampleNext(const Scene *scene, Sampler *sampler,
 		const PathVertex *pred, const PathEdge *predEdge,
 		PathEdge *succEdge, PathVertex *succ,
-		ETransportMode mode, bool russianRoulette, Spectrum *throughput) {
+		ETransportMode mode, bool russianRoulette, Spectrum *throughput,
+		const GuidingTree *guide, Float pathLength) {
 	Ray ray;
 
 	memset(succEdge, 0, sizeof(PathEdge));
@@ -338,18 +347,41 @@ bool PathVertex::sampleNext(const Scene *scene, Sampler *sampler,
 				Vector wi = normalize(pred->getPosition() - its.p);
 				Vector wo;
 
-				/* Sample the BSDF */
 				BSDFSamplingRecord bRec(its, sampler, mode);
 				bRec.wi = its.toLocal(wi);
-				weight[mode] = bsdf->sample(bRec, pdf[mode], sampler->next2D());
-				if (weight[mode].isZero())
-					return false;
+
+				/* Decide whether to draw the direction from the guiding
+				   distribution (one-sample MIS with the BSDF) */
+				bool guided = guide && GuidingTree::isGuidable(bsdf)
+					&& guide->isTrained(its.p, pathLength);
+				Float bsdfFraction = guided ? guide->getBSDFSamplingFraction() : 1.0f;
+				Float guidePdf = 0.0f;
+
+				if (guided && sampler->next1D() >= bsdfFraction) {
+					/* Sample the guiding distribution */
+					wo = guide->sample(its.p, pathLength, sampler->next2D(), guidePdf);
+					bRec.wo = its.toLocal(wo);
+					bRec.sampledType = bsdf->getType() & BSDF::ESmooth;
+					bRec.sampledComponent = -1;
+					pdf[mode] = bsdf->pdf(bRec, ESolidAngle);
+					if (pdf[mode] <= RCPOVERFLOW)
+						return false;
+					weight[mode] = bsdf->eval(bRec, ESolidAngle) / pdf[mode];
+					if (weight[mode].isZero())
+						return false;
+				} else {
+					/* Sample the BSDF */
+					weight[mode] = bsdf->sample(bRec, pdf[mode], sampler->next2D());
+					if (weight[mode].isZero())
+						return false;
+					wo = its.toWorld(bRec.wo);
+					if (guided)
+						guidePdf = guide->pdf(its.p, pathLength, wo);
+				}
 
 				measure = BSDF::getMeasure(bRec.sampledType);
 				componentType = (uint16_t) (bRec.sampledType & BSDF::EAll);
 
-				wo = its.toWorld(bRec.wo);
-
 				/* Prevent light leaks due to the use of shading normals */
 				Float wiDotGeoN = dot(its.geoFrame.n, wi),
 				      woDotGeoN = dot(its.geoFrame.n, wo);
@@ -395,6 +427,12 @@ bool PathVertex::sampleNext(const Scene *scene, Sampler *sampler,
 				}
 				bRec.reverse();
 
+				/* Account for the density of the guided mixture. The reverse
+				   weight is unaffected, and the pdf fields keep the BSDF densities */
+				if (guided)
+					weight[mode] *= pdf[mode] / (bsdfFraction * pdf[mode]
+						+ (1 - bsdfFraction) * guidePdf);
+
 				/* Adjoint BSDF for shading normals */
 				if (mode == EImportance)
 					weight[EImportance] *= std::abs(
@@ -20,6 +20,7 @@
 #include <mitsuba/core/version.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/fstream.h>
+#include <mitsuba/core/sse.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/scoped_array.hpp>
 #include <boost/thread/mutex.hpp>
@@ -46,6 +47,7 @@
 #include <ImfVecAttribute.h>
 #include <ImfMatrixAttribute.h>
 #include <ImfVersion.h>
+#include <ImfThreading.h>
 #include <ImfIO.h>
 #include <ImathBox.h>
 #endif
@@ -627,6 +629,33 @@ void Bitmap::copyFrom(const Bitmap *bitmap, Point2i sourceOffset,
 	}
 }
 
+/// Compute <tt>target[i] += source[i]</tt> for \c count single precision values
+static void accumulateValuesSSE(const float *source, float *target, size_t count) {
+	size_t i = 0;
+#if defined(MTS_SSE)
+	for (; i+4 <= count; i += 4)
+		_mm_storeu_ps(target + i, _mm_add_ps(
+			_mm_loadu_ps(target + i), _mm_loadu_ps(source + i)));
+#endif
+	for (; i<count; ++i)
+		target[i] += source[i];
+}
+
+#if defined(MTS_HAS_AVX_KERNELS)
+/// AVX version of \ref accumulateValuesSSE()
+MTS_TARGET("avx") static void accumulateValuesAVX(const float *source, float *target, size_t count) {
+	size_t i = 0;
+	for (; i+8 <= count; i += 8)
+		_mm256_storeu_ps(target + i, _mm256_add_ps(
+			_mm256_loadu_ps(target + i), _mm256_loadu_ps(source + i)));
+	for (; i<count; ++i)
+		target[i] += source[i];
+}
+#endif
+
+/* Implementation selected in Bitmap::staticInitialization() */
+static void (*accumulateValues)(const float *, float *, size_t) = accumulateValuesSSE;
+
 void Bitmap::accumulate(const Bitmap *bitmap, Point2i sourceOffset,
 		Point2i targetOffset, Vector2i size) {
 	Assert(getPixelFormat() == bitmap->getPixelFormat() &&
@@ -687,8 +716,7 @@ void Bitmap::accumulate(const Bitmap *bitmap, Point2i sourceOffset,
 				break;
 
 			case EFloat32:
-				for (size_t i = 0; i < columns; ++i)
-					((float *) target)[i] += ((float *) source)[i];
+				accumulateValues((const float *) source, (float *) target, columns);
 				break;
 
 			case EFloat64:
@@ -1532,6 +1560,61 @@ Spectrum Bitmap::getPixel(const Point2i &pos) const {
 	return result;
 }
 
+/**
+ * Apply a format conversion to \c count consecutive pixels. The work is split
+ * into blocks that are converted in parallel. The first block is processed on
+ * the calling thread, so that unsupported conversions raise an error outside
+ * of the parallel region.
+ */
+static void convertBlocks(const FormatConverter *cvt,
+		Bitmap::EPixelFormat sourceFormat, Float sourceGamma, const uint8_t *source, size_t sourcePixelSize,
+		Bitmap::EPixelFormat destFormat, Float destGamma, uint8_t *dest, size_t destPixelSize,
+		size_t count, Float multiplier, Spectrum::EConversionIntent intent, int channelCount) {
+	/* Large enough that the lookup tables of the 8/16 bit converters pay off */
+	const size_t blockSize = 1 << 17;
+	const ssize_t blocks = (ssize_t) ((count + blockSize - 1) / blockSize);
+
+	cvt->convert(sourceFormat, sourceGamma, source, destFormat, destGamma, dest,
+		std::min(count, blockSize), multiplier, intent, channelCount);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(dynamic) if (blocks > 2)
+	#endif
+	for (ssize_t block=1; block<blocks; ++block) {
+		size_t start = (size_t) block * blockSize;
+		cvt->convert(sourceFormat, sourceGamma, source + start * sourcePixelSize,
+			destFormat, destGamma, dest + start * destPixelSize,
+			std::min(count - start, blockSize), multiplier, intent, channelCount);
+	}
+}
+
+/// Multiply a contiguous sequence of values by a common factor
+static void scaleValuesSSE(const Float *source, Float factor, Float *dest, size_t count) {
+	size_t i = 0;
+#if defined(MTS_SSE)
+	const __m128 f = _mm_set1_ps(factor);
+	for (; i+4 <= count; i += 4)
+		_mm_storeu_ps(dest + i, _mm_mul_ps(_mm_loadu_ps(source + i), f));
+#endif
+	for (; i<count; ++i)
+		dest[i] = source[i] * factor;
+}
+
+#if defined(MTS_HAS_AVX_KERNELS)
+/// AVX version of \ref scaleValuesSSE()
+MTS_TARGET("avx") static void scaleValuesAVX(const Float *source, Float factor, Float *dest, size_t count) {
+	size_t i = 0;
+	const __m256 f = _mm256_set1_ps(factor);
+	for (; i+8 <= count; i += 8)
+		_mm256_storeu_ps(dest + i, _mm256_mul_ps(_mm256_loadu_ps(source + i), f));
+	for (; i<count; ++i)
+		dest[i] = source[i] * factor;
+}
+#endif
+
+/* Implementation selected in Bitmap::staticInitialization() */
+static void (*scaleValues)(const Float *, Float, Float *, size_t) = scaleValuesSSE;
+
 void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionIntent intent) const {
 	if (m_componentFormat == EBitmask || target->getComponentFormat() == EBitmask)
 		Log(EError, "Conversions involving bitmasks are currently not supported!");
@@ -1552,10 +1635,10 @@ void Bitmap::convert(Bitmap *target, Float multiplier, Spectrum::EConversionInte
 
 	Assert(cvt != NULL);
 
-	cvt->convert(m_pixelFormat, m_gamma, m_data,
-		target->getPixelFormat(), target->getGamma(), target->getData(),
-		(size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
-		m_channelCount);
+	convertBlocks(cvt, m_pixelFormat, m_gamma, m_data, getBytesPerPixel(),
+		target->getPixelFormat(), target->getGamma(), target->getUInt8Data(),
+		target->getBytesPerPixel(), (size_t) m_size.x * (size_t) m_size.y,
+		multiplier, intent, m_channelCount);
 }
 
 ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
@@ -1584,8 +1667,8 @@ ref<Bitmap> Bitmap::convert(EPixelFormat pixelFormat,
 		target->setChannelNames(m_channelNames);
 	target->setGamma(gamma);
 
-	cvt->convert(m_pixelFormat, m_gamma, m_data,
-		pixelFormat, gamma, target->getData(),
+	convertBlocks(cvt, m_pixelFormat, m_gamma, m_data, getBytesPerPixel(),
+		pixelFormat, gamma, target->getUInt8Data(), target->getBytesPerPixel(),
 		(size_t) m_size.x * (size_t) m_size.y, multiplier, intent,
 		m_channelCount);
 
@@ -1614,63 +1697,28 @@ void Bitmap::convertMultiSpectrumAlphaWeight(const Bitmap *source,
 	if (source->getComponentFormat() != EFloat && source->getPixelFormat() != EMultiSpectrumAlphaWeight)
 		Log(EError, "convertMultiSpectrumAlphaWeight(): unsupported!");
 
-	Float *temp = new Float[count * target->getChannelCount()], *dst = temp;
-
-	for (size_t k = 0; k<count; ++k) {
-		const Float *srcData = (const Float *) sourcePtr + k * source->getChannelCount();
-		Float weight = srcData[source->getChannelCount()-1],
-			  invWeight = weight == 0 ? 0 : (Float) 1 / weight;
-		Float alpha = srcData[source->getChannelCount()-2] * invWeight;
-
-		for (size_t i=0; i<pixelFormats.size(); ++i) {
-			Spectrum value = ((Spectrum *) srcData)[i] * invWeight;
-			Float tmp0, tmp1, tmp2;
-			switch (pixelFormats[i]) {
-				case Bitmap::ELuminance:
-					*dst++ = value.getLuminance();
-					break;
-				case Bitmap::ELuminanceAlpha:
-					*dst++ = value.getLuminance();
-					*dst++ = alpha;
-					break;
-				case Bitmap::EXYZ:
-					value.toXYZ(tmp0, tmp1, tmp2);
-					*dst++ = tmp0;
-					*dst++ = tmp1;
-					*dst++ = tmp2;
-					break;
-				case Bitmap::EXYZA:
-					value.toXYZ(tmp0, tmp1, tmp2);
-					*dst++ = tmp0;
-					*dst++ = tmp1;
-					*dst++ = tmp2;
-					*dst++ = alpha;
-					break;
-				case Bitmap::ERGB:
-					value.toLinearRGB(tmp0, tmp1, tmp2);
-					*dst++ = tmp0;
-					*dst++ = tmp1;
-					*dst++ = tmp2;
-					break;
-				case Bitmap::ERGBA:
-					value.toLinearRGB(tmp0, tmp1, tmp2);
-					*dst++ = tmp0;
-					*dst++ = tmp1;
-					*dst++ = tmp2;
-					*dst++ = alpha;
-					break;
-				case Bitmap::ESpectrum:
-					for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-						*dst++ = value[j];
-					break;
-				case Bitmap::ESpectrumAlpha:
-					for (int j=0; j<SPECTRUM_SAMPLES; ++j)
-						*dst++ = value[j];
-					*dst++ = alpha;
-					break;
-				default:
-					Log(EError, "Unknown pixel format!");
-			}
+	/* When all outputs are spectral (or RGB, which is the same thing in
+	   an RGB build), a pixel simply turns into its spectral values divided
+	   by the weight. Validate the formats here, since errors can't be
+	   raised from within the parallel loop below */
+	bool spectralOnly = true;
+	for (size_t i=0; i<pixelFormats.size(); ++i) {
+		switch (pixelFormats[i]) {
+			case Bitmap::ESpectrum:
+				break;
+			case Bitmap::ERGB:
+				spectralOnly &= SPECTRUM_SAMPLES == 3;
+				break;
+			case Bitmap::ELuminance:
+			case Bitmap::ELuminanceAlpha:
+			case Bitmap::EXYZ:
+			case Bitmap::EXYZA:
+			case Bitmap::ERGBA:
+			case Bitmap::ESpectrumAlpha:
+				spectralOnly = false;
+				break;
+			default:
+				Log(EError, "Unknown pixel format!");
 		}
 	}
 
@@ -1678,10 +1726,100 @@ void Bitmap::convertMultiSpectrumAlphaWeight(const Bitmap *source,
 		std::make_pair(EFloat, target->getComponentFormat())
 	);
 
-	cvt->convert(Bitmap::EMultiChannel, 1.0f, temp, Bitmap::EMultiChannel, 1.0f, targetPtr,
-			count, 1.0f, Spectrum::EReflectance, target->getChannelCount());
+	const int sourceChannels = source->getChannelCount(),
+	          targetChannels = target->getChannelCount();
+	const size_t targetPixelSize = target->getBytesPerPixel();
+
+	/* Convert blocks of pixels in parallel, each one via a small temporary buffer */
+	const size_t blockSize = 1024;
+	const ssize_t blocks = (ssize_t) ((count + blockSize - 1) / blockSize);
+
+	#if defined(MTS_OPENMP)
+		#pragma omp parallel if (blocks > 1)
+	#endif
+	{
+		Float *temp = new Float[std::min(count, blockSize) * targetChannels];
+
+		#if defined(MTS_OPENMP)
+			#pragma omp for schedule(dynamic)
+		#endif
+		for (ssize_t block=0; block<blocks; ++block) {
+			size_t start = (size_t) block * blockSize,
+			       end = std::min(count, start + blockSize);
+			Float *dst = temp;
+
+			for (size_t k=start; k<end; ++k) {
+				const Float *srcData = (const Float *) sourcePtr + k * sourceChannels;
+				Float weight = srcData[sourceChannels-1],
+					  invWeight = weight == 0 ? 0 : (Float) 1 / weight;
+
+				if (spectralOnly) {
+					scaleValues(srcData, invWeight, dst, targetChannels);
+					dst += targetChannels;
+					continue;
+				}
+
+				Float alpha = srcData[sourceChannels-2] * invWeight;
+
+				for (size_t i=0; i<pixelFormats.size(); ++i) {
+					Spectrum value = ((Spectrum *) srcData)[i] * invWeight;
+					Float tmp0, tmp1, tmp2;
+					switch (pixelFormats[i]) {
+						case Bitmap::ELuminance:
+							*dst++ = value.getLuminance();
+							break;
+						case Bitmap::ELuminanceAlpha:
+							*dst++ = value.getLuminance();
+							*dst++ = alpha;
+							break;
+						case Bitmap::EXYZ:
+							value.toXYZ(tmp0, tmp1, tmp2);
+							*dst++ = tmp0;
+							*dst++ = tmp1;
+							*dst++ = tmp2;
+							break;
+						case Bitmap::EXYZA:
+							value.toXYZ(tmp0, tmp1, tmp2);
+							*dst++ = tmp0;
+							*dst++ = tmp1;
+							*dst++ = tmp2;
+							*dst++ = alpha;
+							break;
+						case Bitmap::ERGB:
+							value.toLinearRGB(tmp0, tmp1, tmp2);
+							*dst++ = tmp0;
+							*dst++ = tmp1;
+							*dst++ = tmp2;
+							break;
+						case Bitmap::ERGBA:
+							value.toLinearRGB(tmp0, tmp1, tmp2);
+							*dst++ = tmp0;
+							*dst++ = tmp1;
+							*dst++ = tmp2;
+							*dst++ = alpha;
+							break;
+						case Bitmap::ESpectrum:
+							for (int j=0; j<SPECTRUM_SAMPLES; ++j)
+								*dst++ = value[j];
+							break;
+						case Bitmap::ESpectrumAlpha:
+							for (int j=0; j<SPECTRUM_SAMPLES; ++j)
+								*dst++ = value[j];
+							*dst++ = alpha;
+							break;
+						default:
+							break;
+					}
+				}
+			}
 
-	delete[] temp;
+			cvt->convert(Bitmap::EMultiChannel, 1.0f, temp, Bitmap::EMultiChannel, 1.0f,
+				targetPtr + start * targetPixelSize, end - start, 1.0f,
+				Spectrum::EReflectance, targetChannels);
+		}
+
+		delete[] temp;
+	}
 }
 
 void Bitmap::convert(void *target, EPixelFormat pixelFormat,
@@ -3327,8 +3465,9 @@ void Bitmap::writeOpenEXR(Stream *stream) const {
 		 pixelFormat == EXYZA || pixelFormat == ESpectrumAlpha) && !explicitChannelNames)
 		frameBuffer.insert("A", Imf::Slice(compType, ptr, pixelStride, rowStride));
 
+	/* Compress blocks of scanlines using the OpenEXR thread pool */
 	EXROStream ostr(stream);
-	Imf::OutputFile file(ostr, header);
+	Imf::OutputFile file(ostr, header, Imf::globalThreadCount());
 	file.setFrameBuffer(frameBuffer);
 	file.writePixels(m_size.y);
 }
@@ -3916,6 +4055,14 @@ void Bitmap::staticInitialization() {
 	/* Initialize the Bitmap format conversion */
 	FormatConverter::staticInitialization();
 
+#if defined(MTS_HAS_AVX_KERNELS)
+	/* Use the widest kernels supported by the processor */
+	if (getSIMDLevel() >= ESIMDAVX) {
+		accumulateValues = accumulateValuesAVX;
+		scaleValues = scaleValuesAVX;
+	}
+#endif
+
 #if defined(MTS_HAS_FFTW)
 	/* Initialize FFTW if enabled */
 	fftw_init_threads();
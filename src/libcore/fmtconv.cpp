@@ -20,6 +20,7 @@
 #define BOOST_MPL_LIMIT_VECTOR_SIZE 40
 
 #include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/sse.h>
 #include <boost/mpl/vector.hpp>
 #include <boost/mpl/for_each.hpp>
 #include <boost/mpl/fold.hpp>
@@ -77,6 +78,37 @@ namespace detail {
 	template <> inline half safe_cast(double a) {
 		return static_cast<half>(static_cast<float>(a));
 	}
+
+	/* Bulk conversion of linear multi-channel data (no gamma or multiplier).
+	   Returns false when there is no specialized implementation */
+	template <typename S, typename D> inline bool convertLinear(const S *source, D *dest, size_t count) {
+		return false;
+	}
+
+	static void floatToHalfScalar(const float *source, half *dest, size_t count) {
+		for (size_t i=0; i<count; ++i)
+			dest[i] = half(source[i]);
+	}
+
+#if defined(MTS_HAS_AVX_KERNELS)
+	/* Only used when the processor supports F16C, see hasF16C() */
+	MTS_TARGET("avx,f16c") static void floatToHalfF16C(const float *source, half *dest, size_t count) {
+		size_t i = 0;
+		for (; i+8 <= count; i += 8)
+			_mm_storeu_si128((__m128i *) (dest + i),
+				_mm256_cvtps_ph(_mm256_loadu_ps(source + i), _MM_FROUND_TO_NEAREST_INT));
+		for (; i<count; ++i)
+			dest[i] = half(source[i]);
+	}
+#endif
+
+	/* Implementation selected in FormatConverter::staticInitialization() */
+	static void (*floatToHalf)(const float *, half *, size_t) = floatToHalfScalar;
+
+	template <> inline bool convertLinear(const float *source, half *dest, size_t count) {
+		floatToHalf(source, dest, count);
+		return true;
+	}
 }
 
 template <typename T> struct FormatConverterImpl : public FormatConverter {
@@ -1074,6 +1106,9 @@ template <typename T> struct FormatConverterImpl : public FormatConverter {
 				case Bitmap::EMultiChannel: {
 					switch (destFormat) {
 						case Bitmap::EMultiChannel:
+							if (sourceGamma == 1 && invDestGamma == 1 && multiplier == 1 &&
+								detail::convertLinear(source, dest, count*channelCount))
+								break;
 							for (size_t i=0; i<count*channelCount; ++i)
 								*dest++ = convertScalar<DestFormat>(*source++, sourceGamma, precomp, multiplier, invDestGamma);
 							break;
@@ -1206,6 +1241,11 @@ FormatConverter::ConverterMap FormatConverter::m_converters;
 
 void FormatConverter::staticInitialization() {
 	mpl::for_each<ConverterImplementations>(RegisterConverter(m_converters));
+
+#if defined(MTS_HAS_AVX_KERNELS)
+	if (hasF16C())
+		detail::floatToHalf = detail::floatToHalfF16C;
+#endif
 }
 
 void FormatConverter::staticShutdown() {
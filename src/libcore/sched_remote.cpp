@@ -19,11 +19,252 @@
 #include <mitsuba/core/sched_remote.h>
 #include <mitsuba/core/sstream.h>
 #include <mitsuba/core/mstream.h>
+#include <mitsuba/core/fstream.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/version.h>
 
 MTS_NAMESPACE_BEGIN
 
+/* ==================================================================== */
+/*                      Content-addressed resources                     */
+/* ==================================================================== */
+
+namespace {
+	inline uint64_t rotl64(uint64_t x, int r) {
+		return (x << r) | (x >> (64 - r));
+	}
+
+	inline uint64_t fmix64(uint64_t k) {
+		k ^= k >> 33;
+		k *= 0xff51afd7ed558ccdULL;
+		k ^= k >> 33;
+		k *= 0xc4ceb9fe1a85ec53ULL;
+		k ^= k >> 33;
+		return k;
+	}
+
+	/* Bounds and average size (a power of two) of the content-defined
+	   chunks that resources are split into before transmission */
+	const size_t resourceChunkMin = 64 * 1024;
+	const size_t resourceChunkAvg = 1024 * 1024;
+	const size_t resourceChunkMax = 8 * 1024 * 1024;
+
+	/// Part of a serialized resource, identified by the hash of its contents
+	struct ResourceChunk {
+		size_t offset, size;
+		ResourceHash hash;
+	};
+
+	/// Random table of the rolling hash that determines the chunk boundaries
+	struct GearTable {
+		uint64_t values[256];
+
+		GearTable() {
+			/* Fixed seed, so that all clients agree on the boundaries */
+			uint64_t state = 0x9E3779B97F4A7C15ULL;
+			for (int i=0; i<256; ++i) {
+				state += 0x9E3779B97F4A7C15ULL;
+				values[i] = fmix64(state);
+			}
+		}
+	};
+
+	const GearTable gearTable;
+
+	/**
+	 * Split a serialized resource into chunks whose boundaries only depend
+	 * on the preceding few dozen bytes (content-defined chunking using a gear
+	 * hash). Changing a small part of a resource, e.g. the output file name
+	 * or sensor of a scene, then only affects the chunks around it, and the
+	 * remaining ones (meshes, textures, ..) keep their hashes.
+	 */
+	void splitResource(const uint8_t *data, size_t size,
+			std::vector<ResourceChunk> &chunks) {
+		const uint64_t mask = (uint64_t) (resourceChunkAvg - 1) << 44;
+		size_t start = 0;
+
+		while (start < size) {
+			size_t end = std::min(size, start + resourceChunkMax),
+			       pos = std::min(end, start + resourceChunkMin);
+			uint64_t h = 0;
+			for (; pos < end; ++pos) {
+				h = (h << 1) + gearTable.values[data[pos]];
+				if ((h & mask) == 0) {
+					++pos;
+					break;
+				}
+			}
+
+			ResourceChunk chunk;
+			chunk.offset = start;
+			chunk.size = pos - start;
+			chunk.hash = ResourceHash::compute(data + start, chunk.size);
+			chunks.push_back(chunk);
+			start = pos;
+		}
+	}
+}
+
+ResourceHash ResourceHash::compute(const void *_data, size_t size) {
+	const uint8_t *data = static_cast<const uint8_t *>(_data);
+	const size_t nblocks = size / 16;
+	const uint64_t c1 = 0x87c37b91114253d5ULL, c2 = 0x4cf5ad432745937fULL;
+	uint64_t h1 = 0, h2 = 0;
+
+	for (size_t i=0; i<nblocks; ++i) {
+		uint64_t k1, k2;
+		memcpy(&k1, data + 16*i, sizeof(uint64_t));
+		memcpy(&k2, data + 16*i + 8, sizeof(uint64_t));
+
+		k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+		h1 = rotl64(h1, 27); h1 += h2; h1 = h1*5 + 0x52dce729;
+		k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		h2 = rotl64(h2, 31); h2 += h1; h2 = h2*5 + 0x38495ab5;
+	}
+
+	const uint8_t *tail = data + nblocks * 16;
+	uint64_t k1 = 0, k2 = 0;
+	switch (size & 15) {
+		case 15: k2 ^= ((uint64_t) tail[14]) << 48;
+		case 14: k2 ^= ((uint64_t) tail[13]) << 40;
+		case 13: k2 ^= ((uint64_t) tail[12]) << 32;
+		case 12: k2 ^= ((uint64_t) tail[11]) << 24;
+		case 11: k2 ^= ((uint64_t) tail[10]) << 16;
+		case 10: k2 ^= ((uint64_t) tail[ 9]) << 8;
+		case  9: k2 ^= ((uint64_t) tail[ 8]);
+			k2 *= c2; k2 = rotl64(k2, 33); k2 *= c1; h2 ^= k2;
+		case  8: k1 ^= ((uint64_t) tail[ 7]) << 56;
+		case  7: k1 ^= ((uint64_t) tail[ 6]) << 48;
+		case  6: k1 ^= ((uint64_t) tail[ 5]) << 40;
+		case  5: k1 ^= ((uint64_t) tail[ 4]) << 32;
+		case  4: k1 ^= ((uint64_t) tail[ 3]) << 24;
+		case  3: k1 ^= ((uint64_t) tail[ 2]) << 16;
+		case  2: k1 ^= ((uint64_t) tail[ 1]) << 8;
+		case  1: k1 ^= ((uint64_t) tail[ 0]);
+			k1 *= c1; k1 = rotl64(k1, 31); k1 *= c2; h1 ^= k1;
+	};
+
+	h1 ^= (uint64_t) size; h2 ^= (uint64_t) size;
+	h1 += h2; h2 += h1;
+	h1 = fmix64(h1); h2 = fmix64(h2);
+	h1 += h2; h2 += h1;
+
+	ResourceHash result;
+	result.h1 = h1;
+	result.h2 = h2;
+	return result;
+}
+
+std::string ResourceHash::toString() const {
+	return formatString("%016llx%016llx", (unsigned long long) h1,
+		(unsigned long long) h2);
+}
+
+ResourceCache::ResourceCache(size_t memoryLimit, const fs::path &directory)
+		: m_directory(directory), m_memoryLimit(memoryLimit),
+		  m_memoryUsage(0), m_timestamp(0) {
+	m_mutex = new Mutex();
+	if (!m_directory.empty() && !fs::exists(m_directory)) {
+		if (!fs::create_directories(m_directory))
+			Log(EError, "Unable to create the resource cache directory \"%s\"!",
+				m_directory.string().c_str());
+	}
+}
+
+ref<MemoryStream> ResourceCache::get(const ResourceHash &hash) {
+	LockGuard lock(m_mutex);
+	std::map<ResourceHash, Entry>::iterator it = m_entries.find(hash);
+	if (it != m_entries.end()) {
+		it->second.lastAccess = ++m_timestamp;
+		return it->second.data;
+	}
+
+	if (m_directory.empty())
+		return NULL;
+
+	fs::path filename = m_directory / (hash.toString() + ".res");
+	if (!fs::exists(filename))
+		return NULL;
+
+	ref<MemoryStream> data;
+	try {
+		ref<FileStream> fstream = new FileStream(filename, FileStream::EReadOnly);
+		size_t size = fstream->getSize();
+		data = new MemoryStream(size);
+		data->setByteOrder(Stream::ENetworkByteOrder);
+		fstream->copyTo(data, size);
+		fstream->close();
+	} catch (const std::exception &e) {
+		Log(EWarn, "Could not read the cached resource \"%s\": %s",
+			filename.string().c_str(), e.what());
+		return NULL;
+	}
+	insert(hash, data);
+	return data;
+}
+
+void ResourceCache::put(const ResourceHash &hash, MemoryStream *data) {
+	LockGuard lock(m_mutex);
+	if (m_entries.find(hash) != m_entries.end())
+		return;
+	insert(hash, data);
+
+	if (m_directory.empty())
+		return;
+
+	fs::path filename = m_directory / (hash.toString() + ".res");
+	if (fs::exists(filename))
+		return;
+
+	/* Write to a temporary file first, so that other server
+	   processes sharing the directory never see partial data */
+	fs::path tmpFilename = m_directory / (hash.toString() + ".tmp");
+	try {
+		ref<FileStream> fstream = new FileStream(tmpFilename, FileStream::ETruncWrite);
+		fstream->write(data->getData(), data->getSize());
+		fstream->close();
+		fs::rename(tmpFilename, filename);
+	} catch (const std::exception &e) {
+		Log(EWarn, "Could not write the cached resource \"%s\": %s",
+			filename.string().c_str(), e.what());
+	}
+}
+
+void ResourceCache::insert(const ResourceHash &hash, MemoryStream *data) {
+	Entry entry;
+	entry.data = data;
+	entry.lastAccess = ++m_timestamp;
+	m_entries[hash] = entry;
+	m_memoryUsage += data->getSize();
+
+	/* Evict the least recently used entries (but never the new one) */
+	while (m_memoryUsage > m_memoryLimit && m_entries.size() > 1) {
+		std::map<ResourceHash, Entry>::iterator victim = m_entries.end();
+		for (std::map<ResourceHash, Entry>::iterator it = m_entries.begin();
+				it != m_entries.end(); ++it) {
+			if (it->first == hash)
+				continue;
+			if (victim == m_entries.end() || it->second.lastAccess < victim->second.lastAccess)
+				victim = it;
+		}
+		Log(EDebug, "Evicting resource %s from the cache (%i KB)",
+			victim->first.toString().c_str(), (int) (victim->second.data->getSize() / 1024));
+		m_memoryUsage -= victim->second.data->getSize();
+		m_entries.erase(victim);
+	}
+}
+
+std::string ResourceCache::toString() const {
+	std::ostringstream oss;
+	oss << "ResourceCache[" << endl
+		<< "  entries = " << m_entries.size() << "," << endl
+		<< "  memoryUsage = " << memString(m_memoryUsage) << "," << endl
+		<< "  memoryLimit = " << memString(m_memoryLimit) << "," << endl
+		<< "  directory = \"" << m_directory.string() << "\"" << endl
+		<< "]";
+	return oss.str();
+}
+
 class CancelThread : public Thread {
 public:
 	CancelThread(ParallelProcess *proc) : Thread("cthr"), m_proc(proc) { }
@@ -66,6 +307,7 @@ RemoteWorker::RemoteWorker(const std::string &name, Stream *stream) : Worker(nam
 	m_reader = new RemoteWorkerReader(this);
 	m_reader->start();
 	m_inFlight = 0;
+	m_queryDone = false;
 	m_isRemote = true;
 	Log(EDebug, "Connection to \"%s\" established (%i cores).",
 		m_nodeName.c_str(), m_coreCount);
@@ -99,6 +341,27 @@ void RemoteWorker::flush() {
 	m_stream->flush();
 }
 
+std::vector<bool> RemoteWorker::queryResources(const std::vector<ResourceHash> &hashes,
+		const std::vector<size_t> &sizes) {
+	m_memStream->writeShort(StreamBackend::EQueryResources);
+	m_memStream->writeInt((int) hashes.size());
+	for (size_t i=0; i<hashes.size(); ++i) {
+		hashes[i].save(m_memStream);
+		m_memStream->writeSize(sizes[i]);
+	}
+	m_queryDone = false;
+	flush();
+
+	/* The answer is received by the reader thread */
+	while (!m_queryDone)
+		m_finishCond->wait();
+	m_queryDone = false;
+
+	if (m_queryResponse.size() != hashes.size())
+		Log(EError, "Received an invalid response to a resource query!");
+	return m_queryResponse;
+}
+
 void RemoteWorker::run() {
 	Scheduler::EStatus status;
 
@@ -161,30 +424,71 @@ void RemoteWorker::run() {
 			manager->serialize(m_memStream, m_schedItem.wp);
 			m_processes.insert(id);
 
-			for (size_t i=0; i<resources.size(); ++i) {
-				int resID = resources[i].first;
-				const MemoryStream *resStream = resources[i].second;
-				Log(EDebug, "Sending resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
-					resStream->getPos() / 1024);
-				m_memStream->writeShort(StreamBackend::ENewResource);
-				m_memStream->writeInt(resID);
-				m_memStream->writeSize(resStream->getPos());
-				m_memStream->write(resStream->getData(), resStream->getPos());
-			}
-
+			/* Serialize the multi resources and split all resources into
+			   chunks that are identified by the hash of their contents. Only
+			   chunks which are not yet cached on the remote side are
+			   transmitted in full. */
+			std::vector<ref<MemoryStream> > multiStreams;
 			for (size_t i=0; i<multiResources.size(); i += m_coreCount) {
-				int resID = multiResources[i].first;
 				ref<MemoryStream> resStream = new MemoryStream();
 				ref<InstanceManager> manager = new InstanceManager();
 				resStream->setByteOrder(Stream::ENetworkByteOrder);
 				for (size_t j=0; j<m_coreCount; ++j)
 					manager->serialize(resStream, multiResources[i+j].second);
-				Log(EDebug, "Sending multi resource %i to \"%s\" (%i KB)", resID, m_nodeName.c_str(),
-					resStream->getPos() / 1024);
-				m_memStream->writeShort(StreamBackend::ENewMultiResource);
+				multiStreams.push_back(resStream);
+			}
+
+			size_t resourceCount = resources.size() + multiStreams.size();
+			std::vector<std::vector<ResourceChunk> > chunks(resourceCount);
+			std::map<ResourceHash, size_t> chunkIndex;
+			std::vector<ResourceHash> hashes;
+			std::vector<size_t> sizes;
+			for (size_t i=0; i<resourceCount; ++i) {
+				bool multi = i >= resources.size();
+				const MemoryStream *resStream = multi ? multiStreams[i - resources.size()].get()
+					: resources[i].second;
+				splitResource(resStream->getData(), resStream->getPos(), chunks[i]);
+				for (size_t j=0; j<chunks[i].size(); ++j) {
+					const ResourceChunk &chunk = chunks[i][j];
+					if (chunkIndex.find(chunk.hash) != chunkIndex.end())
+						continue;
+					chunkIndex[chunk.hash] = hashes.size();
+					hashes.push_back(chunk.hash);
+					sizes.push_back(chunk.size);
+				}
+			}
+
+			std::vector<bool> cached;
+			if (!hashes.empty())
+				cached = queryResources(hashes, sizes);
+
+			for (size_t i=0; i<resourceCount; ++i) {
+				bool multi = i >= resources.size();
+				int resID = multi ? multiResources[(i - resources.size()) * m_coreCount].first
+					: resources[i].first;
+				const MemoryStream *resStream = multi ? multiStreams[i - resources.size()].get()
+					: resources[i].second;
+
+				size_t sent = 0;
+				m_memStream->writeShort(multi ? StreamBackend::ENewMultiResource
+					: StreamBackend::ENewResource);
 				m_memStream->writeInt(resID);
 				m_memStream->writeSize(resStream->getPos());
-				m_memStream->write(resStream->getData(), resStream->getPos());
+				m_memStream->writeInt((int) chunks[i].size());
+				for (size_t j=0; j<chunks[i].size(); ++j) {
+					const ResourceChunk &chunk = chunks[i][j];
+					bool isCached = cached[chunkIndex[chunk.hash]];
+					chunk.hash.save(m_memStream);
+					m_memStream->writeSize(chunk.size);
+					m_memStream->writeBool(isCached);
+					if (!isCached) {
+						m_memStream->write(resStream->getData() + chunk.offset, chunk.size);
+						sent += chunk.size;
+					}
+				}
+				Log(EDebug, "Sending %sresource %i to \"%s\" (%i of %i KB, the rest is cached)",
+					multi ? "multi " : "", resID, m_nodeName.c_str(), (int) (sent / 1024),
+					(int) (resStream->getPos() / 1024));
 			}
 
 			for (ParallelProcess::ResourceBindings::const_iterator it = bindings.begin();
@@ -272,6 +576,15 @@ void RemoteWorkerReader::run() {
 			msg = m_stream->readShort();
 			id = m_stream->readInt();
 
+			if (msg == StreamBackend::EResourceStatus) {
+				/* Response to a resource cache query ('id' holds the number of entries) */
+				std::vector<bool> cached(id);
+				for (int i=0; i<id; ++i)
+					cached[i] = m_stream->readBool();
+				m_parent->signalQueryResponse(cached);
+				continue;
+			}
+
 			if (id != m_currentID) {
 				m_parent->setProcessByID(m_schedItem, id);
 				m_currentID = id;
@@ -321,8 +634,9 @@ void RemoteWorkerReader::run() {
 /* ==================================================================== */
 
 StreamBackend::StreamBackend(const std::string &thrName, Scheduler *scheduler,
-		const std::string &nodeName, Stream *stream, bool detach) : Thread(thrName),
-		m_scheduler(scheduler), m_nodeName(nodeName), m_stream(stream), m_detach(detach) {
+		const std::string &nodeName, Stream *stream, bool detach, ResourceCache *cache)
+		: Thread(thrName), m_scheduler(scheduler), m_nodeName(nodeName), m_stream(stream),
+		  m_cache(cache), m_detach(detach) {
 	m_sendMutex = new Mutex();
 	m_memStream = new MemoryStream();
 	m_memStream->setByteOrder(Stream::ENetworkByteOrder);
@@ -388,31 +702,72 @@ void StreamBackend::run() {
 						m_processes[id] = rp;
 					}
 					break;
-				case ENewResource: {
-						int id = m_stream->readInt();
-						size_t size = m_stream->readSize();
-						ref<InstanceManager> manager = new InstanceManager();
-						ref<MemoryStream> mstream = new MemoryStream(size);
-						mstream->setByteOrder(Stream::ENetworkByteOrder);
-						m_stream->copyTo(mstream, size);
-						mstream->seek(0);
-						ref<SerializableObject> res = static_cast<SerializableObject *>(manager->getInstance(mstream));
-						m_resources[id] = m_scheduler->registerResource(res);
+				case EQueryResources: {
+						/* All chunks reported by the previous query were
+						   referenced by the resources that followed it */
+						m_pinned.clear();
+						int count = m_stream->readInt();
+						std::vector<bool> cached(count, false);
+						for (int i=0; i<count; ++i) {
+							ResourceHash hash;
+							hash.load(m_stream);
+							m_stream->readSize();
+							if (!m_cache)
+								continue;
+							ref<MemoryStream> data = m_cache->get(hash);
+							if (data) {
+								/* Keep the entry alive even if it is evicted in the meantime */
+								m_pinned[hash] = data;
+								cached[i] = true;
+							}
+						}
+
+						LockGuard lock(m_sendMutex);
+						m_memStream->reset();
+						m_memStream->writeShort(EResourceStatus);
+						m_memStream->writeInt(count);
+						for (int i=0; i<count; ++i)
+							m_memStream->writeBool(cached[i]);
+						m_memStream->seek(0);
+						m_memStream->copyTo(m_stream);
+						m_stream->flush();
 					}
 					break;
+				case ENewResource:
 				case ENewMultiResource: {
 						int id = m_stream->readInt();
 						size_t size = m_stream->readSize();
-						ref<InstanceManager> manager = new InstanceManager();
+						int chunkCount = m_stream->readInt();
 						ref<MemoryStream> mstream = new MemoryStream(size);
 						mstream->setByteOrder(Stream::ENetworkByteOrder);
-						m_stream->copyTo(mstream, size);
-						mstream->seek(0);
-						size_t coreCount = m_scheduler->getCoreCount();
-						std::vector<SerializableObject *> objects(coreCount);
-						for (size_t i=0; i<coreCount; ++i)
-							objects[i] = static_cast<SerializableObject *>(manager->getInstance(mstream));
-						m_resources[id] = m_scheduler->registerMultiResource(objects);
+						size_t reused = 0;
+						for (int i=0; i<chunkCount; ++i) {
+							ResourceHash hash;
+							hash.load(m_stream);
+							size_t chunkSize = m_stream->readSize();
+							if (m_stream->readBool()) {
+								std::map<ResourceHash, ref<MemoryStream> >::iterator it = m_pinned.find(hash);
+								if (it == m_pinned.end() || it->second->getSize() != chunkSize)
+									Log(EError, "Resource chunk %s is not present in the cache!",
+										hash.toString().c_str());
+								mstream->write(it->second->getData(), chunkSize);
+								reused += chunkSize;
+							} else {
+								ref<MemoryStream> chunk = new MemoryStream(chunkSize);
+								chunk->setByteOrder(Stream::ENetworkByteOrder);
+								m_stream->copyTo(chunk, chunkSize);
+								mstream->write(chunk->getData(), chunkSize);
+								if (m_cache)
+									m_cache->put(hash, chunk);
+							}
+						}
+						if (mstream->getSize() != size)
+							Log(EError, "Received an incomplete resource (" SIZE_T_FMT
+								" instead of " SIZE_T_FMT " bytes)!", mstream->getSize(), size);
+						if (reused > 0)
+							Log(EDebug, "Reused %i of %i KB of resource %i from the cache",
+								(int) (reused / 1024), (int) (size / 1024), id);
+						registerResource(id, mstream, msg == ENewMultiResource);
 					}
 					break;
 				case EEnsurePluginLoaded: {
@@ -494,6 +849,24 @@ void StreamBackend::run() {
 	}
 }
 
+void StreamBackend::registerResource(int id, MemoryStream *data, bool multi) {
+	/* Read through a separate stream so that cached data can be shared */
+	ref<MemoryStream> mstream = new MemoryStream(data->getData(), data->getSize());
+	mstream->setByteOrder(Stream::ENetworkByteOrder);
+	ref<InstanceManager> manager = new InstanceManager();
+
+	if (!multi) {
+		ref<SerializableObject> res = static_cast<SerializableObject *>(manager->getInstance(mstream));
+		m_resources[id] = m_scheduler->registerResource(res);
+	} else {
+		size_t coreCount = m_scheduler->getCoreCount();
+		std::vector<SerializableObject *> objects(coreCount);
+		for (size_t i=0; i<coreCount; ++i)
+			objects[i] = static_cast<SerializableObject *>(manager->getInstance(mstream));
+		m_resources[id] = m_scheduler->registerMultiResource(objects);
+	}
+}
+
 void StreamBackend::sendCancellation(int id, int numLost) {
 	Log(EInfo, "Notifying the remote side about the cancellation of process %i", id);
 
@@ -589,6 +962,7 @@ void RemoteProcess::handleCancellation() {
 	m_full.clear();
 }
 
+MTS_IMPLEMENT_CLASS(ResourceCache, false, Object)
 MTS_IMPLEMENT_CLASS(RemoteWorker, false, Worker)
 MTS_IMPLEMENT_CLASS(RemoteWorkerReader, false, Thread)
 MTS_IMPLEMENT_CLASS(StreamBackend, false, Thread)
@@ -77,6 +77,15 @@ __declspec(thread) int __thread_id;
 #endif
 static int __thread_id_ctr = -1;
 
+/* NUMA node of the calling thread. Kept in a plain thread-local variable
+   (rather than in the Thread instance), since the kd-tree traversal
+   queries it for every ray when replicas are present */
+#if defined(__WINDOWS__)
+__declspec(thread) int __numa_node = -1;
+#else
+__thread int __numa_node = -1;
+#endif
+
 /**
  * Internal Thread members
  */
@@ -89,6 +98,8 @@ struct Thread::ThreadPrivate {
 	bool running, joined;
 	Thread::EThreadPriority priority;
 	int coreAffinity;
+	int numaAffinity;
+	int numaNode;
 	static ThreadLocal<Thread> *self;
 	bool critical;
 	boost::thread thread;
@@ -99,7 +110,7 @@ struct Thread::ThreadPrivate {
 	ThreadPrivate(const std::string & name_) :
 		name(name_), running(false), joined(false),
 		priority(Thread::ENormalPriority), coreAffinity(-1),
-	    critical(false) { }
+		numaAffinity(-1), numaNode(-1), critical(false) { }
 };
 
 static std::vector<bool (*)(void)> __crashHandlers;
@@ -393,6 +404,9 @@ void Thread::setCoreAffinity(int coreID) {
 	}
 
 	CPU_FREE(cpuset);
+	d->numaNode = getNUMANodeOfProcessor(actualCoreID);
+	if (pthread_equal(pthread_self(), d->native_handle))
+		__numa_node = d->numaNode;
 #elif defined(__WINDOWS__)
 	int nCores = getCoreCount();
 	const HANDLE handle = d->thread.native_handle();
@@ -413,6 +427,51 @@ int Thread::getCoreAffinity() const {
 	return d->coreAffinity;
 }
 
+void Thread::setNUMANodeAffinity(int node) {
+	d->numaAffinity = node;
+	if (!d->running || node < 0)
+		return;
+
+#if defined(__LINUX__)
+	std::vector<int> processors = getNUMANodeProcessors(node);
+	if (processors.empty()) {
+		Log(EWarn, "Thread::setNUMANodeAffinity(): NUMA node %i does not exist!", node);
+		return;
+	}
+
+	int nProcessors = *std::max_element(processors.begin(), processors.end()) + 1;
+	size_t size = CPU_ALLOC_SIZE(nProcessors);
+	cpu_set_t *cpuset = CPU_ALLOC(nProcessors);
+	if (!cpuset) {
+		Log(EWarn, "Thread::setNUMANodeAffinity(): could not allocate cpu_set_t");
+		return;
+	}
+	CPU_ZERO_S(size, cpuset);
+	for (size_t i=0; i<processors.size(); ++i)
+		CPU_SET_S(processors[i], size, cpuset);
+
+	int retval = pthread_setaffinity_np(d->native_handle, size, cpuset);
+	CPU_FREE(cpuset);
+	if (retval) {
+		Log(EWarn, "Thread::setNUMANodeAffinity(): pthread_setaffinity_np: failed: %s", strerror(retval));
+		return;
+	}
+	d->numaNode = node;
+	if (pthread_equal(pthread_self(), d->native_handle))
+		__numa_node = node;
+#else
+	Log(EWarn, "Thread::setNUMANodeAffinity(): not supported on this platform");
+#endif
+}
+
+int Thread::getNUMANode() const {
+	return d->numaNode;
+}
+
+int getCurrentNUMANode() {
+	return __numa_node;
+}
+
 void Thread::dispatch(Thread *thread) {
 	detail::initializeLocalTLS();
 
@@ -453,6 +512,8 @@ void Thread::dispatch(Thread *thread) {
 
 	if (thread->getCoreAffinity() != -1)
 		thread->setCoreAffinity(thread->getCoreAffinity());
+	else if (thread->d->numaAffinity != -1)
+		thread->setNUMANodeAffinity(thread->d->numaAffinity);
 
 	try {
 		thread->run();
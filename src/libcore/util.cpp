@@ -22,7 +22,9 @@
 #include <mitsuba/core/quad.h>
 #include <mitsuba/core/sse.h>
 #include <mitsuba/core/frame.h>
+#include <mitsuba/core/thread.h>
 #include <boost/bind.hpp>
+#include <boost/algorithm/string.hpp>
 #include <stdarg.h>
 #include <iomanip>
 #include <errno.h>
@@ -34,10 +36,22 @@
 #include <windows.h>
 #include <direct.h>
 #include <psapi.h>
+#include <intrin.h>
 #else
 #include <malloc.h>
 #endif
 
+#if defined(__LINUX__)
+#include <sys/mman.h>
+#include <fstream>
+#endif
+
+#include <boost/thread/mutex.hpp>
+
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+#include <cpuid.h>
+#endif
+
 #if defined(__WINDOWS__)
 # include <windows.h>
 # include <winsock2.h>
@@ -144,6 +158,142 @@ void freeAligned(void *ptr) {
 #endif
 }
 
+/* Size of a transparent huge page on x86_64 */
+#define MTS_HUGE_PAGE_SIZE (2 * 1024 * 1024)
+
+void * __restrict allocHugeAligned(size_t size) {
+#if defined(__LINUX__)
+	if (size < MTS_HUGE_PAGE_SIZE)
+		return allocAligned(size);
+
+	void *ptr = NULL;
+	if (posix_memalign(&ptr, MTS_HUGE_PAGE_SIZE, size) != 0)
+		return NULL;
+#if defined(MADV_HUGEPAGE)
+	/* Only a hint -- fails silently when THP are disabled */
+	madvise(ptr, size, MADV_HUGEPAGE);
+#endif
+	return ptr;
+#else
+	return allocAligned(size);
+#endif
+}
+
+static std::vector<std::vector<int> > __numa_nodes;
+static std::vector<int> __numa_processor_node;
+static bool __numa_initialized = false;
+static bool __numa_replication = false;
+static boost::mutex __numa_mutex;
+
+#if defined(__LINUX__)
+/// Parse a Linux CPU list (e.g. "0-3,8-11")
+static std::vector<int> parseCPUList(const std::string &str) {
+	std::vector<int> result;
+	std::vector<std::string> ranges = tokenize(str, ", \n");
+	for (size_t i=0; i<ranges.size(); ++i) {
+		std::vector<std::string> bounds = tokenize(ranges[i], "-");
+		if (bounds.empty())
+			continue;
+		int start = atoi(bounds[0].c_str()),
+		    end = bounds.size() > 1 ? atoi(bounds[1].c_str()) : start;
+		for (int j=start; j<=end; ++j)
+			result.push_back(j);
+	}
+	return result;
+}
+#endif
+
+static void initializeNUMA() {
+	boost::mutex::scoped_lock lock(__numa_mutex);
+	if (__numa_initialized)
+		return;
+
+#if defined(__LINUX__)
+	/* Read the topology from sysfs, which avoids a dependency on libnuma */
+	for (int node=0; ; ++node) {
+		std::ifstream is(formatString("/sys/devices/system/node/node%i/cpulist", node).c_str());
+		if (is.fail())
+			break;
+		std::string line;
+		std::getline(is, line);
+		std::vector<int> processors = parseCPUList(line);
+		for (size_t i=0; i<processors.size(); ++i) {
+			if (processors[i] >= (int) __numa_processor_node.size())
+				__numa_processor_node.resize(processors[i] + 1, 0);
+			__numa_processor_node[processors[i]] = node;
+		}
+		__numa_nodes.push_back(processors);
+	}
+#endif
+
+	if (__numa_nodes.empty()) {
+		std::vector<int> processors;
+		int nCores = getCoreCount();
+		for (int i=0; i<nCores; ++i)
+			processors.push_back(i);
+		__numa_nodes.push_back(processors);
+	}
+	__numa_initialized = true;
+}
+
+int getNUMANodeCount() {
+	initializeNUMA();
+	return (int) __numa_nodes.size();
+}
+
+int getNUMANodeOfProcessor(int processor) {
+	initializeNUMA();
+	if (processor < 0 || processor >= (int) __numa_processor_node.size())
+		return 0;
+	return __numa_processor_node[processor];
+}
+
+std::vector<int> getNUMANodeProcessors(int node) {
+	initializeNUMA();
+	if (node < 0 || node >= (int) __numa_nodes.size())
+		return std::vector<int>();
+	return __numa_nodes[node];
+}
+
+/// Helper thread, which places a copy of a memory region on a NUMA node
+class NUMACopyThread : public Thread {
+public:
+	NUMACopyThread(const void *src, size_t size, int node)
+		: Thread(formatString("numa%i", node)), m_src(src), m_size(size), m_dest(NULL) {
+		setNUMANodeAffinity(node);
+	}
+
+	void run() {
+		m_dest = allocHugeAligned(m_size);
+		memcpy(m_dest, m_src, m_size);
+	}
+
+	inline void *getResult() { return m_dest; }
+protected:
+	virtual ~NUMACopyThread() { }
+private:
+	const void *m_src;
+	size_t m_size;
+	void *m_dest;
+};
+
+void *copyToNUMANode(const void *src, size_t size, int node) {
+	ref<NUMACopyThread> thread = new NUMACopyThread(src, size, node);
+	thread->start();
+	thread->join();
+	if (!thread->getResult())
+		SLog(EError, "copyToNUMANode(): out of memory!");
+	return thread->getResult();
+}
+
+void setNUMAReplication(bool enabled) {
+	__numa_replication = enabled;
+}
+
+bool getNUMAReplication() {
+	return __numa_replication;
+}
+
 static int __cached_core_count = 0;
 
 int getCoreCount() {
@@ -216,6 +366,98 @@ done:
 #endif
 }
 
+static int __cached_simd_level = -1;
+
+ESIMDLevel getSIMDLevel() {
+	// assumes atomic word size memory access
+	if (__cached_simd_level >= 0)
+		return (ESIMDLevel) __cached_simd_level;
+
+	ESIMDLevel level = ESIMDNone;
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	/* The AVX checks also verify that the OS saves the YMM/ZMM state */
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("sse2"))
+		level = ESIMDSSE2;
+	if (level == ESIMDSSE2 && __builtin_cpu_supports("sse4.2"))
+		level = ESIMDSSE42;
+	if (level == ESIMDSSE42 && __builtin_cpu_supports("avx"))
+		level = ESIMDAVX;
+	if (level == ESIMDAVX && __builtin_cpu_supports("avx2"))
+		level = ESIMDAVX2;
+	if (level == ESIMDAVX2 && __builtin_cpu_supports("avx512f"))
+		level = ESIMDAVX512;
+#elif defined(__MSVC__) && (defined(_M_IX86) || defined(_M_X64))
+	int info[4];
+	__cpuid(info, 0);
+	int maxLeaf = info[0];
+	__cpuid(info, 1);
+	bool osSavesYMM = false, osSavesZMM = false;
+	if ((info[2] & (1 << 27)) != 0) { // OSXSAVE
+		unsigned long long xcr0 = _xgetbv(0);
+		osSavesYMM = (xcr0 & 0x06) == 0x06;
+		osSavesZMM = (xcr0 & 0xE6) == 0xE6;
+	}
+	if (info[3] & (1 << 26))
+		level = ESIMDSSE2;
+	if (level == ESIMDSSE2 && (info[2] & (1 << 20)))
+		level = ESIMDSSE42;
+	if (level == ESIMDSSE42 && (info[2] & (1 << 28)) && osSavesYMM)
+		level = ESIMDAVX;
+	if (level == ESIMDAVX && maxLeaf >= 7) {
+		__cpuidex(info, 7, 0);
+		if (info[1] & (1 << 5))
+			level = ESIMDAVX2;
+		if (level == ESIMDAVX2 && (info[1] & (1 << 16)) && osSavesZMM)
+			level = ESIMDAVX512;
+	}
+#endif
+
+	const char *override = getenv("MTS_SIMD");
+	if (override) {
+		std::string name = boost::to_lower_copy(std::string(override));
+		for (int i=ESIMDNone; i<=ESIMDAVX512; ++i) {
+			if (name == getSIMDLevelName((ESIMDLevel) i)) {
+				if (i < (int) level)
+					level = (ESIMDLevel) i;
+				break;
+			}
+		}
+	}
+
+	__cached_simd_level = (int) level;
+	return level;
+}
+
+bool hasF16C() {
+	if (getSIMDLevel() < ESIMDAVX)
+		return false;
+#if defined(__GNUC__) && (defined(__i386__) || defined(__x86_64__))
+	unsigned int eax, ebx, ecx, edx;
+	if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx))
+		return false;
+	return (ecx & (1 << 29)) != 0;
+#elif defined(__MSVC__) && (defined(_M_IX86) || defined(_M_X64))
+	int info[4];
+	__cpuid(info, 1);
+	return (info[2] & (1 << 29)) != 0;
+#else
+	return false;
+#endif
+}
+
+const char *getSIMDLevelName(ESIMDLevel level) {
+	switch (level) {
+		case ESIMDNone: return "none";
+		case ESIMDSSE2: return "sse2";
+		case ESIMDSSE42: return "sse4.2";
+		case ESIMDAVX: return "avx";
+		case ESIMDAVX2: return "avx2";
+		case ESIMDAVX512: return "avx512";
+		default: return "unknown";
+	}
+}
+
 size_t getTotalSystemMemory() {
 #if defined(__WINDOWS__)
 	MEMORYSTATUSEX status;
@@ -60,10 +60,22 @@ void GLGeometry::refresh() {
 		memString(m_size[EVertexID] + m_size[EIndexID]).c_str());
 
 	GLfloat *vertices = new GLfloat[vertexCount * m_stride/sizeof(GLfloat)];
-	GLuint *indices = (GLuint *) m_mesh->getTriangles();
+	const GLuint *indices = (const GLuint *) m_mesh->getTriangles();
 	const Point *sourcePositions = m_mesh->getVertexPositions();
-	const Normal *sourceNormals = m_mesh->getVertexNormals();
-	const Point2 *sourceTexcoords = m_mesh->getVertexTexcoords();
+	bool hasNormals = m_mesh->hasVertexNormals(),
+	     hasTexcoords = m_mesh->hasVertexTexcoords();
+	GLuint *decodedIndices = NULL;
+
+	if (m_mesh->isCompact()) {
+		/* Compact meshes store compressed indices -- decode them for the upload */
+		decodedIndices = new GLuint[triCount * 3];
+		for (size_t i=0; i<triCount; ++i) {
+			Triangle tri = m_mesh->getTriangle(i);
+			for (int j=0; j<3; ++j)
+				decodedIndices[3*i+j] = tri.idx[j];
+		}
+		indices = decodedIndices;
+	}
 	const Color3 *sourceColors = m_mesh->getVertexColors();
 	Vector *sourceTangents = NULL;
 
@@ -75,7 +87,7 @@ void GLGeometry::refresh() {
 		memset(sourceTangents, 0, sizeof(Vector)*vertexCount);
 
 		for (size_t i=0; i<triCount; ++i) {
-			const Triangle &tri = m_mesh->getTriangles()[i];
+			const Triangle tri = m_mesh->getTriangle(i);
 			const TangentSpace &tangents = triTangents[i];
 			for (int j=0; j<3; ++j) {
 				sourceTangents[tri.idx[j]] += tangents.dpdu;
@@ -97,14 +109,16 @@ void GLGeometry::refresh() {
 		vertices[pos++] = (GLfloat) sourcePositions[i].x;
 		vertices[pos++] = (GLfloat) sourcePositions[i].y;
 		vertices[pos++] = (GLfloat) sourcePositions[i].z;
-		if (sourceNormals) {
-			vertices[pos++] = (GLfloat) sourceNormals[i].x;
-			vertices[pos++] = (GLfloat) sourceNormals[i].y;
-			vertices[pos++] = (GLfloat) sourceNormals[i].z;
+		if (hasNormals) {
+			Normal n = m_mesh->getVertexNormal(i);
+			vertices[pos++] = (GLfloat) n.x;
+			vertices[pos++] = (GLfloat) n.y;
+			vertices[pos++] = (GLfloat) n.z;
 		}
-		if (sourceTexcoords) {
-			vertices[pos++] = (GLfloat) sourceTexcoords[i].x;
-			vertices[pos++] = (GLfloat) sourceTexcoords[i].y;
+		if (hasTexcoords) {
+			Point2 uv = m_mesh->getVertexTexcoord(i);
+			vertices[pos++] = (GLfloat) uv.x;
+			vertices[pos++] = (GLfloat) uv.y;
 		}
 		if (sourceTangents) {
 			vertices[pos++] = (GLfloat) sourceTangents[i].x;
@@ -137,6 +151,8 @@ void GLGeometry::refresh() {
 	delete[] vertices;
 	if (sourceTangents)
 		delete[] sourceTangents;
+	if (decodedIndices)
+		delete[] decodedIndices;
 }
 
 void GLGeometry::bind() {
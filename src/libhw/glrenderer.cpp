@@ -288,6 +288,11 @@ void GLRenderer::drawMesh(const TriMesh *mesh) {
 		GLRenderer::drawMesh((*it).second);
 	} else {
 		/* This shape is not resident in GPU memory. Draw the slow way.. */
+		if (mesh->isCompact()) {
+			Log(EWarn, "Compact meshes must be uploaded to the GPU before "
+				"they can be drawn (\"%s\")", mesh->getName().c_str());
+			return;
+		}
 		const GLchar *positions = (const GLchar *) mesh->getVertexPositions();
 		const GLchar *normals = (const GLchar *) mesh->getVertexNormals();
 		const GLchar *texcoords = (const GLchar *) mesh->getVertexTexcoords();
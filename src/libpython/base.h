@@ -20,6 +20,8 @@
 #define __PYTHON_BASE_H
 
 #include <mitsuba/mitsuba.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/core/half.h>
 
 #if defined(_MSC_VER)
 #pragma warning(disable : 4244) // 'return' : conversion from 'Py_ssize_t' to 'unsigned int', possible loss of data
@@ -281,6 +283,244 @@ struct TrivialScopedLock {
 		.def("__getitem__", &Name::get) \
 		.def("__setitem__", &Name::set)
 
+/**
+ * \brief Exposes memory owned by a Mitsuba object (e.g. the storage of a
+ * \ref Bitmap or \ref ImageBlock) through the Python buffer protocol
+ *
+ * The buffer keeps its owner alive and can be wrapped without copying,
+ * e.g. using <tt>numpy.array(buffer, copy=False)</tt>. Views with
+ * non-contiguous strides are only handed out to consumers that
+ * request strided access (which includes NumPy).
+ */
+struct NativeBuffer {
+	mitsuba::ref<mitsuba::Object> owner;
+	void *ptr;
+	mitsuba::Bitmap::EComponentFormat format;
+	int ndim;
+	Py_ssize_t shape[4], strides[4];
+	Py_ssize_t itemSize, count;
+	bool contiguous;
+	const char* formatString;
+
+	/// Create a C-contiguous buffer with the given shape
+	NativeBuffer(mitsuba::Object *owner, void *ptr, mitsuba::Bitmap::EComponentFormat format,
+			int ndim, const Py_ssize_t *shape) : owner(owner), ptr(ptr), format(format), ndim(ndim) {
+		init(shape, NULL);
+	}
+
+	/// Create a buffer with the given shape and byte strides
+	NativeBuffer(mitsuba::Object *owner, void *ptr, mitsuba::Bitmap::EComponentFormat format,
+			int ndim, const Py_ssize_t *shape, const Py_ssize_t *strides)
+			: owner(owner), ptr(ptr), format(format), ndim(ndim) {
+		init(shape, strides);
+	}
+
+	/**
+	 * \brief Create a <tt>height x width x frames x channels</tt> view of
+	 * a region of a bitmap that stores a transient rendering
+	 *
+	 * For \ref Bitmap::EMultiSpectrumAlphaWeight (i.e. film and image block
+	 * storage), the view covers the spectral samples of each frame and skips
+	 * the trailing alpha and weight channels. Other bitmaps are split into
+	 * \c frames groups of channels; when <tt>frames <= 0</tt>, multi-channel
+	 * bitmaps are assumed to contain RGB frames if possible.
+	 */
+	static NativeBuffer transient(mitsuba::Object *owner, mitsuba::Bitmap *bitmap,
+			const mitsuba::Point2i &offset, const mitsuba::Vector2i &size, int frames) {
+		using namespace mitsuba;
+		int channelCount = bitmap->getChannelCount(), channels;
+		if (bitmap->getPixelFormat() == Bitmap::EMultiSpectrumAlphaWeight) {
+			frames = (channelCount - 2) / SPECTRUM_SAMPLES;
+			channels = SPECTRUM_SAMPLES;
+		} else {
+			if (frames <= 0)
+				frames = (bitmap->getPixelFormat() == Bitmap::EMultiChannel
+					&& channelCount % 3 == 0) ? channelCount / 3 : 1;
+			if (channelCount % frames != 0)
+				SLog(EError, "transientBuffer(): %i channels cannot be split into %i frames!",
+					channelCount, frames);
+			channels = channelCount / frames;
+		}
+
+		if (offset.x < 0 || offset.y < 0 || offset.x + size.x > bitmap->getWidth()
+				|| offset.y + size.y > bitmap->getHeight())
+			SLog(EError, "transientBuffer(): region is out of bounds!");
+
+		Py_ssize_t itemSize = (Py_ssize_t) bitmap->getBytesPerComponent();
+		Py_ssize_t shape[4] = { size.y, size.x, frames, channels };
+		Py_ssize_t strides[4] = {
+			(Py_ssize_t) bitmap->getWidth() * channelCount * itemSize,
+			channelCount * itemSize,
+			channels * itemSize,
+			itemSize
+		};
+		uint8_t *ptr = bitmap->getUInt8Data() +
+			(offset.y * strides[0] + offset.x * strides[1]);
+
+		return NativeBuffer(owner, ptr, bitmap->getComponentFormat(), 4, shape, strides);
+	}
+
+	void init(const Py_ssize_t *shape, const Py_ssize_t *strides) {
+		using namespace mitsuba;
+		switch (format) {
+			case Bitmap::EUInt8:   formatString = "B"; itemSize = 1; break;
+			case Bitmap::EUInt16:  formatString = "H"; itemSize = 2; break;
+			case Bitmap::EUInt32:  formatString = "I"; itemSize = 4; break;
+			case Bitmap::EFloat16: formatString = "e"; itemSize = 2; break;
+			case Bitmap::EFloat32: formatString = "f"; itemSize = 4; break;
+			case Bitmap::EFloat64: formatString = "d"; itemSize = 8; break;
+			default:
+				SLog(EError, "Unsupported bufer format!");
+		}
+		if (ndim < 1 || ndim > 4)
+			SLog(EError, "Unsupported number of buffer dimensions (%i)!", ndim);
+
+		Py_ssize_t stride = itemSize;
+		count = 1;
+		contiguous = true;
+		for (int i=ndim-1; i>=0; --i) {
+			this->shape[i] = shape[i];
+			this->strides[i] = strides ? strides[i] : stride;
+			contiguous &= this->strides[i] == stride;
+			stride *= shape[i];
+			count *= shape[i];
+		}
+	}
+
+	/// Return the address of the element with the given (C-order) linear index
+	void *address(Py_ssize_t idx) const {
+		uint8_t *result = (uint8_t *) ptr;
+		for (int i=ndim-1; i>=0; --i) {
+			result += (idx % shape[i]) * strides[i];
+			idx /= shape[i];
+		}
+		return result;
+	}
+
+	std::string toString() const {
+		std::ostringstream oss;
+		oss << "NativeBuffer[ndim=" << ndim << ", shape=[";
+		for (int i=0; i<ndim; ++i) {
+			oss << shape[i];
+			if (i+1 < ndim)
+				oss << ", ";
+		}
+		oss << "], strides=[";
+		for (int i=0; i<ndim; ++i) {
+			oss << strides[i];
+			if (i+1 < ndim)
+				oss << ", ";
+		}
+		oss << "], format=" << format << ", size=" << mitsuba::memString(count * itemSize) << "]";
+		return oss.str();
+	}
+
+	static int getbuffer(PyObject *obj, Py_buffer *view, int flags) {
+		bp::extract<NativeBuffer&> b(obj);
+		if (!b.check()) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer is invalid!");
+			view->obj = NULL;
+			return -1;
+		}
+		NativeBuffer &buf = b();
+
+		if (!buf.ptr) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer does not point anywhere!");
+			view->obj = NULL;
+			return -1;
+		}
+
+		if (view == NULL)
+			return 0;
+
+		if (!buf.contiguous && (flags & PyBUF_STRIDES) != PyBUF_STRIDES) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer is not contiguous, "
+				"the consumer must support strides!");
+			view->obj = NULL;
+			return -1;
+		}
+
+		view->obj = obj;
+		if (view->obj)
+			Py_INCREF(view->obj);
+		buf.owner->incRef();
+
+		view->ndim = 1;
+		view->buf = buf.ptr;
+		view->format = NULL;
+		view->shape = NULL;
+		view->suboffsets = NULL;
+		view->internal = NULL;
+		view->strides = NULL;
+		view->len = buf.count * buf.itemSize;
+		view->readonly = false;
+		view->itemsize = buf.itemSize;
+
+		if ((flags & PyBUF_FORMAT) == PyBUF_FORMAT)
+			view->format = const_cast<char *>(buf.formatString);
+
+		if ((flags & PyBUF_STRIDES) == PyBUF_STRIDES)
+			view->strides = &buf.strides[0];
+
+		if ((flags & PyBUF_ND) == PyBUF_ND) {
+			view->ndim = buf.ndim;
+			view->shape = &buf.shape[0];
+		}
+
+		return 0;
+	}
+
+	static void releasebuffer(PyObject *obj, Py_buffer *view) {
+		bp::extract<NativeBuffer&> b(obj);
+		if (!b.check()) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer is invalid!");
+			return;
+		}
+		NativeBuffer &buf = b();
+		buf.owner->decRef();
+	}
+
+	static Py_ssize_t len(PyObject *obj) {
+		bp::extract<NativeBuffer&> b(obj);
+		if (!b.check()) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer is invalid!");
+			return -1;
+		}
+		NativeBuffer &buf = b();
+		return buf.count;
+	}
+
+	static PyObject* item(PyObject *obj, Py_ssize_t idx) {
+		using namespace mitsuba;
+		bp::extract<NativeBuffer&> b(obj);
+		if (!b.check()) {
+			PyErr_SetString(PyExc_BufferError, "Native buffer is invalid!");
+			return 0;
+		}
+		NativeBuffer &buf = b();
+		if (idx < 0 || idx >= buf.count) {
+			PyErr_SetString(PyExc_IndexError, "Native buffer index out of range!");
+			return 0;
+		}
+		void *ptr = buf.address(idx);
+
+		bp::object result;
+		switch (buf.format) {
+			case Bitmap::EUInt8:   result = bp::object(*((uint8_t *) ptr)); break;
+			case Bitmap::EUInt16:  result = bp::object(*((uint16_t *) ptr)); break;
+			case Bitmap::EUInt32:  result = bp::object(*((uint32_t *) ptr)); break;
+			case Bitmap::EFloat16: result = bp::object((float) *((half *) ptr)); break;
+			case Bitmap::EFloat32: result = bp::object(*((float *) ptr)); break;
+			case Bitmap::EFloat64: result = bp::object(*((double *) ptr)); break;
+			default:
+				PyErr_SetString(PyExc_BufferError, "Unsupported buffer format!");
+				return 0;
+		}
+
+		return bp::incref(result.ptr());
+	}
+};
+
 
 namespace mitsuba {
 	class SerializableObject;
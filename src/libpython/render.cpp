@@ -4,6 +4,7 @@
 #include <mitsuba/render/renderqueue.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/noise.h>
+#include <mitsuba/render/sparsehist.h>
 #include "../shapes/instance.h"
 
 using namespace mitsuba;
@@ -187,8 +188,16 @@ typedef InternalArray<Point2>       InternalPoint2Array;
 typedef InternalArray<Color3>       InternalColor3Array;
 typedef InternalArray<TangentSpace> InternalTangentSpaceArray;
 
+/* Compact meshes don't store the raw arrays; refuse to wrap NULL pointers */
+static void trimesh_checkNotCompact(const TriMesh *triMesh, const char *name) {
+	if (triMesh->isCompact())
+		SLog(EError, "TriMesh::%s(): the mesh \"%s\" is stored in compact form, "
+			"which does not support direct array access!", name, triMesh->getName().c_str());
+}
+
 static InternalUInt32Array trimesh_getTriangles(TriMesh *triMesh) {
 	BOOST_STATIC_ASSERT(sizeof(Triangle) == 3*sizeof(uint32_t));
+	trimesh_checkNotCompact(triMesh, "getTriangles");
 	return InternalUInt32Array(triMesh, (uint32_t *) triMesh->getTriangles(), triMesh->getTriangleCount()*3);
 }
 
@@ -197,10 +206,12 @@ static InternalPoint3Array trimesh_getVertexPositions(TriMesh *triMesh) {
 }
 
 static InternalNormalArray trimesh_getVertexNormals(TriMesh *triMesh) {
+	trimesh_checkNotCompact(triMesh, "getVertexNormals");
 	return InternalNormalArray(triMesh, triMesh->getVertexNormals(), triMesh->getVertexCount());
 }
 
 static InternalPoint2Array trimesh_getVertexTexcoords(TriMesh *triMesh) {
+	trimesh_checkNotCompact(triMesh, "getVertexTexcoords");
 	return InternalPoint2Array(triMesh, triMesh->getVertexTexcoords(), triMesh->getVertexCount());
 }
 
@@ -277,6 +288,101 @@ static void renderQueue_waitLeft(RenderQueue *queue, size_t count) {
 	queue->waitLeft(count);
 }
 
+static NativeBuffer imageBlock_buffer(ImageBlock *block) {
+	/* Expose the interior of the block (without the border region) */
+	Bitmap *bitmap = block->getBitmap();
+	int borderSize = block->getBorderSize();
+	Py_ssize_t itemSize = (Py_ssize_t) bitmap->getBytesPerComponent(),
+	           channels = (Py_ssize_t) bitmap->getChannelCount();
+	Py_ssize_t shape[3] = { block->getHeight(), block->getWidth(), channels };
+	Py_ssize_t strides[3] = { bitmap->getWidth() * channels * itemSize, channels * itemSize, itemSize };
+	uint8_t *ptr = bitmap->getUInt8Data() + borderSize * (strides[0] + strides[1]);
+
+	return NativeBuffer(block, ptr, bitmap->getComponentFormat(), 3, shape, strides);
+}
+
+static NativeBuffer imageBlock_transientBuffer(ImageBlock *block) {
+	int borderSize = block->getBorderSize();
+	return NativeBuffer::transient(block, block->getBitmap(),
+		Point2i(borderSize, borderSize), block->getSize(), -1);
+}
+
+static ref<Bitmap> film_developBitmap(Film *film) {
+	ref<Bitmap> bitmap = film->developBitmap();
+	if (!bitmap)
+		SLog(EError, "The film \"%s\" cannot be developed into memory!",
+			film->getClass()->getName().c_str());
+	return bitmap;
+}
+
+static NativeBuffer film_developTransient(Film *film) {
+	ref<Bitmap> bitmap = film_developBitmap(film);
+	return NativeBuffer::transient(bitmap, bitmap, Point2i(0, 0),
+		bitmap->getSize(), (int) film->getFrames());
+}
+
+/* Views of the CSR arrays of a sparse histogram (see fileFormat=sparse of hdrfilm) */
+static NativeBuffer sparseHistogram_offsets(SparseHistogram *hist) {
+	Py_ssize_t shape[1] = { (Py_ssize_t) hist->getOffsets().size() };
+	return NativeBuffer(hist, hist->getOffsetData(), Bitmap::EUInt32, 1, shape);
+}
+
+static NativeBuffer sparseHistogram_binIndices(SparseHistogram *hist) {
+	Py_ssize_t shape[1] = { (Py_ssize_t) hist->getNonZeroCount() };
+	return NativeBuffer(hist, hist->getBinIndexData(), Bitmap::EUInt32, 1, shape);
+}
+
+static NativeBuffer sparseHistogram_values(SparseHistogram *hist) {
+	Py_ssize_t shape[2] = { (Py_ssize_t) hist->getNonZeroCount(), 3 };
+	return NativeBuffer(hist, hist->getValueData(), Bitmap::EFloat32, 2, shape);
+}
+
+/**
+ * Render the scene on the current scheduler and return the developed film
+ * as a <tt>height x width x frames x channels</tt> buffer (without writing
+ * it to disk unless the scene has a destination file)
+ */
+static NativeBuffer scene_renderTransient(Scene *scene) {
+	ref<RenderQueue> queue = new RenderQueue();
+	ref<RenderJob> job = new RenderJob("pyrender", scene, queue, -1, -1, -1, false);
+	bool success;
+	{
+		ReleaseGIL gil;
+		job->start();
+		queue->waitLeft(0);
+		success = job->wait();
+	}
+	queue->join();
+	if (!success)
+		SLog(EError, "Rendering of the scene did not complete successfully!");
+	return film_developTransient(scene->getFilm());
+}
+
+/**
+ * Replace the film of the active sensor by a new instance, whose properties
+ * are those of the current film merged with \c props. This allows changing
+ * the decomposition (e.g. \c minBound, \c maxBound, \c binWidth) and the
+ * modulation settings between renderings of an already loaded scene. The
+ * reconstruction filter and the sampler are kept.
+ */
+static void scene_setFilmProperties(Scene *scene, const Properties &props) {
+	Sensor *sensor = scene->getSensor();
+	Film *oldFilm = sensor->getFilm();
+
+	Properties merged(oldFilm->getProperties());
+	merged.merge(props);
+
+	ref<Film> film = static_cast<Film *> (PluginManager::getInstance()->
+		createObject(MTS_CLASS(Film), merged));
+	film->addChild(oldFilm->getReconstructionFilter());
+	film->configure();
+
+	/* Recompute the sensor's resolution-dependent state. The sampler
+	   was already configured by the integrator and is left untouched */
+	sensor->addChild(film);
+	sensor->configure();
+}
+
 static void scene_cancel(Scene *scene) {
 	ReleaseGIL gil;
 	scene->cancel();
@@ -363,6 +469,8 @@ void export_render() {
 		.def("invalidate", &Scene::invalidate)
 		.def("preprocess", &Scene::preprocess)
 		.def("render", &Scene::render)
+		.def("renderTransient", scene_renderTransient)
+		.def("setFilmProperties", scene_setFilmProperties)
 		.def("postprocess", &Scene::postprocess)
 		.def("flush", &Scene::flush)
 		.def("cancel", scene_cancel)
@@ -574,6 +682,8 @@ void export_render() {
 		.def("computeUVTangents", &TriMesh::computeUVTangents)
 		.def("computeNormals", &TriMesh::computeNormals)
 		.def("rebuildTopology", &TriMesh::rebuildTopology)
+		.def("compact", &TriMesh::compact)
+		.def("isCompact", &TriMesh::isCompact)
 		.def("serialize", triMesh_serialize1)
 		.def("serialize", triMesh_serialize2)
 		.def("writeOBJ", &TriMesh::writeOBJ)
@@ -672,6 +782,9 @@ void export_render() {
 		.def("destinationExists", &Film::destinationExists)
 		.def("hasHighQualityEdges", &Film::hasHighQualityEdges)
 		.def("hasAlpha", &Film::hasAlpha)
+		.def("developBitmap", film_developBitmap)
+		.def("developTransient", film_developTransient)
+		.def("getFrames", &Film::getFrames)
 		.def("getReconstructionFilter", film_getreconstructionfilter, BP_RETURN_VALUE);
 
 	void (ProjectiveCamera::*projectiveCamera_setWorldTransform1)(const Transform &) = &ProjectiveCamera::setWorldTransform;
@@ -807,7 +920,27 @@ void export_render() {
 		.def("put", imageBlock_put1)
 		.def("put", imageBlock_put2)
 		.def("clone", &ImageBlock::clone, BP_RETURN_VALUE)
-		.def("copyTo", &ImageBlock::copyTo);
+		.def("copyTo", &ImageBlock::copyTo)
+		.def("buffer", imageBlock_buffer)
+		.def("transientBuffer", imageBlock_transientBuffer);
+
+	void (SparseHistogram::*sparseHistogram_write1)(Stream *) const = &SparseHistogram::write;
+	void (SparseHistogram::*sparseHistogram_write2)(const fs::path &) const = &SparseHistogram::write;
+
+	BP_CLASS(SparseHistogram, Object, bp::init<Stream *>())
+		.def(bp::init<fs::path>())
+		.def(bp::init<const Bitmap *, Float, Float>())
+		.def("write", sparseHistogram_write1)
+		.def("write", sparseHistogram_write2)
+		.def("toBitmap", &SparseHistogram::toBitmap)
+		.def("getSize", &SparseHistogram::getSize, BP_RETURN_VALUE)
+		.def("getBinCount", &SparseHistogram::getBinCount)
+		.def("getMinBound", &SparseHistogram::getMinBound)
+		.def("getBinWidth", &SparseHistogram::getBinWidth)
+		.def("getNonZeroCount", &SparseHistogram::getNonZeroCount)
+		.def("offsets", sparseHistogram_offsets)
+		.def("binIndices", sparseHistogram_binIndices)
+		.def("values", sparseHistogram_values);
 
 	BP_CLASS(RectangularWorkUnit, WorkUnit, bp::init<>())
 		.def("getOffset", &RectangularWorkUnit::getOffset, BP_RETURN_VALUE)
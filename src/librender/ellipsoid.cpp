@@ -1,5 +1,6 @@
 #include <mitsuba/render/ellipsoid.h>
 #include <mitsuba/core/aabb.h>
+#include <mitsuba/core/sse.h>
 //#include <boost/dynamic_bitset.hpp>
 
 using boost::math::policies::policy;
@@ -22,6 +23,36 @@ typedef policy<digits10<10> > my_pol_10;
 
 MTS_NAMESPACE_BEGIN
 
+#if defined(MTS_HAS_AVX_KERNELS)
+/// AVX version of the corner test in isBoxInsideEllipsoid() (four corners at a time)
+MTS_TARGET("avx") static bool isBoxInsideUnitSphereAVX(const FLOAT m[4][4], const AABB &aabb) {
+	const __m256d x = _mm256_set_pd(aabb.max.x, aabb.min.x, aabb.max.x, aabb.min.x),
+	              y = _mm256_set_pd(aabb.max.y, aabb.max.y, aabb.min.y, aabb.min.y),
+	              threshold = _mm256_set1_pd(1 - Eps);
+
+	for (int i=0; i<2; ++i) {
+		const __m256d z = _mm256_set1_pd(i == 0 ? aabb.min.z : aabb.max.z);
+		__m256d p[4];
+		for (int j=0; j<4; ++j)
+			p[j] = _mm256_add_pd(
+				_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(m[j][0]), x),
+				              _mm256_mul_pd(_mm256_set1_pd(m[j][1]), y)),
+				_mm256_add_pd(_mm256_mul_pd(_mm256_set1_pd(m[j][2]), z),
+				              _mm256_set1_pd(m[j][3])));
+		for (int j=0; j<3; ++j)
+			p[j] = _mm256_div_pd(p[j], p[3]);
+
+		__m256d lengthSquared = _mm256_add_pd(_mm256_mul_pd(p[0], p[0]),
+			_mm256_add_pd(_mm256_mul_pd(p[1], p[1]), _mm256_mul_pd(p[2], p[2])));
+		if (_mm256_movemask_pd(_mm256_cmp_pd(lengthSquared, threshold, _CMP_GT_OQ)))
+			return false;
+	}
+	return true;
+}
+
+static const bool __use_avx_ellipsoid = getSIMDLevel() >= ESIMDAVX;
+#endif
+
 template <typename PointType, typename LengthType>
 bool TEllipsoid<PointType, LengthType>::isBoxValid(const AABB& aabb) const{
 	if(!isBoxCuttingEllipsoid(aabb)){
@@ -38,6 +69,10 @@ bool TEllipsoid<PointType, LengthType>::isBoxValid(const AABB& aabb) const{
 
 template <typename PointType, typename LengthType>
 bool TEllipsoid<PointType, LengthType>::isBoxInsideEllipsoid(const AABB& aabb) const{
+#if defined(MTS_HAS_AVX_KERNELS)
+	if (__use_avx_ellipsoid)
+		return isBoxInsideUnitSphereAVX(m_T3D2Sphere.getMatrix().m, aabb);
+#endif
 	for(size_t i = 0; i < 8; i++){
 		const Point& temp = aabb.getCorner(i);
 		PointType Pt(temp[0], temp[1], temp[2]);
@@ -200,7 +200,8 @@ ref<Bitmap> Emitter::getBitmap(const Vector2i &sizeHint) const {
            reuse cache files that have been created previously */
 		cacheFile = m_filename;
 		cacheFile.replace_extension(".mip");
-		tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true);
+		tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true)
+			&& !TileCache::getInstance()->isEnabled();
 
 		/* These are reasonable MIP map defaults for environment maps, I don't
        think there is a need to expose them through plugin parameters */
@@ -18,6 +18,8 @@
 
 #include <mitsuba/render/film.h>
 #include <mitsuba/core/plugin.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/fstream.h>
 #include <boost/algorithm/string.hpp>
 #include <boost/math/distributions/normal.hpp>
 
@@ -106,6 +108,41 @@ Film::Film(const Properties &props)
 	m_sBounces  	= props.getInteger("sBounce", 0);
 	m_tBounces 		= props.getInteger("tBounce", 0);
 
+	/* Region of interest for incremental re-rendering: only pixels with a
+	   nonzero value in the mask and the time bins [roiMinBin, roiMaxBin]
+	   receive new samples */
+	m_roiMinBin = props.getInteger("roiMinBin", 0);
+	m_roiMaxBin = props.getInteger("roiMaxBin", (int) m_frames - 1);
+	if (m_roiMinBin < 0 || m_roiMaxBin >= (int) m_frames || m_roiMinBin > m_roiMaxBin)
+		Log(EError, "Invalid region of interest bin range [%i, %i] (the film has " SIZE_T_FMT " bins)!",
+			m_roiMinBin, m_roiMaxBin, m_frames);
+
+	m_roiPixelCount = (size_t) m_cropSize.x * (size_t) m_cropSize.y;
+	if (props.hasProperty("roiMask")) {
+		fs::path filename = Thread::getThread()->getFileResolver()->resolve(
+			props.getString("roiMask"));
+		Log(EInfo, "Loading region of interest mask \"%s\" ..", filename.string().c_str());
+		ref<FileStream> fs = new FileStream(filename, FileStream::EReadOnly);
+		ref<Bitmap> mask = new Bitmap(Bitmap::EAuto, fs);
+		if (mask->getSize() != m_cropSize)
+			Log(EError, "The region of interest mask must have the size of the crop window (%s)!",
+				m_cropSize.toString().c_str());
+		mask = mask->convert(Bitmap::ELuminance, Bitmap::EFloat32);
+
+		m_roiMask = new Bitmap(Bitmap::ELuminance, Bitmap::EUInt8, m_cropSize);
+		size_t nPixels = (size_t) m_cropSize.x * (size_t) m_cropSize.y, count = 0;
+		const float *source = mask->getFloat32Data();
+		uint8_t *target = m_roiMask->getUInt8Data();
+		for (size_t i=0; i<nPixels; ++i) {
+			target[i] = source[i] != 0 ? 1 : 0;
+			count += target[i];
+		}
+		if (count == 0)
+			Log(EError, "The region of interest mask does not select any pixels!");
+		Log(EInfo, "Region of interest: " SIZE_T_FMT " of " SIZE_T_FMT " pixels, bins %i to %i",
+			count, nPixels, m_roiMinBin, m_roiMaxBin);
+		m_roiPixelCount = count;
+	}
 }
 
 Film::Film(Stream *stream, InstanceManager *manager)
@@ -124,12 +161,23 @@ Film::Film(Stream *stream, InstanceManager *manager)
 	m_forceBounces = stream->readBool();
 	m_sBounces = stream->readUInt();
 	m_tBounces = stream->readUInt();
+	m_roiMinBin = stream->readInt();
+	m_roiMaxBin = stream->readInt();
+	m_roiPixelCount = stream->readSize();
+	if (stream->readBool()) {
+		m_roiMask = new Bitmap(Bitmap::ELuminance, Bitmap::EUInt8, m_cropSize);
+		stream->read(m_roiMask->getUInt8Data(), m_roiMask->getBufferSize());
+	}
 	m_filter = static_cast<ReconstructionFilter *>(manager->getInstance(stream));
 	m_pathLengthSampler = static_cast<PathLengthSampler *>(manager->getInstance(stream));
 }
 
 Film::~Film() { }
 
+ref<Bitmap> Film::developBitmap() const {
+	return NULL;
+}
+
 void Film::serialize(Stream *stream, InstanceManager *manager) const {
 	ConfigurableObject::serialize(stream, manager);
 	m_size.serialize(stream);
@@ -146,6 +194,12 @@ void Film::serialize(Stream *stream, InstanceManager *manager) const {
 	stream->writeBool(m_forceBounces);
 	stream->writeUInt(m_sBounces);
 	stream->writeUInt(m_tBounces);
+	stream->writeInt(m_roiMinBin);
+	stream->writeInt(m_roiMaxBin);
+	stream->writeSize(m_roiPixelCount);
+	stream->writeBool(m_roiMask.get() != NULL);
+	if (m_roiMask.get())
+		stream->write(m_roiMask->getUInt8Data(), m_roiMask->getBufferSize());
 	manager->serialize(stream, m_filter.get());
 	manager->serialize(stream, m_pathLengthSampler.get());
 }
@@ -42,6 +42,43 @@ ImageBlock::~ImageBlock() {
 		delete[] m_weightsX;
 }
 
+#if defined(MTS_HAS_AVX_KERNELS)
+/// AVX version of ImageBlock::splat()
+MTS_TARGET("avx") static void splatAVX(Float *dest, const Float *value, Float weight, int channels) {
+	int k = 0;
+	const __m256 weight8 = _mm256_set1_ps(weight);
+	for (; k+8 <= channels; k += 8)
+		_mm256_storeu_ps(dest + k, _mm256_add_ps(_mm256_loadu_ps(dest + k),
+			_mm256_mul_ps(weight8, _mm256_loadu_ps(value + k))));
+	for (; k<channels; ++k)
+		dest[k] += weight * value[k];
+}
+
+static const bool __use_avx_splat = getSIMDLevel() >= ESIMDAVX;
+#endif
+
+void ImageBlock::rasterizeWide(const Point2i &min, const Point2i &max,
+		const Float *value, int channels) {
+#if defined(MTS_HAS_AVX_KERNELS)
+	if (__use_avx_splat) {
+		const size_t width = (size_t) m_bitmap->getWidth();
+
+		for (int y=min.y, yr=0; y<=max.y; ++y, ++yr) {
+			const Float weightY = m_weightsY[yr];
+			Float *dest = m_bitmap->getFloatData()
+				+ (y * width + min.x) * channels;
+
+			for (int xr=0; xr<=max.x-min.x; ++xr) {
+				splatAVX(dest, value, m_weightsX[xr] * weightY, channels);
+				dest += channels;
+			}
+		}
+		return;
+	}
+#endif
+	rasterize<0>(min, max, value, channels);
+}
+
 void ImageBlock::load(Stream *stream) {
 	m_offset = Point2i(stream);
 	m_size = Vector2i(stream);
@@ -239,16 +239,10 @@ IrradianceCache::IrradianceCache(Stream *stream, InstanceManager *manager) :
 	m_clampNeighbor = stream->readBool();
 	m_useGradients = stream->readBool();
 	size_t recordCount = stream->readSize();
-	m_records.reserve(recordCount);
-	for (size_t i=0; i<recordCount; ++i) {
-		Record *sample = new Record(stream);
-		Float validRadius = sample->R0 / (2*m_kappa);
-		m_octree.insert(sample, AABB(
-			sample->p-Vector(1,1,1)*validRadius,
-			sample->p+Vector(1,1,1)*validRadius
-		));
-		m_records.push_back(sample);
-	}
+	std::vector<Record *> records(recordCount);
+	for (size_t i=0; i<recordCount; ++i)
+		records[i] = new Record(stream);
+	insert(records);
 }
 
 IrradianceCache::~IrradianceCache() {
@@ -352,6 +346,22 @@ void IrradianceCache::insert(Record *record) {
 	m_records.push_back(record);
 }
 
+void IrradianceCache::insert(const std::vector<Record *> &records) {
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic, 256)
+#endif
+	for (int i=0; i<(int) records.size(); ++i) {
+		Record *record = records[i];
+		Float validRadius = record->R0 / (2*m_kappa);
+		m_octree.insert(record, AABB(
+			record->p-Vector(1,1,1)*validRadius,
+			record->p+Vector(1,1,1)*validRadius
+		));
+	}
+	LockGuard lock(m_mutex);
+	m_records.insert(m_records.end(), records.begin(), records.end());
+}
+
 static StatsCounter irradHits("Irradiance cache", "Hits");
 static StatsCounter irradMisses("Irradiance cache", "Misses");
 
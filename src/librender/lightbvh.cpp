@@ -0,0 +1,430 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/lightbvh.h>
+#include <mitsuba/render/trimesh.h>
+#include <mitsuba/core/timer.h>
+
+MTS_NAMESPACE_BEGIN
+
+/* Below this depth, nodes are split at the midpoint of their centroid
+   bounds. Deeper nodes use median splits, which keeps the bit trails of
+   all emitters within 64 bits. */
+#define LIGHTBVH_MAX_MIDPOINT_DEPTH 32
+
+/* Number of stratified samples used to estimate the power of an emitter */
+#define LIGHTBVH_POWER_SAMPLES 4
+
+namespace {
+	/// Order build items by the given coordinate of their centroid
+	struct CentroidOrder {
+		int axis;
+		inline CentroidOrder(int axis) : axis(axis) { }
+		template <typename T> inline bool operator()(const T &a, const T &b) const {
+			return a.centroid[axis] < b.centroid[axis];
+		}
+	};
+
+	/// Select the build items on the lower side of a split plane
+	struct CentroidBelow {
+		int axis;
+		Float split;
+		inline CentroidBelow(int axis, Float split) : axis(axis), split(split) { }
+		template <typename T> inline bool operator()(const T &item) const {
+			return item.centroid[axis] < split;
+		}
+	};
+
+	/// cos(max(0, a - b)) given the sines and cosines of two angles
+	inline Float cosSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+		if (cosA > cosB)
+			return 1.0f;
+		return cosA * cosB + sinA * sinB;
+	}
+
+	/// sin(max(0, a - b)) given the sines and cosines of two angles
+	inline Float sinSubClamped(Float sinA, Float cosA, Float sinB, Float cosB) {
+		if (cosA > cosB)
+			return 0.0f;
+		return sinA * cosB - cosA * sinB;
+	}
+
+	/// Compute a cone that contains two other cones
+	void mergeCones(const Vector &wa, Float cosA, const Vector &wb, Float cosB,
+			Vector &w, Float &cosTheta) {
+		w = wa;
+		cosTheta = -1.0f;
+		if (cosA <= -1.0f || cosB <= -1.0f)
+			return;
+
+		Float thetaA = math::safe_acos(cosA),
+		      thetaB = math::safe_acos(cosB),
+		      thetaD = unitAngle(wa, wb);
+
+		if (std::min(thetaD + thetaB, (Float) M_PI) <= thetaA) {
+			cosTheta = cosA;
+			return;
+		} else if (std::min(thetaD + thetaA, (Float) M_PI) <= thetaB) {
+			w = wb;
+			cosTheta = cosB;
+			return;
+		}
+
+		Float thetaO = 0.5f * (thetaA + thetaD + thetaB);
+		if (thetaO >= M_PI)
+			return;
+
+		/* Rotate the axis of the first cone towards the second one */
+		Vector wr = cross(wa, wb);
+		if (wr.lengthSquared() == 0)
+			return;
+		w = normalize(Transform::rotate(wr, radToDeg(thetaO - thetaA))(wa));
+		cosTheta = std::cos(thetaO);
+	}
+
+	/**
+	 * Compute a cone that contains the emission directions of an area
+	 * emitter by collecting the normals of a triangulation of its shape.
+	 * Returns \c false when no useful cone could be found.
+	 */
+	bool computeEmissionCone(const Shape *shape, Vector &axis, Float &cosTheta) {
+		ref<TriMesh> mesh = const_cast<Shape *>(shape)->createTriMesh();
+		if (!mesh || mesh->getTriangleCount() == 0)
+			return false;
+
+		const Point *positions = mesh->getVertexPositions();
+		std::vector<Vector> directions;
+
+		if (mesh->hasVertexNormals()) {
+			/* Interpolated shading normals determine the side that emits light */
+			directions.reserve(mesh->getVertexCount());
+			for (size_t i=0; i<mesh->getVertexCount(); ++i) {
+				Normal n = mesh->getVertexNormal(i);
+				Float length = n.length();
+				if (length > 0)
+					directions.push_back(Vector(n) / length);
+			}
+		} else {
+			directions.reserve(mesh->getTriangleCount());
+			for (size_t i=0; i<mesh->getTriangleCount(); ++i) {
+				const Triangle tri = mesh->getTriangle(i);
+				Vector n = cross(positions[tri.idx[1]] - positions[tri.idx[0]],
+					positions[tri.idx[2]] - positions[tri.idx[0]]);
+				Float length = n.length();
+				if (length > 0)
+					directions.push_back(n / length);
+			}
+		}
+
+		Vector sum(0.0f);
+		for (size_t i=0; i<directions.size(); ++i)
+			sum += directions[i];
+		Float length = sum.length();
+		if (directions.empty() || length < 1e-3f * directions.size())
+			return false;
+
+		axis = sum / length;
+		cosTheta = 1.0f;
+		for (size_t i=0; i<directions.size(); ++i)
+			cosTheta = std::min(cosTheta, dot(axis, directions[i]));
+
+		/* Interpolated normals may leave a cone that is wider than a hemisphere */
+		if (cosTheta < 0)
+			return false;
+		return true;
+	}
+}
+
+LightBVH::LightBVH(const ref_vector<Emitter> &emitters)
+		: m_emitterCount(emitters.size()), m_maxDepth(0) {
+	ref<Timer> timer = new Timer();
+	m_bitTrails.resize(m_emitterCount, 0);
+	m_isInfinite.resize(m_emitterCount, false);
+
+	std::vector<BuildItem> items;
+	items.reserve(m_emitterCount);
+	for (size_t i=0; i<m_emitterCount; ++i) {
+		const Emitter *emitter = emitters[i].get();
+		m_emitterIndex[emitter] = (uint32_t) i;
+
+		if (emitter->isEnvironmentEmitter() || !emitter->getAABB().isValid()) {
+			m_infinite.push_back((uint32_t) i);
+			m_isInfinite[i] = true;
+			continue;
+		}
+
+		BuildItem item;
+		item.bounds = computeBounds(emitter);
+		item.centroid = item.bounds.aabb.getCenter();
+		item.emitter = (uint32_t) i;
+		items.push_back(item);
+	}
+
+	if (!items.empty()) {
+		m_nodes.reserve(2 * items.size() - 1);
+		build(items, 0, items.size(), 0, 0);
+	}
+
+	Log(EDebug, "Built a light BVH over " SIZE_T_FMT " emitters (" SIZE_T_FMT
+		" nodes, depth %i, " SIZE_T_FMT " infinite emitters) in %i ms",
+		items.size(), m_nodes.size(), m_maxDepth, m_infinite.size(),
+		timer->getMilliseconds());
+}
+
+LightBVH::LightBounds LightBVH::computeBounds(const Emitter *emitter) {
+	LightBounds bounds;
+	bounds.aabb = emitter->getAABB();
+
+	/* The value returned by samplePosition() is the emitted power
+	   divided by the positional density */
+	Float power = 0.0f;
+	for (int i=0; i<LIGHTBVH_POWER_SAMPLES; ++i) {
+		for (int j=0; j<LIGHTBVH_POWER_SAMPLES; ++j) {
+			PositionSamplingRecord pRec(0.0f);
+			Point2 sample((i + 0.5f) / LIGHTBVH_POWER_SAMPLES,
+				(j + 0.5f) / LIGHTBVH_POWER_SAMPLES);
+			power += emitter->samplePosition(pRec, sample).getLuminance();
+		}
+	}
+	power /= LIGHTBVH_POWER_SAMPLES * LIGHTBVH_POWER_SAMPLES;
+
+	/* Never exclude an emitter whose power cannot be estimated */
+	if (!(power > 0) || !std::isfinite(power))
+		power = 1.0f;
+	bounds.phi = power * emitter->getSamplingWeight();
+
+	/* Area emitters only emit into the hemisphere around their normal */
+	Vector axis;
+	Float cosTheta;
+	if (emitter->getShape() && computeEmissionCone(emitter->getShape(), axis, cosTheta)) {
+		bounds.axis = axis;
+		bounds.cosThetaO = cosTheta;
+		bounds.cosThetaE = 0.0f;
+	} else {
+		bounds.axis = Vector(0.0f, 0.0f, 1.0f);
+		bounds.cosThetaO = -1.0f;
+		bounds.cosThetaE = 0.0f;
+	}
+	return bounds;
+}
+
+LightBVH::LightBounds LightBVH::build(std::vector<BuildItem> &items,
+		size_t start, size_t end, uint64_t bitTrail, int depth) {
+	m_maxDepth = std::max(m_maxDepth, depth);
+
+	if (end - start == 1) {
+		Node node;
+		node.bounds = items[start].bounds;
+		node.index = items[start].emitter;
+		node.leaf = true;
+		m_nodes.push_back(node);
+		m_bitTrails[node.index] = bitTrail;
+		return node.bounds;
+	}
+
+	AABB centroidBounds;
+	for (size_t i=start; i<end; ++i)
+		centroidBounds.expandBy(items[i].centroid);
+	int axis = centroidBounds.getLargestAxis();
+
+	size_t mid = start;
+	if (depth < LIGHTBVH_MAX_MIDPOINT_DEPTH && centroidBounds.getExtents()[axis] > 0) {
+		Float split = centroidBounds.getCenter()[axis];
+		mid = std::partition(items.begin() + start, items.begin() + end,
+			CentroidBelow(axis, split)) - items.begin();
+	}
+	if (mid == start || mid == end) {
+		mid = (start + end) / 2;
+		std::nth_element(items.begin() + start, items.begin() + mid,
+			items.begin() + end, CentroidOrder(axis));
+	}
+
+	size_t nodeIndex = m_nodes.size();
+	m_nodes.push_back(Node());
+	LightBounds left = build(items, start, mid, bitTrail, depth + 1);
+	m_nodes[nodeIndex].index = (uint32_t) m_nodes.size();
+	LightBounds right = build(items, mid, end,
+		bitTrail | ((uint64_t) 1 << depth), depth + 1);
+
+	Node &node = m_nodes[nodeIndex];
+	node.bounds = LightBounds::merge(left, right);
+	node.leaf = false;
+	return node.bounds;
+}
+
+LightBVH::LightBounds LightBVH::LightBounds::merge(const LightBounds &a, const LightBounds &b) {
+	if (a.phi == 0)
+		return b;
+	else if (b.phi == 0)
+		return a;
+
+	LightBounds result;
+	result.aabb = a.aabb;
+	result.aabb.expandBy(b.aabb);
+	result.phi = a.phi + b.phi;
+	mergeCones(a.axis, a.cosThetaO, b.axis, b.cosThetaO, result.axis, result.cosThetaO);
+	result.cosThetaE = std::min(a.cosThetaE, b.cosThetaE);
+	return result;
+}
+
+Float LightBVH::LightBounds::importance(const Point &p, const Normal &n) const {
+	if (phi == 0)
+		return 0.0f;
+
+	/* Distance to the center of the bounds, clamped for nearby points */
+	Point center = aabb.getCenter();
+	Vector wi = p - center;
+	Float dist2 = wi.lengthSquared(),
+	      radius = 0.5f * aabb.getExtents().length();
+	if (dist2 > 0)
+		wi /= std::sqrt(dist2);
+	else
+		wi = axis;
+	dist2 = std::max(dist2, radius);
+
+	/* Angle between the cone axis and the direction towards p */
+	Float cosThetaW = dot(axis, wi),
+	      sinThetaW = math::safe_sqrt(1 - cosThetaW * cosThetaW);
+
+	/* Angle subtended by the bounds as seen from p */
+	Float cosThetaB = -1.0f;
+	if (!aabb.contains(p) && distanceSquared(p, center) > radius * radius)
+		cosThetaB = math::safe_sqrt(1 - radius * radius / distanceSquared(p, center));
+	Float sinThetaB = math::safe_sqrt(1 - cosThetaB * cosThetaB);
+
+	/* Minimum angle between the emission cone and the direction towards p */
+	Float sinThetaO = math::safe_sqrt(1 - cosThetaO * cosThetaO);
+	Float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO),
+	      sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO),
+	      cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+	if (cosThetaP <= cosThetaE)
+		return 0.0f;
+
+	Float result = phi * cosThetaP / dist2;
+
+	/* Foreshortening at the shading point (two-sided to account for transmission) */
+	if (!n.isZero()) {
+		Float cosThetaI = absDot(wi, n),
+		      sinThetaI = math::safe_sqrt(1 - cosThetaI * cosThetaI);
+		result *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+	}
+
+	return std::max(result, (Float) 0.0f);
+}
+
+size_t LightBVH::sample(const Point &p, const Normal &n, Float &sample, Float &pdf) const {
+	size_t infiniteCount = m_infinite.size();
+	Float pInfinite = (Float) infiniteCount /
+		(Float) (infiniteCount + (m_nodes.empty() ? 0 : 1));
+
+	if (sample < pInfinite) {
+		sample /= pInfinite;
+		size_t index = std::min((size_t) (sample * infiniteCount), infiniteCount - 1);
+		sample = std::min(sample * infiniteCount - index, ONE_MINUS_EPS);
+		pdf = pInfinite / infiniteCount;
+		return m_infinite[index];
+	} else if (m_nodes.empty()) {
+		pdf = 0.0f;
+		return (size_t) -1;
+	}
+
+	sample = std::min((sample - pInfinite) / (1 - pInfinite), ONE_MINUS_EPS);
+	pdf = 1 - pInfinite;
+
+	const Node *node = &m_nodes[0];
+	if (node->leaf && node->bounds.importance(p, n) == 0) {
+		pdf = 0.0f;
+		return (size_t) -1;
+	}
+
+	while (!node->leaf) {
+		const Node *left = node + 1, *right = &m_nodes[node->index];
+		Float impLeft = left->bounds.importance(p, n),
+		      impRight = right->bounds.importance(p, n);
+		if (impLeft == 0 && impRight == 0) {
+			pdf = 0.0f;
+			return (size_t) -1;
+		}
+
+		Float pLeft = impLeft / (impLeft + impRight);
+		if (sample < pLeft) {
+			sample = std::min(sample / pLeft, ONE_MINUS_EPS);
+			pdf *= pLeft;
+			node = left;
+		} else {
+			sample = std::min((sample - pLeft) / (1 - pLeft), ONE_MINUS_EPS);
+			pdf *= 1 - pLeft;
+			node = right;
+		}
+	}
+
+	return node->index;
+}
+
+Float LightBVH::pdf(const Point &p, const Normal &n, const Emitter *emitter) const {
+	boost::unordered_map<const Emitter *, uint32_t>::const_iterator it
+		= m_emitterIndex.find(emitter);
+	if (it == m_emitterIndex.end())
+		return 0.0f;
+
+	size_t infiniteCount = m_infinite.size();
+	Float pInfinite = (Float) infiniteCount /
+		(Float) (infiniteCount + (m_nodes.empty() ? 0 : 1));
+	if (m_isInfinite[it->second])
+		return pInfinite / infiniteCount;
+
+	const Node *node = &m_nodes[0];
+	if (node->leaf)
+		return node->bounds.importance(p, n) > 0 ? 1 - pInfinite : 0.0f;
+
+	/* Follow the bit trail from the root down to the emitter */
+	uint64_t bitTrail = m_bitTrails[it->second];
+	Float pdf = 1 - pInfinite;
+	while (!node->leaf) {
+		const Node *left = node + 1, *right = &m_nodes[node->index];
+		Float impLeft = left->bounds.importance(p, n),
+		      impRight = right->bounds.importance(p, n);
+		if (impLeft == 0 && impRight == 0)
+			return 0.0f;
+
+		if (bitTrail & 1) {
+			pdf *= impRight / (impLeft + impRight);
+			node = right;
+		} else {
+			pdf *= impLeft / (impLeft + impRight);
+			node = left;
+		}
+		bitTrail >>= 1;
+	}
+
+	return pdf;
+}
+
+std::string LightBVH::toString() const {
+	std::ostringstream oss;
+	oss << "LightBVH[" << endl
+		<< "  emitterCount = " << m_emitterCount << "," << endl
+		<< "  infiniteEmitterCount = " << m_infinite.size() << "," << endl
+		<< "  nodeCount = " << m_nodes.size() << "," << endl
+		<< "  maxDepth = " << m_maxDepth << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(LightBVH, false, Object)
+MTS_NAMESPACE_END
@@ -20,6 +20,7 @@
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/core/plugin.h>
 #include <mitsuba/core/statistics.h>
+#include <boost/algorithm/string.hpp>
 
 #define DEFAULT_BLOCKSIZE 32
 
@@ -30,7 +31,7 @@ MTS_NAMESPACE_BEGIN
 // ===========================================================================
 
 Scene::Scene()
- : NetworkedObject(Properties()), m_blockSize(DEFAULT_BLOCKSIZE) {
+ : NetworkedObject(Properties()), m_blockSize(DEFAULT_BLOCKSIZE), m_useLightBVH(false) {
 	m_kdtree = new ShapeKDTree();
 	m_sourceFile = new fs::path();
 	m_destinationFile = new fs::path();
@@ -76,6 +77,19 @@ Scene::Scene(const Properties &props)
 	   in succession before a leaf node will be created.*/
 	if (props.hasProperty("kdMaxBadRefines"))
 		m_kdtree->setMaxBadRefines(props.getInteger("kdMaxBadRefines"));
+	/* Emitter selection for direct illumination: "weight" picks emitters
+	   proportionally to their sampling weights, while "bvh" builds a light
+	   BVH that accounts for the position and orientation of every emitter
+	   relative to the shading point. */
+	std::string emitterSampling = boost::to_lower_copy(
+		props.getString("emitterSampling", "weight"));
+	if (emitterSampling == "weight")
+		m_useLightBVH = false;
+	else if (emitterSampling == "bvh")
+		m_useLightBVH = true;
+	else
+		Log(EError, "The \"emitterSampling\" parameter must be equal to "
+			"either \"weight\" or \"bvh\"!");
 	m_sourceFile = new fs::path();
 	m_destinationFile = new fs::path();
 }
@@ -90,6 +104,8 @@ Scene::Scene(Scene *scene) : NetworkedObject(Properties()) {
 	m_sourceFile = new fs::path(*scene->m_sourceFile);
 	m_destinationFile = new fs::path(*scene->m_destinationFile);
 	m_emitterPDF = scene->m_emitterPDF;
+	m_lightBVH = scene->m_lightBVH;
+	m_useLightBVH = scene->m_useLightBVH;
 	m_shapes = scene->m_shapes;
 	m_sensors = scene->m_sensors;
 	m_meshes = scene->m_meshes;
@@ -119,6 +135,7 @@ Scene::Scene(Stream *stream, InstanceManager *manager)
 	m_blockSize = stream->readUInt();
 	m_degenerateSensor = stream->readBool();
 	m_degenerateEmitters = stream->readBool();
+	m_useLightBVH = stream->readBool();
 	m_aabb = AABB(stream);
 	m_environmentEmitter = static_cast<Emitter *>(manager->getInstance(stream));
 	m_sourceFile = new fs::path(stream->readString());
@@ -185,6 +202,7 @@ void Scene::serialize(Stream *stream, InstanceManager *manager) const {
 	stream->writeUInt(m_blockSize);
 	stream->writeBool(m_degenerateSensor);
 	stream->writeBool(m_degenerateEmitters);
+	stream->writeBool(m_useLightBVH);
 	m_aabb.serialize(stream);
 	manager->serialize(stream, m_environmentEmitter.get());
 	stream->writeString(m_sourceFile->string());
@@ -381,6 +399,10 @@ void Scene::initialize() {
 	}
 
 	initializeBidirectional();
+
+	/* Build the light BVH once the emitters know their extents */
+	if (m_useLightBVH && !m_lightBVH)
+		m_lightBVH = new LightBVH(m_emitters);
 }
 
 void Scene::initializeBidirectional() {
@@ -831,7 +853,11 @@ Spectrum Scene::sampleEmitterDirect(DirectSamplingRecord &dRec,
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
+	size_t index = sampleEmitterIndex(dRec, sample.x, emPdf);
+	if (index == (size_t) -1) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	const Emitter *emitter = m_emitters[index].get();
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
@@ -857,7 +883,11 @@ Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
+	size_t index = sampleEmitterIndex(dRec, sample.x, emPdf);
+	if (index == (size_t) -1) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	const Emitter *emitter = m_emitters[index].get();
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
@@ -880,7 +910,11 @@ Spectrum Scene::sampleAttenuatedEmitterDirect(DirectSamplingRecord &dRec,
 
 	/* Randomly pick an emitter */
 	Float emPdf;
-	size_t index = m_emitterPDF.sampleReuse(sample.x, emPdf);
+	size_t index = sampleEmitterIndex(dRec, sample.x, emPdf);
+	if (index == (size_t) -1) {
+		dRec.pdf = 0.0f;
+		return Spectrum(0.0f);
+	}
 	const Emitter *emitter = m_emitters[index].get();
 	Spectrum value = emitter->sampleDirect(dRec, sample);
 
@@ -948,6 +982,8 @@ Spectrum Scene::sampleAttenuatedSensorDirect(DirectSamplingRecord &dRec,
 
 Float Scene::pdfEmitterDirect(const DirectSamplingRecord &dRec) const {
 	const Emitter *emitter = static_cast<const Emitter *>(dRec.object);
+	if (m_lightBVH.get())
+		return emitter->pdfDirect(dRec) * m_lightBVH->pdf(dRec.ref, dRec.refN, emitter);
 	return emitter->pdfDirect(dRec) * pdfEmitterDiscrete(emitter);
 }
 
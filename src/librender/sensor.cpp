@@ -368,7 +368,8 @@ Float PerspectiveCamera::getDiagonalFov() const {
            reuse cache files that have been created previously */
 		cacheFile = m_filename;
 		cacheFile.replace_extension(".mip");
-		tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true);
+		tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true)
+			&& !TileCache::getInstance()->isEnabled();
 
 		/* These are reasonable MIP map defaults for environment maps, I don't
        think there is a need to expose them through plugin parameters */
@@ -66,6 +66,16 @@ void ShapeKDTree::addShape(const Shape *shape) {
 	m_shapes.push_back(shape);
 }
 
+/* Per-triangle bounding boxes are recomputed from the vertices on demand,
+   which costs a few min/max operations on data that has just been loaded
+   anyway, and saves storing an AABB for every triangle */
+static FINLINE AABB triangleAABB(const Point &A, const Point &B, const Point &C) {
+	AABB aabb(A);
+	aabb.expandBy(B);
+	aabb.expandBy(C);
+	return aabb;
+}
+
 void ShapeKDTree::build() {
 	for (size_t i=1; i<m_shapeMap.size(); ++i)
 		m_shapeMap[i] += m_shapeMap[i-1];
@@ -77,17 +87,16 @@ void ShapeKDTree::build() {
 	SizeType primCount = getPrimitiveCount();
 	Log(EDebug, "Precomputing triangle intersection information (%s)",
 			memString(sizeof(TriAccel)*primCount).c_str());
-	m_triAccel = static_cast<TriAccel *>(allocAligned(primCount * sizeof(TriAccel)));
+	m_triAccel = static_cast<TriAccel *>(allocHugeAligned(primCount * sizeof(TriAccel)));
 
 	IndexType idx = 0;
 	for (IndexType i=0; i<m_shapes.size(); ++i) {
 		const Shape *shape = m_shapes[i];
 		if (m_triangleFlag[i]) {
 			const TriMesh *mesh = static_cast<const TriMesh *>(shape);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
 			for (IndexType j=0; j<mesh->getTriangleCount(); ++j) {
-				const Triangle &tri = triangles[j];
+				const Triangle tri = mesh->getTriangle(j);
 				const Point &v0 = positions[tri.idx[0]];
 				const Point &v1 = positions[tri.idx[1]];
 				const Point &v2 = positions[tri.idx[2]];
@@ -131,8 +140,14 @@ void ShapeKDTree::build() {
 			Log(EDebug, "\n\n\n Current implementation with BVH does not allow non-triangular meshes; The results are mostly wrong !! \n\n\n");
 	}
 	m_bvh = new BVH<TriAccel>(m_shapes, triaccels);
+	/* The ellipsoid traversal only needs the node hierarchy and the index
+	   list; release the copy of the triangle data used during construction */
+	std::vector<TriAccel>().swap(m_bvh->m_triaccels);
 	Log(EDebug, "Finished -- took %i ms", timerBVH->getMilliseconds());
 
+	if (getNUMAReplication())
+		replicateNUMA();
+
 //	printBBTree(m_nodes, 0);
 //	printAllTriangles();
 }
@@ -149,24 +164,15 @@ void ShapeKDTree::buildBBTree(const KDNode* node){
 			if(ta.k == KNoTriangleFlag)
 				continue;
 			const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
 
-			const Triangle &tri = triangles[ta.primIndex];
+			const Triangle tri = mesh->getTriangle(ta.primIndex);
 			const Point &A = positions[tri.idx[0]];
 			const Point &B = positions[tri.idx[1]];
 			const Point &C = positions[tri.idx[2]];
 
 			m_BBTree->m_triangleRepetition[primIdx]++;
-
-			//create triangle BBox only for the first repetition of the triangle;
-			if(m_BBTree->m_triangleRepetition[primIdx] == 1){
-				m_BBTree->m_aabbTriangle[primIdx].expandBy(A);
-				m_BBTree->m_aabbTriangle[primIdx].expandBy(B);
-				m_BBTree->m_aabbTriangle[primIdx].expandBy(C);
-			}
-
-			m_BBTree->expandBy(m_BBTree->m_aabbTriangle[primIdx]);
+			m_BBTree->expandBy(triangleAABB(A, B, C));
 		}
 	}else{
 		m_BBTree->goLeft();
@@ -191,10 +197,9 @@ void ShapeKDTree::printBBTree(const KDNode* node, const size_t& index) const{
 			const TriAccel &ta = m_triAccel[primIdx];
 
 			const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
 
-			const Triangle &tri = triangles[ta.primIndex];
+			const Triangle tri = mesh->getTriangle(ta.primIndex);
 			const Point &A = positions[tri.idx[0]];
 			const Point &B = positions[tri.idx[1]];
 			const Point &C = positions[tri.idx[2]];
@@ -238,10 +243,9 @@ void ShapeKDTree::printAllTriangles() const{
 		const TriAccel &ta = m_triAccel[x];
 
 		const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-		const Triangle *triangles = mesh->getTriangles();
 		const Point *positions = mesh->getVertexPositions();
 
-		const Triangle &tri = triangles[ta.primIndex];
+		const Triangle tri = mesh->getTriangle(ta.primIndex);
 		const Point &A = positions[tri.idx[0]];
 		const Point &B = positions[tri.idx[1]];
 		const Point &C = positions[tri.idx[2]];
@@ -293,20 +297,18 @@ bool ShapeKDTree::ellipsoidParseBVH_DFS(Ellipsoid* e, Float &value, ref<Sampler>
 
 					//gather the required data structures
 					const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-					const Triangle *triangles = mesh->getTriangles();
 					const Point *positions = mesh->getVertexPositions();
-					const Normal *normals = mesh->getVertexNormals();
 
-					const Triangle &tri = triangles[ta.primIndex];
+					const Triangle tri = mesh->getTriangle(ta.primIndex);
 					const Point &A = positions[tri.idx[0]];
 					const Point &B = positions[tri.idx[1]];
 					const Point &C = positions[tri.idx[2]];
 					Normal N = cross(B-A, C-A);
-					if(normals != NULL){
-						if(dot(normals[tri.idx[0]], N) < 0)
+					if(mesh->hasVertexNormals()){
+						if(dot(mesh->getVertexNormal(tri.idx[0]), N) < 0)
 							N = -N;
 					}
-					if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, m_BBTree->m_aabbTriangle[*it])){
+					if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, triangleAABB(A, B, C))){
 						intersectingTriangles[countIntersectingTriangles++] = *it;
 						e->appendPrimPDF(1.0f);
 					}
@@ -402,20 +404,18 @@ bool ShapeKDTree::ellipsoidParseKDTreeDFS(const KDNode* node, size_t& index, Ell
 
 			//gather the required data structures
 			const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
-			const Normal *normals = mesh->getVertexNormals();
 
-			const Triangle &tri = triangles[ta.primIndex];
+			const Triangle tri = mesh->getTriangle(ta.primIndex);
 			const Point &A = positions[tri.idx[0]];
 			const Point &B = positions[tri.idx[1]];
 			const Point &C = positions[tri.idx[2]];
 			Normal N = cross(B-A, C-A);
-			if(normals != NULL){
-				if(dot(normals[tri.idx[0]], N) < 0)
+			if(mesh->hasVertexNormals()){
+				if(dot(mesh->getVertexNormal(tri.idx[0]), N) < 0)
 					N = -N;
 			}
-			if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, m_BBTree->m_aabbTriangle[x])){
+			if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, triangleAABB(A, B, C))){
 				intersectingTriangles[countIntersectingTriangles] = x;
 				Centroid = (A + B + C)/3;
 				V1 = Centroid - e->getFocalPoint1();
@@ -462,10 +462,9 @@ bool ShapeKDTree::ellipsoidParseIntersectingTriangles(Ellipsoid* e, Float &value
 	const TriAccel &ta = m_triAccel[x];
 
 	const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-	const Triangle *triangles = mesh->getTriangles();
 	const Point *positions = mesh->getVertexPositions();
 
-	const Triangle &tri = triangles[ta.primIndex];
+	const Triangle tri = mesh->getTriangle(ta.primIndex);
 	const Point &A = positions[tri.idx[0]];
 	const Point &B = positions[tri.idx[1]];
 	const Point &C = positions[tri.idx[2]];
@@ -504,20 +503,18 @@ bool ShapeKDTree::ellipsoidParseKDTreeFlattened(const KDNode* node, size_t& inde
 
 			//gather the required data structures
 			const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
-			const Normal *normals = mesh->getVertexNormals();
 
-			const Triangle &tri = triangles[ta.primIndex];
+			const Triangle tri = mesh->getTriangle(ta.primIndex);
 			const Point &A = positions[tri.idx[0]];
 			const Point &B = positions[tri.idx[1]];
 			const Point &C = positions[tri.idx[2]];
 			Normal N = cross(B-A, C-A);
-			if(normals != NULL){
-				if(dot(normals[tri.idx[0]], N) < 0)
+			if(mesh->hasVertexNormals()){
+				if(dot(mesh->getVertexNormal(tri.idx[0]), N) < 0)
 					N = -N;
 			}
-			if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, m_BBTree->m_aabbTriangle[x])){
+			if(!e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, triangleAABB(A, B, C))){
 				intersectingTriangles[countIntersectingTriangles] = x;
 				Centroid = (A + B + C)/3;
 				V1 = Centroid - e->getFocalPoint1();
@@ -655,20 +652,18 @@ bool ShapeKDTree::ellipsoidParseKDTree(const KDNode* node, size_t& index, Ellips
 		}else{
 			//gather the required data structures
 			const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-			const Triangle *triangles = mesh->getTriangles();
 			const Point *positions = mesh->getVertexPositions();
-			const Normal *normals = mesh->getVertexNormals();
 
-			const Triangle &tri = triangles[ta.primIndex];
+			const Triangle tri = mesh->getTriangle(ta.primIndex);
 			const Point &A = positions[tri.idx[0]];
 			const Point &B = positions[tri.idx[1]];
 			const Point &C = positions[tri.idx[2]];
 			Normal N = cross(B-A, C-A);
-			if(normals != NULL){
-				if(dot(normals[tri.idx[0]], N) < 0)
+			if(mesh->hasVertexNormals()){
+				if(dot(mesh->getVertexNormal(tri.idx[0]), N) < 0)
 					N = -N;
 			}
-			if(e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, m_BBTree->m_aabbTriangle[primIdx])){
+			if(e->earlyTriangleReject(A, B, C, N, ta.shapeIndex, ta.primIndex, triangleAABB(A, B, C))){
 				e->cacheSetTriState(primIdx,Cache::EFails);
 			}else{
 				// The statement below in not exactly correct, but then even if we sample this triangle in the future, the full-ellipsoid intersection will change this state to false. Till then, we can sample this triangle and additionally, we don't have to unnecessarily do the early test for this triangle again and again.
@@ -687,10 +682,9 @@ bool ShapeKDTree::ellipsoidParseKDTree(const KDNode* node, size_t& index, Ellips
 	const TriAccel &ta = m_triAccel[primIdx];
 
 	const TriMesh *mesh = static_cast<const TriMesh *>(m_shapes[ta.shapeIndex]);
-	const Triangle *triangles = mesh->getTriangles();
 	const Point *positions = mesh->getVertexPositions();
 
-	const Triangle &tri = triangles[ta.primIndex];
+	const Triangle tri = mesh->getTriangle(ta.primIndex);
 	const Point &A = positions[tri.idx[0]];
 	const Point &B = positions[tri.idx[1]];
 	const Point &C = positions[tri.idx[2]];
@@ -771,20 +765,19 @@ bool ShapeKDTree::rayIntersect(const Ray &ray, Float &t, ConstShapePtr &shape,
 
 				if (m_triangleFlag[cache->shapeIndex]) {
 					const TriMesh *trimesh = static_cast<const TriMesh *>(shape);
-					const Triangle &tri = trimesh->getTriangles()[cache->primIndex];
+					const Triangle tri = trimesh->getTriangle(cache->primIndex);
 					const Point *vertexPositions = trimesh->getVertexPositions();
-					const Point2 *vertexTexcoords = trimesh->getVertexTexcoords();
 					const uint32_t idx0 = tri.idx[0], idx1 = tri.idx[1], idx2 = tri.idx[2];
 					const Point &p0 = vertexPositions[idx0];
 					const Point &p1 = vertexPositions[idx1];
 					const Point &p2 = vertexPositions[idx2];
 					n = normalize(cross(p1-p0, p2-p0));
 
-					if (EXPECT_TAKEN(vertexTexcoords)) {
+					if (EXPECT_TAKEN(trimesh->hasVertexTexcoords())) {
 						const Vector b(1 - cache->u - cache->v, cache->u, cache->v);
-						const Point2 &t0 = vertexTexcoords[idx0];
-						const Point2 &t1 = vertexTexcoords[idx1];
-						const Point2 &t2 = vertexTexcoords[idx2];
+						const Point2 t0 = trimesh->getVertexTexcoord(idx0);
+						const Point2 t1 = trimesh->getVertexTexcoord(idx1);
+						const Point2 t2 = trimesh->getVertexTexcoord(idx2);
 						uv = t0 * b.x + t1 * b.y + t2 * b.z;
 					} else {
 						uv = Point2(0.0f);
@@ -848,7 +841,8 @@ void ShapeKDTree::rayIntersectPacket(const RayPacket4 &packet,
 	CoherentKDStackEntry MM_ALIGN16 stack[MTS_KD_MAXDEPTH];
 	RayInterval4 MM_ALIGN16 interval;
 
-	const KDNode * __restrict currNode = m_nodes;
+	const KDNode * __restrict currNode = getLocalNodes();
+	const IndexType * __restrict indices = getLocalIndices();
 	int stackIndex = 0;
 
 	++coherentPackets;
@@ -915,7 +909,7 @@ void ShapeKDTree::rayIntersectPacket(const RayPacket4 &packet,
 					_mm_mul_ps(interval.maxt.ps, SSEConstants::op_eps.ps)));
 
 			for (IndexType entry=primStart; entry != primEnd; entry++) {
-				const TriAccel &kdTri = m_triAccel[m_indices[entry]];
+				const TriAccel &kdTri = m_triAccel[indices[entry]];
 				if (EXPECT_TAKEN(kdTri.k != KNoTriangleFlag)) {
 					itsFound.ps = _mm_or_ps(itsFound.ps,
 						mitsuba::rayIntersectPacket(kdTri, packet, searchStart.ps, searchEnd.ps, masked.ps, its));
@@ -0,0 +1,227 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/sparsehist.h>
+#include <mitsuba/core/fstream.h>
+
+MTS_NAMESPACE_BEGIN
+
+/* File identifier and version of the sparse histogram format */
+#define MTS_SPARSEHIST_MAGIC "MTSH"
+#define MTS_SPARSEHIST_VERSION 1
+
+SparseHistogram::SparseHistogram(const Bitmap *storage, Float minBound, Float binWidth)
+		: m_size(storage->getSize()), m_minBound(minBound), m_binWidth(binWidth) {
+	if ((storage->getPixelFormat() != Bitmap::EMultiSpectrumAlphaWeight &&
+		 storage->getPixelFormat() != Bitmap::ESpectrumAlphaWeight) ||
+		 storage->getComponentFormat() != Bitmap::EFloat)
+		Log(EError, "SparseHistogram: unsupported film storage format!");
+	if (SPECTRUM_SAMPLES != 3)
+		Log(EError, "SparseHistogram: only RGB builds (SPECTRUM_SAMPLES=3) are supported!");
+
+	const int channels = storage->getChannelCount(),
+	          height = m_size.y, width = m_size.x;
+	m_binCount = (channels - 2) / SPECTRUM_SAMPLES;
+	const Float *data = storage->getFloatData();
+
+	/* First pass: count the non-zero bins of every pixel */
+	std::vector<uint32_t> counts((size_t) width * height);
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int y=0; y<height; ++y) {
+		for (int x=0; x<width; ++x) {
+			size_t pixel = (size_t) y * width + x;
+			const Float *value = data + pixel * channels;
+			uint32_t count = 0;
+			if (value[channels - 1] != 0) {
+				for (int b=0; b<m_binCount; ++b, value += SPECTRUM_SAMPLES) {
+					if (value[0] != 0 || value[1] != 0 || value[2] != 0)
+						++count;
+				}
+			}
+			counts[pixel] = count;
+		}
+	}
+
+	m_offsets.resize(counts.size() + 1);
+	uint64_t nnz = 0;
+	for (size_t i=0; i<counts.size(); ++i) {
+		m_offsets[i] = (uint32_t) nnz;
+		nnz += counts[i];
+		if (nnz > (uint64_t) 0xFFFFFFFFU)
+			Log(EError, "SparseHistogram: too many non-zero bins for the sparse format!");
+	}
+	m_offsets[counts.size()] = (uint32_t) nnz;
+	m_binIndices.resize((size_t) nnz);
+	m_values.resize((size_t) nnz * 3);
+
+	/* Second pass: copy the normalized values of the non-zero bins */
+#if defined(MTS_OPENMP)
+	#pragma omp parallel for schedule(dynamic)
+#endif
+	for (int y=0; y<height; ++y) {
+		for (int x=0; x<width; ++x) {
+			size_t pixel = (size_t) y * width + x, index = m_offsets[pixel];
+			if (counts[pixel] == 0)
+				continue;
+			const Float *value = data + pixel * channels;
+			Float invWeight = 1.0f / value[channels - 1];
+			for (int b=0; b<m_binCount; ++b, value += SPECTRUM_SAMPLES) {
+				if (value[0] == 0 && value[1] == 0 && value[2] == 0)
+					continue;
+				m_binIndices[index] = (uint32_t) b;
+				for (int k=0; k<3; ++k)
+					m_values[3*index + k] = (float) (value[k] * invWeight);
+				++index;
+			}
+		}
+	}
+}
+
+SparseHistogram::SparseHistogram(Stream *stream) {
+	read(stream);
+}
+
+SparseHistogram::SparseHistogram(const fs::path &path) {
+	ref<FileStream> stream = new FileStream(path, FileStream::EReadOnly);
+	read(stream);
+}
+
+void SparseHistogram::read(Stream *stream) {
+	Stream::EByteOrder byteOrder = stream->getByteOrder();
+	stream->setByteOrder(Stream::ELittleEndian);
+
+	char magic[4];
+	stream->read(magic, 4);
+	if (memcmp(magic, MTS_SPARSEHIST_MAGIC, 4) != 0)
+		Log(EError, "SparseHistogram: invalid file (the header is corrupt)!");
+	uint8_t version = stream->readUChar();
+	if (version != MTS_SPARSEHIST_VERSION)
+		Log(EError, "SparseHistogram: unsupported file version %i (expected %i)",
+			(int) version, MTS_SPARSEHIST_VERSION);
+
+	m_size.x = stream->readInt();
+	m_size.y = stream->readInt();
+	m_binCount = (int) stream->readUInt();
+	m_minBound = (Float) stream->readSingle();
+	m_binWidth = (Float) stream->readSingle();
+	size_t nnz = (size_t) stream->readUInt();
+
+	/* Validate the header before allocating any memory */
+	if (m_size.x < 0 || m_size.y < 0 || m_binCount <= 0)
+		Log(EError, "SparseHistogram: invalid file (bad size or bin count)!");
+	size_t nPixels = (size_t) m_size.x * (size_t) m_size.y;
+	if (nnz / (size_t) m_binCount > nPixels)
+		Log(EError, "SparseHistogram: invalid file (too many non-zero bins)!");
+
+	m_offsets.resize(nPixels + 1);
+	m_binIndices.resize(nnz);
+	m_values.resize(nnz * 3);
+	stream->readUIntArray(&m_offsets[0], m_offsets.size());
+	if (nnz > 0) {
+		stream->readUIntArray(&m_binIndices[0], nnz);
+		stream->readSingleArray(&m_values[0], nnz * 3);
+	}
+
+	/* The offsets must partition the bin arrays, and every
+	   pixel may store each bin at most once */
+	if (m_offsets[0] != 0 || m_offsets.back() != nnz)
+		Log(EError, "SparseHistogram: invalid file (inconsistent offsets)!");
+	for (size_t pixel=0; pixel<nPixels; ++pixel) {
+		if (m_offsets[pixel+1] < m_offsets[pixel] ||
+			m_offsets[pixel+1] - m_offsets[pixel] > (uint32_t) m_binCount)
+			Log(EError, "SparseHistogram: invalid file (inconsistent offsets)!");
+	}
+	for (size_t i=0; i<nnz; ++i) {
+		if (m_binIndices[i] >= (uint32_t) m_binCount)
+			Log(EError, "SparseHistogram: invalid file (bin index %u is out of "
+				"range, expected less than %i)!", m_binIndices[i], m_binCount);
+	}
+
+	stream->setByteOrder(byteOrder);
+}
+
+void SparseHistogram::write(Stream *stream) const {
+	Stream::EByteOrder byteOrder = stream->getByteOrder();
+	stream->setByteOrder(Stream::ELittleEndian);
+
+	stream->write(MTS_SPARSEHIST_MAGIC, 4);
+	stream->writeUChar(MTS_SPARSEHIST_VERSION);
+	stream->writeInt(m_size.x);
+	stream->writeInt(m_size.y);
+	stream->writeUInt((uint32_t) m_binCount);
+	stream->writeSingle((float) m_minBound);
+	stream->writeSingle((float) m_binWidth);
+	stream->writeUInt((uint32_t) m_binIndices.size());
+	stream->writeUIntArray(&m_offsets[0], m_offsets.size());
+	if (!m_binIndices.empty()) {
+		stream->writeUIntArray(&m_binIndices[0], m_binIndices.size());
+		stream->writeSingleArray(&m_values[0], m_values.size());
+	}
+
+	stream->setByteOrder(byteOrder);
+}
+
+void SparseHistogram::write(const fs::path &path) const {
+	ref<FileStream> stream = new FileStream(path, FileStream::ETruncWrite);
+	write(stream);
+}
+
+ref<Bitmap> SparseHistogram::toBitmap() const {
+	ref<Bitmap> bitmap = new Bitmap(Bitmap::EMultiChannel, Bitmap::EFloat32,
+		m_size, 3 * m_binCount);
+	bitmap->clear();
+	float *target = bitmap->getFloat32Data();
+	size_t nPixels = (size_t) m_size.x * m_size.y;
+
+	for (size_t pixel=0; pixel<nPixels; ++pixel) {
+		float *dest = target + pixel * 3 * m_binCount;
+		for (uint32_t i=m_offsets[pixel]; i<m_offsets[pixel+1]; ++i)
+			for (int k=0; k<3; ++k)
+				dest[3*m_binIndices[i] + k] = m_values[3*i + k];
+	}
+
+	std::vector<std::string> channelNames;
+	for (int b=0; b<m_binCount; ++b) {
+		std::string name = formatString("%i.", b+1);
+		channelNames.push_back(name + "R");
+		channelNames.push_back(name + "G");
+		channelNames.push_back(name + "B");
+	}
+	bitmap->setChannelNames(channelNames);
+	return bitmap;
+}
+
+std::string SparseHistogram::toString() const {
+	size_t nPixels = (size_t) m_size.x * m_size.y;
+	std::ostringstream oss;
+	oss << "SparseHistogram[" << endl
+		<< "  size = " << m_size.toString() << "," << endl
+		<< "  binCount = " << m_binCount << "," << endl
+		<< "  minBound = " << m_minBound << "," << endl
+		<< "  binWidth = " << m_binWidth << "," << endl
+		<< "  nonZero = " << m_binIndices.size() << " ("
+		<< (nPixels * m_binCount > 0 ? 100.0 * m_binIndices.size() / (nPixels * m_binCount) : 0.0)
+		<< "% of all bins)" << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(SparseHistogram, false, Object)
+MTS_NAMESPACE_END
@@ -0,0 +1,154 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/tilecache.h>
+#include <boost/thread/mutex.hpp>
+
+MTS_NAMESPACE_BEGIN
+
+namespace stats {
+	StatsCounter tileCacheHits("Texture system", "Tile cache hits", EPercentage);
+	StatsCounter tileCacheEvictions("Texture system", "Tile cache evictions");
+}
+
+static boost::mutex __tileCacheInstanceLock;
+ref<TileCache> TileCache::m_instance = NULL;
+
+TileCache::Tile::Tile(size_t size) : m_size(size) {
+	m_data = static_cast<uint8_t *>(allocAligned(size));
+}
+
+TileCache::Tile::~Tile() {
+	freeAligned(m_data);
+}
+
+TileCache::TileCache() : m_nextID(1), m_maxSize(0), m_size(0) {
+	m_mutex = new Mutex();
+}
+
+TileCache::~TileCache() { }
+
+TileCache *TileCache::getInstance() {
+	if (EXPECT_NOT_TAKEN(m_instance.get() == NULL)) {
+		boost::mutex::scoped_lock guard(__tileCacheInstanceLock);
+		if (m_instance.get() == NULL)
+			m_instance = new TileCache();
+	}
+	return m_instance;
+}
+
+void TileCache::setMaxSize(size_t size) {
+	LockGuard lock(m_mutex);
+	m_maxSize = size;
+	evict();
+}
+
+uint32_t TileCache::registerSource(const TileSource *source) {
+	LockGuard lock(m_mutex);
+	uint32_t id = m_nextID++;
+	m_sources[id] = source;
+	return id;
+}
+
+void TileCache::unregisterSource(uint32_t id) {
+	LockGuard lock(m_mutex);
+	m_sources.erase(id);
+
+	/* Identifiers are never reused, hence stale entries in the
+	   per-thread caches can't produce false hits. Drop everything
+	   from the shared cache, however. */
+	for (EntryList::iterator it = m_lru.begin(); it != m_lru.end();) {
+		if ((uint32_t) (it->key >> 40) == id) {
+			m_size -= it->tile->getSize();
+			m_entries.erase(it->key);
+			it = m_lru.erase(it);
+		} else {
+			++it;
+		}
+	}
+}
+
+ref<TileCache::Tile> TileCache::lookup(uint64_t key, uint32_t id, int level, int tx, int ty) {
+	const TileSource *source;
+	{
+		LockGuard lock(m_mutex);
+		EntryMap::iterator it = m_entries.find(key);
+		if (it != m_entries.end()) {
+			/* Move to the front of the LRU list */
+			m_lru.splice(m_lru.begin(), m_lru, it->second);
+			++stats::tileCacheHits;
+			stats::tileCacheHits.incrementBase();
+			return it->second->tile;
+		}
+
+		std::map<uint32_t, const TileSource *>::const_iterator it2 = m_sources.find(id);
+		if (it2 == m_sources.end())
+			Log(EError, "getTile(): unknown tile source %i!", id);
+		source = it2->second;
+	}
+	stats::tileCacheHits.incrementBase();
+
+	/* Generate the tile without holding the lock. Another thread
+	   may be doing the same -- in that case, the first one wins. */
+	ref<Tile> tile = new Tile(source->getTileSize(level));
+	source->fillTile(level, tx, ty, tile);
+
+	LockGuard lock(m_mutex);
+	EntryMap::iterator it = m_entries.find(key);
+	if (it != m_entries.end()) {
+		m_lru.splice(m_lru.begin(), m_lru, it->second);
+		return it->second->tile;
+	}
+
+	Entry entry;
+	entry.key = key;
+	entry.tile = tile;
+	m_lru.push_front(entry);
+	m_entries[key] = m_lru.begin();
+	m_size += tile->getSize();
+	evict();
+
+	return tile;
+}
+
+void TileCache::evict() {
+	/* Never evict the most recently inserted tile */
+	while (m_size > m_maxSize && m_lru.size() > 1) {
+		Entry &entry = m_lru.back();
+		m_size -= entry.tile->getSize();
+		m_entries.erase(entry.key);
+		m_lru.pop_back();
+		++stats::tileCacheEvictions;
+	}
+}
+
+std::string TileCache::toString() const {
+	LockGuard lock(m_mutex);
+	std::ostringstream oss;
+	oss << "TileCache[" << endl
+		<< "  maxSize = " << memString(m_maxSize) << "," << endl
+		<< "  size = " << memString(m_size) << "," << endl
+		<< "  tiles = " << m_lru.size() << "," << endl
+		<< "  sources = " << m_sources.size() << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(TileCache::Tile, false, Object)
+MTS_IMPLEMENT_CLASS(TileCache, false, Object)
+MTS_NAMESPACE_END
@@ -0,0 +1,129 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/timetag.h>
+
+MTS_NAMESPACE_BEGIN
+
+/* File identifier and version of the time-tag format */
+#define MTS_TIMETAG_MAGIC "MTT"
+#define MTS_TIMETAG_VERSION 1
+
+/* Offset of the event count within the header */
+#define MTS_TIMETAG_COUNT_OFFSET 4
+
+TimeTagFile::TimeTagFile(const fs::path &path, const Header &header)
+		: m_header(header), m_eventsRead(0), m_write(true) {
+	m_stream = new FileStream(path, FileStream::ETruncReadWrite);
+	m_stream->setByteOrder(Stream::ELittleEndian);
+	m_header.eventCount = 0;
+	writeHeader();
+}
+
+TimeTagFile::TimeTagFile(const fs::path &path)
+		: m_eventsRead(0), m_write(false) {
+	m_stream = new FileStream(path, FileStream::EReadOnly);
+	m_stream->setByteOrder(Stream::ELittleEndian);
+	readHeader();
+}
+
+TimeTagFile::~TimeTagFile() {
+	if (m_stream)
+		close();
+}
+
+void TimeTagFile::writeHeader() {
+	m_stream->write(MTS_TIMETAG_MAGIC, 3);
+	m_stream->writeUChar(MTS_TIMETAG_VERSION);
+	m_stream->writeULong(m_header.eventCount);
+	m_stream->writeInt(m_header.size.x);
+	m_stream->writeInt(m_header.size.y);
+	m_stream->writeULong(m_header.sampleCount);
+	m_stream->writeUInt((uint32_t) m_header.decompositionType);
+	m_stream->writeSingle((float) m_header.minBound);
+	m_stream->writeSingle((float) m_header.maxBound);
+	m_stream->writeSingle((float) m_header.binWidth);
+}
+
+void TimeTagFile::readHeader() {
+	char magic[3];
+	m_stream->read(magic, 3);
+	if (memcmp(magic, MTS_TIMETAG_MAGIC, 3) != 0)
+		Log(EError, "\"%s\" is not a time-tag file!",
+			m_stream->getPath().string().c_str());
+	uint8_t version = m_stream->readUChar();
+	if (version != MTS_TIMETAG_VERSION)
+		Log(EError, "Unsupported time-tag file version %i (expected %i)",
+			(int) version, MTS_TIMETAG_VERSION);
+	m_header.eventCount = m_stream->readULong();
+	m_header.size.x = m_stream->readInt();
+	m_header.size.y = m_stream->readInt();
+	m_header.sampleCount = m_stream->readULong();
+	m_header.decompositionType = (Film::EDecompositionType) m_stream->readUInt();
+	m_header.minBound = (Float) m_stream->readSingle();
+	m_header.maxBound = (Float) m_stream->readSingle();
+	m_header.binWidth = (Float) m_stream->readSingle();
+}
+
+void TimeTagFile::append(const std::vector<TimeTagEvent> &events) {
+	if (!m_write || !m_stream)
+		Log(EError, "append(): the time-tag file is not open for writing!");
+	for (size_t i=0; i<events.size(); ++i)
+		events[i].serialize(m_stream);
+	m_header.eventCount += events.size();
+}
+
+size_t TimeTagFile::read(std::vector<TimeTagEvent> &events, size_t maxCount) {
+	if (m_write || !m_stream)
+		Log(EError, "read(): the time-tag file is not open for reading!");
+	size_t count = (size_t) std::min((uint64_t) maxCount,
+		m_header.eventCount - m_eventsRead);
+	events.clear();
+	events.reserve(count);
+	for (size_t i=0; i<count; ++i)
+		events.push_back(TimeTagEvent(m_stream));
+	m_eventsRead += count;
+	return count;
+}
+
+void TimeTagFile::close() {
+	if (!m_stream)
+		return;
+	if (m_write) {
+		m_stream->seek(MTS_TIMETAG_COUNT_OFFSET);
+		m_stream->writeULong(m_header.eventCount);
+		m_stream->flush();
+	}
+	m_stream->close();
+	m_stream = NULL;
+}
+
+std::string TimeTagFile::toString() const {
+	std::ostringstream oss;
+	oss << "TimeTagFile[" << endl
+		<< "  size = " << m_header.size.toString() << "," << endl
+		<< "  sampleCount = " << m_header.sampleCount << "," << endl
+		<< "  range = [" << m_header.minBound << ", " << m_header.maxBound << "]," << endl
+		<< "  binWidth = " << m_header.binWidth << "," << endl
+		<< "  eventCount = " << m_header.eventCount << endl
+		<< "]";
+	return oss.str();
+}
+
+MTS_IMPLEMENT_CLASS(TimeTagFile, false, Object)
+MTS_NAMESPACE_END
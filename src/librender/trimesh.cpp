@@ -50,6 +50,11 @@ TriMesh::TriMesh(const std::string &name, size_t triangleCount,
 	m_texcoords = hasTexcoords ? new Point2[m_vertexCount] : NULL;
 	m_colors = hasVertexColors ? new Color3[m_vertexCount] : NULL;
 	m_tangents = NULL;
+	m_compact = false;
+	m_packedTriangles = NULL;
+	m_triangleBlocks = NULL;
+	m_packedNormals = NULL;
+	m_packedTexcoords = NULL;
 	m_surfaceArea = m_invSurfaceArea = -1;
 	m_mutex = new Mutex();
 }
@@ -57,7 +62,8 @@ TriMesh::TriMesh(const std::string &name, size_t triangleCount,
 TriMesh::TriMesh(const Properties &props)
  : Shape(props), m_triangles(NULL), m_positions(NULL),
 	m_normals(NULL), m_texcoords(NULL), m_tangents(NULL),
-	m_colors(NULL) {
+	m_colors(NULL), m_packedTriangles(NULL), m_triangleBlocks(NULL),
+	m_packedNormals(NULL), m_packedTexcoords(NULL) {
 
 	/* By default, any existing normals will be used for
 	   rendering. If no normals are found, Mitsuba will
@@ -71,6 +77,10 @@ TriMesh::TriMesh(const Properties &props)
 	/* Causes all normals to be flipped */
 	m_flipNormals = props.getBoolean("flipNormals", false);
 
+	/* Store the mesh in compact form after loading (quantized normals
+	   and texture coordinates, compressed indices). See TriMesh::compact() */
+	m_compact = props.getBoolean("compact", false);
+
 	m_triangles = NULL;
 	m_surfaceArea = m_invSurfaceArea = -1;
 	m_mutex = new Mutex();
@@ -79,7 +89,9 @@ TriMesh::TriMesh(const Properties &props)
 TriMesh::TriMesh(Stream *stream, int index)
 		: Shape(Properties()), m_triangles(NULL),
 	m_positions(NULL), m_normals(NULL), m_texcoords(NULL),
-	m_tangents(NULL), m_colors(NULL) {
+	m_tangents(NULL), m_colors(NULL), m_compact(false),
+	m_packedTriangles(NULL), m_triangleBlocks(NULL),
+	m_packedNormals(NULL), m_packedTexcoords(NULL) {
 
 	m_mutex = new Mutex();
 	loadCompressed(stream, index);
@@ -92,18 +104,21 @@ enum ETriMeshFlags {
 	EHasTangents     = 0x0004, // unused
 	EHasColors       = 0x0008,
 	EFaceNormals     = 0x0010,
+	ECompact         = 0x0020,
 	ESinglePrecision = 0x1000,
 	EDoublePrecision = 0x2000
 };
 
 TriMesh::TriMesh(Stream *stream, InstanceManager *manager)
-	: Shape(stream, manager), m_tangents(NULL) {
+	: Shape(stream, manager), m_tangents(NULL), m_packedTriangles(NULL),
+	  m_triangleBlocks(NULL), m_packedNormals(NULL), m_packedTexcoords(NULL) {
 	m_name = stream->readString();
 	m_aabb = AABB(stream);
 
 	uint32_t flags = stream->readUInt();
 	m_vertexCount = stream->readSize();
 	m_triangleCount = stream->readSize();
+	m_compact = flags & ECompact;
 
 	m_positions = new Point[m_vertexCount];
 	stream->readFloatArray(reinterpret_cast<Float *>(m_positions),
@@ -349,6 +364,14 @@ TriMesh::~TriMesh() {
 		delete[] m_colors;
 	if (m_triangles)
 		delete[] m_triangles;
+	if (m_packedTriangles)
+		delete[] m_packedTriangles;
+	if (m_triangleBlocks)
+		delete[] m_triangleBlocks;
+	if (m_packedNormals)
+		delete[] m_packedNormals;
+	if (m_packedTexcoords)
+		delete[] m_packedTexcoords;
 }
 
 AABB TriMesh::getAABB() const {
@@ -362,6 +385,10 @@ Float TriMesh::pdfPosition(const PositionSamplingRecord &pRec) const {
 void TriMesh::configure() {
 	Shape::configure();
 
+	/* Compact meshes were already configured before being compacted */
+	if (isCompact())
+		return;
+
 	if (!m_aabb.isValid()) {
 		/* Most shape objects should compute the AABB while
 		   loading the geometry -- but let's be on the safe side */
@@ -381,8 +408,133 @@ void TriMesh::configure() {
 		computeUVTangents();
 
 	/* For manifold exploration: always compute UV tangents when a glossy material
-	   is involved. TODO: find a way to avoid this expense (compute on demand?) */
-	computeUVTangents();
+	   is involved. TODO: find a way to avoid this expense (compute on demand?)
+	   Compact meshes skip this, since the tangents cost 24 bytes per triangle */
+	if (!m_compact)
+		computeUVTangents();
+	else
+		compact();
+}
+
+/* Zig-zag + LEB128 coding of the index deltas of compact meshes */
+static inline void writeVarint(std::vector<uint8_t> &buf, int64_t delta) {
+	uint64_t value = ((uint64_t) delta << 1) ^ (uint64_t) (delta >> 63);
+	while (value >= 0x80) {
+		buf.push_back((uint8_t) (value | 0x80));
+		value >>= 7;
+	}
+	buf.push_back((uint8_t) value);
+}
+
+static inline int64_t readVarint(const uint8_t *&ptr) {
+	uint64_t value = 0;
+	int shift = 0;
+	uint8_t byte;
+	do {
+		byte = *ptr++;
+		value |= (uint64_t) (byte & 0x7F) << shift;
+		shift += 7;
+	} while (byte & 0x80);
+	return (int64_t) (value >> 1) ^ -(int64_t) (value & 1);
+}
+
+void TriMesh::compact() {
+	if (isCompact())
+		return;
+
+	ref<Timer> timer = new Timer();
+	size_t before = m_triangleCount * sizeof(Triangle)
+		+ (m_normals ? m_vertexCount * sizeof(Normal) : 0)
+		+ (m_texcoords ? m_vertexCount * sizeof(Point2) : 0);
+
+	/* Indices: every block of triangles is delta-encoded starting from zero,
+	   so that each block can be decoded independently. Consecutive indices
+	   of well-ordered (e.g. stripified or scan-order) meshes differ by small
+	   amounts and mostly take one byte */
+	size_t blockCount = (m_triangleCount + ETriangleBlockSize - 1) / ETriangleBlockSize;
+	std::vector<uint8_t> buf;
+	buf.reserve(m_triangleCount * 4);
+	m_triangleBlocks = new uint64_t[blockCount + 1];
+	for (size_t block=0; block<blockCount; ++block) {
+		m_triangleBlocks[block] = buf.size();
+		size_t start = block * ETriangleBlockSize,
+		       end = std::min(start + ETriangleBlockSize, m_triangleCount);
+		int64_t prev = 0;
+		for (size_t i=start; i<end; ++i) {
+			for (int j=0; j<3; ++j) {
+				int64_t idx = m_triangles[i].idx[j];
+				writeVarint(buf, idx - prev);
+				prev = idx;
+			}
+		}
+	}
+	m_triangleBlocks[blockCount] = buf.size();
+	m_packedTriangles = new uint8_t[std::max(buf.size(), (size_t) 1)];
+	if (!buf.empty())
+		memcpy(m_packedTriangles, &buf[0], buf.size());
+	delete[] m_triangles;
+	m_triangles = NULL;
+	size_t after = buf.size() + (blockCount + 1) * sizeof(uint64_t);
+
+	if (m_normals) {
+		m_packedNormals = new uint32_t[m_vertexCount];
+		for (size_t i=0; i<m_vertexCount; ++i)
+			m_packedNormals[i] = packOctahedralNormal(m_normals[i]);
+		delete[] m_normals;
+		m_normals = NULL;
+		after += m_vertexCount * sizeof(uint32_t);
+	}
+
+	if (m_texcoords) {
+		/* Quantize relative to the bounding box of the texture coordinates */
+		Point2 uvMin(std::numeric_limits<Float>::infinity()),
+		       uvMax(-std::numeric_limits<Float>::infinity());
+		for (size_t i=0; i<m_vertexCount; ++i) {
+			uvMin.x = std::min(uvMin.x, m_texcoords[i].x);
+			uvMin.y = std::min(uvMin.y, m_texcoords[i].y);
+			uvMax.x = std::max(uvMax.x, m_texcoords[i].x);
+			uvMax.y = std::max(uvMax.y, m_texcoords[i].y);
+		}
+		if (m_vertexCount == 0)
+			uvMin = uvMax = Point2(0.0f);
+		m_texcoordOffset = uvMin;
+		m_texcoordScale = (uvMax - uvMin) / (Float) 65535;
+		Vector2 invScale(
+			m_texcoordScale.x > 0 ? 1 / m_texcoordScale.x : 0,
+			m_texcoordScale.y > 0 ? 1 / m_texcoordScale.y : 0);
+
+		m_packedTexcoords = new uint16_t[2 * m_vertexCount];
+		for (size_t i=0; i<m_vertexCount; ++i) {
+			Vector2 rel = m_texcoords[i] - uvMin;
+			m_packedTexcoords[2*i]   = (uint16_t) math::clamp(
+				math::roundToInt(rel.x * invScale.x), 0, 65535);
+			m_packedTexcoords[2*i+1] = (uint16_t) math::clamp(
+				math::roundToInt(rel.y * invScale.y), 0, 65535);
+		}
+		delete[] m_texcoords;
+		m_texcoords = NULL;
+		after += m_vertexCount * 2 * sizeof(uint16_t);
+	}
+
+	Log(EDebug, "Compacted mesh \"%s\" in %i ms (%s -> %s)", m_name.c_str(),
+		timer->getMilliseconds(), memString(before).c_str(), memString(after).c_str());
+}
+
+Triangle TriMesh::decodeTriangle(size_t i) const {
+	size_t block = i / ETriangleBlockSize;
+	const uint8_t *ptr = m_packedTriangles + m_triangleBlocks[block];
+	int64_t prev = 0;
+
+	/* Skip the preceding triangles of the block */
+	for (size_t k = (i % ETriangleBlockSize) * 3; k > 0; --k)
+		prev += readVarint(ptr);
+
+	Triangle tri;
+	for (int j=0; j<3; ++j) {
+		prev += readVarint(ptr);
+		tri.idx[j] = (uint32_t) prev;
+	}
+	return tri;
 }
 
 void TriMesh::prepareSamplingTable() {
@@ -396,7 +548,7 @@ void TriMesh::prepareSamplingTable() {
 		/* Generate a PDF for sampling wrt. area */
 		m_areaDistr.reserve(m_triangleCount);
 		for (size_t i=0; i<m_triangleCount; i++)
-			m_areaDistr.append(m_triangles[i].surfaceArea(m_positions));
+			m_areaDistr.append(getTriangle(i).surfaceArea(m_positions));
 		m_surfaceArea = m_areaDistr.normalize();
 		m_invSurfaceArea = 1.0f / m_surfaceArea;
 	}
@@ -416,8 +568,26 @@ void TriMesh::samplePosition(PositionSamplingRecord &pRec,
 
 	Point2 sample(_sample);
 	size_t index = m_areaDistr.sampleReuse(sample.y);
-	pRec.p = m_triangles[index].sample(m_positions, m_normals,
-		m_texcoords, pRec.n, pRec.uv, sample);
+	if (EXPECT_TAKEN(!isCompact())) {
+		pRec.p = m_triangles[index].sample(m_positions, m_normals,
+			m_texcoords, pRec.n, pRec.uv, sample);
+	} else {
+		/* Gather the decoded vertex data into a local triangle */
+		Triangle tri = decodeTriangle(index), local;
+		Point positions[3];
+		Normal normals[3];
+		Point2 texcoords[3];
+		for (int j=0; j<3; ++j) {
+			local.idx[j] = j;
+			positions[j] = m_positions[tri.idx[j]];
+			if (m_packedNormals)
+				normals[j] = getVertexNormal(tri.idx[j]);
+			if (m_packedTexcoords)
+				texcoords[j] = getVertexTexcoord(tri.idx[j]);
+		}
+		pRec.p = local.sample(positions, m_packedNormals ? normals : NULL,
+			m_packedTexcoords ? texcoords : NULL, pRec.n, pRec.uv, sample);
+	}
 	pRec.pdf = m_invSurfaceArea;
 	pRec.measure = EArea;
 }
@@ -468,6 +638,10 @@ struct TopoData {
 void TriMesh::rebuildTopology(Float maxAngle) {
 	typedef std::multimap<Vertex, TopoData, vertex_key_order> MMap;
 	typedef std::pair<Vertex, TopoData> MPair;
+
+	if (isCompact())
+		Log(EError, "\"%s\": rebuildTopology(): compact meshes cannot be modified!",
+			m_name.c_str());
 	const Float dpThresh = std::cos(degToRad(maxAngle));
 	size_t degenerateTriangles = 0;
 
@@ -607,6 +781,9 @@ void TriMesh::rebuildTopology(Float maxAngle) {
 
 void TriMesh::computeNormals(bool force) {
 	int invalidNormals = 0;
+	if (isCompact())
+		Log(EError, "\"%s\": computeNormals(): compact meshes cannot be modified!",
+			m_name.c_str());
 	if (m_faceNormals) {
 		if (m_normals) {
 			delete[] m_normals;
@@ -682,6 +859,9 @@ void TriMesh::computeNormals(bool force) {
 
 void TriMesh::computeUVTangents() {
 	// int degenerate = 0;
+	if (isCompact())
+		Log(EError, "\"%s\": computeUVTangents(): compact meshes cannot be modified!",
+			m_name.c_str());
 	if (!m_texcoords) {
 		bool anisotropic = hasBSDF() && m_bsdf->getType() & BSDF::EAnisotropic;
 		if (anisotropic)
@@ -744,12 +924,12 @@ void TriMesh::computeUVTangents() {
 
 void TriMesh::getNormalDerivative(const Intersection &its,
 		Vector &dndu, Vector &dndv, bool shadingFrame) const {
-	if (!shadingFrame || !m_normals) {
+	if (!shadingFrame || !hasVertexNormals()) {
 		dndu = dndv = Vector(0.0f);
 	} else {
 		Assert(its.primIndex < m_triangleCount);
 
-		const Triangle &tri = m_triangles[its.primIndex];
+		const Triangle tri = getTriangle(its.primIndex);
 
 		uint32_t idx0 = tri.idx[0],
 				 idx1 = tri.idx[1],
@@ -780,9 +960,9 @@ void TriMesh::getNormalDerivative(const Intersection &its,
 		      w = 1 - u - v;
 
 		const Normal
-			&n0 = m_normals[idx0],
-			&n1 = m_normals[idx1],
-			&n2 = m_normals[idx2];
+			n0 = getVertexNormal(idx0),
+			n1 = getVertexNormal(idx1),
+			n2 = getVertexNormal(idx2);
 
 		/* Now compute the derivative of "normalize(u*n1 + v*n2 + (1-u-v)*n0)"
 		   with respect to [u, v] in the local triangle parameterization.
@@ -797,13 +977,13 @@ void TriMesh::getNormalDerivative(const Intersection &its,
 		dndu = (n1 - n0) * il; dndu -= N * dot(N, dndu);
 		dndv = (n2 - n0) * il; dndv -= N * dot(N, dndv);
 
-		if (m_texcoords) {
+		if (hasVertexTexcoords()) {
 			/* Compute derivatives with respect to a specified texture
 			   UV parameterization.  */
 			const Point2
-				&uv0 = m_texcoords[idx0],
-				&uv1 = m_texcoords[idx1],
-				&uv2 = m_texcoords[idx2];
+				uv0 = getVertexTexcoord(idx0),
+				uv1 = getVertexTexcoord(idx1),
+				uv2 = getVertexTexcoord(idx2);
 
 			Vector2 duv1 = uv1 - uv0, duv2 = uv2 - uv0;
 
@@ -829,14 +1009,16 @@ ref<TriMesh> TriMesh::createTriMesh() {
 void TriMesh::serialize(Stream *stream, InstanceManager *manager) const {
 	Shape::serialize(stream, manager);
 	uint32_t flags = 0;
-	if (m_normals)
+	if (hasVertexNormals())
 		flags |= EHasNormals;
-	if (m_texcoords)
+	if (hasVertexTexcoords())
 		flags |= EHasTexcoords;
 	if (m_colors)
 		flags |= EHasColors;
 	if (m_faceNormals)
 		flags |= EFaceNormals;
+	if (m_compact)
+		flags |= ECompact;
 	stream->writeString(m_name);
 	m_aabb.serialize(stream);
 	stream->writeUInt(flags);
@@ -851,11 +1033,26 @@ void TriMesh::serialize(Stream *stream, InstanceManager *manager) const {
 	if (m_texcoords)
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_texcoords),
 			m_vertexCount * sizeof(Point2)/sizeof(Float));
+	if (m_packedNormals) {
+		/* Compact meshes are sent in decoded form and compacted again
+		   by the receiver */
+		for (size_t i=0; i<m_vertexCount; ++i)
+			getVertexNormal(i).serialize(stream);
+	}
+	if (m_packedTexcoords) {
+		for (size_t i=0; i<m_vertexCount; ++i)
+			getVertexTexcoord(i).serialize(stream);
+	}
 	if (m_colors)
 		stream->writeFloatArray(reinterpret_cast<Float *>(m_colors),
 			m_vertexCount * sizeof(Color3)/sizeof(Float));
-	stream->writeUIntArray(reinterpret_cast<uint32_t *>(m_triangles),
-		m_triangleCount * sizeof(Triangle)/sizeof(uint32_t));
+	if (m_triangles) {
+		stream->writeUIntArray(reinterpret_cast<uint32_t *>(m_triangles),
+			m_triangleCount * sizeof(Triangle)/sizeof(uint32_t));
+	} else {
+		for (size_t i=0; i<m_triangleCount; ++i)
+			stream->writeUIntArray(decodeTriangle(i).idx, 3);
+	}
 }
 
 ref<TriMesh> TriMesh::fromBlender(const std::string &name,
@@ -1006,6 +1203,10 @@ ref<TriMesh> TriMesh::fromBlender(const std::string &name,
 }
 
 void TriMesh::writeOBJ(const fs::path &path) const {
+	if (isCompact())
+		Log(EError, "\"%s\": writeOBJ(): compact meshes cannot be exported!",
+			m_name.c_str());
+
 	fs::ofstream os(path);
 	os << "o " << m_name << endl;
 	for (size_t i=0; i<m_vertexCount; ++i) {
@@ -1054,6 +1255,10 @@ void TriMesh::writeOBJ(const fs::path &path) const {
 }
 
 void TriMesh::writePLY(const fs::path &path) const {
+	if (isCompact())
+		Log(EError, "\"%s\": writePLY(): compact meshes cannot be exported!",
+			m_name.c_str());
+
 	fs::ofstream os(path, std::ios::out | std::ios::binary);
 
 	os << "ply\n";
@@ -1131,6 +1336,10 @@ void TriMesh::writePLY(const fs::path &path) const {
 void TriMesh::serialize(Stream *_stream) const {
 	ref<Stream> stream = _stream;
 
+	if (isCompact())
+		Log(EError, "\"%s\": compact meshes cannot be written to the "
+			"serialized mesh format!", m_name.c_str());
+
 	if (stream->getByteOrder() != Stream::ELittleEndian)
 		Log(EError, "Tried to unserialize a shape from a stream, "
 			"which was not previously set to little endian byte order!");
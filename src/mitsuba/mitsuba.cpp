@@ -34,6 +34,7 @@
 #include <mitsuba/core/statistics.h>
 #include <mitsuba/render/renderjob.h>
 #include <mitsuba/render/scenehandler.h>
+#include <mitsuba/render/tilecache.h>
 #include <fstream>
 #include <stdexcept>
 #include <boost/algorithm/string.hpp>
@@ -79,7 +80,11 @@ void help() {
 	cout <<  "   -r sec      Write (partial) output images every 'sec' seconds" << endl << endl;
 	cout <<  "   -b res      Specify the block resolution used to split images into parallel" << endl;
 	cout <<  "               workloads (default: 32). Only applies to some integrators." << endl << endl;
+	cout <<  "   -T size     Limit the memory used by texture MIP maps: coarser levels are" << endl;
+	cout <<  "               generated on demand and kept in a tile cache of 'size' MiB" << endl << endl;
 	cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
+	cout <<  "   -N          NUMA mode: keep workers on their NUMA node and replicate read-only" << endl;
+	cout <<  "               acceleration data structures (e.g. kd-trees) on every node" << endl << endl;
 	cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
 	cout <<  "   -w          Treat warnings as errors" << endl << endl;
 	cout <<  "   -z          Disable progress bars" << endl << endl;
@@ -139,7 +144,7 @@ int mitsuba_app(int argc, char **argv) {
 		bool quietMode = false, progressBars = true, skipExisting = false;
 		ELogLevel logLevel = EInfo;
 		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
-		bool treatWarningsAsErrors = false;
+		bool treatWarningsAsErrors = false, numaMode = false;
 		std::map<std::string, std::string, SimpleStringOrdering> parameters;
 		int blockSize = 32;
 		int flushTimer = -1;
@@ -151,7 +156,7 @@ int mitsuba_app(int argc, char **argv) {
 
 		optind = 1;
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:qhzvtwx")) != -1) {
+		while ((optchar = getopt(argc, argv, "a:c:D:s:j:n:o:r:b:p:L:T:Nqhzvtwx")) != -1) {
 			switch (optchar) {
 				case 'a': {
 						std::vector<std::string> paths = tokenize(optarg, ";");
@@ -237,12 +242,22 @@ int mitsuba_app(int argc, char **argv) {
 					if (blockSize < 2 || blockSize > 128)
 						SLog(EError, "Invalid block size (should be in the range 2-128)");
 					break;
+				case 'T': {
+						long cacheSize = strtol(optarg, &end_ptr, 10);
+						if (*end_ptr != '\0' || cacheSize < 0)
+							SLog(EError, "Could not parse the tile cache size!");
+						TileCache::getInstance()->setMaxSize((size_t) cacheSize * 1024 * 1024);
+					}
+					break;
 				case 'z':
 					progressBars = false;
 					break;
 				case 'q':
 					quietMode = true;
 					break;
+				case 'N':
+					numaMode = true;
+					break;
 				case 'h':
 				default:
 					help();
@@ -273,13 +288,25 @@ int mitsuba_app(int argc, char **argv) {
 
 		SLog(EInfo, "Mitsuba version %s, Copyright (c) " MTS_YEAR " Wenzel Jakob",
 				Version(MTS_VERSION).toStringComplete().c_str());
+		SLog(EDebug, "Using %s kernels where available",
+				getSIMDLevelName(getSIMDLevel()));
+
+		if (numaMode) {
+			setNUMAReplication(true);
+			SLog(EInfo, "NUMA mode: %i node(s) detected", getNUMANodeCount());
+		}
 
 		/* Configure the scheduling subsystem */
 		Scheduler *scheduler = Scheduler::getInstance();
 		bool useCoreAffinity = nprocs == nprocs_avail;
-		for (int i=0; i<nprocs; ++i)
-			scheduler->registerWorker(new LocalWorker(useCoreAffinity ? i : -1,
-				formatString("wrk%i", i)));
+		for (int i=0; i<nprocs; ++i) {
+			ref<LocalWorker> worker = new LocalWorker(useCoreAffinity ? i : -1,
+				formatString("wrk%i", i));
+			/* Keep unpinned workers from migrating between NUMA nodes */
+			if (numaMode && !useCoreAffinity)
+				worker->setNUMANodeAffinity(i % getNUMANodeCount());
+			scheduler->registerWorker(worker);
+		}
 		std::vector<std::string> hosts = tokenize(networkHosts, ";");
 
 		/* Establish network connections to nested servers */
@@ -101,15 +101,17 @@ int mtssrv(int argc, char **argv) {
 			listenPort = MTS_DEFAULT_PORT;
 		std::string nodeName = getHostName(),
 					networkHosts = "";
-		bool quietMode = false;
+		bool quietMode = false, numaMode = false;
 		ELogLevel logLevel = EInfo;
 		std::string hostName = getFQDN();
 		FileResolver *fileResolver = Thread::getThread()->getFileResolver();
 		bool hostNameSet = false;
+		size_t cacheMemory = MTS_DEFAULT_RESOURCE_CACHE;
+		std::string cacheDirectory;
 
 		optind = 1;
 		/* Parse command-line arguments */
-		while ((optchar = getopt(argc, argv, "a:c:s:n:p:i:l:L:qhv")) != -1) {
+		while ((optchar = getopt(argc, argv, "a:c:s:n:p:i:l:L:C:M:Nqhv")) != -1) {
 			switch (optchar) {
 				case 'a': {
 						std::vector<std::string> paths = tokenize(optarg, ";");
@@ -147,6 +149,14 @@ int mtssrv(int argc, char **argv) {
 				case 'v':
 					logLevel = EDebug;
 					break;
+				case 'C':
+					cacheDirectory = optarg;
+					break;
+				case 'M':
+					cacheMemory = (size_t) strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0')
+						SLog(EError, "Could not parse the resource cache size!");
+					break;
 				case 'L': {
 						std::string arg = boost::to_lower_copy(std::string(optarg));
 						if (arg == "trace")
@@ -176,6 +186,9 @@ int mtssrv(int argc, char **argv) {
 				case 'q':
 					quietMode = true;
 					break;
+				case 'N':
+					numaMode = true;
+					break;
 				case 'h':
 				default:
 					cout <<  "Mitsuba version " << Version(MTS_VERSION).toStringComplete()
@@ -202,6 +215,12 @@ int mtssrv(int argc, char **argv) {
 					cout <<  "               To listen on stdin, specify \"-ls\" (implies -q)" << endl << endl;
 					cout <<  "   -n name     Assign a node name to this instance (Default: host name)" << endl << endl;
 					cout <<  "   -v          Be more verbose (can be specified twice)" << endl << endl;
+					cout <<  "   -N          NUMA mode: keep workers on their NUMA node and replicate read-only" << endl;
+					cout <<  "               acceleration data structures (e.g. kd-trees) on every node" << endl << endl;
+					cout <<  "   -M size     Amount of memory (in MiB) used to cache resources such as" << endl;
+					cout <<  "               scenes between jobs, so that they are only transmitted once" << endl;
+					cout <<  "               (Default: " << MTS_DEFAULT_RESOURCE_CACHE << ", 0 disables the in-memory cache)" << endl << endl;
+					cout <<  "   -C dir      Additionally keep cached resources in the given directory" << endl << endl;
 					cout <<  "   -L level    Explicitly specify the log level (trace/debug/info/warn/error)" << endl << endl;
 					cout <<  " For documentation, please refer to http://www.mitsuba-renderer.org/docs.html" << endl;
 					return 0;
@@ -234,6 +253,11 @@ int mtssrv(int argc, char **argv) {
 		SetConsoleCtrlHandler((PHANDLER_ROUTINE) CtrlHandler, TRUE);
 #endif
 
+		if (numaMode) {
+			setNUMAReplication(true);
+			SLog(EInfo, "NUMA mode: %i node(s) detected", getNUMANodeCount());
+		}
+
 		/* Configure the scheduling subsystem */
 		Scheduler *scheduler = Scheduler::getInstance();
 		for (int i=0; i<nprocs; ++i)
@@ -285,9 +309,13 @@ int mtssrv(int argc, char **argv) {
 		}
 		scheduler->start();
 
+		/* Resource cache shared by all connections */
+		ref<ResourceCache> cache = new ResourceCache(cacheMemory * 1024 * 1024,
+			fs::path(cacheDirectory));
+
 		if (listenPort == -1) {
 			ref<StreamBackend> backend = new StreamBackend("con0",
-					scheduler, nodeName, new ConsoleStream(), false);
+					scheduler, nodeName, new ConsoleStream(), false, cache);
 			backend->start();
 			backend->join();
 			return 0;
@@ -385,7 +413,7 @@ int mtssrv(int argc, char **argv) {
 			}
 
 			ref<StreamBackend> backend = new StreamBackend(formatString("con%i", connectionIndex++),
-				scheduler, nodeName, new SocketStream(newSocket), true);
+				scheduler, nodeName, new SocketStream(newSocket), true, cache);
 			backend->start();
 		}
 #if defined(__WINDOWS__)
@@ -26,6 +26,11 @@ MTS_NAMESPACE_BEGIN
  *     \parameter{sampleCount}{\Integer}{
  *       Number of samples per pixel \default{4}
  *     }
+ *     \parameter{seed}{\Integer}{
+ *       Seed of the pseudorandom number generator. Renderings that are
+ *       later combined (e.g. when refining a film) must use different
+ *       seeds. \default{the generator's built-in seed}
+ *     }
  * }
  *
  * \renderings{
@@ -55,7 +60,10 @@ public:
 	IndependentSampler(const Properties &props) : Sampler(props) {
 		/* Number of samples per pixel when used with a sampling-based integrator */
 		m_sampleCount = props.getSize("sampleCount", 4);
-		m_random = new Random();
+		if (props.hasProperty("seed"))
+			m_random = new Random((uint64_t) props.getLong("seed"));
+		else
+			m_random = new Random();
 	}
 
 	IndependentSampler(Stream *stream, InstanceManager *manager)
@@ -36,6 +36,11 @@ MTS_NAMESPACE_BEGIN
  *       increase both storage and computational costs.
  *       \default{4}
  *     }
+ *     \parameter{seed}{\Integer}{
+ *       Seed of the pseudorandom number generator. Renderings that are
+ *       later combined (e.g. when refining a film) must use different
+ *       seeds. \default{the generator's built-in seed}
+ *     }
  * }
  * \vspace{-2mm}
  * \renderings{
@@ -94,7 +99,10 @@ public:
 			m_samples2D[i] = new Point2[m_sampleCount];
 		}
 
-		m_random = new Random();
+		if (props.hasProperty("seed"))
+			m_random = new Random((uint64_t) props.getLong("seed"));
+		else
+			m_random = new Random();
 	}
 
 	LowDiscrepancySampler(Stream *stream, InstanceManager *manager)
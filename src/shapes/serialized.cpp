@@ -57,6 +57,13 @@ extern MTS_EXPORT_RENDER void pushSceneCleanupHandler(void (*cleanup)());
  *       Optional flag to flip all normals. \default{\code{false}, i.e.
  *       the normals are left unchanged}.
  *	   }
+ *     \parameter{compact}{\Boolean}{
+ *       Store the mesh in a compact form that quantizes normals and texture
+ *       coordinates and compresses the triangle indices. This roughly halves
+ *       the memory usage of large meshes at a small cost in intersection
+ *       performance. Compact meshes cannot be displayed by the real-time
+ *       preview unless they are uploaded to the GPU. \default{\code{false}}
+ *	   }
  *     \parameter{toWorld}{\Transform\Or\Animation}{
  *	      Specifies an optional linear object-to-world transformation.
  *        \default{none (i.e. object space $=$ world space)}
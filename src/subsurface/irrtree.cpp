@@ -81,12 +81,20 @@ void IrradianceOctree::propagate(OctreeNode *node) {
 		}
 		statsNumSamples += node->count;
 	} else {
-		/* Inner node */
+		/* Inner node -- the subtrees below the root node are
+		   processed in parallel */
+#if defined(MTS_OPENMP)
+		#pragma omp parallel for schedule(dynamic) if (node == m_root && m_items.size() > 65536)
+#endif
+		for (int i=0; i<8; i++) {
+			if (node->children[i])
+				propagate(node->children[i]);
+		}
+
 		for (int i=0; i<8; i++) {
 			OctreeNode *child = node->children[i];
 			if (!child)
 				continue;
-			propagate(child);
 			repr.E += child->data.E * child->data.area;
 			repr.area += child->data.area;
 			Float weight = child->data.E.getLuminance() * child->data.area;
@@ -1489,6 +1489,9 @@ public:
 			const TriMesh *triMesh = static_cast<const TriMesh *>(its.shape);
 			const Point *positions = triMesh->getVertexPositions();
 			const Vector *normals = triMesh->getVertexNormals();
+			if (triMesh->isCompact())
+				Log(EError, "The non-fast single scattering mode does not "
+					"support compact meshes (\"%s\")", triMesh->getName().c_str());
 
 			size_t numTriangles = triMesh->getTriangleCount();
 			bool *doneThisTriangleBefore = new bool[numTriangles];
@@ -0,0 +1,145 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/bitmap.h>
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/scene.h>
+#include <mitsuba/render/renderqueue.h>
+#include <mitsuba/render/renderjob.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * This testcase renders a small scene with the bidirectional path tracer,
+ * once in full and once restricted to a pixel mask, and checks that both
+ * agree on the pixels of the mask
+ */
+class TestBDPTRegionOfInterest : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_pixelMask)
+	MTS_END_TESTCASE()
+
+	/// Instantiate and configure a plugin
+	ConfigurableObject *create(const Class *theClass, const Properties &props,
+			ConfigurableObject *child1 = NULL, ConfigurableObject *child2 = NULL) {
+		ConfigurableObject *object = PluginManager::getInstance()->createObject(theClass, props);
+		if (child1)
+			object->addChild(child1);
+		if (child2)
+			object->addChild(child2);
+		object->configure();
+		return object;
+	}
+
+	/// A closed diffuse box lit by a spherical area light
+	ref<Scene> createScene(const fs::path &roiMask, uint32_t seed) {
+		Properties filmProps("hdrfilm");
+		filmProps.setInteger("width", 16);
+		filmProps.setInteger("height", 16);
+		if (!roiMask.empty())
+			filmProps.setString("roiMask", roiMask.string());
+
+		Properties samplerProps("independent");
+		samplerProps.setInteger("sampleCount", 256);
+		samplerProps.setInteger("seed", (int) seed);
+
+		Properties sensorProps("perspective");
+		sensorProps.setTransform("toWorld", Transform::lookAt(
+			Point(0, 0, 3), Point(0, 0, 0), Vector(0, 1, 0)));
+
+		Properties integratorProps("bdpt");
+		integratorProps.setInteger("maxDepth", 3);
+		integratorProps.setBoolean("lightImage", true);
+
+		Properties boxProps("cube");
+		boxProps.setTransform("toWorld", Transform::scale(Vector(4.0f)));
+		boxProps.setBoolean("flipNormals", true);
+
+		Properties lightProps("sphere");
+		lightProps.setPoint("center", Point(-1.0f, 2.0f, 0.5f));
+		lightProps.setFloat("radius", 0.4f);
+
+		Properties emitterProps("area");
+		emitterProps.setSpectrum("radiance", Spectrum(10.0f));
+
+		ref<Scene> scene = new Scene(Properties());
+		scene->addChild(create(MTS_CLASS(Integrator), integratorProps));
+		scene->addChild(create(MTS_CLASS(Sensor), sensorProps,
+			create(MTS_CLASS(Film), filmProps,
+				create(MTS_CLASS(ReconstructionFilter), Properties("box"))),
+			create(MTS_CLASS(Sampler), samplerProps)));
+		scene->addChild(create(MTS_CLASS(Shape), boxProps,
+			create(MTS_CLASS(BSDF), Properties("diffuse"))));
+		scene->addChild(create(MTS_CLASS(Shape), lightProps,
+			create(MTS_CLASS(Emitter), emitterProps)));
+		scene->configure();
+		scene->initialize();
+		return scene;
+	}
+
+	/// Render the scene and return the developed film
+	ref<Bitmap> render(Scene *scene) {
+		ref<RenderQueue> queue = new RenderQueue();
+		ref<RenderJob> job = new RenderJob("rend", scene, queue, -1, -1, -1, false);
+		job->start();
+		queue->waitLeft(0);
+		assertTrue(job->wait());
+		queue->join();
+
+		ref<Bitmap> bitmap = scene->getFilm()->developBitmap();
+		assertTrue(bitmap.get() != NULL);
+		return bitmap;
+	}
+
+	void test01_pixelMask() {
+		/* Select the upper left quarter of the image */
+		ref<Bitmap> mask = new Bitmap(Bitmap::ELuminance, Bitmap::EFloat32, Vector2i(16));
+		mask->clear();
+		float *maskData = mask->getFloat32Data();
+		for (int y=0; y<8; ++y)
+			for (int x=0; x<8; ++x)
+				maskData[x + y * 16] = 1.0f;
+
+		fs::path maskPath = fs::temp_directory_path() / "mts_test_bdpt_roi.exr";
+		mask->write(Bitmap::EOpenEXR, maskPath);
+
+		ref<Bitmap> full = render(createScene(fs::path(), 1));
+		ref<Bitmap> region = render(createScene(maskPath, 2));
+		fs::remove(maskPath);
+
+		/* The light image receives contributions from emitter subpaths of
+		   all rendered pixels. If it was not rescaled by the fraction of
+		   masked pixels, the region would be noticeably too dark */
+		Float fullLum = 0, regionLum = 0;
+		for (int y=0; y<8; ++y) {
+			for (int x=0; x<8; ++x) {
+				fullLum += full->getPixel(Point2i(x, y)).getLuminance();
+				regionLum += region->getPixel(Point2i(x, y)).getLuminance();
+			}
+		}
+		Log(EInfo, "Mean luminance of the masked pixels: %f (full), %f (region)",
+			fullLum / 64, regionLum / 64);
+		assertTrue(fullLum > 0);
+		assertEqualsEpsilon(regionLum / fullLum, (Float) 1, (Float) 0.05f);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestBDPTRegionOfInterest, "Testcase for region-of-interest rendering in BDPT")
+MTS_NAMESPACE_END
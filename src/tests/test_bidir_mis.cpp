@@ -0,0 +1,291 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/plugin.h>
+#include <mitsuba/core/warp.h>
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/scene.h>
+#include <mitsuba/bidir/path.h>
+#include <mitsuba/bidir/util.h>
+
+/* Relative tolerance when comparing MIS weights */
+#if defined(SINGLE_PRECISION)
+	#define ERROR_REQ 1e-3f
+#else
+	#define ERROR_REQ 1e-8
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * This testcase checks that the constant-time MIS weights based on the
+ * partial sums of Path::computeMISPartials() agree with the full sweep
+ * over both subpaths for all connection strategies
+ */
+class TestBidirMIS : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_miWeight)
+	MTS_DECLARE_TEST(test02_miWeightDirect)
+	MTS_DECLARE_TEST(test03_miWeightLightImage)
+	MTS_DECLARE_TEST(test04_miWeightElliptic)
+	MTS_END_TESTCASE()
+
+	/// Instantiate and configure a plugin
+	ConfigurableObject *create(const Class *theClass, const Properties &props,
+			ConfigurableObject *child1 = NULL, ConfigurableObject *child2 = NULL) {
+		ConfigurableObject *object = PluginManager::getInstance()->createObject(theClass, props);
+		if (child1)
+			object->addChild(child1);
+		if (child2)
+			object->addChild(child2);
+		object->configure();
+		return object;
+	}
+
+	/// A closed diffuse box with a glossy sphere and a spherical area light
+	ref<Scene> createScene() {
+		Properties filmProps("hdrfilm");
+		filmProps.setInteger("width", 16);
+		filmProps.setInteger("height", 16);
+
+		Properties sensorProps("perspective");
+		sensorProps.setTransform("toWorld", Transform::lookAt(
+			Point(0, 0, 3), Point(0, 0, 0), Vector(0, 1, 0)));
+
+		Properties boxProps("cube");
+		boxProps.setTransform("toWorld", Transform::scale(Vector(4.0f)));
+		boxProps.setBoolean("flipNormals", true);
+
+		Properties sphereProps("sphere");
+		sphereProps.setPoint("center", Point(0.5f, -0.5f, 0.0f));
+		sphereProps.setFloat("radius", 0.7f);
+
+		Properties glossyProps("roughplastic");
+		glossyProps.setFloat("alpha", 0.3f);
+
+		Properties lightProps("sphere");
+		lightProps.setPoint("center", Point(-1.0f, 2.0f, 0.5f));
+		lightProps.setFloat("radius", 0.4f);
+
+		Properties emitterProps("area");
+		emitterProps.setSpectrum("radiance", Spectrum(10.0f));
+
+		ref<Scene> scene = new Scene(Properties());
+		scene->addChild(create(MTS_CLASS(Sensor), sensorProps,
+			create(MTS_CLASS(Film), filmProps),
+			create(MTS_CLASS(Sampler), Properties("independent"))));
+		scene->addChild(create(MTS_CLASS(Shape), boxProps,
+			create(MTS_CLASS(BSDF), Properties("diffuse"))));
+		scene->addChild(create(MTS_CLASS(Shape), sphereProps,
+			create(MTS_CLASS(BSDF), glossyProps)));
+		scene->addChild(create(MTS_CLASS(Shape), lightProps,
+			create(MTS_CLASS(Emitter), emitterProps)));
+		scene->configure();
+		scene->initialize();
+		return scene;
+	}
+
+	/**
+	 * Trace random subpath pairs and compare the weights of all (s, t)
+	 * strategies before and after caching the partial sums. Only the
+	 * connections with <tt>s>=2</tt> and <tt>t>=2</tt> can take the
+	 * constant-time path; the others must be unaffected by the cache.
+	 */
+	void checkWeights(bool sampleDirect, bool lightImage) {
+		ref<Scene> scene = createScene();
+		ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), Properties("independent")));
+		sampler->generate(Point2i(0));
+
+		MemoryPool pool;
+		Path emitterSubpath, sensorSubpath;
+		const int maxDepth = 6;
+		size_t nChecked = 0;
+
+		for (int i=0; i<500; ++i) {
+			Point2i pixel(i % 16, (i / 16) % 16);
+			emitterSubpath.initialize(scene, 0, EImportance, pool);
+			emitterSubpath.randomWalk(scene, sampler, maxDepth, -1, EImportance, pool);
+			sensorSubpath.initialize(scene, 0, ERadiance, pool);
+			sensorSubpath.randomWalkFromPixel(scene, sampler, maxDepth, pixel, -1, pool);
+
+			std::vector<Float> sweep;
+			for (int pass=0; pass<2; ++pass) {
+				if (pass == 1) {
+					emitterSubpath.computeMISPartials(scene, EImportance, sampleDirect, lightImage);
+					sensorSubpath.computeMISPartials(scene, ERadiance, sampleDirect, lightImage);
+				}
+
+				size_t index = 0;
+				for (int s=1; s<(int) emitterSubpath.vertexCount(); ++s) {
+					for (int t=1; t<(int) sensorSubpath.vertexCount(); ++t) {
+						if (s + t > maxDepth + 1)
+							continue;
+
+						PathVertex
+							*vs = emitterSubpath.vertex(s),
+							*vt = sensorSubpath.vertex(t);
+						const PathEdge
+							*vsEdge = emitterSubpath.edge(s-1),
+							*vtEdge = sensorSubpath.edge(t-1);
+
+						if (!vs->isConnectable() || !vt->isConnectable())
+							continue;
+
+						RestoreMeasureHelper rmh0(vs), rmh1(vt);
+						PathEdge connectionEdge;
+						int interactions = maxDepth - s - t + 1;
+						if (!connectionEdge.pathConnectAndCollapse(scene,
+								vsEdge, vs, vt, vtEdge, interactions))
+							continue;
+
+						Float weight = Path::miWeight(scene, emitterSubpath, &connectionEdge,
+							sensorSubpath, s, t, sampleDirect, lightImage);
+
+						if (pass == 0) {
+							sweep.push_back(weight);
+						} else {
+							Float expected = sweep[index++];
+							assertEqualsEpsilon(weight, expected,
+								ERROR_REQ * std::max((Float) 1, expected));
+							++nChecked;
+						}
+					}
+				}
+				if (pass == 1)
+					assertTrue(index == sweep.size());
+			}
+
+			emitterSubpath.release(pool);
+			sensorSubpath.release(pool);
+			sampler->advance();
+		}
+
+		Log(EInfo, "Compared " SIZE_T_FMT " connections", nChecked);
+		assertTrue(nChecked > 0);
+	}
+
+	void test01_miWeight() {
+		checkWeights(false, false);
+	}
+
+	void test02_miWeightDirect() {
+		checkWeights(true, false);
+	}
+
+	void test03_miWeightLightImage() {
+		checkWeights(true, true);
+	}
+
+	/**
+	 * Insert a shadow vertex between random subpath pairs, as done by the
+	 * elliptic connection strategy, and compare the constant-time weight
+	 * of Path::miWeightElliptic() against the full sweep
+	 */
+	void test04_miWeightElliptic() {
+		ref<Scene> scene = createScene();
+		ref<Sampler> sampler = static_cast<Sampler *> (PluginManager::getInstance()->
+				createObject(MTS_CLASS(Sampler), Properties("independent")));
+		sampler->generate(Point2i(0));
+
+		MemoryPool pool;
+		Path emitterSubpath, sensorSubpath;
+		const int maxDepth = 6;
+		size_t nChecked = 0;
+
+		PathVertex shadowVertex;
+		PathEdge connectionEdge1, connectionEdge2;
+
+		for (int i=0; i<500; ++i) {
+			Point2i pixel(i % 16, (i / 16) % 16);
+			emitterSubpath.initialize(scene, 0, EImportance, pool);
+			emitterSubpath.randomWalk(scene, sampler, maxDepth, -1, EImportance, pool);
+			sensorSubpath.initialize(scene, 0, ERadiance, pool);
+			sensorSubpath.randomWalkFromPixel(scene, sampler, maxDepth, pixel, -1, pool);
+
+			/* The elliptic strategy always runs with these settings */
+			emitterSubpath.computeMISPartials(scene, EImportance, false, true);
+			sensorSubpath.computeMISPartials(scene, ERadiance, false, true);
+
+			for (int s=1; s<(int) emitterSubpath.vertexCount(); ++s) {
+				for (int t=1; t<(int) sensorSubpath.vertexCount(); ++t) {
+					if (s + t > maxDepth)
+						continue;
+
+					PathVertex
+						*vs = emitterSubpath.vertex(s),
+						*vt = sensorSubpath.vertex(t);
+					const PathEdge
+						*vsEdge = emitterSubpath.edge(s-1),
+						*vtEdge = sensorSubpath.edge(t-1);
+
+					if (!vs->isConnectable() || !vt->isConnectable())
+						continue;
+
+					/* Place the shadow vertex on a random ray leaving 'vs' */
+					Vector d(warp::squareToUniformSphere(sampler->next2D()));
+					Ray ray(vs->getPosition(), d, Epsilon,
+						std::numeric_limits<Float>::infinity(), 0);
+
+					memset(&shadowVertex, 0, sizeof(PathVertex));
+					memset(&connectionEdge1, 0, sizeof(PathEdge));
+					memset(&connectionEdge2, 0, sizeof(PathEdge));
+					Intersection &its = shadowVertex.getIntersection();
+					if (!scene->rayIntersect(ray, its))
+						continue;
+					shadowVertex.type = PathVertex::ESurfaceInteraction;
+					shadowVertex.degenerate = !(its.getBSDF()->hasComponent(BSDF::ESmooth) ||
+							its.shape->isEmitter() || its.shape->isSensor());
+					if (!shadowVertex.isConnectable())
+						continue;
+
+					RestoreMeasureHelper rmh0(vs), rmh1(vt);
+					int interactions = 0;
+					connectionEdge1.medium = vsEdge ? vsEdge->medium : NULL;
+					if (!connectionEdge1.pathConnectAndCollapse(scene, vsEdge, vs,
+							&shadowVertex, NULL, interactions) ||
+						!connectionEdge2.pathConnectAndCollapse(scene, &connectionEdge1,
+							&shadowVertex, vt, vtEdge, interactions))
+						continue;
+
+					Float weight = Path::miWeightElliptic(scene, emitterSubpath,
+						&connectionEdge1, &shadowVertex, &connectionEdge2,
+						sensorSubpath, s, t, false, true, sampler);
+					Float expected = Path::miWeightEllipticSweep(scene, emitterSubpath,
+						&connectionEdge1, &shadowVertex, &connectionEdge2,
+						sensorSubpath, s, t);
+
+					assertEqualsEpsilon(weight, expected,
+						ERROR_REQ * std::max((Float) 1, expected));
+					++nChecked;
+				}
+			}
+
+			emitterSubpath.release(pool);
+			sensorSubpath.release(pool);
+			sampler->advance();
+		}
+
+		Log(EInfo, "Compared " SIZE_T_FMT " elliptic connections", nChecked);
+		assertTrue(nChecked > 0);
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestBidirMIS, "Testcase for the recursive BDPT MIS weights")
+MTS_NAMESPACE_END
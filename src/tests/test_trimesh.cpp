@@ -0,0 +1,159 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/core/warp.h>
+#include <mitsuba/render/testcase.h>
+#include <mitsuba/render/trimesh.h>
+
+MTS_NAMESPACE_BEGIN
+
+class TestTriMesh : public TestCase {
+public:
+	MTS_BEGIN_TESTCASE()
+	MTS_DECLARE_TEST(test01_octahedralNormals)
+	MTS_DECLARE_TEST(test02_compactTriangles)
+	MTS_DECLARE_TEST(test03_compactAttributes)
+	MTS_END_TESTCASE()
+
+	/// Check that a packed normal decodes to (almost) the same direction
+	void checkNormal(const Normal &n) {
+		Normal m = unpackOctahedralNormal(packOctahedralNormal(n));
+
+		/* The sine of the angle is better conditioned than its cosine.
+		   The encoding has a maximum error of roughly 0.004 degrees */
+		assertEqualsEpsilon(m.length(), (Float) 1, 1e-5f);
+		assertTrue(cross(n, m).length() < 1e-4f);
+		assertTrue(dot(n, m) > 0);
+	}
+
+	void test01_octahedralNormals() {
+		/* Axes, octant diagonals, and the folds of the octahedron */
+		Float values[] = { -1, -0.5f, 0, 0.5f, 1 };
+		for (int i=0; i<5; ++i) {
+			for (int j=0; j<5; ++j) {
+				for (int k=0; k<5; ++k) {
+					Normal n(values[i], values[j], values[k]);
+					if (n.isZero())
+						continue;
+					checkNormal(normalize(n));
+				}
+			}
+		}
+
+		/* Directions very close to the poles */
+		checkNormal(normalize(Normal(1e-6f, -1e-6f, 1)));
+		checkNormal(normalize(Normal(-1e-6f, 1e-6f, -1)));
+
+		/* Random directions */
+		ref<Random> random = new Random();
+		for (int i=0; i<100000; ++i)
+			checkNormal(Normal(warp::squareToUniformSphere(Point2(random->nextFloat(), random->nextFloat()))));
+
+		/* A degenerate normal maps to the center of the parameterization */
+		assertTrue(packOctahedralNormal(Normal(0.0f)) == 0x7FFF7FFFU);
+	}
+
+	void test02_compactTriangles() {
+		/* Enough vertices for multi-byte deltas in both directions */
+		const size_t vertexCount = 1 << 20;
+		const size_t triangleCount = 5 * TriMesh::ETriangleBlockSize + 7;
+		ref<TriMesh> mesh = new TriMesh("test", triangleCount, vertexCount);
+		Triangle *triangles = mesh->getTriangles();
+
+		ref<Random> random = new Random();
+		for (size_t i=0; i<triangleCount; ++i) {
+			for (int j=0; j<3; ++j) {
+				uint32_t idx;
+				switch (i % 4) {
+					/* Small, mostly increasing deltas (well-ordered mesh) */
+					case 0: idx = (uint32_t) (3*i + j); break;
+					/* Jumps between the first and last vertex */
+					case 1: idx = (j % 2 == 0) ? (uint32_t) (vertexCount - 1) : 0; break;
+					/* Arbitrary indices */
+					case 2: idx = random->nextUInt((uint32_t) vertexCount); break;
+					/* Repeated indices (zero deltas) */
+					default: idx = (uint32_t) (vertexCount / 2); break;
+				}
+				triangles[i].idx[j] = idx;
+			}
+		}
+
+		/* The first triangle of every block must not depend on the
+		   last triangle of the previous block */
+		for (size_t i=TriMesh::ETriangleBlockSize; i<triangleCount; i += TriMesh::ETriangleBlockSize) {
+			triangles[i-1].idx[2] = (uint32_t) (vertexCount - 1);
+			triangles[i].idx[0] = 0;
+		}
+
+		std::vector<Triangle> expected(triangles, triangles + triangleCount);
+		mesh->compact();
+		assertTrue(mesh->isCompact());
+		assertTrue(mesh->getTriangles() == NULL);
+
+		/* Decode in reverse order, so that no lookup can benefit
+		   from the position of the previous one */
+		for (size_t i=triangleCount; i-- > 0; ) {
+			Triangle tri = mesh->getTriangle(i);
+			for (int j=0; j<3; ++j)
+				assertEquals((int) tri.idx[j], (int) expected[i].idx[j]);
+		}
+
+		/* Compacting twice must not change anything */
+		mesh->compact();
+		for (size_t i=0; i<triangleCount; ++i) {
+			Triangle tri = mesh->getTriangle(i);
+			for (int j=0; j<3; ++j)
+				assertEquals((int) tri.idx[j], (int) expected[i].idx[j]);
+		}
+	}
+
+	void test03_compactAttributes() {
+		const size_t vertexCount = 1000;
+		ref<TriMesh> mesh = new TriMesh("test", 1, vertexCount, true, true);
+		Normal *normals = mesh->getVertexNormals();
+		Point2 *texcoords = mesh->getVertexTexcoords();
+		for (int j=0; j<3; ++j)
+			mesh->getTriangles()[0].idx[j] = j;
+
+		ref<Random> random = new Random();
+		for (size_t i=0; i<vertexCount; ++i) {
+			normals[i] = Normal(warp::squareToUniformSphere(Point2(random->nextFloat(), random->nextFloat())));
+			texcoords[i] = Point2(random->nextFloat() * 4 - 1, random->nextFloat());
+		}
+
+		std::vector<Normal> expectedNormals(normals, normals + vertexCount);
+		std::vector<Point2> expectedTexcoords(texcoords, texcoords + vertexCount);
+		mesh->compact();
+		assertTrue(mesh->getVertexNormals() == NULL);
+		assertTrue(mesh->getVertexTexcoords() == NULL);
+		assertTrue(mesh->hasVertexNormals() && mesh->hasVertexTexcoords());
+
+		for (size_t i=0; i<vertexCount; ++i) {
+			Normal n = mesh->getVertexNormal(i);
+			assertTrue(cross(n, expectedNormals[i]).length() < 1e-4f);
+			assertTrue(dot(n, expectedNormals[i]) > 0);
+
+			/* 16 bit quantization of the bounding box [-1, 3] x [0, 1] */
+			Point2 uv = mesh->getVertexTexcoord(i);
+			assertEqualsEpsilon(uv, expectedTexcoords[i], 1e-4f);
+		}
+	}
+};
+
+MTS_EXPORT_TESTCASE(TestTriMesh, "Testcase for the compact triangle mesh storage")
+MTS_NAMESPACE_END
@@ -207,7 +207,8 @@ public:
 			else
 				cacheFile.replace_extension(formatString(".%s.mip", m_channel.c_str()));
 
-			tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true);
+			tryReuseCache = fs::exists(cacheFile) && props.getBoolean("cache", true)
+				&& !TileCache::getInstance()->isEnabled();
 		}
 
 		std::string filterType = boost::to_lower_copy(props.getString("filterType", "ewa"));
@@ -0,0 +1,744 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/fstream.h>
+#include <mitsuba/core/mmap.h>
+#include <mitsuba/core/bitmap.h>
+#include <boost/algorithm/string.hpp>
+#if defined(WIN32)
+# include <mitsuba/core/getopt.h>
+#endif
+#if defined(MTS_OPENMP)
+# include <omp.h>
+#endif
+
+#if defined(MTS_HAS_OPENEXR)
+/* The ellipsoid helpers (pulled in via the scene headers) define a 'FLOAT'
+   macro, which clashes with the OpenEXR pixel type enumeration */
+#if defined(FLOAT)
+# undef FLOAT
+#endif
+#include <ImfInputFile.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImathBox.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * \brief Lazily evaluated source of the frames of a transient rendering
+ *
+ * All frames are returned as float32-valued RGB or luminance bitmaps.
+ */
+class FrameSource : public Object {
+public:
+	/// Return the number of frames
+	virtual int getFrameCount() const = 0;
+
+	/// Return the resolution of a frame
+	virtual Vector2i getSize() const = 0;
+
+	/// Return the pixel format of a frame (\ref Bitmap::ERGB or \ref Bitmap::ELuminance)
+	virtual Bitmap::EPixelFormat getPixelFormat() const = 0;
+
+	/**
+	 * \brief Can individual frames be loaded cheaply and concurrently?
+	 *
+	 * If not, frames should be requested in large groups from a single thread.
+	 */
+	virtual bool isRandomAccess() const = 0;
+
+	/// Load the frames <tt>[first, first+frames.size())</tt>
+	virtual void load(int first, ref_vector<Bitmap> &frames) = 0;
+
+	/// Allocate a bitmap that can hold one frame
+	ref<Bitmap> createFrame() const {
+		return new Bitmap(getPixelFormat(), Bitmap::EFloat32, getSize());
+	}
+
+	MTS_DECLARE_CLASS()
+protected:
+	virtual ~FrameSource() { }
+};
+
+#if defined(MTS_HAS_OPENEXR)
+/**
+ * \brief OpenEXR frame source
+ *
+ * Transient renderings store frame \c i in the channels <tt>i.R</tt>,
+ * <tt>i.G</tt>, <tt>i.B</tt> (or <tt>i.Y</tt>). Only the channels of the
+ * requested frames are decoded into the target bitmaps.
+ */
+class EXRFrameSource : public FrameSource {
+public:
+	EXRFrameSource(const fs::path &path) : m_file(path.string().c_str()) {
+		const Imf::Header &header = m_file.header();
+		m_dataWindow = header.dataWindow();
+		m_size = Vector2i(m_dataWindow.max.x - m_dataWindow.min.x + 1,
+			m_dataWindow.max.y - m_dataWindow.min.y + 1);
+
+		std::map<int, std::vector<std::string> > frames;
+		std::vector<std::string> plain(4);
+		bool transient = false;
+		for (Imf::ChannelList::ConstIterator it = header.channels().begin();
+				it != header.channels().end(); ++it) {
+			std::string name = it.name(), prefix, suffix = name;
+			size_t pos = name.find_last_of('.');
+			if (pos != std::string::npos) {
+				prefix = name.substr(0, pos);
+				suffix = name.substr(pos + 1);
+			}
+			int idx = channelIndex(suffix);
+			if (idx < 0)
+				continue;
+
+			char *end_ptr = NULL;
+			long frame = prefix.empty() ? -1 : std::strtol(prefix.c_str(), &end_ptr, 10);
+			if (frame >= 0 && *end_ptr == '\0') {
+				std::vector<std::string> &channels = frames[(int) frame];
+				channels.resize(4);
+				channels[idx] = name;
+				transient = true;
+			} else if (prefix.empty()) {
+				plain[idx] = name;
+			}
+		}
+
+		if (!transient)
+			frames[0] = plain;
+
+		for (std::map<int, std::vector<std::string> >::iterator it = frames.begin();
+				it != frames.end(); ++it)
+			m_frames.push_back(it->second);
+
+		if (m_frames.empty())
+			Log(EError, "\"%s\": could not find any RGB/luminance channels!",
+				path.string().c_str());
+
+		m_pixelFormat = m_frames[0][0].empty() ? Bitmap::ELuminance : Bitmap::ERGB;
+		for (size_t i=0; i<m_frames.size(); ++i) {
+			bool rgb = !m_frames[i][0].empty() && !m_frames[i][1].empty() && !m_frames[i][2].empty();
+			if (m_pixelFormat == Bitmap::ERGB ? !rgb : m_frames[i][3].empty())
+				Log(EError, "\"%s\": the frames have inconsistent channels!", path.string().c_str());
+		}
+	}
+
+	int getFrameCount() const { return (int) m_frames.size(); }
+	Vector2i getSize() const { return m_size; }
+	Bitmap::EPixelFormat getPixelFormat() const { return m_pixelFormat; }
+	bool isRandomAccess() const { return false; }
+
+	void load(int first, ref_vector<Bitmap> &frames) {
+		int nChannels = m_pixelFormat == Bitmap::ERGB ? 3 : 1;
+		size_t xStride = nChannels * sizeof(float),
+		       yStride = xStride * m_size.x;
+
+		Imf::FrameBuffer fb;
+		for (size_t i=0; i<frames.size(); ++i) {
+			char *base = (char *) frames[i]->getFloat32Data()
+				- (ptrdiff_t) m_dataWindow.min.x * (ptrdiff_t) xStride
+				- (ptrdiff_t) m_dataWindow.min.y * (ptrdiff_t) yStride;
+			const std::vector<std::string> &channels = m_frames[first + i];
+			if (nChannels == 3) {
+				for (int ch=0; ch<3; ++ch)
+					fb.insert(channels[ch].c_str(), Imf::Slice(Imf::FLOAT,
+						base + ch * sizeof(float), xStride, yStride));
+			} else {
+				fb.insert(channels[3].c_str(), Imf::Slice(Imf::FLOAT,
+					base, xStride, yStride));
+			}
+		}
+
+		/* Decompression is parallelized by OpenEXR's own thread pool */
+		m_file.setFrameBuffer(fb);
+		m_file.readPixels(m_dataWindow.min.y, m_dataWindow.max.y);
+	}
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Map a channel suffix to R=0, G=1, B=2, Y=3
+	static int channelIndex(const std::string &suffix) {
+		std::string s = boost::to_lower_copy(suffix);
+		if (s == "r" || s == "red")
+			return 0;
+		else if (s == "g" || s == "green")
+			return 1;
+		else if (s == "b" || s == "blue")
+			return 2;
+		else if (s == "y" || s == "luminance")
+			return 3;
+		return -1;
+	}
+
+	virtual ~EXRFrameSource() { }
+private:
+	Imf::InputFile m_file;
+	Imath::Box2i m_dataWindow;
+	Vector2i m_size;
+	Bitmap::EPixelFormat m_pixelFormat;
+	std::vector<std::vector<std::string> > m_frames;
+};
+#endif
+
+/**
+ * \brief NumPy (.npy) frame source
+ *
+ * Supports float32/float64 arrays with the shapes <tt>(height, width)</tt>,
+ * <tt>(height, width, frames * channels)</tt> (as written by the \c mfilm
+ * plugin) and <tt>(height, width, frames, channels)</tt>. The file is
+ * memory-mapped, so frames are only paged in when they are accessed.
+ */
+class NPYFrameSource : public FrameSource {
+public:
+	NPYFrameSource(const fs::path &path, int channelsPerFrame) {
+		m_mmap = new MemoryMappedFile(path, true);
+		const char *data = (const char *) m_mmap->getData();
+		size_t size = m_mmap->getSize();
+
+		if (size < 10 || memcmp(data, "\x93NUMPY", 6) != 0)
+			Log(EError, "\"%s\": not a NumPy array file!", path.string().c_str());
+
+		uint8_t major = (uint8_t) data[6];
+		size_t headerLen, headerOffset;
+		if (major == 1) {
+			headerLen = (size_t) (uint8_t) data[8] | ((size_t) (uint8_t) data[9] << 8);
+			headerOffset = 10;
+		} else {
+			if (size < 12)
+				Log(EError, "\"%s\": truncated header!", path.string().c_str());
+			headerLen = 0;
+			for (int i=3; i>=0; --i)
+				headerLen = (headerLen << 8) | (size_t) (uint8_t) data[8+i];
+			headerOffset = 12;
+		}
+		if (headerOffset + headerLen > size)
+			Log(EError, "\"%s\": truncated header!", path.string().c_str());
+
+		std::string header(data + headerOffset, headerLen);
+		std::string descr = dictEntry(header, "descr");
+		if (descr.find("<f4") != std::string::npos || descr.find("|f4") != std::string::npos)
+			m_wordSize = 4;
+		else if (descr.find("<f8") != std::string::npos || descr.find("|f8") != std::string::npos)
+			m_wordSize = 8;
+		else
+			Log(EError, "\"%s\": unsupported data type %s (must be little endian "
+				"float32 or float64)", path.string().c_str(), descr.c_str());
+
+		if (dictEntry(header, "fortran_order").find("True") != std::string::npos)
+			Log(EError, "\"%s\": Fortran-ordered arrays are not supported!", path.string().c_str());
+
+		std::string shapeStr = dictEntry(header, "shape");
+		std::vector<std::string> tokens = tokenize(shapeStr, "(), ");
+		std::vector<size_t> shape;
+		for (size_t i=0; i<tokens.size(); ++i)
+			shape.push_back((size_t) std::strtoul(tokens[i].c_str(), NULL, 10));
+
+		size_t frames = 1, channels = 1;
+		if (shape.size() == 2) {
+			frames = channels = 1;
+		} else if (shape.size() == 3) {
+			if (channelsPerFrame <= 0)
+				channelsPerFrame = (shape[2] % 3 == 0) ? 3 : 1;
+			channels = (size_t) channelsPerFrame;
+			if (shape[2] % channels != 0)
+				Log(EError, "\"%s\": %i channels are not divisible into frames of %i channels!",
+					path.string().c_str(), (int) shape[2], channelsPerFrame);
+			frames = shape[2] / channels;
+		} else if (shape.size() == 4) {
+			frames = shape[2];
+			channels = shape[3];
+		} else {
+			Log(EError, "\"%s\": unsupported array shape %s", path.string().c_str(), shapeStr.c_str());
+		}
+
+		if (channels != 1 && channels != 3)
+			Log(EError, "\"%s\": frames must have 1 or 3 channels!", path.string().c_str());
+
+		m_size = Vector2i((int) shape[1], (int) shape[0]);
+		m_frameCount = (int) frames;
+		m_channels = (int) channels;
+		m_offset = headerOffset + headerLen;
+
+		if (m_offset + (size_t) m_size.x * m_size.y * frames * channels * m_wordSize > size)
+			Log(EError, "\"%s\": file is truncated!", path.string().c_str());
+	}
+
+	int getFrameCount() const { return m_frameCount; }
+	Vector2i getSize() const { return m_size; }
+	Bitmap::EPixelFormat getPixelFormat() const {
+		return m_channels == 3 ? Bitmap::ERGB : Bitmap::ELuminance;
+	}
+	bool isRandomAccess() const { return true; }
+
+	void load(int first, ref_vector<Bitmap> &frames) {
+		const uint8_t *data = (const uint8_t *) m_mmap->getData() + m_offset;
+		size_t pixelStride = (size_t) m_frameCount * m_channels;
+		size_t pixelCount = (size_t) m_size.x * (size_t) m_size.y;
+
+		for (size_t i=0; i<frames.size(); ++i) {
+			float *target = frames[i]->getFloat32Data();
+			size_t offset = (size_t) (first + i) * m_channels;
+
+			if (m_wordSize == 4) {
+				const float *source = (const float *) data + offset;
+				for (size_t j=0; j<pixelCount; ++j) {
+					for (int ch=0; ch<m_channels; ++ch)
+						*target++ = source[ch];
+					source += pixelStride;
+				}
+			} else {
+				const double *source = (const double *) data + offset;
+				for (size_t j=0; j<pixelCount; ++j) {
+					for (int ch=0; ch<m_channels; ++ch)
+						*target++ = (float) source[ch];
+					source += pixelStride;
+				}
+			}
+		}
+	}
+
+	MTS_DECLARE_CLASS()
+protected:
+	/// Extract the value associated with a key in the header's Python dictionary literal
+	static std::string dictEntry(const std::string &header, const std::string &key) {
+		size_t pos = header.find("'" + key + "'");
+		if (pos == std::string::npos)
+			SLog(EError, "Invalid NumPy header (missing '%s'): %s", key.c_str(), header.c_str());
+		pos = header.find(':', pos);
+		size_t end = key == "shape" ? header.find(')', pos) + 1 : header.find(',', pos);
+		return header.substr(pos + 1, end - pos - 1);
+	}
+
+	virtual ~NPYFrameSource() { }
+private:
+	ref<MemoryMappedFile> m_mmap;
+	Vector2i m_size;
+	int m_frameCount, m_channels;
+	size_t m_wordSize, m_offset;
+};
+
+/**
+ * \brief Exports the frames of a transient rendering (stored as a
+ * multi-channel OpenEXR or NumPy cube) as a numbered sequence of
+ * tonemapped PNG/JPEG images or as a raw RGB24 video stream.
+ */
+class ExportFrames : public Utility {
+public:
+	void help() {
+		cout << endl;
+		cout << "Synopsis: Exports the frames of a transient rendering as an image sequence or a raw video stream" << endl;
+		cout << endl;
+		cout << "Usage: mtsutil exportframes [options] <EXR/NPY file>" << endl;
+		cout << "Options/Arguments:" << endl;
+		cout << "   -h             Display this help text" << endl << endl;
+		cout << "   -o prefix      Output prefix; frames are written to <prefix>_00000.png etc." << endl;
+		cout << "                  (Default: the input filename without extension)" << endl << endl;
+		cout << "   -f fmt         Output format (png/jpg/raw, default:png). 'raw' writes all" << endl;
+		cout << "                  frames as one headerless RGB24 stream to <prefix>.rgb, which" << endl;
+		cout << "                  can e.g. be encoded using" << endl;
+		cout << "                  'ffmpeg -f rawvideo -pix_fmt rgb24 -s WxH -r 25 -i <prefix>.rgb out.mp4'" << endl << endl;
+		cout << "   -g gamma       Specify the gamma value (The default is -1 => sRGB)" << endl << endl;
+		cout << "   -m multiplier  Multiply the pixel values by 'multiplier'. By default, the" << endl;
+		cout << "                  multiplier is chosen so that the 'quantile' of the non-zero" << endl;
+		cout << "                  luminances maps to white" << endl << endl;
+		cout << "   -q quantile    Quantile used for the automatic exposure (Default = 0.95)" << endl << endl;
+		cout << "   -p key,burn    Run Reinhard et al.'s photographic tonemapping operator. 'key'" << endl;
+		cout << "                  between [0, 1] chooses between low and high-key images and" << endl;
+		cout << "                  'burn' (also [0, 1]) controls how much highlights may burn out" << endl << endl;
+		cout << "   -l             Per-frame (local) exposure/tonemapping. By default, a single" << endl;
+		cout << "                  global setting is computed from all frames to avoid flicker" << endl << endl;
+		cout << "   -r first,last  Only export the given (inclusive, zero-based) range of frames" << endl << endl;
+		cout << "   -c channels    Channels per frame of 3D NumPy arrays (1 or 3, Default: auto)" << endl << endl;
+		cout << "   -t threads     Number of worker threads (Default = number of cores)" << endl << endl;
+		cout << "   -M memory      Memory budget for decoded EXR frames in MiB (Default = 1024)" << endl;
+	}
+
+	/// Accumulates luminance statistics for the automatic exposure and the tonemapper
+	struct Statistics {
+		/// Log2-spaced luminance histogram with 16 bins per stop
+		std::vector<size_t> histogram;
+		double logSum;
+		size_t count, nonZero;
+		Float maxLuminance;
+
+		enum {
+			EBinsPerStop = 16,
+			EMinExponent = -64,
+			EBinCount = 128 * EBinsPerStop
+		};
+
+		Statistics() : histogram(EBinCount, 0), logSum(0),
+			count(0), nonZero(0), maxLuminance(0) { }
+
+		void put(const Bitmap *bitmap) {
+			const float *data = bitmap->getFloat32Data();
+			size_t pixels = bitmap->getPixelCount();
+			bool rgb = bitmap->getPixelFormat() == Bitmap::ERGB;
+
+			for (size_t i=0; i<pixels; ++i) {
+				Float luminance;
+				if (rgb) {
+					luminance = data[0] * (Float) 0.212671 + data[1] * (Float) 0.715160 + data[2] * (Float) 0.072169;
+					data += 3;
+				} else {
+					luminance = *data++;
+				}
+				if (!std::isfinite(luminance))
+					continue;
+				logSum += math::fastlog(1e-3f + std::max((Float) 0, luminance));
+				count++;
+				if (luminance <= 0)
+					continue;
+				maxLuminance = std::max(maxLuminance, luminance);
+				int bin = (int) std::floor((std::log2(luminance) - EMinExponent) * EBinsPerStop);
+				histogram[std::min(std::max(bin, 0), (int) EBinCount - 1)]++;
+				nonZero++;
+			}
+		}
+
+		void put(const Statistics &stats) {
+			for (size_t i=0; i<histogram.size(); ++i)
+				histogram[i] += stats.histogram[i];
+			logSum += stats.logSum;
+			count += stats.count;
+			nonZero += stats.nonZero;
+			maxLuminance = std::max(maxLuminance, stats.maxLuminance);
+		}
+
+		/// Approximate quantile of the non-zero luminance values
+		Float quantile(Float q) const {
+			if (nonZero == 0)
+				return 0;
+			size_t target = (size_t) std::ceil(q * nonZero), sum = 0;
+			for (size_t i=0; i<histogram.size(); ++i) {
+				sum += histogram[i];
+				if (sum >= target && sum > 0)
+					return std::pow((Float) 2, (Float) EMinExponent + (i + 1) / (Float) EBinsPerStop);
+			}
+			return maxLuminance;
+		}
+
+		Float logAvgLuminance() const {
+			return count == 0 ? (Float) 0 : math::fastexp((Float) (logSum / count));
+		}
+	};
+
+	int run(int argc, char **argv) {
+		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+		int optchar;
+		char *end_ptr = NULL;
+		optind = 1;
+		std::string outputPrefix, format = "png";
+		Float gamma = -1, multiplier = -1, quantile = 0.95f;
+		Float tonemapper[] = {-1, -1};
+		bool local = false;
+		int range[] = {0, -1};
+		int channelsPerFrame = -1;
+		int nThreads = getCoreCount();
+		size_t memBudget = 1024;
+
+		/* Parse command-line arguments */
+		while ((optchar = getopt(argc, argv, "hlo:f:g:m:q:p:r:c:t:M:")) != -1) {
+			switch (optchar) {
+				case 'h': {
+						help();
+						return 0;
+					}
+					break;
+
+				case 'o':
+					outputPrefix = optarg;
+					break;
+
+				case 'f':
+					format = boost::to_lower_copy(std::string(optarg));
+					if (format == "jpeg")
+						format = "jpg";
+					if (format != "png" && format != "jpg" && format != "raw")
+						Log(EError, "Unknown format! (must be png/jpg/raw)");
+					break;
+
+				case 'g':
+					gamma = (Float) strtod(optarg, &end_ptr);
+					if (*end_ptr != '\0')
+						Log(EError, "Could not parse the gamma value!");
+					break;
+
+				case 'm':
+					multiplier = (Float) strtod(optarg, &end_ptr);
+					if (*end_ptr != '\0' || multiplier <= 0)
+						Log(EError, "Could not parse the multiplier!");
+					break;
+
+				case 'q':
+					quantile = (Float) strtod(optarg, &end_ptr);
+					if (*end_ptr != '\0' || quantile <= 0 || quantile > 1)
+						Log(EError, "Could not parse the quantile (must be in (0, 1])!");
+					break;
+
+				case 'p': {
+						std::vector<std::string> tokens = tokenize(optarg, ", ");
+						if (tokens.size() != 2)
+							Log(EError, "Invalid tone mapper parameter!");
+						for (int i=0; i<2; ++i) {
+							tonemapper[i] = (Float) std::strtod(tokens[i].c_str(), &end_ptr);
+							if (*end_ptr != '\0')
+								Log(EError, "Cannot parse tone mapper parameters!");
+						}
+					}
+					break;
+
+				case 'l':
+					local = true;
+					break;
+
+				case 'r': {
+						std::vector<std::string> tokens = tokenize(optarg, ", ");
+						if (tokens.size() != 2)
+							Log(EError, "Invalid frame range parameter!");
+						for (int i=0; i<2; ++i) {
+							range[i] = (int) std::strtol(tokens[i].c_str(), &end_ptr, 10);
+							if (*end_ptr != '\0')
+								Log(EError, "Cannot parse integer in frame range parameter!");
+						}
+					}
+					break;
+
+				case 'c':
+					channelsPerFrame = (int) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || (channelsPerFrame != 1 && channelsPerFrame != 3))
+						Log(EError, "The channel count must be 1 or 3!");
+					break;
+
+				case 't':
+					nThreads = (int) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || nThreads <= 0)
+						Log(EError, "Could not parse the thread count!");
+					break;
+
+				case 'M':
+					memBudget = (size_t) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || memBudget == 0)
+						Log(EError, "Could not parse the memory budget!");
+					break;
+			}
+		}
+
+		if (optind + 1 != argc) {
+			help();
+			return 0;
+		}
+
+		#if defined(MTS_OPENMP)
+			Thread::initializeOpenMP(nThreads);
+		#else
+			nThreads = 1;
+		#endif
+
+		fs::path inputFile = fileResolver->resolve(argv[optind]);
+		std::string extension = boost::to_lower_copy(inputFile.extension().string());
+		ref<FrameSource> source;
+		if (extension == ".npy") {
+			source = new NPYFrameSource(inputFile, channelsPerFrame);
+		} else {
+			#if defined(MTS_HAS_OPENEXR)
+				source = new EXRFrameSource(inputFile);
+			#else
+				Log(EError, "OpenEXR support was disabled at compile time!");
+			#endif
+		}
+
+		if (outputPrefix.empty()) {
+			fs::path prefix = inputFile;
+			outputPrefix = prefix.replace_extension("").string();
+		}
+
+		int first = std::max(range[0], 0),
+		    last = range[1] < 0 ? source->getFrameCount() - 1
+		                        : std::min(range[1], source->getFrameCount() - 1);
+		if (first > last)
+			Log(EError, "The frame range is empty!");
+		int nFrames = last - first + 1;
+
+		/* Frames per group: small groups for random access sources, otherwise
+		   as many decoded frames as fit into the memory budget */
+		size_t frameBytes = (size_t) source->getSize().x * source->getSize().y *
+			(source->getPixelFormat() == Bitmap::ERGB ? 3 : 1) * sizeof(float);
+		int groupSize = source->isRandomAccess() ? 4 * nThreads :
+			(int) std::max((size_t) 1, (memBudget * 1024 * 1024) / frameBytes);
+		groupSize = std::min(groupSize, nFrames);
+
+		Log(EInfo, "Exporting %i frames of %ix%i pixels from \"%s\" (%i frames per group, %i threads) ..",
+			nFrames, source->getSize().x, source->getSize().y,
+			inputFile.filename().string().c_str(), groupSize, nThreads);
+
+		ref<Timer> timer = new Timer();
+		bool reinhard = tonemapper[0] != -1;
+		Float logAvgLuminance = 0, maxLuminance = 0;
+		if (!local && (reinhard || multiplier < 0)) {
+			/* Global mode: one additional pass to gather statistics over all frames */
+			std::vector<Statistics> stats(nThreads);
+			forEachFrame(source, first, nFrames, groupSize,
+				[&](int frame, Bitmap *bitmap) {
+					stats[mts_omp_get_thread_num()].put(bitmap);
+				});
+			for (int i=1; i<nThreads; ++i)
+				stats[0].put(stats[i]);
+
+			logAvgLuminance = stats[0].logAvgLuminance();
+			maxLuminance = stats[0].maxLuminance;
+			if (multiplier < 0 && !reinhard) {
+				Float q = stats[0].quantile(quantile);
+				multiplier = q > 0 ? 1 / q : (Float) 1;
+			}
+			Log(EInfo, "Global statistics: log-average luminance = %f, max. luminance = %f%s",
+				logAvgLuminance, maxLuminance, multiplier > 0 ?
+				formatString(", multiplier = %f", multiplier).c_str() : "");
+		}
+
+		Bitmap::EFileFormat fileFormat = format == "jpg" ? Bitmap::EJPEG : Bitmap::EPNG;
+		Bitmap::EPixelFormat outFormat = (format == "raw" || source->getPixelFormat() == Bitmap::ERGB)
+			? Bitmap::ERGB : Bitmap::ELuminance;
+
+		ref<FileStream> rawStream;
+		ref_vector<Bitmap> rawFrames;
+		if (format == "raw") {
+			rawStream = new FileStream(outputPrefix + ".rgb", FileStream::ETruncWrite);
+			rawFrames.resize(groupSize);
+		}
+
+		forEachFrame(source, first, nFrames, groupSize,
+			[&](int frame, Bitmap *bitmap) {
+				Float scale = multiplier > 0 ? multiplier : (Float) 1;
+				if (reinhard) {
+					Float logAvg = local ? 0 : logAvgLuminance,
+					      maxLum = local ? 0 : maxLuminance;
+					bitmap->tonemapReinhard(logAvg, maxLum, tonemapper[0], tonemapper[1]);
+				} else if (local) {
+					Statistics stats;
+					stats.put(bitmap);
+					Float q = stats.quantile(quantile);
+					scale = q > 0 ? 1 / q : (Float) 1;
+				}
+
+				ref<Bitmap> output = bitmap->convert(outFormat, Bitmap::EUInt8, gamma, scale);
+
+				if (rawStream) {
+					rawFrames[(frame - first) % groupSize] = output;
+				} else {
+					fs::path filename = formatString("%s_%05i.%s",
+						outputPrefix.c_str(), frame, format.c_str());
+					ref<FileStream> os = new FileStream(filename, FileStream::ETruncReadWrite);
+					output->write(fileFormat, os);
+				}
+			},
+			[&](int groupStart, int groupFrames) {
+				/* Raw streams must be written in frame order */
+				for (int i=0; rawStream && i<groupFrames; ++i) {
+					rawStream->write(rawFrames[i]->getUInt8Data(), rawFrames[i]->getBufferSize());
+					rawFrames[i] = NULL;
+				}
+			});
+
+		if (rawStream)
+			Log(EInfo, "Wrote %i frames (%ix%i, rgb24) to \"%s\" (took %s)", nFrames,
+				source->getSize().x, source->getSize().y, rawStream->getPath().string().c_str(),
+				timeString(timer->getSeconds()).c_str());
+		else
+			Log(EInfo, "Wrote %i frames to \"%s_*.%s\" (took %s)", nFrames, outputPrefix.c_str(),
+				format.c_str(), timeString(timer->getSeconds()).c_str());
+
+		return 0;
+	}
+
+	/**
+	 * \brief Load the frames <tt>[first, first+count)</tt> group by group and
+	 * invoke \c process on each of them (one worker per frame). \c groupDone
+	 * is called on the main thread after each group has been processed.
+	 */
+	template <typename Functor> void forEachFrame(FrameSource *source, int first,
+			int count, int groupSize, const Functor &process) {
+		forEachFrame(source, first, count, groupSize, process, [](int, int) { });
+	}
+
+	template <typename Functor, typename GroupFunctor> void forEachFrame(FrameSource *source,
+			int first, int count, int groupSize, const Functor &process, const GroupFunctor &groupDone) {
+		bool randomAccess = source->isRandomAccess();
+		ref_vector<Bitmap> frames(groupSize);
+		std::vector<std::string> messages;
+
+		for (int groupStart = first; groupStart < first + count; groupStart += groupSize) {
+			int groupFrames = std::min(groupSize, first + count - groupStart);
+
+			if (!randomAccess) {
+				frames.resize(groupFrames);
+				for (int i=0; i<groupFrames; ++i) {
+					if (!frames[i])
+						frames[i] = source->createFrame();
+				}
+				source->load(groupStart, frames);
+			}
+
+			#if defined(MTS_OPENMP)
+				#pragma omp parallel for schedule(dynamic)
+			#endif
+			for (int i=0; i<groupFrames; ++i) {
+				try {
+					ref<Bitmap> frame;
+					if (randomAccess) {
+						ref_vector<Bitmap> single(1);
+						single[0] = source->createFrame();
+						source->load(groupStart + i, single);
+						frame = single[0];
+					} else {
+						/* Each decoded frame is visited once, so it may be modified in place */
+						frame = frames[i];
+					}
+					process(groupStart + i, frame.get());
+				} catch (const std::exception &e) {
+					#if defined(MTS_OPENMP)
+						#pragma omp critical
+					#endif
+					messages.push_back(formatString("Frame %i: %s", groupStart + i, e.what()));
+				}
+			}
+
+			if (!messages.empty()) {
+				for (size_t i=0; i<messages.size(); ++i)
+					Log(EWarn, "%s", messages[i].c_str());
+				Log(EError, "Could not export the frames!");
+			}
+
+			groupDone(groupStart, groupFrames);
+		}
+	}
+
+	MTS_DECLARE_UTILITY()
+};
+
+MTS_IMPLEMENT_CLASS(FrameSource, true, Object)
+#if defined(MTS_HAS_OPENEXR)
+MTS_IMPLEMENT_CLASS(EXRFrameSource, false, FrameSource)
+#endif
+MTS_IMPLEMENT_CLASS(NPYFrameSource, false, FrameSource)
+MTS_EXPORT_UTILITY(ExportFrames, "Export transient renderings as image sequences or raw video")
+MTS_NAMESPACE_END
@@ -0,0 +1,388 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/timer.h>
+#include <boost/algorithm/string.hpp>
+#include <boost/scoped_ptr.hpp>
+#include <boost/scoped_array.hpp>
+#if defined(WIN32)
+# include <mitsuba/core/getopt.h>
+#endif
+#if defined(MTS_OPENMP)
+# include <omp.h>
+#endif
+
+/* The ellipsoid helpers (pulled in via the scene headers) define a 'FLOAT'
+   macro, which clashes with the OpenEXR pixel type enumeration */
+#if defined(FLOAT)
+# undef FLOAT
+#endif
+
+#include <ImfInputFile.h>
+#include <ImfOutputFile.h>
+#include <ImfChannelList.h>
+#include <ImfFrameBuffer.h>
+#include <ImfIntAttribute.h>
+#include <ImfStringAttribute.h>
+#include <ImathBox.h>
+
+MTS_NAMESPACE_BEGIN
+
+/**
+ * Streaming merge of independent (e.g. differently seeded) renderings of
+ * the same scene. All inputs are opened at the same time and processed in
+ * bands of scanlines, hence the memory usage only depends on the size of a
+ * band and not on the size or number of the input images. Each band is
+ * folded into a weighted running mean / sum of squared deviations using
+ * West's incremental (weighted Welford) update, which is numerically
+ * stable even for hundreds of inputs.
+ */
+class MergeImages : public Utility {
+public:
+	void help() {
+		cout << endl;
+		cout << "Synopsis: Merges independent renderings of the same scene (e.g. rendered with" << endl;
+		cout << "different seeds on several machines) into a mean and a variance image. All" << endl;
+		cout << "channels of the inputs are processed, including the frames of transient renders." << endl;
+		cout << endl;
+		cout << "Usage: mtsutil mergeimages [options] <EXR file 1> <EXR file 2> .. <EXR file N>" << endl;
+		cout << "Options/Arguments:" << endl;
+		cout << "   -h             Display this help text" << endl << endl;
+		cout << "   -o prefix      Output prefix: writes <prefix>_mean.exr and <prefix>_var.exr" << endl;
+		cout << "                  (Default = merged)" << endl << endl;
+		cout << "   -w w1,..,wN    Per-image weights, e.g. the sample counts of the individual" << endl;
+		cout << "                  renderings (Default = 1 for every image)" << endl << endl;
+		cout << "   -n prefix,N    Instead of listing the inputs, merge prefix_0.exr .. prefix_<N-1>.exr" << endl << endl;
+		cout << "   -s             Write the standard deviation (<prefix>_sd.exr) instead of the variance" << endl << endl;
+		cout << "   -m             Only write the mean image" << endl << endl;
+		cout << "   -f             Write float32 outputs (Default: use the component format of the inputs)" << endl << endl;
+		cout << "   -p threads     Number of worker threads (Default = number of cores)" << endl << endl;
+		cout << "   -M memory      Approximate memory budget for the band buffers in MiB (Default = 1024)" << endl << endl;
+		cout << " The mean is weighted by the supplied weights, so merging renderings with" << endl;
+		cout << " different sample counts produces the same result as a single rendering with" << endl;
+		cout << " the combined sample count. The variance image contains the weighted variance" << endl;
+		cout << " of the input pixel values around this mean." << endl;
+	}
+
+	/// Per-input state: an open OpenEXR file and its weight
+	struct Input {
+		std::string filename;
+		boost::scoped_ptr<Imf::InputFile> file;
+		Float weight;
+	};
+
+	/**
+	 * \brief Set up an interleaved float32 frame buffer covering the
+	 * scanlines <tt>[y0, y0+lines)</tt> of a data window
+	 */
+	static void setupFrameBuffer(Imf::FrameBuffer &fb, float *data,
+			const std::vector<std::string> &channels, const Imath::Box2i &dw, int y0) {
+		size_t width = (size_t) (dw.max.x - dw.min.x + 1);
+		size_t xStride = channels.size() * sizeof(float),
+		       yStride = xStride * width;
+
+		char *base = (char *) data
+			- (ptrdiff_t) dw.min.x * (ptrdiff_t) xStride
+			- (ptrdiff_t) y0 * (ptrdiff_t) yStride;
+
+		for (size_t i=0; i<channels.size(); ++i)
+			fb.insert(channels[i].c_str(), Imf::Slice(Imf::FLOAT,
+				base + i * sizeof(float), xStride, yStride));
+	}
+
+	int run(int argc, char **argv) {
+		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+		int optchar;
+		char *end_ptr = NULL;
+		optind = 1;
+		std::string outputPrefix = "merged";
+		std::vector<Float> weights;
+		std::vector<std::string> filenames;
+		bool writeSD = false, writeVariance = true, forceFloat32 = false;
+		int nThreads = getCoreCount();
+		size_t memBudget = 1024;
+
+		/* Parse command-line arguments */
+		while ((optchar = getopt(argc, argv, "hsmfo:w:n:p:M:")) != -1) {
+			switch (optchar) {
+				case 'h': {
+						help();
+						return 0;
+					}
+					break;
+
+				case 'o':
+					outputPrefix = optarg;
+					break;
+
+				case 's':
+					writeSD = true;
+					break;
+
+				case 'm':
+					writeVariance = false;
+					break;
+
+				case 'f':
+					forceFloat32 = true;
+					break;
+
+				case 'w': {
+						std::vector<std::string> tokens = tokenize(optarg, ", ");
+						for (size_t i=0; i<tokens.size(); ++i) {
+							Float weight = (Float) std::strtod(tokens[i].c_str(), &end_ptr);
+							if (*end_ptr != '\0' || weight <= 0)
+								Log(EError, "Could not parse the weight \"%s\" (must be positive)!",
+									tokens[i].c_str());
+							weights.push_back(weight);
+						}
+					}
+					break;
+
+				case 'n': {
+						std::vector<std::string> tokens = tokenize(optarg, ",");
+						if (tokens.size() != 2)
+							Log(EError, "Invalid prefix parameter (expected prefix,N)!");
+						int count = (int) std::strtol(tokens[1].c_str(), &end_ptr, 10);
+						if (*end_ptr != '\0' || count <= 0)
+							Log(EError, "Could not parse the number of images!");
+						for (int i=0; i<count; ++i)
+							filenames.push_back(formatString("%s_%i.exr", tokens[0].c_str(), i));
+					}
+					break;
+
+				case 'p':
+					nThreads = (int) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || nThreads <= 0)
+						Log(EError, "Could not parse the thread count!");
+					break;
+
+				case 'M':
+					memBudget = (size_t) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || memBudget == 0)
+						Log(EError, "Could not parse the memory budget!");
+					break;
+			}
+		}
+
+		for (int i=optind; i<argc; ++i)
+			filenames.push_back(argv[i]);
+
+		if (filenames.empty()) {
+			help();
+			return 0;
+		}
+
+		if (weights.empty())
+			weights.resize(filenames.size(), (Float) 1);
+		else if (weights.size() != filenames.size())
+			Log(EError, "Specified %i weights for %i images!",
+				(int) weights.size(), (int) filenames.size());
+
+		#if defined(MTS_OPENMP)
+			Thread::initializeOpenMP(nThreads);
+		#else
+			nThreads = 1;
+		#endif
+
+		/* Open all inputs -- this only reads the headers and offset tables */
+		size_t nInputs = filenames.size();
+		boost::scoped_array<Input> inputs(new Input[nInputs]);
+		for (size_t i=0; i<nInputs; ++i) {
+			fs::path path = fileResolver->resolve(filenames[i]);
+			inputs[i].filename = path.string();
+			inputs[i].weight = weights[i];
+			inputs[i].file.reset(new Imf::InputFile(inputs[i].filename.c_str()));
+		}
+
+		const Imf::Header &refHeader = inputs[0].file->header();
+		Imath::Box2i dw = refHeader.dataWindow();
+		std::vector<std::string> channels;
+		for (Imf::ChannelList::ConstIterator it = refHeader.channels().begin();
+				it != refHeader.channels().end(); ++it) {
+			if (it.channel().xSampling != 1 || it.channel().ySampling != 1)
+				Log(EError, "\"%s\": sub-sampled channels are not supported!", inputs[0].filename.c_str());
+			channels.push_back(it.name());
+		}
+
+		/* A few sanity checks */
+		for (size_t i=1; i<nInputs; ++i) {
+			const Imf::Header &header = inputs[i].file->header();
+			if (header.dataWindow() != dw)
+				Log(EError, "\"%s\" and \"%s\" have different data windows!",
+					inputs[0].filename.c_str(), inputs[i].filename.c_str());
+			size_t idx = 0;
+			for (Imf::ChannelList::ConstIterator it = header.channels().begin();
+					it != header.channels().end(); ++it, ++idx) {
+				if (idx >= channels.size() || channels[idx] != it.name())
+					Log(EError, "\"%s\" and \"%s\" have different channels!",
+						inputs[0].filename.c_str(), inputs[i].filename.c_str());
+			}
+			if (idx != channels.size())
+				Log(EError, "\"%s\" and \"%s\" have different channels!",
+					inputs[0].filename.c_str(), inputs[i].filename.c_str());
+		}
+
+		size_t width = (size_t) (dw.max.x - dw.min.x + 1),
+		       height = (size_t) (dw.max.y - dw.min.y + 1),
+		       entriesPerLine = width * channels.size();
+
+		/* Read up to 'nThreads' inputs concurrently. Choose the band height so
+		   that the read buffers and the accumulators stay within the budget */
+		size_t batchSize = std::min(nInputs, (size_t) nThreads);
+		size_t bytesPerLine = entriesPerLine *
+			(batchSize * sizeof(float) + 2 * sizeof(double) + sizeof(float));
+		size_t bandHeight = std::max((size_t) 1, (memBudget * 1024 * 1024) / bytesPerLine);
+		bandHeight = std::min(bandHeight, height);
+
+		Log(EInfo, "Merging %i images of %ix%i pixels with %i channels (%i scanlines per band, %i threads) ..",
+			(int) nInputs, (int) width, (int) height, (int) channels.size(),
+			(int) bandHeight, nThreads);
+
+		/* Prepare the output files */
+		Imf::Header outHeader(refHeader);
+		outHeader.insert("mergedImages", Imf::IntAttribute((int) nInputs));
+		if (outHeader.findTypedAttribute<Imf::StringAttribute>("log"))
+			outHeader.erase("log");
+		if (forceFloat32) {
+			Imf::ChannelList outChannels;
+			for (size_t i=0; i<channels.size(); ++i)
+				outChannels.insert(channels[i].c_str(), Imf::Channel(Imf::FLOAT));
+			outHeader.channels() = outChannels;
+		}
+
+		std::string meanFilename = outputPrefix + "_mean.exr",
+		            varFilename = outputPrefix + (writeSD ? "_sd.exr" : "_var.exr");
+		boost::scoped_ptr<Imf::OutputFile> meanFile(new Imf::OutputFile(meanFilename.c_str(), outHeader));
+		boost::scoped_ptr<Imf::OutputFile> varFile;
+		if (writeVariance)
+			varFile.reset(new Imf::OutputFile(varFilename.c_str(), outHeader));
+
+		size_t bandEntries = bandHeight * entriesPerLine;
+		std::vector<float> readBuffer(batchSize * bandEntries);
+		std::vector<float> outBuffer(bandEntries);
+		std::vector<double> mean(bandEntries), m2(bandEntries);
+		std::vector<std::string> messages;
+		double totalVariance = 0;
+		double totalWeight = 0;
+		for (size_t i=0; i<nInputs; ++i)
+			totalWeight += inputs[i].weight;
+
+		ref<Timer> timer = new Timer();
+		for (int y0 = dw.min.y; y0 <= dw.max.y; y0 += (int) bandHeight) {
+			int y1 = std::min(y0 + (int) bandHeight - 1, dw.max.y);
+			size_t nEntries = (size_t) (y1 - y0 + 1) * entriesPerLine;
+
+			std::fill(mean.begin(), mean.begin() + nEntries, 0.0);
+			std::fill(m2.begin(), m2.begin() + nEntries, 0.0);
+			double weightSum = 0;
+
+			for (size_t batchStart = 0; batchStart < nInputs; batchStart += batchSize) {
+				int batchEnd = (int) std::min(batchStart + batchSize, nInputs);
+
+				/* Stream the current band of each input of this batch */
+				#if defined(MTS_OPENMP)
+					#pragma omp parallel for schedule(dynamic)
+				#endif
+				for (int i=(int) batchStart; i<batchEnd; ++i) {
+					try {
+						Imf::FrameBuffer fb;
+						setupFrameBuffer(fb, &readBuffer[(i - batchStart) * bandEntries], channels, dw, y0);
+						inputs[i].file->setFrameBuffer(fb);
+						inputs[i].file->readPixels(y0, y1);
+					} catch (const std::exception &e) {
+						#if defined(MTS_OPENMP)
+							#pragma omp critical
+						#endif
+						messages.push_back(formatString("\"%s\": %s",
+							inputs[i].filename.c_str(), e.what()));
+					}
+				}
+
+				if (!messages.empty()) {
+					for (size_t i=0; i<messages.size(); ++i)
+						Log(EWarn, "%s", messages[i].c_str());
+					Log(EError, "Could not read the input images!");
+				}
+
+				/* Weighted incremental mean/variance update, in input order */
+				double weightSumStart = weightSum;
+				#if defined(MTS_OPENMP)
+					#pragma omp parallel for schedule(static)
+				#endif
+				for (ptrdiff_t j=0; j<(ptrdiff_t) nEntries; ++j) {
+					double W = weightSumStart, mu = mean[j], S = m2[j];
+					for (int i=(int) batchStart; i<batchEnd; ++i) {
+						double w = inputs[i].weight,
+						       x = readBuffer[(i - batchStart) * bandEntries + j];
+						W += w;
+						double delta = x - mu;
+						mu += delta * (w / W);
+						S += w * delta * (x - mu);
+					}
+					mean[j] = mu;
+					m2[j] = S;
+				}
+
+				for (int i=(int) batchStart; i<batchEnd; ++i)
+					weightSum += inputs[i].weight;
+			}
+
+			/* Write the band to the output files */
+			Imf::FrameBuffer fb;
+			setupFrameBuffer(fb, &outBuffer[0], channels, dw, y0);
+
+			for (size_t j=0; j<nEntries; ++j)
+				outBuffer[j] = (float) mean[j];
+			meanFile->setFrameBuffer(fb);
+			meanFile->writePixels(y1 - y0 + 1);
+
+			if (writeVariance) {
+				double bandVariance = 0;
+				#if defined(MTS_OPENMP)
+					#pragma omp parallel for schedule(static) reduction(+:bandVariance)
+				#endif
+				for (ptrdiff_t j=0; j<(ptrdiff_t) nEntries; ++j) {
+					double variance = std::max(0.0, m2[j] / totalWeight);
+					bandVariance += variance;
+					outBuffer[j] = (float) (writeSD ? std::sqrt(variance) : variance);
+				}
+				totalVariance += bandVariance;
+				varFile->setFrameBuffer(fb);
+				varFile->writePixels(y1 - y0 + 1);
+			}
+
+			Log(EDebug, "Processed scanlines %i..%i", y0, y1);
+		}
+
+		Log(EInfo, "Wrote \"%s\"%s (took %s)", meanFilename.c_str(),
+			writeVariance ? formatString(" and \"%s\"", varFilename.c_str()).c_str() : "",
+			timeString(timer->getSeconds()).c_str());
+		if (writeVariance)
+			Log(EInfo, "Total variance: %f", totalVariance);
+
+		return 0;
+	}
+
+	MTS_DECLARE_UTILITY()
+};
+
+MTS_EXPORT_UTILITY(MergeImages, "Streaming mean/variance merge of independent EXR renderings")
+MTS_NAMESPACE_END
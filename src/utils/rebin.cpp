@@ -0,0 +1,223 @@
+/*
+    This file is part of Mitsuba, a physically based rendering system.
+
+    Copyright (c) 2007-2014 by Wenzel Jakob and others.
+
+    Mitsuba is free software; you can redistribute it and/or modify
+    it under the terms of the GNU General Public License Version 3
+    as published by the Free Software Foundation.
+
+    Mitsuba is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE. See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program. If not, see <http://www.gnu.org/licenses/>.
+*/
+
+#include <mitsuba/render/util.h>
+#include <mitsuba/render/timetag.h>
+#include <mitsuba/core/timer.h>
+#include <mitsuba/core/fresolver.h>
+#include <mitsuba/core/bitmap.h>
+#if defined(WIN32)
+# include <mitsuba/core/getopt.h>
+#endif
+
+MTS_NAMESPACE_BEGIN
+
+/* Number of events that are read from the file at once */
+#define REBIN_CHUNK_SIZE (1 << 20)
+
+/**
+ * \brief Bins the raw events of a time-tag file (written by the
+ * bidirectional path tracer's \c timeTags mode) into a transient image
+ */
+class Rebin : public Utility {
+public:
+	void help() {
+		cout << endl;
+		cout << "Synopsis: Bins the events of a time-tag (.ttag) file into a transient image" << endl;
+		cout << endl;
+		cout << "Usage: mtsutil rebin [options] <TTAG file>" << endl;
+		cout << "Options/Arguments:" << endl;
+		cout << "   -h             Display this help text" << endl << endl;
+		cout << "   -o file        Output EXR file (Default: the input filename with" << endl;
+		cout << "                  the extension .exr). Time bins are stored as the" << endl;
+		cout << "                  layers '1', '2', .. like the output of 'hdrfilm'" << endl << endl;
+		cout << "   -r min,max     Range of path lengths (or bounce orders, when the" << endl;
+		cout << "                  film used a bounce decomposition) to bin" << endl;
+		cout << "                  (Default: the range of the rendering)" << endl << endl;
+		cout << "   -w width       Width of a time bin (Default: the film's bin width)" << endl << endl;
+		cout << "   -n bins        Number of time bins; overrides the bin width" << endl << endl;
+		cout << "   -b min,max     Only include paths with the given (inclusive) range" << endl;
+		cout << "                  of bounces" << endl << endl;
+		cout << "   -l             Exclude the light image contributions" << endl;
+	}
+
+	int run(int argc, char **argv) {
+		ref<FileResolver> fileResolver = Thread::getThread()->getFileResolver();
+		int optchar;
+		char *end_ptr = NULL;
+		optind = 1;
+		std::string outputFile;
+		Float range[] = {-1, -1}, binWidth = -1;
+		int bins = -1, bounces[] = {0, -1};
+		bool excludeLightImage = false;
+
+		/* Parse command-line arguments */
+		while ((optchar = getopt(argc, argv, "ho:r:w:n:b:l")) != -1) {
+			switch (optchar) {
+				case 'h': {
+						help();
+						return 0;
+					}
+					break;
+
+				case 'o':
+					outputFile = optarg;
+					break;
+
+				case 'r': {
+						std::vector<std::string> tokens = tokenize(optarg, ", ");
+						if (tokens.size() != 2)
+							Log(EError, "Invalid path length range parameter!");
+						for (int i=0; i<2; ++i) {
+							range[i] = (Float) std::strtod(tokens[i].c_str(), &end_ptr);
+							if (*end_ptr != '\0')
+								Log(EError, "Cannot parse the path length range!");
+						}
+					}
+					break;
+
+				case 'w':
+					binWidth = (Float) std::strtod(optarg, &end_ptr);
+					if (*end_ptr != '\0' || binWidth <= 0)
+						Log(EError, "Could not parse the bin width!");
+					break;
+
+				case 'n':
+					bins = (int) std::strtol(optarg, &end_ptr, 10);
+					if (*end_ptr != '\0' || bins <= 0)
+						Log(EError, "Could not parse the number of bins!");
+					break;
+
+				case 'b': {
+						std::vector<std::string> tokens = tokenize(optarg, ", ");
+						if (tokens.size() != 2)
+							Log(EError, "Invalid bounce range parameter!");
+						for (int i=0; i<2; ++i) {
+							bounces[i] = (int) std::strtol(tokens[i].c_str(), &end_ptr, 10);
+							if (*end_ptr != '\0')
+								Log(EError, "Cannot parse integer in bounce range parameter!");
+						}
+					}
+					break;
+
+				case 'l':
+					excludeLightImage = true;
+					break;
+			}
+		}
+
+		if (optind + 1 != argc) {
+			help();
+			return 0;
+		}
+
+		fs::path inputFile = fileResolver->resolve(argv[optind]);
+		ref<TimeTagFile> file = new TimeTagFile(inputFile);
+		const TimeTagFile::Header &header = file->getHeader();
+
+		/* The events store the quantity that the film decomposed by */
+		const char *quantity = NULL;
+		switch (header.decompositionType) {
+			case Film::ETransient:
+			case Film::ETransientEllipse:
+				quantity = "path lengths";
+				break;
+			case Film::EBounce:
+				quantity = "bounce orders";
+				break;
+			default:
+				Log(EError, "\"%s\" does not contain a transient or bounce decomposition "
+					"(decomposition type %i)!", inputFile.string().c_str(),
+					(int) header.decompositionType);
+		}
+
+		if (range[0] < 0 && range[1] < 0) {
+			range[0] = header.minBound;
+			range[1] = header.maxBound;
+		}
+		if (range[1] <= range[0])
+			Log(EError, "The range of %s is empty!", quantity);
+
+		if (bins < 0) {
+			if (binWidth < 0)
+				binWidth = header.binWidth;
+			if (binWidth <= 0)
+				Log(EError, "The file does not specify a bin width; please pass -w or -n!");
+			bins = std::max(1, (int) std::ceil((range[1] - range[0]) / binWidth - 1e-4f));
+		} else {
+			binWidth = (range[1] - range[0]) / bins;
+		}
+
+		if (outputFile.empty()) {
+			fs::path path = inputFile;
+			outputFile = path.replace_extension(".exr").string();
+		}
+
+		Log(EInfo, "Binning " SIZE_T_FMT " events of a %ix%i rendering by their %s into "
+			"%i bins of width %f ..", (size_t) header.eventCount, header.size.x, header.size.y,
+			quantity, bins, binWidth);
+
+		ref<Timer> timer = new Timer();
+		size_t nPixels = (size_t) header.size.x * (size_t) header.size.y;
+		ref<Bitmap> bitmap = new Bitmap(Bitmap::EMultiChannel, Bitmap::EFloat32,
+			header.size, 3 * bins);
+		bitmap->clear();
+		float *data = bitmap->getFloat32Data();
+		float invSampleCount = header.sampleCount > 0
+			? 1.0f / (float) header.sampleCount : 1.0f;
+
+		std::vector<TimeTagEvent> events;
+		size_t binned = 0;
+		while (file->read(events, REBIN_CHUNK_SIZE) > 0) {
+			for (size_t i=0; i<events.size(); ++i) {
+				const TimeTagEvent &event = events[i];
+				if (event.pixel >= nPixels || event.bounces < bounces[0] ||
+					(bounces[1] >= 0 && event.bounces > bounces[1]) ||
+					(excludeLightImage && (event.flags & TimeTagEvent::ELightImage)))
+					continue;
+				if (event.pathLength < range[0] || event.pathLength >= range[1])
+					continue;
+				int bin = std::min((int) ((event.pathLength - range[0]) / binWidth), bins - 1);
+				float *target = data + (size_t) event.pixel * 3 * bins + 3 * bin;
+				for (int k=0; k<3; ++k)
+					target[k] += event.value[k] * invSampleCount;
+				binned++;
+			}
+		}
+		file->close();
+
+		std::vector<std::string> channelNames;
+		for (int i=0; i<bins; ++i) {
+			std::string name = formatString("%i.", i+1);
+			channelNames.push_back(name + "R");
+			channelNames.push_back(name + "G");
+			channelNames.push_back(name + "B");
+		}
+		bitmap->setChannelNames(channelNames);
+
+		Log(EInfo, "Writing " SIZE_T_FMT " binned events to \"%s\" (took %i ms)",
+			binned, outputFile.c_str(), timer->getMilliseconds());
+		bitmap->write(Bitmap::EOpenEXR, outputFile);
+		return 0;
+	}
+
+	MTS_DECLARE_UTILITY()
+};
+
+MTS_EXPORT_UTILITY(Rebin, "Bin the events of a time-tag file into a transient image")
+MTS_NAMESPACE_END